@@ -0,0 +1,32 @@
+
+// PackedVertex (see vertex_packed.h): inputs of vs_*_packed.hlsl.
+// Same constant buffer as for Vertex, with the mesh dequantization after.
+cbuffer VSConstantBuffer : register(b0)
+{
+    float4x4 World;
+    float4x4 View;
+    float4x4 Projection;
+    float4 PositionScale;
+    float4 PositionOffset;
+    float4 TexCoordTransform; // xy = scale, zw = offset
+}
+
+float3 DecodePosition(float4 Position)
+{
+    return Position.xyz * PositionScale.xyz + PositionOffset.xyz;
+}
+
+float2 DecodeTexCoord(float2 Tex)
+{
+    return Tex * TexCoordTransform.xy + TexCoordTransform.zw;
+}
+
+// Octahedral; same as VertexPacked_OctDecode().
+float3 OctDecode(float2 Encoded)
+{
+    float3 n = float3(Encoded.x, Encoded.y, 1.0 - abs(Encoded.x) - abs(Encoded.y));
+    float t  = saturate(-n.z);
+    n.x     += (n.x >= 0.0) ? -t : t;
+    n.y     += (n.y >= 0.0) ? -t : t;
+    return normalize(n);
+}
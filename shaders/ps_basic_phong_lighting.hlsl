@@ -2,6 +2,9 @@
 
 Texture2D TextureDiffuse   : register(t0);
 Texture2D TextureNormal    : register(t1);
+// Same textures, once packed (see RenderModel::pack_textures()).
+Texture2DArray TextureDiffuseArray : register(t2);
+Texture2DArray TextureNormalArray  : register(t3);
 SamplerState SamplerLinear : register(s0);
 
 struct PointLight
@@ -18,24 +21,55 @@ cbuffer PSConstantBuffer0 : register(b0)
     float4 ViewerPosition;
     // x = has texture
     // y = lights count
+    // z = normal map is BC5: x, y only, z is reconstructed
+    // w = mesh has a normal map; tangents are not there otherwise (see PackedTangent)
     float4 Parameters;
+    // x = diffuse slice, y = normal slice
+    // z = diffuse is a slice of TextureDiffuseArray, w = normal is a slice of TextureNormalArray
+    float4 TextureSlices;
 };
 
+float4 SampleDiffuse(float2 uv)
+{
+    if (TextureSlices.z > 0)
+    {
+        return TextureDiffuseArray.Sample(SamplerLinear, float3(uv, TextureSlices.x));
+    }
+    return TextureDiffuse.Sample(SamplerLinear, uv);
+}
+
+float4 SampleNormal(float2 uv)
+{
+    if (TextureSlices.w > 0)
+    {
+        return TextureNormalArray.Sample(SamplerLinear, float3(uv, TextureSlices.y));
+    }
+    return TextureNormal.Sample(SamplerLinear, uv);
+}
+
 float4 main_ps(VS_OUTPUT input) : SV_Target
 {
     float3 object_color;
     float3 normal;
 
-    if (Parameters.x > 0)
+    if ((Parameters.x > 0) && (Parameters.w > 0))
     {
-        object_color = (float3)TextureDiffuse.Sample(SamplerLinear, input.Tex);
+        object_color = (float3)SampleDiffuse(input.Tex);
         // object_color = float3(1.0, 1.0, 1.0);
 
-        float3 tangent_normal = (float3)TextureNormal.Sample(SamplerLinear, input.Tex);
-        // sRGB.
-        tangent_normal = pow(abs(tangent_normal), 1/2.2);
-
-        tangent_normal = tangent_normal * 2.0 - 1.0; // [0; 1] -> [-1; 1]
+        float3 tangent_normal;
+        if (Parameters.z > 0)
+        {
+            // Linear (DXGI_FORMAT_BC5_UNORM).
+            float2 xy = SampleNormal(input.Tex).xy * 2.0 - 1.0;
+            tangent_normal = float3(xy, sqrt(saturate(1.0 - dot(xy, xy))));
+        }
+        else
+        {
+            // Linear as well: normal maps are never uploaded as sRGB (see Texture::srgb).
+            tangent_normal = (float3)SampleNormal(input.Tex);
+            tangent_normal = tangent_normal * 2.0 - 1.0; // [0; 1] -> [-1; 1]
+        }
         float3x3 TBN = float3x3(
               normalize(input.Tangent)
             , normalize(input.Binormal)
@@ -44,6 +78,11 @@ float4 main_ps(VS_OUTPUT input) : SV_Target
         // https://stackoverflow.com/questions/16555669/hlsl-normal-mapping-matrix-multiplication
         normal = mul(tangent_normal, TBN);
     }
+    else if (Parameters.x > 0)
+    {
+        object_color = (float3)SampleDiffuse(input.Tex);
+        normal = normalize(input.Normal);
+    }
     else
     {
         object_color = float3(1.0, 1.0, 1.0);
@@ -0,0 +1,23 @@
+#include "common_basic_phong_lighting.hlsl"
+#include "common_vertex_packed.hlsl"
+
+// vs_basic_phong_lighting.hlsl for PackedVertex.
+VS_OUTPUT main_vs(
+      float4 Position  : POSITION
+    , float2 Normal    : NORMAL
+    , float2 Tangent   : TANGENT // slot 1 (PackedTangent); zero without a normal map
+    , float2 Tex       : TEXCOORD0)
+{
+    VS_OUTPUT output  = (VS_OUTPUT)0;
+    output.WorldPos   = (float3)mul(World, float4(DecodePosition(Position), 1.0));
+    output.Tex        = DecodeTexCoord(Tex);
+    output.Position   = float4(output.WorldPos, 1.0);
+    output.Position   = mul(View, output.Position);
+    output.Position   = mul(Projection, output.Position);
+
+    float3x3 World3x3 = (float3x3)World;
+    output.Normal     = normalize(mul(World3x3, OctDecode(Normal)));
+    output.Tangent    = normalize(mul(World3x3, OctDecode(Tangent)));
+    output.Binormal   = normalize(cross(output.Normal, output.Tangent));
+    return output;
+}
@@ -0,0 +1,16 @@
+#include "common_gooch_shading.hlsl"
+#include "common_vertex_packed.hlsl"
+
+// vs_gooch_shading.hlsl for PackedVertex.
+VS_OUTPUT main_vs(float4 Position : POSITION, float2 Normal : NORMAL)
+{
+    float3x3 World3x3 = (float3x3)World;
+
+    VS_OUTPUT output  = (VS_OUTPUT)0;
+    output.WorldPos   = (float3)mul(World, float4(DecodePosition(Position), 1.0));
+    output.Normal     = normalize(mul(World3x3, OctDecode(Normal)));
+    output.Position   = float4(output.WorldPos, 1.0);
+    output.Position   = mul(View, output.Position);
+    output.Position   = mul(Projection, output.Position);
+    return output;
+}
@@ -0,0 +1,15 @@
+#include "common_lines.hlsl"
+#include "common_vertex_packed.hlsl"
+
+// vs_lines.hlsl for PackedVertex: normal is the color, as with Vertex.
+VS_OUTPUT main_vs(
+      float4 Position : POSITION
+    , float2 Color    : COLOR)
+{
+    VS_OUTPUT output = (VS_OUTPUT)0;
+    output.Position  = mul(World, float4(DecodePosition(Position), 1.0));
+    output.Position  = mul(View, output.Position);
+    output.Position  = mul(Projection, output.Position);
+    output.Color     = OctDecode(Color);
+    return output;
+}
@@ -0,0 +1,21 @@
+#include "common_vertex_packed.hlsl"
+
+// vs_normals.hlsl for PackedVertex.
+struct VS_OUTPUT
+{
+    float4 Position : SV_POSITION;
+    float3 Normal : NORMAL;
+};
+
+VS_OUTPUT main_vs(float4 Position : POSITION, float2 Normal : NORMAL)
+{
+    float3x3 World3x3 = (float3x3)World;
+
+    VS_OUTPUT output;
+    output.Position   = mul(World, float4(DecodePosition(Position), 1.0));
+    output.Position   = mul(View, output.Position);
+    output.Position   = mul(Projection, output.Position);
+    output.Normal     = normalize(mul(World3x3, OctDecode(Normal)));
+
+    return output;
+}
@@ -0,0 +1,16 @@
+#include "common_vertex_packed.hlsl"
+
+// vs_vertices_only.hlsl for PackedVertex.
+struct VS_OUTPUT
+{
+    float4 Position : SV_POSITION;
+};
+
+VS_OUTPUT main_vs(float4 Position : POSITION)
+{
+    VS_OUTPUT output;
+    output.Position = mul(World, float4(DecodePosition(Position), 1.0));
+    output.Position = mul(View, output.Position);
+    output.Position = mul(Projection, output.Position);
+    return output;
+}
@@ -1,7 +1,9 @@
 #include "app_state.h"
 #include "shaders_database.h"
+#include "utils_log.h"
 
 #include <algorithm>
+#include <chrono>
 #include <filesystem>
 
 #include <glm/gtc/epsilon.hpp>
@@ -14,6 +16,11 @@
         {&c_vs_lines, {}, {}},
         {&c_vs_vertices_only, {}, {}},
         {&c_vs_normals, {}, {}},
+        {&c_vs_basic_phong_packed, {}, {}},
+        {&c_vs_gooch_shading_packed, {}, {}},
+        {&c_vs_lines_packed, {}, {}},
+        {&c_vs_vertices_only_packed, {}, {}},
+        {&c_vs_normals_packed, {}, {}},
     };
     const PSShader ps_shaders[] = {
         {&c_ps_gooch_shading, {}},
@@ -41,6 +48,41 @@ const VSShader* Shaders::find_vs(const ShaderInfo& info) const
     return nullptr;
 }
 
+// VS for Vertex & its variant for PackedVertex (see vertex_packed.h);
+// every VS that can be picked for a model has one.
+static const ShaderInfo* const c_vs_packed_variants[][2] = {
+    {&c_vs_basic_phong, &c_vs_basic_phong_packed},
+    {&c_vs_gooch_shading, &c_vs_gooch_shading_packed},
+    {&c_vs_lines, &c_vs_lines_packed},
+    {&c_vs_vertices_only, &c_vs_vertices_only_packed},
+    {&c_vs_normals, &c_vs_normals_packed},
+};
+
+const VSShader* Shaders::find_packed_vs(const VSShader& vs) const
+{
+    for (const auto& variants : c_vs_packed_variants)
+    {
+        if (vs.vs_info == variants[0])
+        {
+            return find_vs(*variants[1]);
+        }
+    }
+    // The layout can't match PackedVertex.
+    return nullptr;
+}
+
+bool Shaders::is_packed_vs(const VSShader& vs) const
+{
+    for (const auto& variants : c_vs_packed_variants)
+    {
+        if (vs.vs_info == variants[1])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 const PSShader* Shaders::find_ps(const ShaderInfo& info) const
 {
     Panic(info.kind == ShaderInfo::PS);
@@ -343,148 +385,273 @@ void Init_MessageHandling(AppState& app)
     });
 }
 
-template <typename T>
-static void RemoveDuplicates(std::vector<T>& es)
-{
-    std::sort(std::begin(es), std::end(es));
-    auto it = std::unique(std::begin(es), std::end(es));
-    es.erase(it, std::end(es));
-}
-
-static std::string GetPathFileName(const std::string& path)
+// Changed file drops its loaded model and kept GPU resources (loaded again on select);
+// new ones go to the end.
+static void AddCatalogFile(AppState& app, CatalogFile&& file)
 {
-    auto name = std::filesystem::path(path).stem();
-    while (name.has_extension())
+    for (std::size_t i = 0, count = app.models_.size(); i < count; ++i)
     {
-        auto next = name.stem();
-        if (next == name)
+        FileModel& fm = app.models_[i];
+        if (fm.file_name != file.file_name)
         {
-            break;
+            continue;
+        }
+        if (file.changed)
+        {
+            if (int(i) == app.active_model_index_)
+            {
+                // Upload reads the old model's data; stop it and re-create from the new one.
+                app.upload_job_.reset();
+                app.chunk_pager_.reset();
+                app.texture_streamer_.reset();
+                app.active_model_index_ = -1;
+            }
+            fm.model = Model();
+            app.residency_.forget(fm.file_name);
         }
-        name = std::move(next);
+        return;
     }
-    return name.string();
+    FileModel& fm = app.models_.emplace_back();
+    fm.file_name = std::move(file.file_name);
+    fm.name = std::move(file.name);
 }
 
-static void TryLoadModelsFromPaths(AppState& app, std::vector<std::string> paths)
+// Once all meshes are uploaded (see RenderMesh::make()).
+static void LogVertexPacking(const std::string& file_name, const RenderModel& model)
 {
-    std::vector<std::string> folders;
-    std::vector<std::string> files;
-    for (std::string& p : paths)
+    const VertexPackStats stats = model.vertex_pack_stats();
+    if (stats.meshes == 0)
     {
-        std::error_code ec;
-        std::filesystem::path path(p);
-        if (std::filesystem::is_directory(path, ec))
-        {
-            folders.push_back(std::move(p));
-        }
-        else if (std::filesystem::is_regular_file(path, ec))
-        {
-            files.push_back(path.make_preferred().string());
-            // We also want to get all files in the same directory.
-            folders.push_back(path.parent_path().make_preferred().string());
-        }
-        Panic(!ec);
+        return;
     }
-    RemoveDuplicates(folders);
-    // Collect all files in a folder.
-    for (std::string& f : folders)
+    const VertexPackError& error = stats.max_error;
+    LogDebug(
+        "[model] '%s': packed vertices %.2f -> %.2f MiB; max error: position %.3g (%.4f%% of the size),"
+        " normal %.4f deg, tangent %.4f deg, uv %.3g.\n",
+        file_name.c_str(),
+        double(stats.bytes_before) / (1024.0 * 1024.0),
+        double(stats.bytes_after) / (1024.0 * 1024.0),
+        double(error.position),
+        double(error.position_relative) * 100.0,
+        double(error.normal_degrees),
+        double(error.tangent_degrees),
+        double(error.texture_coord)
+    );
+}
+
+bool TickModelsLoad(AppState& app)
+{
+    if (app.pack_job_.valid() && (app.pack_job_.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
     {
-        for (const auto& e : std::filesystem::recursive_directory_iterator(f))
+        std::string package_path = app.pack_job_.get();
+        if (!package_path.empty())
         {
-            if (e.is_regular_file())
-            {
-                auto path = e.path();
-                files.push_back(path.make_preferred().string());
-            }
+            // List models from the package next to the unpacked ones.
+            app.files_to_load_.push_back(std::move(package_path));
         }
     }
-    RemoveDuplicates(files);
 
-    std::vector<FileModel> models;
-    for (std::string& f : files)
+    if ((app.files_to_load_.size() > 0) && !app.list_job_)
     {
-        const std::string ext = std::filesystem::path(f).extension().string();
-        if (ext != ".obj")
-        {
-            continue;
-        }
-        auto maybe_model = LoadModel(f.c_str());
-        if (!maybe_model)
-        {
-            continue;
-        }
-        models.push_back({});
-        FileModel& fm = models.back();
-        fm.file_name = std::move(f);
-        fm.name = GetPathFileName(fm.file_name);
-        fm.model = std::move(maybe_model.value());
+        // If we dropped single file, select it for convenience.
+        const bool force_select = (app.files_to_load_.size() == 1) //
+                                  && (std::filesystem::is_regular_file(app.files_to_load_[0]));
+        app.select_on_list_ =
+            force_select ? std::filesystem::path(app.files_to_load_[0]).make_preferred().string() : std::string();
+        app.list_job_ = ModelListJob::start(std::exchange(app.files_to_load_, {}), app.file_index_);
     }
 
-    std::vector<FileModel> old_models = std::move(app.models_);
-    app.models_ = std::move(models);
-    auto has_model = [&](const std::string& file_name) {
-        for (const FileModel& m : app.models_)
+    if (app.list_job_)
+    {
+        // Check before draining: nothing is pushed after finished().
+        const bool finished = app.list_job_->finished();
+        CatalogFile file;
+        while (app.list_job_->try_pop(file))
         {
-            if (m.file_name == file_name)
+            if (file.file_name == app.select_on_list_)
             {
-                return true;
+                app.imgui_.selected_model_index_ = int(app.models_.size());
+                for (std::size_t i = 0, count = app.models_.size(); i < count; ++i)
+                {
+                    if (app.models_[i].file_name == file.file_name)
+                    {
+                        app.imgui_.selected_model_index_ = int(i);
+                        break;
+                    }
+                }
             }
+            AddCatalogFile(app, std::move(file));
         }
-        return false;
-    };
-    for (FileModel& old_model : old_models)
-    {
-        if (!has_model(old_model.file_name))
+        if (finished)
         {
-            app.models_.push_back(std::move(old_model));
+            app.list_job_.reset();
         }
     }
-}
 
-bool TickModelsLoad(AppState& app)
-{
-    bool refresh = false;
-    if (app.files_to_load_.size() > 0)
+    for (const ModelLoader::Loaded& loaded : app.loader_.collect(app.models_))
     {
-        const bool force_select = (app.files_to_load_.size() == 1) //
-                                  && (std::filesystem::is_regular_file(app.files_to_load_[0]));
-        const auto select_file = std::filesystem::path(app.files_to_load_[0]).make_preferred().string();
+        app.residency_.on_loaded(app.models_[loaded.index], loaded.load_ms);
+    }
 
-        TryLoadModelsFromPaths(app, std::exchange(app.files_to_load_, {}));
+    if (app.imgui_.check_pack_vertices_change() && (app.active_model_index_ >= 0))
+    {
+        // Meshes are of one vertex format: re-created from the model below, as on a select.
+        // Kept models (see ModelResidency) stay as they were uploaded.
+        app.upload_job_.reset();
+        app.chunk_pager_.reset();
+        app.texture_streamer_.reset();
+        app.active_model_index_ = -1;
+    }
 
-        // If we dropped single file, select it for convenience.
-        if (force_select)
+    const bool has_selection = (app.imgui_.selected_model_index_ >= 0)
+                               && (std::size_t(app.imgui_.selected_model_index_) < app.models_.size());
+    bool changed = false;
+    // Model's change from the UI/initial change. The previous one stays on the screen
+    // (and keeps streaming) until the selected one is loaded.
+    if (has_selection && (app.imgui_.selected_model_index_ != app.active_model_index_))
+    {
+        const std::size_t selected = std::size_t(app.imgui_.selected_model_index_);
+        const FileModel& fm = app.models_[selected];
+        app.residency_.touch(fm.file_name);
+        RenderModel kept;
+        const bool has_kept = app.residency_.take(fm.file_name, kept);
+        // Also prefetches neighbors.
+        app.loader_.request(app.models_, selected, !has_kept);
+        if (has_kept || fm.model.is_loaded())
         {
-            for (std::size_t i = 0, count = app.models_.size(); i < count; ++i)
+            if ((app.active_model_index_ >= 0) && !app.upload_job_ && !app.chunk_pager_.is_active()
+                && (!app.texture_streamer_.is_active() || app.texture_streamer_.is_settled()))
             {
-                if (app.models_[i].file_name == select_file)
+                // Fully uploaded (streamed textures as of now); switching back to it is free
+                // while it fits the GPU budget.
+                const FileModel& active = app.models_[std::size_t(app.active_model_index_)];
+                app.residency_.keep(active.file_name, std::move(app.active_model_));
+            }
+            app.upload_job_.reset();
+            app.chunk_pager_.reset();
+            app.texture_streamer_.reset();
+            app.active_model_index_ = int(selected);
+            if (has_kept)
+            {
+                app.active_model_ = std::move(kept);
+            }
+            else
+            {
+                app.active_model_ = RenderModel::make(*app.device_.Get());
+                app.active_model_.pack_vertices_ = app.imgui_.pack_vertices;
+                app.active_model_.aabb_min = fm.model.aabb_min();
+                app.active_model_.aabb_max = fm.model.aabb_max();
+                // Coarsest mips first, finer ones by tick().
+                const bool stream_textures = app.texture_streamer_.is_needed(fm.model);
+                if (stream_textures)
+                {
+                    app.texture_streamer_.start(*app.device_.Get(), fm.model, app.active_model_);
+                }
+                if (app.chunk_pager_.is_needed(fm.model))
+                {
+                    app.chunk_pager_.start(*app.device_.Get(), fm.model, app.active_model_, !stream_textures);
+                }
+                else
                 {
-                    app.imgui_.selected_model_index_ = int(i);
-                    break;
+                    app.upload_job_ = ModelUploadJob::start(
+                        *app.device_.Get(),
+                        fm.model,
+                        !stream_textures,
+                        app.active_model_.pack_vertices_
+                    );
                 }
             }
+            app.active_model_.vs_shader_ = &app.all_shaders_.vs_shaders_[app.imgui_.model_vs_index];
+            app.active_model_.vs_packed_shader_ = app.all_shaders_.find_packed_vs(*app.active_model_.vs_shader_);
+            app.active_model_.ps_shader_ = &app.all_shaders_.ps_shaders_[app.imgui_.model_ps_index];
+            changed = true;
         }
-        refresh = true;
     }
 
-    if (app.imgui_.selected_model_index_ != app.active_model_index_)
+    if (app.upload_job_ && app.upload_job_->drain(app.active_model_))
     {
-        refresh = true;
+        app.upload_job_.reset();
+        LogVertexPacking(app.models_[std::size_t(app.active_model_index_)].file_name, app.active_model_);
     }
 
-    // Model's change from the UI/initial change.
-    if (refresh)
+    const std::string no_model;
+    const std::string& selected_name =
+        has_selection ? app.models_[std::size_t(app.imgui_.selected_model_index_)].file_name : no_model;
+    const std::string& active_name =
+        (app.active_model_index_ >= 0) ? app.models_[std::size_t(app.active_model_index_)].file_name : no_model;
+    app.residency_.trim(app.models_, selected_name, active_name, app.active_model_.memory_bytes());
+    return changed;
+}
+
+bool TickModelsHotReload(AppState& app)
+{
+    if (app.active_model_index_ < 0)
     {
-        app.active_model_index_ = app.imgui_.selected_model_index_;
-        const Model& model = app.models_[std::size_t(app.imgui_.selected_model_index_)].model;
+        app.model_watch_.watch(std::string());
+        return false;
+    }
+    FileModel& fm = app.models_[std::size_t(app.active_model_index_)];
+    app.model_watch_.watch(fm.file_name);
+    ModelTextureStreamer& streamer = app.texture_streamer_;
+    if (app.upload_job_ || app.chunk_pager_.is_active() || (streamer.is_active() && !streamer.is_settled()))
+    {
+        // Reads the model's data into active_model_; both are patched once it's done.
+        // Paged models are out-of-core imports: too large to import again on a save.
+        // Streamed textures are tails of the model's chains, replaced by tick() until it settles;
+        // changes are picked up then.
+        return false;
+    }
+    const ModelWatch::Reloaded reloaded = app.model_watch_.tick(*app.device_.Get(), fm, app.active_model_);
+    if (streamer.is_active() && (reloaded.model || (reloaded.textures > 0)))
+    {
+        // Reloads upload whole chains (and the textures may be others now): stream them again.
+        app.active_model_.textures.clear();
+        streamer.start(*app.device_.Get(), fm.model, app.active_model_);
+    }
+    if (reloaded.model)
+    {
+        app.residency_.on_loaded(fm, 0.0);
+    }
+    return reloaded.model;
+}
 
-        app.active_model_ = RenderModel::make(*app.device_.Get(), model);
-        app.active_model_.vs_shader_ = &app.all_shaders_.vs_shaders_[app.imgui_.model_vs_index];
-        app.active_model_.ps_shader_ = &app.all_shaders_.ps_shaders_[app.imgui_.model_ps_index];
-        return true;
+void TickModelChunks(AppState& app)
+{
+    if (!app.chunk_pager_.is_active())
+    {
+        return;
     }
-    return false;
+    // Looked up every tick: models_ may have grown (and moved its entries) since start().
+    const FileModel& fm = app.models_[std::size_t(app.active_model_index_)];
+    app.chunk_pager_.tick(*app.device_.Get(), fm.model, app.active_model_, app.camera_.camera_position_);
+}
+
+void TickTextureStreaming(AppState& app)
+{
+    if (!app.texture_streamer_.is_active())
+    {
+        return;
+    }
+    // Looked up every tick, see TickModelChunks().
+    const FileModel& fm = app.models_[std::size_t(app.active_model_index_)];
+    app.texture_streamer_.tick(
+        *app.device_.Get(),
+        fm.model,
+        app.active_model_,
+        app.camera_.camera_position_,
+        app.fov_y_,
+        app.window_height_
+    );
+}
+
+void TickTexturePacking(AppState& app)
+{
+    if (app.upload_job_ || (app.texture_streamer_.is_active() && !app.texture_streamer_.is_settled()))
+    {
+        // Textures still arrive/change every tick; packed again once streaming settles.
+        return;
+    }
+    (void)app.active_model_.pack_textures(*app.device_.Get(), *app.device_context_.Get());
 }
 
 void TickShadersChange(AppState& app)
@@ -1,10 +1,15 @@
 #pragma once
 #include "dx_api.h"
 #include "imgui_state_debug.h"
+#include "model_residency.h"
+#include "model_streaming.h"
+#include "model_watch.h"
 #include "render_model.h"
 #include "shaders_compiler.h"
 #include "stub_window.h"
 
+#include <future>
+#include <memory>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -16,6 +21,14 @@ void Init_KnownShaders(AppState& app);
 
 void TickInput(AppState& app);
 bool TickModelsLoad(AppState& app);
+// True if the active model was imported again.
+bool TickModelsHotReload(AppState& app);
+// Pages chunks of the active model by the camera position; after RenderModel::world is set.
+void TickModelChunks(AppState& app);
+// Streams mips of the active model's textures by the camera; after RenderModel::world is set.
+void TickTextureStreaming(AppState& app);
+// Packs the active model's textures into arrays once they are all uploaded (again after hot reloads).
+void TickTexturePacking(AppState& app);
 void TickShadersChange(AppState& app);
 
 struct Shaders
@@ -23,6 +36,10 @@ struct Shaders
     static Shaders Build();
 
     const VSShader* find_vs(const ShaderInfo& info) const;
+    // Variant of vs for meshes of PackedVertex; null if there is none.
+    const VSShader* find_packed_vs(const VSShader& vs) const;
+    // Not for picking: used in place of the Vertex one (see find_packed_vs()).
+    bool is_packed_vs(const VSShader& vs) const;
     const PSShader* find_ps(const ShaderInfo& info) const;
 
     std::vector<VSShader> vs_shaders_;
@@ -73,6 +90,21 @@ struct AppState
     ComPtr<ID3D11DepthStencilView> depth_buffer_;
 
     std::vector<std::string> files_to_load_;
+    FileIndex file_index_; // owned by list_job_ while it runs
+    std::unique_ptr<ModelListJob> list_job_;
+    std::string select_on_list_; // single dropped file is selected once listed
     std::vector<FileModel> models_;
+    ModelLoader loader_;
+    ModelResidency residency_;
     int active_model_index_ = -1;
+    // Streams active_model_; uses models_[active_model_index_] data.
+    std::unique_ptr<ModelUploadJob> upload_job_;
+    // Instead of upload_job_ for models larger than its budget (out-of-core imports).
+    ModelChunkPager chunk_pager_;
+    // Instead of uploading whole textures for models with large texture sets.
+    ModelTextureStreamer texture_streamer_;
+    // Hot reload of the active model's files.
+    ModelWatch model_watch_;
+    // Package_Build() of the active model's folder; package path on success.
+    std::future<std::string> pack_job_;
 };
@@ -1,8 +1,15 @@
 #include "assimp_model.h"
+#include "package.h"
+#include "texture_container.h"
+#include "texture_convert.h"
+#include "thread_pool.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
@@ -10,13 +17,16 @@
 #include <glm/vec3.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <span>
 #include <vector>
 
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 namespace fs = std::filesystem;
 
@@ -29,12 +39,183 @@ static void Panic(bool condition)
     }
 }
 
+// Packed file (see package.h), decompressed as a whole on open.
+struct PackageIOStream final : Assimp::IOStream
+{
+    explicit PackageIOStream(std::vector<std::uint8_t> bytes)
+        : bytes_(std::move(bytes))
+    {
+    }
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+        {
+            return 0;
+        }
+        count = std::min(count, (bytes_.size() - position_) / size);
+        std::memcpy(buffer, bytes_.data() + position_, size * count);
+        position_ += (size * count);
+        return count;
+    }
+
+    size_t Write(const void* /*buffer*/, size_t /*size*/, size_t /*count*/) override
+    {
+        return 0;
+    }
+
+    // Same as Assimp's MemoryIOStream: offset is backwards for aiOrigin_END.
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        const std::size_t base = (origin == aiOrigin_SET) ? 0 : (origin == aiOrigin_CUR) ? position_ : bytes_.size();
+        if (origin == aiOrigin_END)
+        {
+            if (offset > bytes_.size())
+            {
+                return aiReturn_FAILURE;
+            }
+            position_ = (base - offset);
+            return aiReturn_SUCCESS;
+        }
+        if (offset > (bytes_.size() - base))
+        {
+            return aiReturn_FAILURE;
+        }
+        position_ = (base + offset);
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override
+    {
+        return position_;
+    }
+
+    size_t FileSize() const override
+    {
+        return bytes_.size();
+    }
+
+    void Flush() override
+    {
+    }
+
+private:
+    std::vector<std::uint8_t> bytes_;
+    std::size_t position_ = 0;
+};
+
+// Serves "pkg://" paths, so Assimp finds .mtl/.bin files next to the model in the package.
+struct PackageIOSystem final : Assimp::IOSystem
+{
+    bool Exists(const char* file) const override
+    {
+        return !!Package_Stat(file);
+    }
+
+    char getOsSeparator() const override
+    {
+        return '/';
+    }
+
+    Assimp::IOStream* Open(const char* file, const char* /*mode*/) override
+    {
+        auto maybe_bytes = Package_ReadFile(file);
+        if (!maybe_bytes)
+        {
+            return nullptr;
+        }
+        return new PackageIOStream(std::move(maybe_bytes.value()));
+    }
+
+    void Close(Assimp::IOStream* stream) override
+    {
+        delete stream;
+    }
+};
+
+// Records files the importer opens (see AssimpModel::dependencies).
+struct RecordingIOSystem final : Assimp::IOSystem
+{
+    explicit RecordingIOSystem(Assimp::IOSystem* io)
+        : io_(io)
+    {
+    }
+
+    bool Exists(const char* file) const override
+    {
+        return io_->Exists(file);
+    }
+
+    char getOsSeparator() const override
+    {
+        return io_->getOsSeparator();
+    }
+
+    Assimp::IOStream* Open(const char* file, const char* mode) override
+    {
+        Assimp::IOStream* stream = io_->Open(file, mode);
+        if (stream)
+        {
+            opened.emplace_back(file);
+        }
+        return stream;
+    }
+
+    void Close(Assimp::IOStream* stream) override
+    {
+        io_->Close(stream);
+    }
+
+    std::vector<fs::path> opened;
+
+private:
+    std::unique_ptr<Assimp::IOSystem> io_;
+};
+
+// stbi_load() for files on disk; packed ones are fed through stbi_io_callbacks.
+static unsigned char* Stbi_Load(const std::string& path, int& width, int& height, int& channels)
+{
+    if (!Package_IsPath(path))
+    {
+        return stbi_load(path.c_str(), &width, &height, &channels, 0);
+    }
+    auto maybe_bytes = Package_ReadFile(path);
+    if (!maybe_bytes)
+    {
+        return nullptr;
+    }
+    struct Reader
+    {
+        std::span<const std::uint8_t> bytes;
+        std::size_t position = 0;
+    };
+    Reader reader{maybe_bytes.value(), 0};
+    stbi_io_callbacks callbacks{};
+    callbacks.read = [](void* user, char* data, int size) -> int {
+        Reader& r = *static_cast<Reader*>(user);
+        const std::size_t count = std::min(std::size_t(size), r.bytes.size() - r.position);
+        std::memcpy(data, r.bytes.data() + r.position, count);
+        r.position += count;
+        return int(count);
+    };
+    callbacks.skip = [](void* user, int n) {
+        // Negative n "unget"s bytes.
+        Reader& r = *static_cast<Reader*>(user);
+        const std::ptrdiff_t position = std::ptrdiff_t(r.position) + n;
+        r.position = std::size_t(std::clamp<std::ptrdiff_t>(position, 0, std::ptrdiff_t(r.bytes.size())));
+    };
+    callbacks.eof = [](void* user) -> int {
+        const Reader& r = *static_cast<const Reader*>(user);
+        return (r.position >= r.bytes.size()) ? 1 : 0;
+    };
+    return stbi_load_from_callbacks(&callbacks, &reader, &width, &height, &channels, 0);
+}
+
 // Model's loading with Assimp comes from learnopengl.com:
 // https://learnopengl.com/code_viewer_gh.php?code=includes/learnopengl/model.h
-static AssimpMesh Assimp_ProcessMesh(const aiScene& scene, const aiMesh& mesh)
+// Attributes & texture paths only (cheap); geometry is filled by Assimp_ProcessMesh().
+static AssimpMesh Assimp_ProcessMeshMaterial(const aiScene& scene, const aiMesh& mesh)
 {
-    static_assert(std::is_same_v<float, ai_real>);
-
     AssimpMesh mesh_data{};
 
     Panic(mesh.mVertices);                   // expect to have vertices
@@ -58,6 +239,40 @@ static AssimpMesh Assimp_ProcessMesh(const aiScene& scene, const aiMesh& mesh)
         return has_uv;
     }();
 
+    if (mesh_data.has_texture_coords)
+    {
+        Panic(mesh.mMaterialIndex < scene.mNumMaterials);
+        const aiMaterial& material = *scene.mMaterials[mesh.mMaterialIndex];
+
+        {
+            const unsigned int count = material.GetTextureCount(aiTextureType_DIFFUSE);
+            Panic(count == 1);
+            aiString path;
+            Panic(material.GetTexture(aiTextureType_DIFFUSE, 0, &path) == aiReturn_SUCCESS);
+            mesh_data.texture_diffuse.path.assign(path.C_Str());
+            Panic(path.length == mesh_data.texture_diffuse.path.size());
+
+            Panic(!mesh_data.texture_diffuse.path.empty());
+        }
+
+        {
+            const unsigned int count = material.GetTextureCount(aiTextureType_HEIGHT);
+            Panic(count == 1);
+            aiString path;
+            Panic(material.GetTexture(aiTextureType_HEIGHT, 0, &path) == aiReturn_SUCCESS);
+            mesh_data.texture_normal.path.assign(path.C_Str());
+            Panic(path.length == mesh_data.texture_normal.path.size());
+
+            Panic(!mesh_data.texture_normal.path.empty());
+        }
+    }
+    return mesh_data;
+}
+
+static void Assimp_ProcessMesh(const aiMesh& mesh, AssimpMesh& mesh_data)
+{
+    static_assert(std::is_same_v<float, ai_real>);
+
     Panic(mesh.mPrimitiveTypes == aiPrimitiveType_TRIANGLE);
 
     mesh_data.vertices.reserve(mesh.mNumVertices);
@@ -108,54 +323,24 @@ static AssimpMesh Assimp_ProcessMesh(const aiScene& scene, const aiMesh& mesh)
         }
     }
 
-    if (mesh_data.has_texture_coords)
-    {
-        Panic(mesh.mMaterialIndex < scene.mNumMaterials);
-        const aiMaterial& material = *scene.mMaterials[mesh.mMaterialIndex];
-
-        {
-            const unsigned int count = material.GetTextureCount(aiTextureType_DIFFUSE);
-            Panic(count == 1);
-            aiString path;
-            Panic(material.GetTexture(aiTextureType_DIFFUSE, 0, &path) == aiReturn_SUCCESS);
-            mesh_data.texture_diffuse.path.assign(path.C_Str());
-            Panic(path.length == mesh_data.texture_diffuse.path.size());
-
-            Panic(!mesh_data.texture_diffuse.path.empty());
-        }
-
-        {
-            const unsigned int count = material.GetTextureCount(aiTextureType_HEIGHT);
-            Panic(count == 1);
-            aiString path;
-            Panic(material.GetTexture(aiTextureType_HEIGHT, 0, &path) == aiReturn_SUCCESS);
-            mesh_data.texture_normal.path.assign(path.C_Str());
-            Panic(path.length == mesh_data.texture_normal.path.size());
-
-            Panic(!mesh_data.texture_normal.path.empty());
-        }
-    }
-
     Panic(!mesh_data.indices.empty());
     Panic(!mesh_data.vertices.empty());
-    return mesh_data;
 }
 
-template <typename F>
-static void Assimp_ProcessNode(const aiScene& scene, const aiNode& node, F on_new_mesh)
+// Meshes in the order of nodes traversal (as they were processed one by one).
+static void Assimp_CollectNodeMeshes(const aiScene& scene, const aiNode& node, std::vector<const aiMesh*>& meshes)
 {
     for (unsigned int i = 0; i < node.mNumMeshes; ++i)
     {
-        const aiMesh& mesh = *scene.mMeshes[node.mMeshes[i]];
-        (void)on_new_mesh(Assimp_ProcessMesh(scene, mesh));
+        meshes.push_back(scene.mMeshes[node.mMeshes[i]]);
     }
     for (unsigned int i = 0; i < node.mNumChildren; ++i)
     {
-        Assimp_ProcessNode(scene, *node.mChildren[i], on_new_mesh);
+        Assimp_CollectNodeMeshes(scene, *node.mChildren[i], meshes);
     }
 }
 
-static void UpdateAABB(AssimpModel& model, const AssimpMesh& mesh)
+void Assimp_UpdateAABB(AssimpModel& model, const AssimpMesh& mesh)
 {
     if (mesh.aabb_min.x < model.aabb_min.x)
     {
@@ -184,14 +369,196 @@ static void UpdateAABB(AssimpModel& model, const AssimpMesh& mesh)
     }
 }
 
+// Adds (not yet added) diffuse/normal textures of the mesh to model.materials, not decoded.
+static void Assimp_AddMeshTextures(AssimpModel& model, const AssimpMesh& mesh)
+{
+    if (!mesh.has_texture_coords)
+    {
+        return;
+    }
+    const AssimpTexture textures[2] = {mesh.texture_diffuse, mesh.texture_normal};
+
+    for (const AssimpTexture& t : textures)
+    {
+        const auto it = std::find_if(
+            std::cbegin(model.materials),
+            std::cend(model.materials),
+            [&](const AssimpModel::Blob& data) { return (data.path == t.path); }
+        );
+        if (it != std::cend(model.materials))
+        {
+            continue;
+        }
+        model.materials.emplace_back(AssimpModel::Blob{}).path = t.path;
+    }
+}
+
+// Normal maps are data, sampled without gamma decode whatever their files say.
+static void Assimp_MarkNormalMaps(AssimpModel& model)
+{
+    for (const AssimpMesh& mesh : model.meshes)
+    {
+        for (AssimpModel::Blob& blob : model.materials)
+        {
+            if (mesh.has_texture_coords && (blob.path == mesh.texture_normal.path))
+            {
+                blob.srgb = false;
+            }
+        }
+    }
+}
+
+static void Assimp_DecodeTexture(const fs::path& dir, AssimpModel::Blob& blob)
+{
+    std::string path = std::move(blob.path);
+    Panic(Assimp_LoadTexture(dir / path, blob));
+    blob.path = std::move(path);
+}
+
+bool Assimp_LoadModelTextures(AssimpModel& model, const fs::path& dir)
+{
+    for (const AssimpMesh& mesh : model.meshes)
+    {
+        Assimp_AddMeshTextures(model, mesh);
+    }
+    std::atomic<bool> loaded{true};
+    GlobalThreadPool().parallel_for(model.materials.size(), [&](std::size_t i) {
+        AssimpModel::Blob& blob = model.materials[i];
+        if (!Assimp_LoadTexture(dir / blob.path, blob))
+        {
+            loaded.store(false);
+        }
+    });
+    Assimp_MarkNormalMaps(model);
+    return loaded.load();
+}
+
+// Texels of blob.file; never written, nothing to free.
+static void Assimp_KeepMapped(void*)
+{
+}
+
+static bool Assimp_LoadContainer(const std::string& path, AssimpModel::Blob& blob)
+{
+    MappedFile file;
+    std::vector<std::uint8_t> packed;
+    std::span<const std::uint8_t> bytes;
+    if (Package_IsPath(path))
+    {
+        auto maybe_bytes = Package_ReadFile(path);
+        if (!maybe_bytes)
+        {
+            return false;
+        }
+        packed = std::move(maybe_bytes.value());
+        bytes = packed;
+    }
+    else
+    {
+        auto maybe_file = MappedFile::open(path);
+        if (!maybe_file)
+        {
+            return false;
+        }
+        file = std::move(maybe_file.value());
+        bytes = file.bytes();
+    }
+    auto maybe_texture = TextureContainer_Parse(bytes);
+    if (!maybe_texture)
+    {
+        return false;
+    }
+    TextureContainer& texture = maybe_texture.value();
+    if (texture.owned)
+    {
+        blob.data = std::move(texture.owned);
+    }
+    else if (file.is_open())
+    {
+        blob.data = {const_cast<unsigned char*>(texture.data.data()), &Assimp_KeepMapped};
+        blob.file = std::move(file);
+    }
+    else
+    {
+        // Package entry is decompressed into a temporary buffer.
+        auto* chain = static_cast<std::uint8_t*>(std::malloc(texture.data.size()));
+        if (!chain)
+        {
+            return false;
+        }
+        std::memcpy(chain, texture.data.data(), texture.data.size());
+        blob.data = {chain, &std::free};
+    }
+    blob.width = texture.width;
+    blob.height = texture.height;
+    blob.mips_count = texture.mips_count;
+    blob.format = texture.format;
+    blob.srgb = texture.srgb;
+    return true;
+}
+
+bool Assimp_LoadTexture(const fs::path& texture_file, AssimpModel::Blob& blob)
+{
+    const std::string path = texture_file.string();
+    if (TextureContainer_IsPath(texture_file))
+    {
+        return Assimp_LoadContainer(path, blob);
+    }
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    unsigned char* data = Stbi_Load(path, width, height, channels);
+    if (!data)
+    {
+        return false;
+    }
+    blob.data = {data, &stbi_image_free};
+    if ((channels < 1) || (channels > int(c_texture_channels)))
+    {
+        return false;
+    }
+    if (channels != c_texture_channels) // RGBA
+    {
+        const std::size_t pixels = std::size_t(width) * std::size_t(height);
+        auto* rgba = static_cast<std::uint8_t*>(std::malloc(pixels * c_texture_channels));
+        if (!rgba)
+        {
+            return false;
+        }
+        Texture_ExpandToRGBA(
+            {data, pixels * std::size_t(channels)},
+            unsigned(channels),
+            {rgba, pixels * c_texture_channels}
+        );
+        blob.data = {rgba, &std::free};
+    }
+    blob.width = static_cast<unsigned int>(width);
+    blob.height = static_cast<unsigned int>(height);
+    blob.srgb = true; // images carry no color space; normal maps are marked by the model
+    return true;
+}
+
+std::uint32_t Assimp_ImportFlags()
+{
+    // aiProcess_FlipUVs - no need for DirectX.
+    return std::uint32_t(aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes);
+}
+
 /*static*/ AssimpModel Assimp_Load(fs::path file_path)
 {
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(
-        file_path.string().c_str(),
-        unsigned(aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes)
-    );
-    // aiProcess_FlipUVs - no need for DirectX.
+    Assimp::IOSystem* io = nullptr;
+    if (Package_IsPath(file_path.string()))
+    {
+        io = new PackageIOSystem();
+    }
+    else
+    {
+        io = new Assimp::DefaultIOSystem();
+    }
+    RecordingIOSystem* recording = new RecordingIOSystem(io);
+    importer.SetIOHandler(recording); // owned by importer
+    const aiScene* scene = importer.ReadFile(file_path.string().c_str(), unsigned(Assimp_ImportFlags()));
     Panic(scene);
     Panic((scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) != AI_SCENE_FLAGS_INCOMPLETE);
     Panic(scene->mRootNode);
@@ -201,43 +568,40 @@ static void UpdateAABB(AssimpModel& model, const AssimpMesh& mesh)
     model.aabb_min = glm::vec3(FLT_MAX);
     model.aabb_max = glm::vec3(FLT_MIN);
 
-    Assimp_ProcessNode(*scene, *scene->mRootNode, [&](AssimpMesh&& mesh) {
-        if (mesh.has_texture_coords)
+    std::vector<const aiMesh*> scene_meshes;
+    Assimp_CollectNodeMeshes(*scene, *scene->mRootNode, scene_meshes);
+    model.meshes.reserve(scene_meshes.size());
+    for (const aiMesh* mesh : scene_meshes)
+    {
+        AssimpMesh& mesh_data = model.meshes.emplace_back(Assimp_ProcessMeshMaterial(*scene, *mesh));
+        Assimp_AddMeshTextures(model, mesh_data);
+    }
+    // Textures and meshes are independent: decoded & converted concurrently, in the
+    // same parallel_for() (textures first, they take longer); order is kept.
+    const std::size_t textures_count = model.materials.size();
+    GlobalThreadPool().parallel_for(textures_count + scene_meshes.size(), [&](std::size_t i) {
+        if (i < textures_count)
         {
-            const AssimpTexture textures[2] = {mesh.texture_diffuse, mesh.texture_normal};
-
-            for (const AssimpTexture& t : textures)
-            {
-                const fs::path texture_file = dir / t.path;
-                const auto it = std::find_if(
-                    std::cbegin(model.materials),
-                    std::cend(model.materials),
-                    [&](const AssimpModel::Blob& data) { return (data.path == t.path); }
-                );
-                if (it != std::cend(model.materials))
-                {
-                    continue;
-                }
-
-                const std::string path = texture_file.string();
-                int width = 0;
-                int height = 0;
-                int channels = 0;
-                unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
-                Panic(!!data);
-                Panic(channels == c_texture_channels); // RGBA
-                // stbi_image_free(data)
-                auto& blob = model.materials.emplace_back(AssimpModel::Blob{});
-                blob.data = data;
-                blob.path = t.path;
-                blob.width = static_cast<unsigned int>(width);
-                blob.height = static_cast<unsigned int>(height);
-            }
+            Assimp_DecodeTexture(dir, model.materials[i]);
+            return;
         }
-
-        UpdateAABB(model, mesh);
-        model.meshes.push_back(std::move(mesh));
+        Assimp_ProcessMesh(*scene_meshes[i - textures_count], model.meshes[i - textures_count]);
     });
+    Assimp_MarkNormalMaps(model);
+    for (const AssimpMesh& mesh : model.meshes)
+    {
+        Assimp_UpdateAABB(model, mesh);
+    }
+    // Opened once per read; the model file itself is keyed by its bytes.
+    for (const fs::path& opened : recording->opened)
+    {
+        auto& dependencies = model.dependencies;
+        const bool is_model = (opened.lexically_normal() == file_path.lexically_normal());
+        if (!is_model && (std::find(dependencies.begin(), dependencies.end(), opened) == dependencies.end()))
+        {
+            dependencies.push_back(opened);
+        }
+    }
 
     return model;
 }
@@ -1,7 +1,10 @@
 #pragma once
+#include "mapped_file.h"
 #include "model.h"
+#include <cstdint>
 #include <filesystem>
 #include <glm/vec3.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -9,6 +12,8 @@ namespace fs = std::filesystem;
 
 struct AssimpModel;
 AssimpModel Assimp_Load(fs::path file_path);
+// aiPostProcessSteps used by Assimp_Load(); part of the model cache key.
+std::uint32_t Assimp_ImportFlags();
 
 struct AssimpTexture
 {
@@ -31,13 +36,36 @@ struct AssimpModel
 {
     struct Blob
     {
-        std::string path;    // not exported
-        unsigned char* data; // stbi_image_free(data)
+        std::string path; // not exported
+        std::unique_ptr<unsigned char, void (*)(void*)> data{nullptr, nullptr}; // stbi_image_free(data)
         unsigned int width;
         unsigned int height;
+        unsigned int mips_count = 1; // data is the mip chain (see texture_mips.h)
+        TextureFormat format = TextureFormat::RGBA8;
+        bool srgb = true; // see Texture::srgb
+        MappedFile file; // .dds/.ktx2 that data points into (see texture_container.h)
+        // Owns data once shared (see Model::share_textures()); data doesn't then.
+        std::shared_ptr<const std::uint8_t> shared;
+        // shared are this blob's own texels (mapped: of file), registered for the other models.
+        bool shared_owner = false;
+        bool shared_mapped = false;
+        std::uint64_t content_key = 0;
     };
     std::vector<AssimpMesh> meshes;
     std::vector<Blob> materials;
     glm::vec3 aabb_min;
     glm::vec3 aabb_max;
+    // Files read besides the model file & textures (.mtl, .bin), as opened;
+    // the model cache is stale once one changes (see ModelCache_Save()).
+    std::vector<fs::path> dependencies;
 };
+
+// Shared with native loaders that produce AssimpModel directly.
+void Assimp_UpdateAABB(AssimpModel& model, const AssimpMesh& mesh);
+// Decodes diffuse/normal textures of all meshes into model.materials, on GlobalThreadPool().
+// False if any of them can't be read.
+bool Assimp_LoadModelTextures(AssimpModel& model, const fs::path& dir);
+// Decodes single image into RGBA blob.data/width/height (1-3 channels are expanded).
+// .dds/.ktx2 are not decoded: blob gets their format and mips, mapped in place if possible.
+// False if it can't be read.
+bool Assimp_LoadTexture(const fs::path& texture_file, AssimpModel::Blob& blob);
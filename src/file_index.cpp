@@ -0,0 +1,159 @@
+#include "file_index.h"
+#include "mapped_file.h"
+#include "package.h"
+#include "utils_hash.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// One file per line: "<size> <mtime> <content hash> <path>".
+static constexpr const char* c_index_header = "file_index 1";
+
+static fs::path GetIndexPath()
+{
+    std::error_code ec;
+    return fs::temp_directory_path(ec) / "render_playground" / "file_index.txt";
+}
+
+// 0 if the file can't be read.
+static std::uint64_t HashFile(const fs::path& path)
+{
+    auto maybe_file = MappedFile::open(path);
+    if (!maybe_file)
+    {
+        return 0;
+    }
+    const auto bytes = maybe_file.value().bytes();
+    return Hash64(bytes.data(), bytes.size());
+}
+
+outcome::result<FileStamp> FileStamp_Get(const fs::path& path, bool hash_contents)
+{
+    std::error_code ec;
+    FileStamp stamp{};
+    const std::string path_str = path.string();
+    if (Package_IsPath(path_str))
+    {
+        // Packed file: hash is in the package index; no need to read it.
+        auto maybe_entry = Package_Stat(path_str);
+        if (!maybe_entry)
+        {
+            return outcome::failure(maybe_entry.error());
+        }
+        stamp.size = maybe_entry.value().size;
+        stamp.content_hash = maybe_entry.value().content_hash;
+        return outcome::success(stamp);
+    }
+    stamp.size = fs::file_size(path, ec);
+    if (ec)
+    {
+        return outcome::failure(ec);
+    }
+    stamp.mtime = std::int64_t(fs::last_write_time(path, ec).time_since_epoch().count());
+    if (ec)
+    {
+        return outcome::failure(ec);
+    }
+    if (hash_contents)
+    {
+        stamp.content_hash = HashFile(path);
+    }
+    return outcome::success(stamp);
+}
+
+/*static*/ FileIndex FileIndex::Load()
+{
+    FileIndex index;
+    std::ifstream in(GetIndexPath());
+    std::string line;
+    if (!in || !std::getline(in, line) || (line != c_index_header))
+    {
+        return index;
+    }
+    while (std::getline(in, line))
+    {
+        std::istringstream parser(line);
+        FileStamp stamp{};
+        std::string path;
+        if ((parser >> stamp.size >> stamp.mtime >> stamp.content_hash) && (parser.get() == ' ')
+            && std::getline(parser, path) && !path.empty())
+        {
+            index.entries_[std::move(path)] = stamp;
+        }
+    }
+    return index;
+}
+
+bool FileIndex::save() const
+{
+    const fs::path index_path = GetIndexPath();
+    std::error_code ec;
+    fs::create_directories(index_path.parent_path(), ec);
+    fs::path temp_path = index_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::trunc);
+        if (!out)
+        {
+            return false;
+        }
+        out << c_index_header << '\n';
+        for (const auto& [path, stamp] : entries_)
+        {
+            out << stamp.size << ' ' << stamp.mtime << ' ' << stamp.content_hash << ' ' << path << '\n';
+        }
+        if (!out)
+        {
+            return false;
+        }
+    }
+    fs::rename(temp_path, index_path, ec);
+    return !ec;
+}
+
+FileStamp FileIndex::check(const std::string& path, bool& changed) const
+{
+    changed = true;
+    auto maybe_stamp = FileStamp_Get(path, false);
+    if (!maybe_stamp)
+    {
+        return FileStamp{};
+    }
+    FileStamp stamp = maybe_stamp.value();
+    auto it = entries_.find(path);
+    if (it == entries_.end())
+    {
+        if (hash_contents && (stamp.content_hash == 0))
+        {
+            stamp.content_hash = HashFile(path);
+        }
+        return stamp;
+    }
+
+    const FileStamp& known = it->second;
+    if (stamp.content_hash != 0)
+    {
+        // Packed file: the hash came for free, mtime is unknown.
+        changed = (known.size != stamp.size) || (known.content_hash != stamp.content_hash);
+        return stamp;
+    }
+    if ((known.size == stamp.size) && (known.mtime == stamp.mtime))
+    {
+        stamp.content_hash = known.content_hash;
+        changed = false;
+        return stamp;
+    }
+    if (hash_contents)
+    {
+        stamp.content_hash = HashFile(path);
+        changed = (known.size != stamp.size) || (known.content_hash == 0) || (known.content_hash != stamp.content_hash);
+    }
+    return stamp;
+}
+
+void FileIndex::record(const std::string& path, const FileStamp& stamp)
+{
+    entries_[path] = stamp;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "utils_outcome.h"
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+#include <cstdint>
+
+// What's known about the file content without reading it;
+// content_hash is optional (0 - not computed).
+struct FileStamp
+{
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0; // last_write_time() ticks
+    std::uint64_t content_hash = 0;
+};
+
+// Packed files ("pkg://", see package.h) get content_hash from the package index.
+outcome::result<FileStamp> FileStamp_Get(const std::filesystem::path& path, bool hash_contents);
+
+// Persistent path -> FileStamp map of the imported files
+// (%TEMP%/render_playground/file_index.txt), so re-drops
+// import only new or modified files. Not thread-safe.
+struct FileIndex
+{
+    static FileIndex Load();
+    bool save() const;
+
+    // Current stamp of the file; changed is true if the file is new or
+    // modified since the recorded stamp. With hash_contents, a file with new
+    // mtime but the same size and bytes (touched, copied back) is unchanged.
+    FileStamp check(const std::string& path, bool& changed) const;
+    // Call once the file is imported.
+    void record(const std::string& path, const FileStamp& stamp);
+
+    bool hash_contents = true;
+    std::unordered_map<std::string, FileStamp> entries_;
+};
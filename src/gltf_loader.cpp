@@ -0,0 +1,643 @@
+#include "gltf_loader.h"
+#include "json.h"
+#include "tangents.h"
+#include "texture_container.h"
+#include "utils.h"
+
+#include <stb_image.h>
+
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr std::uint32_t c_glb_magic = 0x46546C67;      // "glTF"
+constexpr std::uint32_t c_glb_chunk_json = 0x4E4F534A; // "JSON"
+constexpr std::uint32_t c_glb_chunk_bin = 0x004E4942;  // "BIN\0"
+constexpr std::size_t c_glb_header_size = 12;
+constexpr std::size_t c_glb_chunk_header_size = 8;
+
+constexpr int c_component_ubyte = 5121;
+constexpr int c_component_ushort = 5123;
+constexpr int c_component_uint = 5125;
+constexpr int c_component_float = 5126;
+
+constexpr int c_mode_triangles = 4;
+
+constexpr std::uint32_t c_no_texture = std::uint32_t(-1);
+
+std::uint32_t ReadU32(const std::uint8_t* p)
+{
+    std::uint32_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+std::size_t ComponentSize(int component_type)
+{
+    switch (component_type)
+    {
+    case c_component_ubyte:
+        return 1;
+    case c_component_ushort:
+        return 2;
+    case c_component_uint:
+    case c_component_float:
+        return 4;
+    }
+    return 0;
+}
+
+std::size_t TypeComponents(std::string_view type)
+{
+    if (type == "SCALAR")
+    {
+        return 1;
+    }
+    if (type == "VEC2")
+    {
+        return 2;
+    }
+    if (type == "VEC3")
+    {
+        return 3;
+    }
+    if (type == "VEC4")
+    {
+        return 4;
+    }
+    return 0;
+}
+
+// Validated accessor: count elements, element i is at data + i * stride.
+struct GlbAccessor
+{
+    const std::uint8_t* data = nullptr;
+    std::size_t count = 0;
+    std::size_t stride = 0;
+    std::size_t element_size = 0;
+    int component_type = 0;
+    std::size_t components = 0;
+    int buffer_view = -1;
+    std::size_t offset_in_view = 0; // accessor.byteOffset
+    bool has_bounds = false;
+    glm::vec3 min{};
+    glm::vec3 max{};
+
+    const std::uint8_t* element(std::size_t i) const
+    {
+        return data + i * stride;
+    }
+};
+
+struct GlbDocument
+{
+    JsonValue json;
+    std::span<const std::uint8_t> bin;
+
+    // nullptr if index is invalid.
+    const JsonValue* get(std::string_view array, double index) const
+    {
+        const JsonValue* items = json.find(array);
+        if (!items || (index < 0))
+        {
+            return nullptr;
+        }
+        return items->at(std::size_t(index));
+    }
+
+    // bufferView bytes, nullptr on error.
+    const JsonValue* buffer_view(int index, std::span<const std::uint8_t>& bytes) const
+    {
+        const JsonValue* view = get("bufferViews", index);
+        if (!view || (view->number_or("buffer", -1) != 0))
+        {
+            return nullptr;
+        }
+        const double offset = view->number_or("byteOffset", 0);
+        const double length = view->number_or("byteLength", -1);
+        if ((offset < 0) || (length < 0) || ((offset + length) > double(bin.size())))
+        {
+            return nullptr;
+        }
+        bytes = bin.subspan(std::size_t(offset), std::size_t(length));
+        return view;
+    }
+
+    outcome::result<GlbAccessor> accessor(double index) const
+    {
+        const JsonValue* a = get("accessors", index);
+        if (!a)
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        GlbAccessor r;
+        r.component_type = int(a->number_or("componentType", 0));
+        r.components = TypeComponents(a->string_or("type", ""));
+        const std::size_t component_size = ComponentSize(r.component_type);
+        const double count = a->number_or("count", -1);
+        const double byte_offset = a->number_or("byteOffset", 0);
+        if ((r.components == 0) || (component_size == 0) || (count < 0) || (byte_offset < 0)
+            || a->find("sparse"))
+        {
+            return outcome::failure(std::errc::not_supported);
+        }
+        r.count = std::size_t(count);
+        r.element_size = (component_size * r.components);
+        r.buffer_view = int(a->number_or("bufferView", -1));
+        r.offset_in_view = std::size_t(byte_offset);
+
+        std::span<const std::uint8_t> bytes;
+        const JsonValue* view = buffer_view(r.buffer_view, bytes);
+        if (!view)
+        {
+            // No bufferView means all zeros (only valid with sparse); not supported.
+            return outcome::failure(std::errc::not_supported);
+        }
+        const double stride = view->number_or("byteStride", 0);
+        r.stride = (stride > 0) ? std::size_t(stride) : r.element_size;
+        if (r.stride < r.element_size)
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        // count is checked first: count * stride must not overflow.
+        if ((r.count > 0)
+            && ((r.count > bytes.size()) || (r.offset_in_view > bytes.size())
+                || (((r.count - 1) * r.stride + r.element_size) > (bytes.size() - r.offset_in_view))))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        r.data = bytes.data() + r.offset_in_view;
+
+        const JsonValue* min = a->find("min");
+        const JsonValue* max = a->find("max");
+        if (min && max && (min->size() >= 3) && (max->size() >= 3))
+        {
+            r.has_bounds = true;
+            r.min = glm::vec3(
+                float(min->at(0)->number_or(0)), float(min->at(1)->number_or(0)), float(min->at(2)->number_or(0)));
+            r.max = glm::vec3(
+                float(max->at(0)->number_or(0)), float(max->at(1)->number_or(0)), float(max->at(2)->number_or(0)));
+        }
+        return outcome::success(r);
+    }
+};
+
+bool IsFloatVec(const GlbAccessor& a, std::size_t components)
+{
+    return (a.component_type == c_component_float) && (a.components == components);
+}
+
+bool IsAligned(const void* p, std::size_t alignment)
+{
+    return ((reinterpret_cast<std::uintptr_t>(p) % alignment) == 0);
+}
+
+struct GlbAttributes
+{
+    GlbAccessor position;
+    GlbAccessor normal;
+    GlbAccessor tangent; // TANGENT (VEC4) or _TANGENT (VEC3)
+    GlbAccessor uv;
+    bool has_normal = false;
+    bool has_tangent = false;
+    bool has_uv = false;
+};
+
+// All attributes live in the same bufferView at Vertex member offsets,
+// so the view can be used as Vertex[] directly.
+bool IsVertexLayout(const GlbAttributes& attributes, bool needs_tangent)
+{
+    const GlbAccessor& p = attributes.position;
+    if (!attributes.has_normal || !attributes.has_uv || (p.stride != sizeof(Vertex))
+        || !IsAligned(p.data, alignof(Vertex)))
+    {
+        return false;
+    }
+    auto matches = [&](const GlbAccessor& a, std::size_t member_offset, std::size_t components) {
+        return (a.buffer_view == p.buffer_view) && (a.stride == p.stride) && (a.count == p.count)
+            && IsFloatVec(a, components) && (a.offset_in_view == (p.offset_in_view + member_offset));
+    };
+    if (!matches(attributes.normal, offsetof(Vertex, normal), 3)
+        || !matches(attributes.uv, offsetof(Vertex, texture_coord), 2))
+    {
+        return false;
+    }
+    if (needs_tangent)
+    {
+        return attributes.has_tangent && matches(attributes.tangent, offsetof(Vertex, tangent), 3);
+    }
+    return true;
+}
+
+glm::vec3 ReadVec3(const GlbAccessor& a, std::size_t i)
+{
+    glm::vec3 v;
+    std::memcpy(&v, a.element(i), sizeof(v));
+    return v;
+}
+
+glm::vec2 ReadVec2(const GlbAccessor& a, std::size_t i)
+{
+    glm::vec2 v;
+    std::memcpy(&v, a.element(i), sizeof(v));
+    return v;
+}
+
+std::uint32_t ReadIndex(const GlbAccessor& a, std::size_t i)
+{
+    const std::uint8_t* p = a.element(i);
+    switch (a.component_type)
+    {
+    case c_component_ubyte:
+        return *p;
+    case c_component_ushort:
+    {
+        std::uint16_t v = 0;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    default:
+        return ReadU32(p);
+    }
+}
+
+// glTF texture index -> Texture id; decodes the image on first use.
+struct GlbTextures
+{
+    const GlbDocument& document;
+    MappedModel& model;
+    std::vector<std::uint32_t> image_to_id;
+
+    // Normal maps are data, sampled without gamma decode whatever their images say.
+    std::uint32_t get(const JsonValue* texture_info, bool normal_map)
+    {
+        const std::uint32_t id = find_or_add(texture_info);
+        if (normal_map && (id != c_no_texture))
+        {
+            model.textures[id].srgb = false;
+        }
+        return id;
+    }
+
+private:
+    std::uint32_t find_or_add(const JsonValue* texture_info)
+    {
+        if (!texture_info)
+        {
+            return c_no_texture;
+        }
+        const JsonValue* texture = document.get("textures", texture_info->number_or("index", -1));
+        if (!texture)
+        {
+            return c_no_texture;
+        }
+        double image_index = texture->number_or("source", -1);
+        // GPU-ready alternative of the image (source is then a fallback, if any).
+        if (const JsonValue* extensions = texture->find("extensions"))
+        {
+            if (const JsonValue* dds = extensions->find("MSFT_texture_dds"))
+            {
+                image_index = dds->number_or("source", image_index);
+            }
+        }
+        const JsonValue* image = document.get("images", image_index);
+        if (!image)
+        {
+            return c_no_texture;
+        }
+        std::uint32_t& id = image_to_id[std::size_t(image_index)];
+        if (id != c_no_texture)
+        {
+            return id;
+        }
+
+        std::span<const std::uint8_t> bytes;
+        if (!document.buffer_view(int(image->number_or("bufferView", -1)), bytes)
+            || (bytes.size() > std::size_t(INT32_MAX)))
+        {
+            return c_no_texture;
+        }
+        // .dds/.ktx2 image is used in place (see texture_container.h).
+        if (auto maybe_container = TextureContainer_Parse(bytes))
+        {
+            TextureContainer& container = maybe_container.value();
+            id = std::uint32_t(model.textures.size());
+            Texture& t = model.textures.emplace_back();
+            t.id = id;
+            t.width = container.width;
+            t.height = container.height;
+            t.mips_count = container.mips_count;
+            t.format = container.format;
+            t.srgb = container.srgb;
+            t.data = container.data;
+            if (container.owned)
+            {
+                model.owned_blobs.push_back(std::move(container.owned));
+            }
+            return id;
+        }
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        // Straight from the mapping, no temporary copy of the encoded image.
+        stbi_uc* data =
+            stbi_load_from_memory(bytes.data(), int(bytes.size()), &width, &height, &channels, c_texture_channels);
+        if (!data)
+        {
+            return c_no_texture;
+        }
+        id = std::uint32_t(model.textures.size());
+        Texture& t = model.textures.emplace_back();
+        t.id = id;
+        t.width = std::uint32_t(width);
+        t.height = std::uint32_t(height);
+        t.data = {data, std::size_t(t.width) * t.height * c_texture_channels};
+        model.owned_blobs.emplace_back(data, &stbi_image_free);
+        return id;
+    }
+};
+
+outcome::result<GlbAttributes> GetAttributes(const GlbDocument& document, const JsonValue& attributes)
+{
+    GlbAttributes r;
+    const JsonValue* position = attributes.find("POSITION");
+    if (!position)
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    auto maybe_position = document.accessor(position->number_or(-1));
+    if (!maybe_position || !IsFloatVec(maybe_position.value(), 3))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    r.position = maybe_position.value();
+    // Unusable optional attribute is ignored (as if missing).
+    auto get_optional = [&](const char* name, std::size_t components, GlbAccessor& a) {
+        const JsonValue* v = attributes.find(name);
+        if (!v)
+        {
+            return false;
+        }
+        auto maybe_accessor = document.accessor(v->number_or(-1));
+        if (!maybe_accessor)
+        {
+            return false;
+        }
+        a = maybe_accessor.value();
+        return IsFloatVec(a, components) && (a.count == r.position.count);
+    };
+    r.has_normal = get_optional("NORMAL", 3, r.normal);
+    r.has_uv = get_optional("TEXCOORD_0", 2, r.uv);
+    r.has_tangent = get_optional("_TANGENT", 3, r.tangent) || get_optional("TANGENT", 4, r.tangent);
+    return outcome::success(r);
+}
+
+std::vector<Vertex> ConvertVertices(const GlbAttributes& attributes)
+{
+    std::vector<Vertex> vertices(attributes.position.count);
+    for (std::size_t i = 0, count = vertices.size(); i < count; ++i)
+    {
+        Vertex& v = vertices[i];
+        v.position = ReadVec3(attributes.position, i);
+        v.normal = attributes.has_normal ? ReadVec3(attributes.normal, i) : glm::vec3(0.f);
+        v.tangent = attributes.has_tangent ? ReadVec3(attributes.tangent, i) : glm::vec3(0.f);
+        v.texture_coord = attributes.has_uv ? ReadVec2(attributes.uv, i) : glm::vec2(0.f);
+    }
+    return vertices;
+}
+
+outcome::result<bool> AddPrimitive(
+    const GlbDocument& document, GlbTextures& textures, MappedModel& model, const JsonValue& primitive)
+{
+    if (primitive.number_or("mode", c_mode_triangles) != c_mode_triangles)
+    {
+        return outcome::success(false);
+    }
+    const JsonValue* attributes_json = primitive.find("attributes");
+    if (!attributes_json)
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    auto maybe_attributes = GetAttributes(document, *attributes_json);
+    if (!maybe_attributes)
+    {
+        return outcome::failure(maybe_attributes.error());
+    }
+    const GlbAttributes& attributes = maybe_attributes.value();
+    const std::size_t vertices_count = attributes.position.count;
+    if (vertices_count == 0)
+    {
+        return outcome::success(false);
+    }
+
+    Mesh mesh{};
+    mesh.texture_diffuse_id = c_no_texture;
+    mesh.texture_normal_id = c_no_texture;
+    if (const JsonValue* material = document.get("materials", primitive.number_or("material", -1)))
+    {
+        if (const JsonValue* pbr = material->find("pbrMetallicRoughness"))
+        {
+            mesh.texture_diffuse_id = textures.get(pbr->find("baseColorTexture"), false);
+        }
+        mesh.texture_normal_id = textures.get(material->find("normalTexture"), true);
+    }
+    const bool needs_tangent = (mesh.texture_normal_id != c_no_texture);
+
+    // Indices.
+    if (const JsonValue* indices_json = primitive.find("indices"))
+    {
+        auto maybe_indices = document.accessor(indices_json->number_or(-1));
+        if (!maybe_indices)
+        {
+            return outcome::failure(maybe_indices.error());
+        }
+        const GlbAccessor& indices = maybe_indices.value();
+        if ((indices.components != 1) || (indices.component_type == c_component_float) || ((indices.count % 3) != 0))
+        {
+            return outcome::failure(std::errc::not_supported);
+        }
+        if ((indices.component_type == c_component_uint) && (indices.stride == sizeof(Index))
+            && IsAligned(indices.data, alignof(Index)))
+        {
+            mesh.indices = {reinterpret_cast<const Index*>(indices.data), indices.count};
+        }
+        else
+        {
+            std::vector<Index>& owned = model.owned_indices.emplace_back(indices.count);
+            for (std::size_t i = 0; i < indices.count; ++i)
+            {
+                owned[i] = ReadIndex(indices, i);
+            }
+            mesh.indices = owned;
+        }
+        for (const Index index : mesh.indices)
+        {
+            if (index >= vertices_count)
+            {
+                return outcome::failure(std::errc::illegal_byte_sequence);
+            }
+        }
+    }
+    else
+    {
+        if ((vertices_count % 3) != 0)
+        {
+            return outcome::failure(std::errc::not_supported);
+        }
+        std::vector<Index>& owned = model.owned_indices.emplace_back(vertices_count);
+        for (std::size_t i = 0; i < vertices_count; ++i)
+        {
+            owned[i] = Index(i);
+        }
+        mesh.indices = owned;
+    }
+
+    // Vertices.
+    if (IsVertexLayout(attributes, needs_tangent))
+    {
+        mesh.vertices = {reinterpret_cast<const Vertex*>(attributes.position.data), vertices_count};
+    }
+    else
+    {
+        std::vector<Vertex>& owned = model.owned_vertices.emplace_back(ConvertVertices(attributes));
+        if (!attributes.has_tangent && attributes.has_uv && attributes.has_normal)
+        {
+            ComputeVertexTangents(owned, mesh.indices);
+        }
+        mesh.vertices = owned;
+    }
+
+    if (attributes.position.has_bounds)
+    {
+        mesh.aabb_min = attributes.position.min;
+        mesh.aabb_max = attributes.position.max;
+    }
+    else
+    {
+        mesh.aabb_min = glm::vec3(FLT_MAX);
+        mesh.aabb_max = glm::vec3(-FLT_MAX);
+        for (const Vertex& v : mesh.vertices)
+        {
+            mesh.aabb_min = glm::min(mesh.aabb_min, v.position);
+            mesh.aabb_max = glm::max(mesh.aabb_max, v.position);
+        }
+    }
+    model.aabb_min = glm::min(model.aabb_min, mesh.aabb_min);
+    model.aabb_max = glm::max(model.aabb_max, mesh.aabb_max);
+    model.meshes.push_back(mesh);
+    return outcome::success(true);
+}
+
+} // namespace
+
+outcome::result<MappedModel> Glb_Load(const fs::path& file_path)
+{
+    MappedModel model{};
+    {
+        auto maybe_file = MappedFile::open(file_path);
+        if (!maybe_file)
+        {
+            return outcome::failure(maybe_file.error());
+        }
+        model.file = std::move(maybe_file.value());
+    }
+    const std::span<const std::uint8_t> bytes = model.file.bytes();
+    if ((bytes.size() < (c_glb_header_size + c_glb_chunk_header_size)) || (ReadU32(bytes.data()) != c_glb_magic)
+        || (ReadU32(bytes.data() + 4) != 2))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    const std::size_t length = std::min<std::size_t>(ReadU32(bytes.data() + 8), bytes.size());
+
+    GlbDocument document;
+    std::string_view json_text;
+    for (std::size_t offset = c_glb_header_size; (offset + c_glb_chunk_header_size) <= length;)
+    {
+        const std::size_t chunk_length = ReadU32(bytes.data() + offset);
+        const std::uint32_t chunk_type = ReadU32(bytes.data() + offset + 4);
+        offset += c_glb_chunk_header_size;
+        if (chunk_length > (length - offset))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        if ((chunk_type == c_glb_chunk_json) && json_text.empty())
+        {
+            json_text = {reinterpret_cast<const char*>(bytes.data() + offset), chunk_length};
+        }
+        else if ((chunk_type == c_glb_chunk_bin) && document.bin.empty())
+        {
+            document.bin = bytes.subspan(offset, chunk_length);
+        }
+        offset += chunk_length;
+    }
+    auto maybe_json = Json_Parse(json_text);
+    if (!maybe_json)
+    {
+        return outcome::failure(maybe_json.error());
+    }
+    document.json = std::move(maybe_json.value());
+
+    // Only the GLB-stored buffer (no uri) is supported.
+    const JsonValue* buffers = document.json.find("buffers");
+    if (buffers && ((buffers->size() > 1) || ((buffers->size() == 1) && buffers->at(0)->find("uri"))))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    if (const JsonValue* buffer = document.get("buffers", 0))
+    {
+        const double buffer_length = buffer->number_or("byteLength", -1);
+        if ((buffer_length < 0) || (buffer_length > double(document.bin.size())))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        document.bin = document.bin.first(std::size_t(buffer_length));
+    }
+    const JsonValue* images = document.json.find("images");
+    const JsonValue* meshes = document.json.find("meshes");
+    if (!meshes)
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+
+    model.aabb_min = glm::vec3(FLT_MAX);
+    model.aabb_max = glm::vec3(-FLT_MAX);
+    GlbTextures textures{document, model, {}};
+    textures.image_to_id.resize(images ? images->size() : 0, c_no_texture);
+    // Every mesh once, not per node instance.
+    for (const JsonValue& mesh : meshes->elements)
+    {
+        const JsonValue* primitives = mesh.find("primitives");
+        if (!primitives)
+        {
+            continue;
+        }
+        for (const JsonValue& primitive : primitives->elements)
+        {
+            auto added = AddPrimitive(document, textures, model, primitive);
+            if (!added)
+            {
+                return outcome::failure(added.error());
+            }
+        }
+    }
+    if (model.meshes.empty())
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    return outcome::success(std::move(model));
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "model_cache.h"
+#include "utils_outcome.h"
+
+#include <filesystem>
+
+// Binary glTF 2.0 (.glb) with the single embedded BIN buffer.
+// The file stays mapped: vertex/index accessors are exposed as Mesh spans
+// into the mapping when the layout already matches (see below), converted
+// into MappedModel::owned_* storage otherwise. Embedded PNG/JPEG images
+// are decoded straight from the mapping.
+//
+// Vertex zero-copy: POSITION, NORMAL, TEXCOORD_0 (float) interleaved in one
+// bufferView with byteStride == sizeof(Vertex) at Vertex offsets; tangent
+// is either the custom "_TANGENT" (float VEC3) attribute at its offset or
+// not needed (no normal texture). glTF's TANGENT is VEC4, so it's converted.
+// Index zero-copy: UNSIGNED_INT, tightly packed.
+//
+// Triangles only (mode 4); node transforms are ignored (as with Assimp path).
+// External buffers/images (.gltf + .bin) are not supported (fail;
+// let Assimp handle those).
+outcome::result<MappedModel> Glb_Load(const std::filesystem::path& file_path);
@@ -2,7 +2,14 @@
 
 #include "app_state.h"
 #include "imgui_state_debug.h"
+#include "package.h"
 #include "render_model.h"
+#include "texture_share.h"
+#include "thread_pool.h"
+
+#include <filesystem>
+
+#include <cstdio>
 
 // Integration of ImGui comes from
 // imgui-src/examples/example_win32_directx11/main.cpp
@@ -68,6 +75,163 @@ void ImGui_TweaksInput(ImGuiState& imgui)
     ImGui::SameLine();
     (void)ImGui::Checkbox("Show model", &imgui.show_model);
 
+    auto progress = [](const char* what, std::uint32_t done, std::uint32_t total) {
+        char overlay[64];
+        (void)std::snprintf(overlay, sizeof(overlay), "%s %u/%u", what, done, total);
+        ImGui::ProgressBar((total > 0) ? (float(done) / float(total)) : 0.f, ImVec2(-1.f, 0.f), overlay);
+    };
+    if (ModelListJob* list_job = imgui.app_->list_job_.get())
+    {
+        progress("Scan files", list_job->files_done(), list_job->files_total());
+        if (ImGui::Button("Cancel scan"))
+        {
+            list_job->cancel();
+        }
+    }
+    if (const ModelUploadJob* upload_job = imgui.app_->upload_job_.get())
+    {
+        progress("Model meshes & textures", upload_job->pieces_done(), upload_job->pieces_total());
+    }
+    const std::vector<FileModel>& models = imgui.app_->models_;
+    const std::size_t selected = std::size_t(imgui.selected_model_index_);
+    if ((selected < models.size()) && imgui.app_->loader_.is_loading(models[selected].file_name))
+    {
+        ImGui::Text("Loading '%s'...", models[selected].name.c_str());
+    }
+    if (imgui.app_->pack_job_.valid())
+    {
+        ImGui::Text("Packing...");
+    }
+    else if ((imgui.app_->active_model_index_ >= 0) && !imgui.app_->list_job_)
+    {
+        const std::string& file_name = models[std::size_t(imgui.app_->active_model_index_)].file_name;
+        if (!Package_IsPath(file_name) && ImGui::Button("Pack model folder"))
+        {
+            // <folder>.rpkg next to the folder.
+            const std::filesystem::path folder = std::filesystem::path(file_name).parent_path();
+            std::filesystem::path package_path = folder;
+            package_path += ".rpkg";
+            imgui.app_->pack_job_ = GlobalThreadPool().submit([folder, package_path]() {
+                return Package_Build(folder, package_path) ? package_path.string() : std::string();
+            });
+        }
+    }
+    if (ImGui::CollapsingHeader("Models residency"))
+    {
+        ModelResidency& residency = imgui.app_->residency_;
+        const ResidencyStats& stats = residency.stats();
+        int cpu_budget_mb = int(residency.cpu_budget_bytes >> 20);
+        int gpu_budget_mb = int(residency.gpu_budget_bytes >> 20);
+        if (ImGui::SliderInt("CPU budget, MB", &cpu_budget_mb, 64, 16384))
+        {
+            residency.cpu_budget_bytes = (std::size_t(cpu_budget_mb) << 20);
+        }
+        if (ImGui::SliderInt("GPU budget, MB", &gpu_budget_mb, 64, 8192))
+        {
+            residency.gpu_budget_bytes = (std::size_t(gpu_budget_mb) << 20);
+        }
+        const double mb = double(1 << 20);
+        ImGui::Text(
+            "CPU: %.1f MB (+%.1f MB mapped), %u models, %u evictions",
+            double(stats.cpu_bytes) / mb,
+            double(stats.cpu_mapped_bytes) / mb,
+            stats.cpu_models,
+            stats.cpu_evictions
+        );
+        ImGui::Text(
+            "GPU: %.1f MB, %u kept models, %u evictions",
+            double(stats.gpu_bytes) / mb,
+            stats.gpu_models,
+            stats.gpu_evictions
+        );
+        ImGui::Text("Reloads: %u, %.1f ms total", stats.reloads, stats.reloads_ms);
+        ModelChunkPager& pager = imgui.app_->chunk_pager_;
+        if (pager.is_active())
+        {
+            const ChunkPagerStats& chunks = pager.stats();
+            int chunks_budget_mb = int(pager.gpu_budget_bytes >> 20);
+            if (ImGui::SliderInt("Chunks GPU budget, MB", &chunks_budget_mb, 64, 8192))
+            {
+                pager.gpu_budget_bytes = (std::size_t(chunks_budget_mb) << 20);
+            }
+            ImGui::Text(
+                "Chunks: %u of %u, %.1f MB, %u uploads, %u evictions",
+                chunks.resident_chunks,
+                chunks.total_chunks,
+                double(chunks.resident_bytes) / mb,
+                chunks.uploads,
+                chunks.evictions
+            );
+        }
+        ModelTextureStreamer& streamer = imgui.app_->texture_streamer_;
+        if (streamer.is_active())
+        {
+            const TextureStreamStats& textures = streamer.stats();
+            int textures_budget_mb = int(streamer.gpu_budget_bytes >> 20);
+            if (ImGui::SliderInt("Textures GPU budget, MB", &textures_budget_mb, 16, 8192))
+            {
+                streamer.gpu_budget_bytes = (std::size_t(textures_budget_mb) << 20);
+            }
+            ImGui::Text(
+                "Textures: %u, resident %.1f MB, requested %.1f MB (%.1f MB in budget), full %.1f MB",
+                textures.textures,
+                double(textures.resident_bytes) / mb,
+                double(textures.requested_bytes) / mb,
+                double(textures.wanted_bytes) / mb,
+                double(textures.full_bytes) / mb
+            );
+            ImGui::Text(
+                "Texture uploads: %u, drops: %u (%s)",
+                textures.uploads,
+                textures.drops,
+                streamer.is_settled() ? "settled" : "streaming"
+            );
+        }
+        const TextureShareStats shared = GlobalTextureShare().stats();
+        ImGui::Text(
+            "Shared textures: CPU %u (%u hits, %.1f MB saved), GPU %u (%u hits, %.1f MB saved)",
+            shared.cpu_textures,
+            shared.cpu_hits,
+            double(shared.cpu_bytes_saved) / mb,
+            shared.gpu_textures,
+            shared.gpu_hits,
+            double(shared.gpu_bytes_saved) / mb
+        );
+        const TexturePackStats& packed = imgui.app_->active_model_.pack_stats_;
+        if (packed.arrays > 0)
+        {
+            ImGui::Text("Texture arrays: %u, of %u textures", packed.arrays, packed.textures);
+            ImGui::Text(
+                "Per frame: %u -> %u binds (%u -> %u textures), %u -> %u draws",
+                packed.binds_before,
+                packed.binds_after,
+                packed.texture_binds_before,
+                packed.texture_binds_after,
+                packed.draws_before,
+                packed.draws_after
+            );
+        }
+        imgui.need_change_pack_vertices = ImGui::Checkbox("Pack vertices", &imgui.pack_vertices);
+        const VertexPackStats vertices = imgui.app_->active_model_.vertex_pack_stats();
+        if (vertices.meshes > 0)
+        {
+            ImGui::Text(
+                "Packed vertices: %.1f -> %.1f MB, of %u meshes",
+                double(vertices.bytes_before) / mb,
+                double(vertices.bytes_after) / mb,
+                vertices.meshes
+            );
+            ImGui::Text(
+                "Max error: position %.2g (%.4f%%), normal %.3f deg, tangent %.3f deg, uv %.2g",
+                double(vertices.max_error.position),
+                double(vertices.max_error.position_relative) * 100.0,
+                double(vertices.max_error.normal_degrees),
+                double(vertices.max_error.tangent_degrees),
+                double(vertices.max_error.texture_coord)
+            );
+        }
+    }
+
     imgui.need_change_wireframe = ImGui::Checkbox("Render wireframe", &imgui.wireframe);
     (void)ImGui::Checkbox("Show zero world space (red = x, green = y, blue = z)", &imgui.show_zero_world_space);
     (void)ImGui::Checkbox("Show light cube", &imgui.show_light_cube);
@@ -117,6 +281,10 @@ void ImGui_ShadersInput(ImGuiState& imgui)
     for (int index = 0, count = int(shaders.vs_shaders_.size()); index < count; ++index)
     {
         const VSShader& vs = shaders.vs_shaders_[std::size_t(index)];
+        if (shaders.is_packed_vs(vs))
+        {
+            continue;
+        }
         if (used_vs_now == index)
         {
             ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.f, 1.f, 0.f, 1.f));
@@ -165,6 +333,7 @@ void ImGui_ShadersInput(ImGuiState& imgui)
             if (used_vs_now != imgui.model_vs_index)
             {
                 active_model.vs_shader_ = &shaders.vs_shaders_[imgui.model_vs_index];
+                active_model.vs_packed_shader_ = shaders.find_packed_vs(*active_model.vs_shader_);
             }
             if (used_ps_now != imgui.model_ps_index)
             {
@@ -47,6 +47,9 @@ struct ImGuiState
     LightMode light_mode = LightMode::Moving_Active;
     float light_move_radius = 10.f;
     bool show_cube_normals = false;
+    // Vertices of the active model as PackedVertex (see RenderMesh::make()); a change re-creates it.
+    bool pack_vertices = true;
+    bool need_change_pack_vertices = false;
 
     AppState* app_ = nullptr;
     int selected_model_index_ = 0;
@@ -60,6 +63,15 @@ struct ImGuiState
         }
         return false;
     }
+    bool check_pack_vertices_change()
+    {
+        if (need_change_pack_vertices)
+        {
+            need_change_pack_vertices = false;
+            return true;
+        }
+        return false;
+    }
     glm::mat4x4 get_model_scale() const
     {
         return glm::scale(glm::mat4x4(1.f), glm::vec3(model_scale));
@@ -0,0 +1,305 @@
+#include "json.h"
+
+#include <charconv>
+
+#include <cstdint>
+
+namespace
+{
+
+constexpr int c_max_depth = 128;
+
+struct JsonParser
+{
+    const char* p;
+    const char* end;
+
+    void skip_spaces()
+    {
+        while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r')))
+        {
+            ++p;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skip_spaces();
+        if ((p < end) && (*p == c))
+        {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+
+    bool consume_word(std::string_view word)
+    {
+        if ((std::size_t(end - p) >= word.size()) && (std::string_view(p, word.size()) == word))
+        {
+            p += word.size();
+            return true;
+        }
+        return false;
+    }
+
+    static void append_utf8(std::string& out, std::uint32_t code_point)
+    {
+        if (code_point < 0x80)
+        {
+            out += char(code_point);
+        }
+        else if (code_point < 0x800)
+        {
+            out += char(0xc0 | (code_point >> 6));
+            out += char(0x80 | (code_point & 0x3f));
+        }
+        else if (code_point < 0x10000)
+        {
+            out += char(0xe0 | (code_point >> 12));
+            out += char(0x80 | ((code_point >> 6) & 0x3f));
+            out += char(0x80 | (code_point & 0x3f));
+        }
+        else
+        {
+            out += char(0xf0 | (code_point >> 18));
+            out += char(0x80 | ((code_point >> 12) & 0x3f));
+            out += char(0x80 | ((code_point >> 6) & 0x3f));
+            out += char(0x80 | (code_point & 0x3f));
+        }
+    }
+
+    bool parse_hex4(std::uint32_t& value)
+    {
+        if ((end - p) < 4)
+        {
+            return false;
+        }
+        const std::from_chars_result r = std::from_chars(p, p + 4, value, 16);
+        if ((r.ec != std::errc()) || (r.ptr != (p + 4)))
+        {
+            return false;
+        }
+        p += 4;
+        return true;
+    }
+
+    bool parse_string(std::string& out)
+    {
+        if (!consume('"'))
+        {
+            return false;
+        }
+        while (p < end)
+        {
+            const char c = *p++;
+            if (c == '"')
+            {
+                return true;
+            }
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (p >= end)
+            {
+                return false;
+            }
+            const char e = *p++;
+            switch (e)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out += e;
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+            {
+                std::uint32_t code_point = 0;
+                if (!parse_hex4(code_point))
+                {
+                    return false;
+                }
+                // Surrogate pair.
+                if ((code_point >= 0xd800) && (code_point < 0xdc00) && consume_word("\\u"))
+                {
+                    std::uint32_t low = 0;
+                    if (!parse_hex4(low) || (low < 0xdc00) || (low >= 0xe000))
+                    {
+                        return false;
+                    }
+                    code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+                }
+                append_utf8(out, code_point);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    bool parse_value(JsonValue& value, int depth)
+    {
+        if (depth > c_max_depth)
+        {
+            return false;
+        }
+        skip_spaces();
+        if (p >= end)
+        {
+            return false;
+        }
+        switch (*p)
+        {
+        case '{':
+        {
+            ++p;
+            value.kind = JsonValue::Object;
+            if (consume('}'))
+            {
+                return true;
+            }
+            do
+            {
+                std::string key;
+                skip_spaces();
+                if (!parse_string(key) || !consume(':'))
+                {
+                    return false;
+                }
+                value.keys.push_back(std::move(key));
+                if (!parse_value(value.elements.emplace_back(), depth + 1))
+                {
+                    return false;
+                }
+            } while (consume(','));
+            return consume('}');
+        }
+        case '[':
+        {
+            ++p;
+            value.kind = JsonValue::Array;
+            if (consume(']'))
+            {
+                return true;
+            }
+            do
+            {
+                if (!parse_value(value.elements.emplace_back(), depth + 1))
+                {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(']');
+        }
+        case '"':
+            value.kind = JsonValue::String;
+            return parse_string(value.string);
+        case 't':
+            value.kind = JsonValue::Bool;
+            value.boolean = true;
+            return consume_word("true");
+        case 'f':
+            value.kind = JsonValue::Bool;
+            value.boolean = false;
+            return consume_word("false");
+        case 'n':
+            value.kind = JsonValue::Null;
+            return consume_word("null");
+        default:
+        {
+            value.kind = JsonValue::Number;
+            const std::from_chars_result r = std::from_chars(p, end, value.number);
+            if (r.ec != std::errc())
+            {
+                return false;
+            }
+            p = r.ptr;
+            return true;
+        }
+        }
+    }
+};
+
+} // namespace
+
+const JsonValue* JsonValue::find(std::string_view key) const
+{
+    if (kind != Object)
+    {
+        return nullptr;
+    }
+    for (std::size_t i = 0, count = keys.size(); i < count; ++i)
+    {
+        if (keys[i] == key)
+        {
+            return &elements[i];
+        }
+    }
+    return nullptr;
+}
+
+const JsonValue* JsonValue::at(std::size_t index) const
+{
+    if ((kind != Array) || (index >= elements.size()))
+    {
+        return nullptr;
+    }
+    return &elements[index];
+}
+
+double JsonValue::number_or(double default_value) const
+{
+    return (kind == Number) ? number : default_value;
+}
+
+double JsonValue::number_or(std::string_view key, double default_value) const
+{
+    const JsonValue* v = find(key);
+    return v ? v->number_or(default_value) : default_value;
+}
+
+std::string_view JsonValue::string_or(std::string_view key, std::string_view default_value) const
+{
+    const JsonValue* v = find(key);
+    return (v && (v->kind == String)) ? std::string_view(v->string) : default_value;
+}
+
+std::size_t JsonValue::size() const
+{
+    return ((kind == Array) || (kind == Object)) ? elements.size() : 0;
+}
+
+outcome::result<JsonValue> Json_Parse(std::string_view text)
+{
+    JsonParser parser{text.data(), text.data() + text.size()};
+    JsonValue root;
+    if (!parser.parse_value(root, 0))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    parser.skip_spaces();
+    if (parser.p != parser.end)
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    return outcome::success(std::move(root));
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "utils_outcome.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+
+// Minimal JSON DOM; enough for glTF.
+struct JsonValue
+{
+    enum Kind
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    Kind kind = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> elements; // Array items or Object values
+    std::vector<std::string> keys;   // Object keys, keys[i] -> elements[i]
+
+    // nullptr if not an Object or no such key.
+    const JsonValue* find(std::string_view key) const;
+    // nullptr if not an Array or out of range.
+    const JsonValue* at(std::size_t index) const;
+
+    double number_or(double default_value) const;
+    // find(key)->number_or(default_value), if any.
+    double number_or(std::string_view key, double default_value) const;
+    std::string_view string_or(std::string_view key, std::string_view default_value) const;
+    std::size_t size() const;
+};
+
+outcome::result<JsonValue> Json_Parse(std::string_view text);
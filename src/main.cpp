@@ -56,6 +56,7 @@ int WINAPI _tWinMain(HINSTANCE /*hInstance*/, HINSTANCE /*hPrevInstance*/, LPTST
     app.watch_ = ShadersWatch(app.compiler_);
     app.all_shaders_ = Shaders::Build();
     app.imgui_.app_ = &app;
+    app.file_index_ = FileIndex::Load();
     app.files_to_load_.push_back(XX_PACKAGE_FOLDER "dragon/dragon.obj");
 
     // Accept WM_DROPFILES.
@@ -200,11 +201,10 @@ int WINAPI _tWinMain(HINSTANCE /*hInstance*/, HINSTANCE /*hPrevInstance*/, LPTST
             continue;
         }
 
-        if (TickModelsLoad(app))
+        if (TickModelsLoad(app) || TickModelsHotReload(app))
         {
-            const Model& m = app.models_[std::size_t(app.active_model_index_)].model;
             render_bb.clear();
-            render_bb.add_bb(m.aabb_min(), m.aabb_max(), glm::vec3(1.f, 0.f, 0.f));
+            render_bb.add_bb(app.active_model_.aabb_min, app.active_model_.aabb_max, glm::vec3(1.f, 0.f, 0.f));
         }
 
         TickShadersChange(app);
@@ -232,6 +232,9 @@ int WINAPI _tWinMain(HINSTANCE /*hInstance*/, HINSTANCE /*hPrevInstance*/, LPTST
         render_bb.world = app.active_model_.world;
         app.active_model_.light_color = app.imgui_.light_color;
         app.active_model_.viewer_position = app.camera_.camera_position_;
+        TickModelChunks(app);
+        TickTextureStreaming(app);
+        TickTexturePacking(app);
 
         switch (app.imgui_.light_mode)
         {
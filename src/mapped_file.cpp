@@ -0,0 +1,102 @@
+#include "mapped_file.h"
+
+#include <Windows.h>
+
+#include <utility>
+
+/*static*/ outcome::result<MappedFile> MappedFile::open(const std::filesystem::path& file_path)
+{
+    MappedFile mapped;
+    HANDLE file = ::CreateFileW(
+        file_path.c_str(),
+        GENERIC_READ,
+        // Mapped file may be replaced (renamed over) or deleted while in use:
+        // re-baked cache, .glb saved by an editor (see ModelWatch).
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return outcome::failure(std::errc::no_such_file_or_directory);
+    }
+    mapped.file_ = file;
+
+    LARGE_INTEGER size{};
+    if (!::GetFileSizeEx(file, &size) || (size.QuadPart <= 0))
+    {
+        // Empty files can't be mapped.
+        return outcome::failure(std::errc::invalid_argument);
+    }
+    mapped.size_ = std::size_t(size.QuadPart);
+
+    mapped.mapping_ = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapped.mapping_)
+    {
+        return outcome::failure(std::errc::io_error);
+    }
+    mapped.data_ = static_cast<const std::uint8_t*>(::MapViewOfFile(mapped.mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped.data_)
+    {
+        return outcome::failure(std::errc::io_error);
+    }
+    return outcome::success(std::move(mapped));
+}
+
+std::span<const std::uint8_t> MappedFile::bytes() const
+{
+    return {data_, size_};
+}
+
+bool MappedFile::is_open() const
+{
+    return !!data_;
+}
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept
+    : file_(std::exchange(rhs.file_, nullptr)),
+      mapping_(std::exchange(rhs.mapping_, nullptr)),
+      data_(std::exchange(rhs.data_, nullptr)),
+      size_(std::exchange(rhs.size_, 0))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        close();
+        file_ = std::exchange(rhs.file_, nullptr);
+        mapping_ = std::exchange(rhs.mapping_, nullptr);
+        data_ = std::exchange(rhs.data_, nullptr);
+        size_ = std::exchange(rhs.size_, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() noexcept
+{
+    close();
+}
+
+void MappedFile::close() noexcept
+{
+    if (data_)
+    {
+        (void)::UnmapViewOfFile(data_);
+        data_ = nullptr;
+    }
+    if (mapping_)
+    {
+        (void)::CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+    if (file_)
+    {
+        (void)::CloseHandle(file_);
+        file_ = nullptr;
+    }
+    size_ = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "utils_outcome.h"
+
+#include <filesystem>
+#include <span>
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of the whole file (CreateFileMapping/MapViewOfFile).
+struct MappedFile
+{
+    static outcome::result<MappedFile> open(const std::filesystem::path& file_path);
+
+    std::span<const std::uint8_t> bytes() const;
+    bool is_open() const;
+
+    MappedFile() noexcept = default;
+    MappedFile(MappedFile&& rhs) noexcept;
+    MappedFile& operator=(MappedFile&& rhs) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() noexcept;
+
+private:
+    void close() noexcept;
+
+private:
+    void* file_ = nullptr;    // HANDLE
+    void* mapping_ = nullptr; // HANDLE
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+};
@@ -0,0 +1,283 @@
+#include "mesh_codec.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
+#include <cstring>
+
+// Layout of the encoded stream:
+//  u32 elements_count
+//  u32 blocks_count
+//  u32 block_bytes[blocks_count]
+//  blocks: for every channel (u32 of the element), for every byte plane:
+//   group headers, 2 bits per group (0 - all zero, 1 - 2 bits, 2 - 4 bits, 3 - 8 bits per byte)
+//   groups data
+
+static constexpr std::size_t c_block_elements = (16 * 1024);
+static constexpr std::size_t c_group_size = 16;
+static constexpr std::size_t c_planes_count = 4;
+
+static_assert(std::is_trivially_copyable_v<Vertex>);
+static_assert((sizeof(Vertex) % sizeof(std::uint32_t)) == 0);
+static_assert((c_block_elements % c_group_size) == 0);
+
+static std::uint32_t ZigZag(std::uint32_t delta)
+{
+    return (delta << 1) ^ std::uint32_t(std::int32_t(delta) >> 31);
+}
+
+static std::uint32_t UnZigZag(std::uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1u));
+}
+
+static std::uint32_t LoadU32(const std::uint8_t* data)
+{
+    std::uint32_t value = 0;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static void StoreU32(std::uint8_t* data, std::uint32_t value)
+{
+    std::memcpy(data, &value, sizeof(value));
+}
+
+static void EncodePlane(const std::uint8_t* bytes, std::size_t count, std::vector<std::uint8_t>& out)
+{
+    const std::size_t groups_count = (count + c_group_size - 1) / c_group_size;
+    const std::size_t headers_offset = out.size();
+    out.resize(out.size() + (groups_count + 3) / 4, 0);
+    for (std::size_t g = 0; g < groups_count; ++g)
+    {
+        std::uint8_t group[c_group_size]{};
+        const std::size_t group_count = std::min(c_group_size, count - g * c_group_size);
+        std::memcpy(group, bytes + g * c_group_size, group_count);
+        std::uint8_t any = 0;
+        for (std::uint8_t v : group)
+        {
+            any |= v;
+        }
+        const std::uint8_t code = (any == 0) ? 0 : (any < 4) ? 1 : (any < 16) ? 2 : 3;
+        out[headers_offset + g / 4] |= std::uint8_t(code << ((g % 4) * 2));
+        switch (code)
+        {
+        case 1:
+            for (std::size_t k = 0; k < c_group_size; k += 4)
+            {
+                out.push_back(std::uint8_t(group[k] | (group[k + 1] << 2) | (group[k + 2] << 4) | (group[k + 3] << 6)));
+            }
+            break;
+        case 2:
+            for (std::size_t k = 0; k < c_group_size; k += 2)
+            {
+                out.push_back(std::uint8_t(group[k] | (group[k + 1] << 4)));
+            }
+            break;
+        case 3:
+            out.insert(out.end(), std::begin(group), std::end(group));
+            break;
+        }
+    }
+}
+
+// ORs bytes of the plane into (value << shift) of values. nullptr if data is malformed.
+static const std::uint8_t* DecodePlane(
+    const std::uint8_t* data,
+    const std::uint8_t* end,
+    std::uint32_t* values,
+    std::size_t count,
+    unsigned shift
+)
+{
+    const std::size_t groups_count = (count + c_group_size - 1) / c_group_size;
+    const std::size_t headers_size = (groups_count + 3) / 4;
+    if (std::size_t(end - data) < headers_size)
+    {
+        return nullptr;
+    }
+    const std::uint8_t* headers = data;
+    data += headers_size;
+    for (std::size_t g = 0; g < groups_count; ++g)
+    {
+        const unsigned code = (headers[g / 4] >> ((g % 4) * 2)) & 3u;
+        if (code == 0)
+        {
+            continue;
+        }
+        const std::size_t data_size = (code == 1) ? 4 : (code == 2) ? 8 : 16;
+        if (std::size_t(end - data) < data_size)
+        {
+            return nullptr;
+        }
+        std::uint8_t group[c_group_size];
+        switch (code)
+        {
+        case 1:
+            for (std::size_t k = 0; k < 4; ++k)
+            {
+                const std::uint8_t v = data[k];
+                group[4 * k + 0] = std::uint8_t(v & 3u);
+                group[4 * k + 1] = std::uint8_t((v >> 2) & 3u);
+                group[4 * k + 2] = std::uint8_t((v >> 4) & 3u);
+                group[4 * k + 3] = std::uint8_t(v >> 6);
+            }
+            break;
+        case 2:
+            for (std::size_t k = 0; k < 8; ++k)
+            {
+                const std::uint8_t v = data[k];
+                group[2 * k + 0] = std::uint8_t(v & 15u);
+                group[2 * k + 1] = std::uint8_t(v >> 4);
+            }
+            break;
+        default:
+            std::memcpy(group, data, c_group_size);
+            break;
+        }
+        data += data_size;
+        std::uint32_t* dst = values + g * c_group_size;
+        const std::size_t group_count = std::min(c_group_size, count - g * c_group_size);
+        for (std::size_t k = 0; k < group_count; ++k)
+        {
+            dst[k] |= (std::uint32_t(group[k]) << shift);
+        }
+    }
+    return data;
+}
+
+static void EncodeBlock(
+    const std::uint8_t* elements,
+    std::size_t count,
+    std::size_t stride,
+    std::vector<std::uint8_t>& out
+)
+{
+    std::vector<std::uint8_t> plane(count);
+    std::vector<std::uint32_t> deltas(count);
+    for (std::size_t channel = 0, channels = (stride / 4); channel < channels; ++channel)
+    {
+        std::uint32_t prev = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const std::uint32_t value = LoadU32(elements + i * stride + channel * 4);
+            deltas[i] = ZigZag(value - prev);
+            prev = value;
+        }
+        for (std::size_t p = 0; p < c_planes_count; ++p)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                plane[i] = std::uint8_t(deltas[i] >> (p * 8));
+            }
+            EncodePlane(plane.data(), count, out);
+        }
+    }
+}
+
+static bool DecodeBlock(
+    const std::uint8_t* data,
+    const std::uint8_t* end,
+    std::uint8_t* elements,
+    std::size_t count,
+    std::size_t stride
+)
+{
+    std::vector<std::uint32_t> deltas(count);
+    for (std::size_t channel = 0, channels = (stride / 4); channel < channels; ++channel)
+    {
+        std::fill(std::begin(deltas), std::end(deltas), 0u);
+        for (unsigned p = 0; p < c_planes_count; ++p)
+        {
+            data = DecodePlane(data, end, deltas.data(), count, p * 8);
+            if (!data)
+            {
+                return false;
+            }
+        }
+        std::uint32_t prev = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            prev += UnZigZag(deltas[i]);
+            StoreU32(elements + i * stride + channel * 4, prev);
+        }
+    }
+    return (data == end);
+}
+
+static std::vector<std::uint8_t> Encode(const std::uint8_t* elements, std::size_t count, std::size_t stride)
+{
+    const std::size_t blocks_count = (count + c_block_elements - 1) / c_block_elements;
+    std::vector<std::vector<std::uint8_t>> blocks(blocks_count);
+    GlobalThreadPool().parallel_for(blocks_count, [&](std::size_t b) {
+        const std::size_t first = (b * c_block_elements);
+        EncodeBlock(elements + first * stride, std::min(c_block_elements, count - first), stride, blocks[b]);
+    });
+
+    std::vector<std::uint8_t> out(4 * (2 + blocks_count));
+    StoreU32(out.data(), std::uint32_t(count));
+    StoreU32(out.data() + 4, std::uint32_t(blocks_count));
+    for (std::size_t b = 0; b < blocks_count; ++b)
+    {
+        StoreU32(out.data() + 4 * (2 + b), std::uint32_t(blocks[b].size()));
+        out.insert(out.end(), blocks[b].begin(), blocks[b].end());
+    }
+    return out;
+}
+
+static bool Decode(std::span<const std::uint8_t> encoded, std::uint8_t* elements, std::size_t count, std::size_t stride)
+{
+    if ((encoded.size() < 8) || (LoadU32(encoded.data()) != count))
+    {
+        return false;
+    }
+    const std::size_t blocks_count = LoadU32(encoded.data() + 4);
+    if ((blocks_count != ((count + c_block_elements - 1) / c_block_elements))
+        || (((encoded.size() - 8) / 4) < blocks_count))
+    {
+        return false;
+    }
+    std::vector<const std::uint8_t*> starts(blocks_count + 1);
+    starts[0] = encoded.data() + 4 * (2 + blocks_count);
+    for (std::size_t b = 0; b < blocks_count; ++b)
+    {
+        const std::size_t block_bytes = LoadU32(encoded.data() + 4 * (2 + b));
+        if (std::size_t(encoded.data() + encoded.size() - starts[b]) < block_bytes)
+        {
+            return false;
+        }
+        starts[b + 1] = starts[b] + block_bytes;
+    }
+    std::atomic<bool> failed{false};
+    GlobalThreadPool().parallel_for(blocks_count, [&](std::size_t b) {
+        const std::size_t first = (b * c_block_elements);
+        const std::size_t block_count = std::min(c_block_elements, count - first);
+        if (!DecodeBlock(starts[b], starts[b + 1], elements + first * stride, block_count, stride))
+        {
+            failed.store(true);
+        }
+    });
+    return !failed.load() && (starts[blocks_count] == (encoded.data() + encoded.size()));
+}
+
+std::vector<std::uint8_t> MeshCodec_EncodeVertices(std::span<const Vertex> vertices)
+{
+    return Encode(reinterpret_cast<const std::uint8_t*>(vertices.data()), vertices.size(), sizeof(Vertex));
+}
+
+std::vector<std::uint8_t> MeshCodec_EncodeIndices(std::span<const Index> indices)
+{
+    return Encode(reinterpret_cast<const std::uint8_t*>(indices.data()), indices.size(), sizeof(Index));
+}
+
+bool MeshCodec_DecodeVertices(std::span<const std::uint8_t> encoded, std::span<Vertex> vertices)
+{
+    return Decode(encoded, reinterpret_cast<std::uint8_t*>(vertices.data()), vertices.size(), sizeof(Vertex));
+}
+
+bool MeshCodec_DecodeIndices(std::span<const std::uint8_t> encoded, std::span<Index> indices)
+{
+    return Decode(encoded, reinterpret_cast<std::uint8_t*>(indices.data()), indices.size(), sizeof(Index));
+}
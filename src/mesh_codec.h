@@ -0,0 +1,24 @@
+#pragma once
+#include "vertex.h"
+
+#include <span>
+#include <vector>
+
+#include <cstdint>
+
+// Lossless compression of Mesh vertex & index streams (used by the model cache).
+// Each 32-bit value (float bits of a Vertex component, or an Index) is stored
+// as zigzag-encoded delta to the previous vertex/index; bytes of the deltas are
+// split into planes, so the mostly-zero high bytes are in the separate streams.
+// Every plane is coded in groups of 16 bytes with 0/2/4/8 bits per byte.
+// Streams are split into independent blocks decoded on GlobalThreadPool().
+
+// Decoded bytes per encoded byte, at most: a group of zeros is 2 header bits for 16 bytes.
+static constexpr std::uint64_t c_mesh_codec_max_expansion = 64;
+
+std::vector<std::uint8_t> MeshCodec_EncodeVertices(std::span<const Vertex> vertices);
+std::vector<std::uint8_t> MeshCodec_EncodeIndices(std::span<const Index> indices);
+
+// Output size must match the encoded one. False if data is malformed.
+bool MeshCodec_DecodeVertices(std::span<const std::uint8_t> encoded, std::span<Vertex> vertices);
+bool MeshCodec_DecodeIndices(std::span<const std::uint8_t> encoded, std::span<Index> indices);
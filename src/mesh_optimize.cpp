@@ -0,0 +1,561 @@
+#include "mesh_optimize.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <numbers>
+#include <vector>
+
+#include <cmath>
+
+// Vertex is in the cache if it was pushed during the last size misses.
+struct FifoCache
+{
+    explicit FifoCache(std::size_t vertex_count, std::size_t cache_size)
+        : pushed_at(vertex_count, 0)
+        , size(cache_size)
+    {
+        Panic(size > 0);
+    }
+
+    // Transformed vertices of the triangle, 0 .. 3.
+    std::uint8_t add(Index i0, Index i1, Index i2)
+    {
+        return std::uint8_t(add(i0) + add(i1) + add(i2));
+    }
+
+    std::uint8_t add(Index vertex)
+    {
+        Panic(vertex < pushed_at.size());
+        if ((pushed_at[vertex] == 0) || ((misses + 1 - pushed_at[vertex]) > size))
+        {
+            ++misses;
+            pushed_at[vertex] = misses;
+            return 1;
+        }
+        return 0;
+    }
+
+    void flush()
+    {
+        misses += size;
+    }
+
+    std::vector<std::size_t> pushed_at; // 0: never
+    std::size_t size = 0;
+    std::size_t misses = 0;
+};
+
+static std::vector<std::uint8_t> TriangleCacheMisses(
+    std::span<const Index> indices,
+    std::size_t vertex_count,
+    std::size_t cache_size
+)
+{
+    Panic((indices.size() % 3) == 0);
+    FifoCache cache(vertex_count, cache_size);
+    std::vector<std::uint8_t> triangle_misses(indices.size() / 3, 0);
+    for (std::size_t t = 0; t < triangle_misses.size(); ++t)
+    {
+        triangle_misses[t] = cache.add(indices[t * 3 + 0], indices[t * 3 + 1], indices[t * 3 + 2]);
+    }
+    return triangle_misses;
+}
+
+VertexCacheStats Mesh_AnalyzeVertexCache(
+    std::span<const Index> indices,
+    std::size_t vertex_count,
+    std::size_t cache_size /*= c_vertex_cache_size*/
+)
+{
+    VertexCacheStats stats{};
+    if (indices.empty() || (vertex_count == 0))
+    {
+        return stats;
+    }
+    std::size_t misses = 0;
+    for (const std::uint8_t triangle_misses : TriangleCacheMisses(indices, vertex_count, cache_size))
+    {
+        misses += triangle_misses;
+    }
+    stats.acmr = float(double(misses) / double(indices.size() / 3));
+    stats.atvr = float(double(misses) / double(vertex_count));
+    return stats;
+}
+
+// Triangles of each vertex (CSR).
+struct Adjacency
+{
+    std::vector<std::uint32_t> offsets; // vertex_count + 1
+    std::vector<std::uint32_t> triangles;
+
+    std::span<const std::uint32_t> of(Index vertex) const
+    {
+        const std::span<const std::uint32_t> all(triangles);
+        return all.subspan(offsets[vertex], offsets[vertex + 1] - offsets[vertex]);
+    }
+};
+
+static Adjacency BuildAdjacency(std::span<const Index> indices, std::size_t vertex_count)
+{
+    Adjacency adjacency{};
+    adjacency.offsets.assign(vertex_count + 1, 0);
+    for (const Index index : indices)
+    {
+        Panic(index < vertex_count);
+        ++adjacency.offsets[index + 1];
+    }
+    for (std::size_t i = 0; i < vertex_count; ++i)
+    {
+        adjacency.offsets[i + 1] += adjacency.offsets[i];
+    }
+    adjacency.triangles.resize(indices.size());
+    std::vector<std::uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (std::size_t i = 0; i < indices.size(); ++i)
+    {
+        adjacency.triangles[fill[indices[i]]++] = std::uint32_t(i / 3);
+    }
+    return adjacency;
+}
+
+void Mesh_OptimizeVertexCache(
+    std::span<Index> indices,
+    std::size_t vertex_count,
+    std::size_t cache_size /*= c_vertex_cache_size*/
+)
+{
+    Panic((indices.size() % 3) == 0);
+    Panic(cache_size > 0);
+    Panic(indices.size() <= std::size_t(UINT32_MAX));
+    const std::size_t triangle_count = (indices.size() / 3);
+    if (triangle_count < 2)
+    {
+        return;
+    }
+    const Adjacency adjacency = BuildAdjacency(indices, vertex_count);
+
+    std::vector<std::uint32_t> live(vertex_count); // not yet emitted triangles
+    for (std::size_t i = 0; i < vertex_count; ++i)
+    {
+        live[i] = (adjacency.offsets[i + 1] - adjacency.offsets[i]);
+    }
+    std::vector<std::size_t> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<Index> dead_end; // recently used vertices, to continue from when the fan ends
+    std::vector<Index> candidates;
+    std::vector<Index> output;
+    output.reserve(indices.size());
+    std::size_t time = (cache_size + 1);
+    std::size_t cursor = 0; // vertices before are done
+    constexpr Index c_none = Index(-1);
+
+    auto next_dead_end = [&]() -> Index {
+        while (!dead_end.empty())
+        {
+            const Index vertex = dead_end.back();
+            dead_end.pop_back();
+            if (live[vertex] > 0)
+            {
+                return vertex;
+            }
+        }
+        for (; cursor < vertex_count; ++cursor)
+        {
+            if (live[cursor] > 0)
+            {
+                return Index(cursor);
+            }
+        }
+        return c_none;
+    };
+
+    Index fan = next_dead_end();
+    while (fan != c_none)
+    {
+        candidates.clear();
+        for (const std::uint32_t triangle : adjacency.of(fan))
+        {
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            emitted[triangle] = true;
+            for (std::size_t k = 0; k < 3; ++k)
+            {
+                const Index vertex = indices[std::size_t(triangle) * 3 + k];
+                output.push_back(vertex);
+                dead_end.push_back(vertex);
+                candidates.push_back(vertex);
+                --live[vertex];
+                if ((time - cache_time[vertex]) > cache_size)
+                {
+                    cache_time[vertex] = time;
+                    ++time;
+                }
+            }
+        }
+
+        // Next fan: the oldest vertex that stays in the cache while its triangles are emitted.
+        Index best = c_none;
+        std::size_t best_priority = 0;
+        for (const Index vertex : candidates)
+        {
+            if (live[vertex] == 0)
+            {
+                continue;
+            }
+            std::size_t priority = 0;
+            const std::size_t age = (time - cache_time[vertex]);
+            if ((age + 2 * std::size_t(live[vertex])) <= cache_size)
+            {
+                priority = age;
+            }
+            if ((best == c_none) || (priority > best_priority))
+            {
+                best = vertex;
+                best_priority = priority;
+            }
+        }
+        fan = (best != c_none) ? best : next_dead_end();
+    }
+    Panic(output.size() == indices.size());
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+// Unnormalized normal (2x area).
+static glm::vec3 TriangleCross(
+    std::span<const Index> indices,
+    std::span<const Vertex> vertices,
+    std::size_t triangle
+)
+{
+    const glm::vec3& p0 = vertices[indices[triangle * 3 + 0]].position;
+    const glm::vec3& p1 = vertices[indices[triangle * 3 + 1]].position;
+    const glm::vec3& p2 = vertices[indices[triangle * 3 + 2]].position;
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+static glm::vec3 TriangleCentroid(
+    std::span<const Index> indices,
+    std::span<const Vertex> vertices,
+    std::size_t triangle
+)
+{
+    const glm::vec3& p0 = vertices[indices[triangle * 3 + 0]].position;
+    const glm::vec3& p1 = vertices[indices[triangle * 3 + 1]].position;
+    const glm::vec3& p2 = vertices[indices[triangle * 3 + 2]].position;
+    return (p0 + p1 + p2) * (1.f / 3.f);
+}
+
+void Mesh_OptimizeOverdraw(
+    std::span<Index> indices,
+    std::span<const Vertex> vertices,
+    float acmr_threshold /*= c_overdraw_acmr_threshold*/,
+    std::size_t cache_size /*= c_vertex_cache_size*/
+)
+{
+    Panic((indices.size() % 3) == 0);
+    const std::size_t triangle_count = (indices.size() / 3);
+    if (triangle_count < 2)
+    {
+        return;
+    }
+    // Hard boundaries: triangles with all the vertices missed start a new patch
+    // (e.g. where Tipsify had a dead end); the order of these is free.
+    const std::vector<std::uint8_t> misses = TriangleCacheMisses(indices, vertices.size(), cache_size);
+    std::vector<std::size_t> patch_starts;
+    for (std::size_t t = 0; t < triangle_count; ++t)
+    {
+        if ((t == 0) || (misses[t] == 3))
+        {
+            patch_starts.push_back(t);
+        }
+    }
+    patch_starts.push_back(triangle_count);
+
+    // Soft boundaries: a patch is split (the cache is cold at each cluster start) as soon as
+    // the cluster so far has ACMR within the threshold of the whole patch.
+    FifoCache cache(vertices.size(), cache_size);
+    std::vector<std::size_t> cluster_starts;
+    for (std::size_t p = 0; (p + 1) < patch_starts.size(); ++p)
+    {
+        const std::size_t begin = patch_starts[p];
+        const std::size_t end = patch_starts[p + 1];
+        cache.flush();
+        std::size_t patch_misses = 0;
+        for (std::size_t t = begin; t < end; ++t)
+        {
+            patch_misses += cache.add(indices[t * 3 + 0], indices[t * 3 + 1], indices[t * 3 + 2]);
+        }
+        const double max_acmr = double(acmr_threshold) * double(patch_misses) / double(end - begin);
+
+        cache.flush();
+        cluster_starts.push_back(begin);
+        std::size_t cluster_misses = 0;
+        std::size_t cluster_triangles = 0;
+        for (std::size_t t = begin; (t + 1) < end; ++t)
+        {
+            cluster_misses += cache.add(indices[t * 3 + 0], indices[t * 3 + 1], indices[t * 3 + 2]);
+            ++cluster_triangles;
+            if (double(cluster_misses) <= (max_acmr * double(cluster_triangles)))
+            {
+                cache.flush();
+                cluster_starts.push_back(t + 1);
+                cluster_misses = 0;
+                cluster_triangles = 0;
+            }
+        }
+    }
+    cluster_starts.push_back(triangle_count);
+    const std::size_t cluster_count = (cluster_starts.size() - 1);
+    if (cluster_count < 2)
+    {
+        return;
+    }
+
+    // Area-weighted centroids & normals.
+    glm::vec3 mesh_centroid(0.f);
+    float mesh_area = 0.f;
+    std::vector<glm::vec3> cluster_centroids(cluster_count, glm::vec3(0.f));
+    std::vector<glm::vec3> cluster_normals(cluster_count, glm::vec3(0.f));
+    for (std::size_t c = 0; c < cluster_count; ++c)
+    {
+        float cluster_area = 0.f;
+        for (std::size_t t = cluster_starts[c]; t < cluster_starts[c + 1]; ++t)
+        {
+            const glm::vec3 cross = TriangleCross(indices, vertices, t);
+            const float area = glm::length(cross);
+            const glm::vec3 centroid = TriangleCentroid(indices, vertices, t);
+            cluster_centroids[c] += centroid * area;
+            cluster_normals[c] += cross;
+            cluster_area += area;
+        }
+        mesh_centroid += cluster_centroids[c];
+        mesh_area += cluster_area;
+        if (cluster_area > 0.f)
+        {
+            cluster_centroids[c] /= cluster_area;
+        }
+    }
+    if (mesh_area > 0.f)
+    {
+        mesh_centroid /= mesh_area;
+    }
+
+    // How much the cluster faces out from the middle of the mesh.
+    std::vector<float> sort_keys(cluster_count, 0.f);
+    for (std::size_t c = 0; c < cluster_count; ++c)
+    {
+        const float length = glm::length(cluster_normals[c]);
+        if (length > 0.f)
+        {
+            sort_keys[c] = glm::dot(cluster_centroids[c] - mesh_centroid, cluster_normals[c] / length);
+        }
+    }
+    std::vector<std::uint32_t> order(cluster_count);
+    for (std::size_t c = 0; c < cluster_count; ++c)
+    {
+        order[c] = std::uint32_t(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](std::uint32_t lhs, std::uint32_t rhs) {
+        return (sort_keys[lhs] > sort_keys[rhs]);
+    });
+
+    std::vector<Index> output;
+    output.reserve(indices.size());
+    for (const std::uint32_t c : order)
+    {
+        const std::size_t first = (cluster_starts[c] * 3);
+        const std::span<const Index> cluster = indices.subspan(first, cluster_starts[c + 1] * 3 - first);
+        output.insert(output.end(), cluster.begin(), cluster.end());
+    }
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+// Fibonacci sphere.
+static glm::vec3 ViewDirection(std::size_t view, std::size_t views)
+{
+    const double golden_angle = std::numbers::pi * (3.0 - std::sqrt(5.0));
+    const double z = 1.0 - (2.0 * (double(view) + 0.5) / double(views));
+    const double radius = std::sqrt(std::max(0.0, 1.0 - z * z));
+    const double angle = golden_angle * double(view);
+    return glm::vec3(float(radius * std::cos(angle)), float(radius * std::sin(angle)), float(z));
+}
+
+static float EdgeFunction(const glm::vec2& a, const glm::vec2& b, const glm::vec2& p)
+{
+    return ((b.x - a.x) * (p.y - a.y)) - ((b.y - a.y) * (p.x - a.x));
+}
+
+struct OverdrawView
+{
+    std::uint64_t covered = 0;
+    std::uint64_t shaded = 0;
+};
+
+static OverdrawView RasterizeView(
+    std::span<const Index> indices,
+    std::span<const Vertex> vertices,
+    const glm::vec3& center,
+    float radius,
+    const glm::vec3& direction,
+    std::uint32_t resolution
+)
+{
+    const glm::vec3 up_hint = (std::abs(direction.y) < 0.99f) ? glm::vec3(0.f, 1.f, 0.f) : glm::vec3(1.f, 0.f, 0.f);
+    const glm::vec3 right = glm::normalize(glm::cross(up_hint, direction));
+    const glm::vec3 up = glm::cross(direction, right);
+    const float scale = (0.5f * float(resolution) / radius);
+    const float offset = (0.5f * float(resolution));
+
+    std::vector<float> depth(std::size_t(resolution) * resolution, std::numeric_limits<float>::infinity());
+    OverdrawView result{};
+    for (std::size_t i = 0; i < indices.size(); i += 3)
+    {
+        glm::vec2 p[3];
+        float z[3];
+        for (std::size_t k = 0; k < 3; ++k)
+        {
+            const glm::vec3 v = (vertices[indices[i + k]].position - center);
+            p[k] = glm::vec2(glm::dot(v, right) * scale + offset, glm::dot(v, up) * scale + offset);
+            z[k] = glm::dot(v, direction);
+        }
+        const float area = EdgeFunction(p[0], p[1], p[2]);
+        if (area == 0.f)
+        {
+            continue;
+        }
+        const float inv_area = (1.f / area);
+        const float max_pixel = float(resolution - 1);
+        const auto x0 = std::uint32_t(std::clamp(std::floor(std::min({p[0].x, p[1].x, p[2].x})), 0.f, max_pixel));
+        const auto x1 = std::uint32_t(std::clamp(std::ceil(std::max({p[0].x, p[1].x, p[2].x})), 0.f, max_pixel));
+        const auto y0 = std::uint32_t(std::clamp(std::floor(std::min({p[0].y, p[1].y, p[2].y})), 0.f, max_pixel));
+        const auto y1 = std::uint32_t(std::clamp(std::ceil(std::max({p[0].y, p[1].y, p[2].y})), 0.f, max_pixel));
+        for (std::uint32_t y = y0; y <= y1; ++y)
+        {
+            for (std::uint32_t x = x0; x <= x1; ++x)
+            {
+                // Both windings (no culling): barycentrics are positive inside either way.
+                const glm::vec2 pixel(float(x) + 0.5f, float(y) + 0.5f);
+                const float w0 = EdgeFunction(p[1], p[2], pixel) * inv_area;
+                const float w1 = EdgeFunction(p[2], p[0], pixel) * inv_area;
+                const float w2 = EdgeFunction(p[0], p[1], pixel) * inv_area;
+                if ((w0 < 0.f) || (w1 < 0.f) || (w2 < 0.f))
+                {
+                    continue;
+                }
+                const float pixel_depth = (w0 * z[0] + w1 * z[1] + w2 * z[2]);
+                float& stored = depth[std::size_t(y) * resolution + x];
+                if (pixel_depth < stored)
+                {
+                    result.covered += (stored == std::numeric_limits<float>::infinity()) ? 1u : 0u;
+                    stored = pixel_depth;
+                    ++result.shaded;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+OverdrawStats Mesh_AnalyzeOverdraw(
+    std::span<const Index> indices,
+    std::span<const Vertex> vertices,
+    std::size_t views /*= c_overdraw_views*/,
+    std::uint32_t resolution /*= c_overdraw_resolution*/
+)
+{
+    Panic((indices.size() % 3) == 0);
+    Panic(resolution > 0);
+    OverdrawStats stats{};
+    if (indices.empty() || (views == 0))
+    {
+        return stats;
+    }
+    glm::vec3 aabb_min = vertices[indices[0]].position;
+    glm::vec3 aabb_max = aabb_min;
+    for (const Index index : indices)
+    {
+        aabb_min = glm::min(aabb_min, vertices[index].position);
+        aabb_max = glm::max(aabb_max, vertices[index].position);
+    }
+    const glm::vec3 center = (aabb_min + aabb_max) * 0.5f;
+    const float radius = std::max(glm::length(aabb_max - center), std::numeric_limits<float>::min());
+
+    std::vector<OverdrawView> results(views);
+    GlobalThreadPool().parallel_for(views, [&](std::size_t view) {
+        results[view] = RasterizeView(indices, vertices, center, radius, ViewDirection(view, views), resolution);
+    });
+    for (const OverdrawView& result : results)
+    {
+        stats.pixels_covered += result.covered;
+        stats.pixels_shaded += result.shaded;
+    }
+    if (stats.pixels_covered > 0)
+    {
+        stats.overdraw = float(double(stats.pixels_shaded) / double(stats.pixels_covered));
+    }
+    return stats;
+}
+
+void Mesh_OptimizeVertexFetch(std::vector<Vertex>& vertices, std::span<Index> indices)
+{
+    constexpr Index c_unused = Index(-1);
+    std::vector<Index> remap(vertices.size(), c_unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (Index& index : indices)
+    {
+        Panic(index < vertices.size());
+        if (remap[index] == c_unused)
+        {
+            remap[index] = Index(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(reordered);
+}
+
+VertexFetchStats Mesh_AnalyzeVertexFetch(
+    std::span<const Index> indices,
+    std::size_t vertex_count,
+    std::size_t vertex_stride,
+    std::size_t cache_size /*= c_vertex_cache_size*/
+)
+{
+    Panic(vertex_stride > 0);
+    VertexFetchStats stats{};
+    if (indices.empty() || (vertex_count == 0))
+    {
+        return stats;
+    }
+    constexpr std::size_t c_no_line = std::size_t(-1);
+    std::vector<std::size_t> lines(c_fetch_cache_lines, c_no_line);
+    FifoCache cache(vertex_count, cache_size);
+    for (const Index index : indices)
+    {
+        if (cache.add(index) == 0)
+        {
+            continue;
+        }
+        const std::size_t begin = (std::size_t(index) * vertex_stride);
+        const std::size_t last = (begin + vertex_stride - 1);
+        for (std::size_t line = (begin / c_fetch_cache_line); line <= (last / c_fetch_cache_line); ++line)
+        {
+            std::size_t& cached = lines[line % c_fetch_cache_lines];
+            if (cached != line)
+            {
+                cached = line;
+                stats.bytes_fetched += c_fetch_cache_line;
+            }
+        }
+    }
+    stats.overfetch = float(double(stats.bytes_fetched) / double(vertex_count * vertex_stride));
+    return stats;
+}
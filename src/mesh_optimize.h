@@ -0,0 +1,86 @@
+#pragma once
+#include "vertex.h"
+
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+// Post-transform vertex cache is modeled as FIFO of this size (any GPU does as well or better).
+static constexpr std::size_t c_vertex_cache_size = 16;
+// Clusters of Mesh_OptimizeOverdraw() may cost this much of the ACMR.
+static constexpr float c_overdraw_acmr_threshold = 1.05f;
+// Mesh_AnalyzeOverdraw(): views (evenly over the sphere) & their size.
+static constexpr std::size_t c_overdraw_views = 32;
+static constexpr std::uint32_t c_overdraw_resolution = 256;
+// Mesh_AnalyzeVertexFetch(): vertex buffer reads go through a direct-mapped cache of these lines.
+static constexpr std::size_t c_fetch_cache_line = 64;
+static constexpr std::size_t c_fetch_cache_lines = 256;
+
+struct VertexCacheStats
+{
+    float acmr = 0.f; // average cache miss ratio: transformed vertices per triangle, 0.5 .. 3
+    float atvr = 0.f; // average transformed to vertex ratio: 1 is the best
+};
+
+// FIFO cache of cache_size simulated over indices (triangle list of vertex_count vertices).
+VertexCacheStats Mesh_AnalyzeVertexCache(
+    std::span<const Index> indices,
+    std::size_t vertex_count,
+    std::size_t cache_size = c_vertex_cache_size
+);
+
+// Reorders triangles (not vertices) for the post-transform cache: Tipsify
+// (Sander, Nehab & Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"),
+// linear in the triangles count. Triangles keep their winding.
+void Mesh_OptimizeVertexCache(
+    std::span<Index> indices,
+    std::size_t vertex_count,
+    std::size_t cache_size = c_vertex_cache_size
+);
+
+// Splits the (vertex cache optimized) order into clusters where the cache is cold anyway
+// and sorts them view-independently: outer, outward-facing clusters first, so they occlude
+// the rest from most directions (Sander, Nehab & Barczak). Triangles keep their winding.
+void Mesh_OptimizeOverdraw(
+    std::span<Index> indices,
+    std::span<const Vertex> vertices,
+    float acmr_threshold = c_overdraw_acmr_threshold,
+    std::size_t cache_size = c_vertex_cache_size
+);
+
+struct OverdrawStats
+{
+    std::uint64_t pixels_covered = 0;
+    std::uint64_t pixels_shaded = 0; // passed the depth test
+    float overdraw = 0.f;            // shaded / covered, 1 is the best
+};
+
+// CPU estimate: orthographic views of the bounding sphere from many directions,
+// rasterized in order with depth test & without culling (as the app renders). Views run on GlobalThreadPool().
+OverdrawStats Mesh_AnalyzeOverdraw(
+    std::span<const Index> indices,
+    std::span<const Vertex> vertices,
+    std::size_t views = c_overdraw_views,
+    std::uint32_t resolution = c_overdraw_resolution
+);
+
+// Vertices in the order of their first use by indices (remapped); vertices no triangle
+// references are dropped. Neighbor triangles read neighbor memory.
+void Mesh_OptimizeVertexFetch(std::vector<Vertex>& vertices, std::span<Index> indices);
+
+struct VertexFetchStats
+{
+    std::size_t bytes_fetched = 0;
+    float overfetch = 0.f; // bytes fetched / vertex buffer size, 1 is the best
+};
+
+// Vertices missed by the post-transform cache (FIFO of cache_size) are read
+// from a buffer of vertex_stride through c_fetch_cache_lines lines of c_fetch_cache_line bytes.
+VertexFetchStats Mesh_AnalyzeVertexFetch(
+    std::span<const Index> indices,
+    std::size_t vertex_count,
+    std::size_t vertex_stride,
+    std::size_t cache_size = c_vertex_cache_size
+);
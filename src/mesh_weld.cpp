@@ -0,0 +1,214 @@
+#include "mesh_weld.h"
+#include "tangents.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "utils_hash.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <span>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Vertices per parallel_for() task.
+static constexpr std::size_t c_weld_block = 16 * 1024;
+
+// Position, normal & UV as compared: float bits, snapped to the grid first if epsilon is set.
+struct WeldKey
+{
+    std::uint32_t bits[8];
+
+    bool operator==(const WeldKey& rhs) const
+    {
+        return (std::memcmp(bits, rhs.bits, sizeof(bits)) == 0);
+    }
+};
+
+static std::uint32_t KeyBits(float value, float epsilon)
+{
+    if (epsilon > 0.f)
+    {
+        value = float(std::round(double(value) / double(epsilon)) * double(epsilon));
+    }
+    if (value == 0.f)
+    {
+        value = 0.f; // -0
+    }
+    return std::bit_cast<std::uint32_t>(value);
+}
+
+static WeldKey MakeKey(const Vertex& v, const MeshWeldSettings& settings)
+{
+    WeldKey key{};
+    key.bits[0] = KeyBits(v.position.x, settings.position_epsilon);
+    key.bits[1] = KeyBits(v.position.y, settings.position_epsilon);
+    key.bits[2] = KeyBits(v.position.z, settings.position_epsilon);
+    key.bits[3] = KeyBits(v.normal.x, settings.normal_epsilon);
+    key.bits[4] = KeyBits(v.normal.y, settings.normal_epsilon);
+    key.bits[5] = KeyBits(v.normal.z, settings.normal_epsilon);
+    key.bits[6] = KeyBits(v.texture_coord.x, settings.uv_epsilon);
+    key.bits[7] = KeyBits(v.texture_coord.y, settings.uv_epsilon);
+    return key;
+}
+
+static void ParallelBlocks(std::size_t count, const std::function<void(std::size_t, std::size_t)>& f)
+{
+    const std::size_t blocks = (count + c_weld_block - 1) / c_weld_block;
+    GlobalThreadPool().parallel_for(blocks, [&](std::size_t block) {
+        const std::size_t begin = block * c_weld_block;
+        f(begin, std::min(count, begin + c_weld_block));
+    });
+}
+
+// For every vertex, the first vertex (smallest index) with the same key.
+static std::vector<Index> FindRepresentatives(std::span<const Vertex> vertices, const MeshWeldSettings& settings)
+{
+    const std::size_t count = vertices.size();
+    std::vector<WeldKey> keys(count);
+    std::vector<std::uint64_t> hashes(count);
+    ParallelBlocks(count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            keys[i] = MakeKey(vertices[i], settings);
+            hashes[i] = Hash64(keys[i].bits, sizeof(keys[i].bits));
+        }
+    });
+
+    // Open addressing, at most half full; slot is (vertex index + 1), 0 is empty.
+    const std::size_t table_size = std::bit_ceil(count * 2);
+    const std::size_t mask = (table_size - 1);
+    std::unique_ptr<std::atomic<std::uint32_t>[]> table(new std::atomic<std::uint32_t>[table_size]);
+    ParallelBlocks(table_size, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            table[i].store(0, std::memory_order_relaxed);
+        }
+    });
+    ParallelBlocks(count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const std::uint32_t value = std::uint32_t(i + 1);
+            std::size_t slot = (hashes[i] & mask);
+            std::uint32_t stored = table[slot].load(std::memory_order_relaxed);
+            for (;;)
+            {
+                if (stored == 0)
+                {
+                    if (table[slot].compare_exchange_weak(stored, value, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                    continue; // stored is updated
+                }
+                if (keys[stored - 1] == keys[i])
+                {
+                    // Slot changes only to a smaller index of the same key.
+                    while ((value < stored)
+                           && !table[slot].compare_exchange_weak(stored, value, std::memory_order_relaxed))
+                    {
+                    }
+                    break;
+                }
+                slot = ((slot + 1) & mask);
+                stored = table[slot].load(std::memory_order_relaxed);
+            }
+        }
+    });
+
+    std::vector<Index> representatives(count);
+    ParallelBlocks(count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            std::size_t slot = (hashes[i] & mask);
+            for (;;)
+            {
+                const std::uint32_t stored = table[slot].load(std::memory_order_relaxed);
+                Panic(stored != 0);
+                if (keys[stored - 1] == keys[i])
+                {
+                    representatives[i] = Index(stored - 1);
+                    break;
+                }
+                slot = ((slot + 1) & mask);
+            }
+        }
+    });
+    return representatives;
+}
+
+static bool IsDegenerate(const Vertex& v0, const Vertex& v1, const Vertex& v2)
+{
+    const glm::vec3 n = glm::cross(v1.position - v0.position, v2.position - v0.position);
+    return (n.x == 0.f) && (n.y == 0.f) && (n.z == 0.f);
+}
+
+MeshWeldStats Mesh_Weld(std::vector<Vertex>& vertices, std::vector<Index>& indices, const MeshWeldSettings& settings)
+{
+    Panic((indices.size() % 3) == 0);
+    MeshWeldStats stats{};
+    stats.vertices_before = vertices.size();
+    stats.triangles_before = (indices.size() / 3);
+    const std::vector<Index> representatives = FindRepresentatives(vertices, settings);
+
+    // Triangles of the merged vertices; degenerate ones are dropped.
+    std::size_t kept = 0;
+    for (std::size_t i = 0; (i + 2) < indices.size(); i += 3)
+    {
+        const Index i0 = representatives[indices[i + 0]];
+        const Index i1 = representatives[indices[i + 1]];
+        const Index i2 = representatives[indices[i + 2]];
+        if ((i0 == i1) || (i1 == i2) || (i0 == i2) || IsDegenerate(vertices[i0], vertices[i1], vertices[i2]))
+        {
+            ++stats.degenerate_triangles;
+            continue;
+        }
+        indices[kept + 0] = i0;
+        indices[kept + 1] = i1;
+        indices[kept + 2] = i2;
+        kept += 3;
+    }
+    indices.resize(kept);
+
+    // Referenced vertices only, in the same order.
+    constexpr Index c_unused = Index(-1);
+    std::vector<Index> remap(vertices.size(), c_unused);
+    for (const Index index : indices)
+    {
+        remap[index] = 0;
+    }
+    Index next = 0;
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        if (remap[i] != c_unused)
+        {
+            remap[i] = next;
+            vertices[next] = vertices[i];
+            ++next;
+        }
+    }
+    vertices.resize(next);
+    vertices.shrink_to_fit();
+    ParallelBlocks(indices.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            indices[i] = remap[indices[i]];
+        }
+    });
+    indices.shrink_to_fit();
+
+    if (settings.recompute_tangents)
+    {
+        ComputeVertexTangents(vertices, indices);
+    }
+    stats.vertices_after = vertices.size();
+    stats.triangles_after = (indices.size() / 3);
+    return stats;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "vertex.h"
+
+#include <vector>
+
+#include <cstddef>
+
+// Vertices of the same position, normal & UV (bit-identical, or within epsilons) are merged:
+// imports without aiProcess_JoinIdenticalVertices (and native loaders) have one vertex per face corner.
+// Tangents are not compared: corners of different faces have their face's tangent
+// (recompute_tangents smooths them over the welded triangles, see ComputeVertexTangents()).
+// Vertices are hashed into a lock-free table on GlobalThreadPool(); the first vertex (by index)
+// of each group is kept, so the result doesn't depend on the threads count.
+struct MeshWeldSettings
+{
+    // 0: bit-identical only (+0 and -0 are the same). Otherwise components are snapped
+    // to a grid of the epsilon and vertices in the same cell are merged.
+    float position_epsilon = 0.f;
+    float normal_epsilon = 0.f;
+    float uv_epsilon = 0.f;
+    bool recompute_tangents = false;
+};
+
+struct MeshWeldStats
+{
+    std::size_t vertices_before = 0;
+    std::size_t vertices_after = 0;
+    std::size_t triangles_before = 0;
+    std::size_t triangles_after = 0;
+    std::size_t degenerate_triangles = 0; // repeated index or zero area, dropped
+};
+
+// Also drops degenerate triangles and vertices no triangle references;
+// vertices keep their relative order.
+MeshWeldStats Mesh_Weld(std::vector<Vertex>& vertices, std::vector<Index>& indices, const MeshWeldSettings& settings);
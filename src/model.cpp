@@ -1,49 +1,141 @@
 #include "model.h"
 #include "assimp_model.h"
+#include "gltf_loader.h"
+#include "mapped_file.h"
+#include "mesh_optimize.h"
+#include "mesh_weld.h"
+#include "model_cache.h"
+#include "obj_loader.h"
+#include "package.h"
+#include "scan_loader.h"
+#include "texture_bc.h"
+#include "texture_compress.h"
+#include "texture_mips.h"
+#include "texture_share.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "utils_log.h"
 
-#include <cassert>
-#include <cstdio>
+#include <glm/common.hpp>
 
-static void Panic(bool condition)
-{
-    if (!condition)
-    {
-        assert(false);
-        std::exit(1);
-    }
-}
+#include <algorithm>
+
+#include <cfloat>
+#include <cstdio>
 
 Model::Model() noexcept = default;
 Model::~Model() noexcept = default;
 Model::Model(Model&&) noexcept = default;
 Model& Model::operator=(Model&&) noexcept = default;
 
+bool Model::is_loaded() const
+{
+    return (mapped_ || assimp_);
+}
+
 glm::vec3 Model::aabb_min() const
 {
+    if (mapped_)
+    {
+        return mapped_->aabb_min;
+    }
     Panic(!!assimp_);
     return assimp_->aabb_min;
 }
 
 glm::vec3 Model::aabb_max() const
 {
+    if (mapped_)
+    {
+        return mapped_->aabb_max;
+    }
     Panic(!!assimp_);
     return assimp_->aabb_max;
 }
 
 std::uint32_t Model::meshes_count() const
 {
+    if (mapped_)
+    {
+        return std::uint32_t(mapped_->meshes.size());
+    }
     Panic(!!assimp_);
     return std::uint32_t(assimp_->meshes.size());
 }
 
 std::uint32_t Model::textures_count() const
 {
+    if (mapped_)
+    {
+        return std::uint32_t(mapped_->textures.size());
+    }
     Panic(!!assimp_);
     return std::uint32_t(assimp_->materials.size());
 }
 
+ModelMemory Model::memory() const
+{
+    ModelMemory memory;
+    if (!is_loaded())
+    {
+        return memory;
+    }
+    // Data in the mapping, if any (moved into shared_file once textures are shared).
+    std::span<const std::uint8_t> mapping;
+    if (mapped_)
+    {
+        mapping = (mapped_->shared_file ? mapped_->shared_file->bytes() : mapped_->file.bytes());
+    }
+    auto add = [&](const void* data, std::size_t size) {
+        const auto* bytes = static_cast<const std::uint8_t*>(data);
+        const bool is_mapped = !mapping.empty() && (bytes >= mapping.data())
+                               && (bytes < (mapping.data() + mapping.size()));
+        (is_mapped ? memory.mapped_bytes : memory.owned_bytes) += size;
+    };
+    for (std::uint32_t i = 0, count = meshes_count(); i < count; ++i)
+    {
+        const Mesh mesh = get_mesh(i);
+        add(mesh.vertices.data(), mesh.vertices.size_bytes());
+        add(mesh.indices.data(), mesh.indices.size_bytes());
+    }
+    for (std::uint32_t i = 0, count = textures_count(); i < count; ++i)
+    {
+        const Texture texture = get_texture(i);
+        if (mapped_)
+        {
+            const bool shared = (i < mapped_->shared_texels.size()) && mapped_->shared_texels[i];
+            if (shared && !mapped_->shared_owner[i])
+            {
+                memory.shared_bytes += texture.data.size_bytes();
+                continue;
+            }
+            add(texture.data.data(), texture.data.size_bytes());
+            continue;
+        }
+        const AssimpModel::Blob& blob = assimp_->materials[i];
+        if (blob.shared && !blob.shared_owner)
+        {
+            memory.shared_bytes += texture.data.size_bytes();
+        }
+        else if (blob.shared ? blob.shared_mapped : blob.file.is_open())
+        {
+            memory.mapped_bytes += texture.data.size_bytes();
+        }
+        else
+        {
+            memory.owned_bytes += texture.data.size_bytes();
+        }
+    }
+    return memory;
+}
+
 Mesh Model::get_mesh(std::uint32_t index) const
 {
+    if (mapped_)
+    {
+        Panic(index < mapped_->meshes.size());
+        return mapped_->meshes[index];
+    }
     Panic(!!assimp_);
     Panic(index < assimp_->meshes.size());
     const AssimpMesh& assimp_mesh = assimp_->meshes[index];
@@ -64,28 +156,838 @@ Mesh Model::get_mesh(std::uint32_t index) const
     mesh.indices = assimp_mesh.indices;
     mesh.texture_diffuse_id = get_texture_id(assimp_mesh.texture_diffuse.path);
     mesh.texture_normal_id = get_texture_id(assimp_mesh.texture_normal.path);
+    mesh.aabb_min = assimp_mesh.aabb_min;
+    mesh.aabb_max = assimp_mesh.aabb_max;
     return mesh;
 }
 
 Texture Model::get_texture(std::uint32_t index) const
 {
+    if (mapped_)
+    {
+        Panic(index < mapped_->textures.size());
+        return mapped_->textures[index];
+    }
     Panic(!!assimp_);
     const AssimpModel::Blob& assimp_texture = assimp_->materials[index];
 
-    const std::size_t size = assimp_texture.height * assimp_texture.width * c_texture_channels;
+    const std::size_t size = TextureMips_ChainBytes(
+        assimp_texture.format,
+        assimp_texture.width,
+        assimp_texture.height,
+        assimp_texture.mips_count
+    );
     Texture texture{};
     texture.id = index;
     texture.height = assimp_texture.height;
     texture.width = assimp_texture.width;
-    texture.data = {assimp_texture.data, assimp_texture.data + size};
+    texture.mips_count = assimp_texture.mips_count;
+    texture.format = assimp_texture.format;
+    texture.srgb = assimp_texture.srgb;
+    texture.data = {assimp_texture.data.get(), assimp_texture.data.get() + size};
+    texture.path = assimp_texture.path;
+    texture.content_key = assimp_texture.content_key;
     return texture;
 }
 
-outcome::result<Model> LoadModel(const char* filename)
+void Model::set_texture(
+    std::uint32_t index,
+    std::unique_ptr<std::uint8_t, void (*)(void*)> texels,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint32_t mips_count,
+    TextureFormat format,
+    bool srgb
+)
+{
+    Panic(!!texels);
+    if (mapped_)
+    {
+        Panic(index < mapped_->textures.size());
+        Texture& texture = mapped_->textures[index];
+        // Previous texels are mapped (freed with the model) or owned by this texture only (replaced).
+        std::vector<MappedModel::OwnedBlob>& blobs = mapped_->owned_blobs;
+        auto blob_it = std::find_if(blobs.begin(), blobs.end(), [&](const MappedModel::OwnedBlob& blob) {
+            return (blob.get() == texture.data.data());
+        });
+        texture.data = {texels.get(), TextureMips_ChainBytes(format, width, height, mips_count)};
+        texture.width = width;
+        texture.height = height;
+        texture.mips_count = mips_count;
+        texture.format = format;
+        texture.srgb = srgb;
+        texture.content_key = 0;
+        if (blob_it != blobs.end())
+        {
+            *blob_it = std::move(texels);
+        }
+        else
+        {
+            blobs.push_back(std::move(texels));
+        }
+        if (index < mapped_->shared_texels.size())
+        {
+            mapped_->shared_texels[index].reset(); // shared ones are freed now
+            mapped_->shared_owner[index] = false;
+        }
+        return;
+    }
+    Panic(!!assimp_);
+    Panic(index < assimp_->materials.size());
+    AssimpModel::Blob& blob = assimp_->materials[index];
+    blob.data = std::move(texels);
+    blob.file = MappedFile{}; // if previous texels were mapped
+    blob.width = width;
+    blob.height = height;
+    blob.mips_count = mips_count;
+    blob.format = format;
+    blob.srgb = srgb;
+    blob.shared.reset();
+    blob.shared_owner = false;
+    blob.shared_mapped = false;
+    blob.content_key = 0;
+}
+
+// Textures referenced as normal maps are filtered (and compressed) as such.
+static std::vector<MipFilter> GetTextureFilters(const Model& model)
+{
+    const std::uint32_t count = model.textures_count();
+    std::vector<MipFilter> filters(count, MipFilter::Color);
+    for (std::uint32_t i = 0, meshes = model.meshes_count(); i < meshes; ++i)
+    {
+        const std::uint32_t normal_id = model.get_mesh(i).texture_normal_id;
+        if (normal_id < count)
+        {
+            filters[normal_id] = MipFilter::NormalMap;
+        }
+    }
+    return filters;
+}
+
+void Model::generate_mips()
+{
+    const std::uint32_t count = textures_count();
+    const std::vector<MipFilter> filters = GetTextureFilters(*this);
+    std::vector<MipChain> chains;
+    chains.reserve(count);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        chains.emplace_back(nullptr, &std::free);
+    }
+    GlobalThreadPool().parallel_for(count, [&](std::size_t i) {
+        const Texture texture = get_texture(std::uint32_t(i));
+        if ((texture.format == TextureFormat::RGBA8) && (texture.mips_count == 1) && (texture.width > 0)
+            && (texture.height > 0))
+        {
+            chains[i] = TextureMips_Build(texture.data, texture.width, texture.height, filters[i]);
+        }
+    });
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        if (chains[i])
+        {
+            const Texture texture = get_texture(i);
+            const std::uint32_t mips_count = TextureMips_FullCount(texture.width, texture.height);
+            set_texture(
+                i,
+                std::move(chains[i]),
+                texture.width,
+                texture.height,
+                mips_count,
+                TextureFormat::RGBA8,
+                texture.srgb
+            );
+        }
+    }
+}
+
+void Model::compress_textures(TextureCompression compression)
 {
+    const std::uint32_t count = textures_count();
+    const std::vector<MipFilter> filters = GetTextureFilters(*this);
+    std::vector<TextureCompressResult> results(count);
+    const StopWatch timer;
+    GlobalThreadPool().parallel_for(count, [&](std::size_t i) {
+        results[i] = TextureCompress_Chain(get_texture(std::uint32_t(i)), filters[i], compression);
+    });
+    const double total_ms = timer.elapsed_ms();
+
+    std::size_t bytes_before = 0;
+    std::size_t bytes_after = 0;
+    std::uint32_t compressed = 0;
+    std::uint32_t cached = 0;
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        const Texture texture = get_texture(i);
+        bytes_before += texture.data.size();
+        TextureCompressResult& result = results[i];
+        if (!result.data)
+        {
+            bytes_after += texture.data.size();
+            continue;
+        }
+        if (result.from_cache)
+        {
+            LogDebug(
+                "[texture] #%u %ux%u %s: cached, PSNR %.2f dB.\n",
+                i,
+                texture.width,
+                texture.height,
+                TextureBC_FormatName(result.format),
+                result.psnr_db
+            );
+        }
+        else
+        {
+            LogDebug(
+                "[texture] #%u %ux%u %s: encoded %.2f ms (%.1f MPix/s), PSNR %.2f dB.\n",
+                i,
+                texture.width,
+                texture.height,
+                TextureBC_FormatName(result.format),
+                result.encode_ms,
+                result.mpix_per_s,
+                result.psnr_db
+            );
+        }
+        ++compressed;
+        cached += (result.from_cache ? 1u : 0u);
+        set_texture(
+            i,
+            std::move(result.data),
+            texture.width,
+            texture.height,
+            texture.mips_count,
+            result.format,
+            texture.srgb
+        );
+        bytes_after += get_texture(i).data.size();
+    }
+    if (compressed > 0)
+    {
+        LogDebug(
+            "[texture] %u of %u textures compressed (%u cached): %.2f MiB -> %.2f MiB, %.2f ms.\n",
+            compressed,
+            count,
+            cached,
+            double(bytes_before) / (1024.0 * 1024.0),
+            double(bytes_after) / (1024.0 * 1024.0),
+            total_ms
+        );
+    }
+}
+
+// Texels are owned by shared (see Model::share_textures()).
+static void KeepShared(void*)
+{
+}
+
+void Model::share_textures()
+{
+    TextureShare& share = GlobalTextureShare();
+    const std::uint32_t count = textures_count();
+    std::uint32_t shared_count = 0;
+    std::size_t bytes_saved = 0;
+    // Keys first: hashing is the slow part.
+    std::vector<std::uint64_t> keys(count);
+    GlobalThreadPool().parallel_for(count, [&](std::size_t i) {
+        const Texture texture = get_texture(std::uint32_t(i));
+        if ((texture.content_key == 0) && !texture.data.empty())
+        {
+            keys[i] = TextureShare_MakeKey(texture);
+        }
+    });
+    if (mapped_)
+    {
+        mapped_->shared_texels.resize(count);
+        mapped_->shared_owner.resize(count);
+    }
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        if (keys[i] == 0)
+        {
+            continue; // already shared or empty
+        }
+        const Texture texture = get_texture(i);
+        // Own texels under shared ownership first: owned ones are moved, mapped ones keep the file.
+        SharedTexels own;
+        bool own_mapped = false;
+        if (mapped_)
+        {
+            auto blob_it = std::find_if(
+                mapped_->owned_blobs.begin(),
+                mapped_->owned_blobs.end(),
+                [&](const MappedModel::OwnedBlob& blob) { return (blob.get() == texture.data.data()); }
+            );
+            if (blob_it != mapped_->owned_blobs.end())
+            {
+                own = SharedTexels(std::move(*blob_it));
+            }
+            else
+            {
+                if (!mapped_->shared_file)
+                {
+                    mapped_->shared_file = std::make_shared<const MappedFile>(std::move(mapped_->file));
+                }
+                own = SharedTexels(mapped_->shared_file, texture.data.data());
+            }
+        }
+        else
+        {
+            Panic(!!assimp_);
+            AssimpModel::Blob& blob = assimp_->materials[i];
+            if (blob.file.is_open())
+            {
+                own = SharedTexels(std::make_shared<const MappedFile>(std::move(blob.file)), texture.data.data());
+                blob.data.release(); // not owned, see Assimp_LoadContainer()
+                own_mapped = true;
+            }
+            else
+            {
+                own = SharedTexels(std::move(blob.data));
+            }
+        }
+
+        SharedTexels texels = share.share_texels(keys[i], texture.data, std::move(own));
+        // Registered by this model: counted by its memory().
+        const bool is_owner = (texels.get() == texture.data.data());
+        if (!is_owner)
+        {
+            ++shared_count;
+            bytes_saved += texture.data.size();
+        }
+        if (mapped_)
+        {
+            Texture& mapped_texture = mapped_->textures[i];
+            mapped_texture.data = {texels.get(), texture.data.size()};
+            mapped_texture.content_key = keys[i];
+            mapped_->shared_texels[i] = std::move(texels);
+            mapped_->shared_owner[i] = is_owner;
+        }
+        else
+        {
+            AssimpModel::Blob& blob = assimp_->materials[i];
+            blob.data = {const_cast<std::uint8_t*>(texels.get()), &KeepShared};
+            blob.content_key = keys[i];
+            blob.shared = std::move(texels);
+            blob.shared_owner = is_owner;
+            blob.shared_mapped = (is_owner && own_mapped);
+        }
+    }
+    if (shared_count > 0)
+    {
+        LogDebug(
+            "[texture] %u of %u textures shared with other models: %.2f MiB saved.\n",
+            shared_count,
+            count,
+            double(bytes_saved) / (1024.0 * 1024.0)
+        );
+    }
+}
+
+// Pipeline flags (ModelCacheKey::pipeline_flags): steps of the viewer itself that change
+// the baked data; Assimp's post-processing steps are import_flags, a field of their own.
+// Data produced by native loaders is not bit-identical to Assimp's (e.g. tangents are not smoothed).
+static constexpr std::uint32_t c_pipeline_native = (1u << 0);
+// Chunked bake of a model larger than memory.
+static constexpr std::uint32_t c_pipeline_out_of_core = (1u << 1);
+// Meshes are welded (see WeldMeshes()).
+static constexpr std::uint32_t c_pipeline_welded = (1u << 2);
+// Reorder triangles for the post-transform cache at import (see OptimizeMeshes()).
+static constexpr bool c_optimize_vertex_cache = true;
+// Optimized order is baked with the model.
+static constexpr std::uint32_t c_pipeline_vertex_cache = (c_optimize_vertex_cache ? (1u << 3) : 0u);
+// Then, reorder clusters of triangles to reduce overdraw (rasterized without culling).
+static constexpr bool c_optimize_overdraw = c_optimize_vertex_cache;
+static constexpr std::uint32_t c_pipeline_overdraw = (c_optimize_overdraw ? (1u << 4) : 0u);
+// Last, put vertices in the order of the first use by that triangles order.
+static constexpr bool c_optimize_vertex_fetch = c_optimize_vertex_cache;
+static constexpr std::uint32_t c_pipeline_vertex_fetch = (c_optimize_vertex_fetch ? (1u << 5) : 0u);
+// Textures are baked in the formats of the preset (bits 6-7).
+static constexpr std::uint32_t c_pipeline_texture_compression = (std::uint32_t(c_texture_compression) << 6);
+// Sources from this size on (.ply/.stl only) are imported out-of-core.
+static constexpr std::uint64_t c_out_of_core_min_bytes = (std::uint64_t(1) << 30);
+static constexpr ChunkSettings c_out_of_core_settings{
+    .memory_limit_bytes = (std::size_t(512) << 20),
+    .chunk_triangles = (64 * 1024),
+};
+// Bit-identical vertices only: snapping would move seams of scans apart.
+static constexpr MeshWeldSettings c_import_weld_settings{};
+// Log overdraw estimated on CPU before & after OptimizeMeshes() (slow; for benchmarks only).
+static constexpr bool c_estimate_overdraw = false;
+// Log Assimp import time next to the native one (slow; for benchmarks only).
+static constexpr bool c_compare_native_with_assimp = false;
+
+enum class NativeFormat
+{
+    None, // Assimp
+    Obj,
+    Ply,
+    Stl,
+    Glb, // not imported; mapped as is (see gltf_loader.h)
+};
+
+static NativeFormat GetNativeFormat(const std::filesystem::path& path)
+{
+    const std::filesystem::path ext = path.extension();
+    if ((ext == ".obj") || (ext == ".OBJ"))
+    {
+        return NativeFormat::Obj;
+    }
+    if ((ext == ".ply") || (ext == ".PLY"))
+    {
+        return NativeFormat::Ply;
+    }
+    if ((ext == ".stl") || (ext == ".STL"))
+    {
+        return NativeFormat::Stl;
+    }
+    if ((ext == ".glb") || (ext == ".GLB"))
+    {
+        return NativeFormat::Glb;
+    }
+    return NativeFormat::None;
+}
+
+bool IsModelFile(const std::filesystem::path& path)
+{
+    return (GetNativeFormat(path) != NativeFormat::None);
+}
+
+static outcome::result<AssimpModel> ImportNative(const char* filename, NativeFormat format)
+{
+    switch (format)
+    {
+    case NativeFormat::Obj:
+        return Obj_Load(filename);
+    case NativeFormat::Ply:
+        return Ply_Load(filename);
+    case NativeFormat::Stl:
+        return Stl_Load(filename);
+    case NativeFormat::Glb:
+    case NativeFormat::None:
+        break;
+    }
+    return outcome::failure(std::errc::not_supported);
+}
+
+// Native loader for the format, if any; Assimp otherwise
+// (or if native one fails, e.g. ASCII .ply/.stl).
+static outcome::result<AssimpModel> ImportModel(const char* filename, NativeFormat format)
+{
+    if (format != NativeFormat::None)
+    {
+        const StopWatch timer;
+        auto maybe_model = ImportNative(filename, format);
+        if (maybe_model)
+        {
+            const double native_ms = timer.elapsed_ms();
+            if constexpr (c_compare_native_with_assimp)
+            {
+                const StopWatch assimp_timer;
+                (void)Assimp_Load(filename);
+                const double assimp_ms = assimp_timer.elapsed_ms();
+                LogDebug(
+                    "[model] '%s': native %.2f ms vs Assimp %.2f ms (x%.1f).\n",
+                    filename,
+                    native_ms,
+                    assimp_ms,
+                    assimp_ms / native_ms
+                );
+            }
+            else
+            {
+                LogDebug("[model] '%s': native %.2f ms.\n", filename, native_ms);
+            }
+            return maybe_model;
+        }
+        LogDebug("[model] '%s': native loader failed, fallback to Assimp.\n", filename);
+    }
     AssimpModel model = Assimp_Load(filename);
     Panic(!model.meshes.empty());
+    return outcome::success(std::move(model));
+}
+
+static double ToMiB(std::size_t bytes)
+{
+    return double(bytes) / (1024.0 * 1024.0);
+}
+
+// Neither Assimp (no aiProcess_JoinIdenticalVertices) nor native loaders share vertices
+// between faces; meshes are welded in parallel (each on GlobalThreadPool() too).
+static void WeldMeshes(const char* filename, AssimpModel& model)
+{
+    const StopWatch timer;
+    std::vector<MeshWeldStats> stats(model.meshes.size());
+    GlobalThreadPool().parallel_for(model.meshes.size(), [&](std::size_t i) {
+        AssimpMesh& mesh = model.meshes[i];
+        MeshWeldSettings settings = c_import_weld_settings;
+        // Face tangents are smoothed over the shared vertices, as aiProcess_CalcTangentSpace does.
+        settings.recompute_tangents = mesh.has_texture_coords;
+        stats[i] = Mesh_Weld(mesh.vertices, mesh.indices, settings);
+    });
+
+    MeshWeldStats total{};
+    model.aabb_min = glm::vec3(FLT_MAX);
+    model.aabb_max = glm::vec3(-FLT_MAX);
+    for (std::size_t i = 0; i < model.meshes.size(); ++i)
+    {
+        // Unreferenced vertices are gone: bounds may shrink.
+        AssimpMesh& mesh = model.meshes[i];
+        mesh.aabb_min = glm::vec3(FLT_MAX);
+        mesh.aabb_max = glm::vec3(-FLT_MAX);
+        for (const Vertex& v : mesh.vertices)
+        {
+            mesh.aabb_min = glm::min(mesh.aabb_min, v.position);
+            mesh.aabb_max = glm::max(mesh.aabb_max, v.position);
+        }
+        Assimp_UpdateAABB(model, mesh);
+        total.vertices_before += stats[i].vertices_before;
+        total.vertices_after += stats[i].vertices_after;
+        total.triangles_before += stats[i].triangles_before;
+        total.triangles_after += stats[i].triangles_after;
+        total.degenerate_triangles += stats[i].degenerate_triangles;
+    }
+    LogDebug(
+        "[model] '%s': welded %zu -> %zu vertices (x%.2f), %zu -> %zu triangles (%zu degenerate), %.2f ms.\n",
+        filename,
+        total.vertices_before,
+        total.vertices_after,
+        (total.vertices_after > 0) ? (double(total.vertices_before) / double(total.vertices_after)) : 0.0,
+        total.triangles_before,
+        total.triangles_after,
+        total.degenerate_triangles,
+        timer.elapsed_ms()
+    );
+}
+
+// Of all meshes, weighted by triangles (ACMR, overdraw) & vertices (ATVR).
+struct MeshOrderStats
+{
+    double acmr = 0.0;
+    double atvr = 0.0;
+    std::size_t bytes_fetched = 0;
+    std::size_t vertex_bytes = 0;
+    std::uint64_t pixels_covered = 0;
+    std::uint64_t pixels_shaded = 0;
+};
+
+static MeshOrderStats GetMeshOrderStats(const AssimpModel& model)
+{
+    std::vector<VertexCacheStats> vertex_cache(model.meshes.size());
+    std::vector<VertexFetchStats> vertex_fetch(model.meshes.size());
+    std::vector<OverdrawStats> overdraw(model.meshes.size());
+    GlobalThreadPool().parallel_for(model.meshes.size(), [&](std::size_t i) {
+        const AssimpMesh& mesh = model.meshes[i];
+        vertex_cache[i] = Mesh_AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+        vertex_fetch[i] = Mesh_AnalyzeVertexFetch(mesh.indices, mesh.vertices.size(), sizeof(Vertex));
+        if (c_estimate_overdraw)
+        {
+            overdraw[i] = Mesh_AnalyzeOverdraw(mesh.indices, mesh.vertices);
+        }
+    });
+
+    MeshOrderStats stats{};
+    std::size_t triangles = 0;
+    std::size_t vertices = 0;
+    for (std::size_t i = 0; i < model.meshes.size(); ++i)
+    {
+        const std::size_t mesh_triangles = (model.meshes[i].indices.size() / 3);
+        const std::size_t mesh_vertices = model.meshes[i].vertices.size();
+        stats.acmr += double(vertex_cache[i].acmr) * double(mesh_triangles);
+        stats.atvr += double(vertex_cache[i].atvr) * double(mesh_vertices);
+        stats.bytes_fetched += vertex_fetch[i].bytes_fetched;
+        stats.vertex_bytes += (mesh_vertices * sizeof(Vertex));
+        stats.pixels_covered += overdraw[i].pixels_covered;
+        stats.pixels_shaded += overdraw[i].pixels_shaded;
+        triangles += mesh_triangles;
+        vertices += mesh_vertices;
+    }
+    stats.acmr = (triangles > 0) ? (stats.acmr / double(triangles)) : 0.0;
+    stats.atvr = (vertices > 0) ? (stats.atvr / double(vertices)) : 0.0;
+    return stats;
+}
+
+static double GetOverfetch(const MeshOrderStats& stats)
+{
+    return (stats.vertex_bytes > 0) ? (double(stats.bytes_fetched) / double(stats.vertex_bytes)) : 0.0;
+}
+
+static double GetOverdraw(const MeshOrderStats& stats)
+{
+    return (stats.pixels_covered > 0) ? (double(stats.pixels_shaded) / double(stats.pixels_covered)) : 0.0;
+}
+
+// Triangles order is baked with the model.
+static void OptimizeMeshes(const char* filename, AssimpModel& model)
+{
+    if (!c_optimize_vertex_cache)
+    {
+        return;
+    }
+    const MeshOrderStats before = GetMeshOrderStats(model);
+    const StopWatch timer;
+    GlobalThreadPool().parallel_for(model.meshes.size(), [&](std::size_t i) {
+        AssimpMesh& mesh = model.meshes[i];
+        Mesh_OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+        if (c_optimize_overdraw)
+        {
+            Mesh_OptimizeOverdraw(mesh.indices, mesh.vertices);
+        }
+        if (c_optimize_vertex_fetch)
+        {
+            Mesh_OptimizeVertexFetch(mesh.vertices, mesh.indices);
+        }
+    });
+    const double optimize_ms = timer.elapsed_ms();
+    const MeshOrderStats after = GetMeshOrderStats(model);
+
+    LogDebug(
+        "[model] '%s': vertex cache (FIFO %zu) ACMR %.3f -> %.3f, ATVR %.3f -> %.3f%s, %.2f ms.\n",
+        filename,
+        c_vertex_cache_size,
+        before.acmr,
+        after.acmr,
+        before.atvr,
+        after.atvr,
+        c_optimize_overdraw ? " (overdraw order)" : "",
+        optimize_ms
+    );
+    LogDebug(
+        "[model] '%s': vertex fetch (%zu x %zu B lines) overfetch %.3f -> %.3f.\n",
+        filename,
+        c_fetch_cache_lines,
+        c_fetch_cache_line,
+        GetOverfetch(before),
+        GetOverfetch(after)
+    );
+    if (c_estimate_overdraw)
+    {
+        LogDebug(
+            "[model] '%s': overdraw (%zu views) %.3f -> %.3f.\n",
+            filename,
+            c_overdraw_views,
+            GetOverdraw(before),
+            GetOverdraw(after)
+        );
+    }
+}
+
+// GLB buffers are used in place; no import and no baked cache.
+static outcome::result<Model> LoadGlb(const char* filename)
+{
+    const std::size_t peak_before = GetPeakMemoryBytes();
+    const StopWatch timer;
+    auto maybe_glb = Glb_Load(filename);
+    if (!maybe_glb)
+    {
+        return outcome::failure(maybe_glb.error());
+    }
+    const double glb_ms = timer.elapsed_ms();
+    const std::size_t glb_peak = GetPeakMemoryBytes() - peak_before;
+    Model m{};
+    m.mapped_ = std::make_unique<MappedModel>(std::move(maybe_glb.value()));
+    m.generate_mips();
+    // Not baked: encoded chains come from the texture cache (see texture_compress.h).
+    m.compress_textures(c_texture_compression);
+    LogDebug(
+        "[model] '%s': GLB mapped %.2f ms, %u of %u meshes converted, peak RSS +%.1f MiB.\n",
+        filename,
+        glb_ms,
+        unsigned(m.mapped_->owned_vertices.size()),
+        unsigned(m.mapped_->meshes.size()),
+        ToMiB(glb_peak)
+    );
+    if constexpr (c_compare_native_with_assimp)
+    {
+        // Peak is process-wide: Assimp's number is growth on top of the GLB one.
+        const std::size_t assimp_peak_before = GetPeakMemoryBytes();
+        const StopWatch assimp_timer;
+        (void)Assimp_Load(filename);
+        const double assimp_ms = assimp_timer.elapsed_ms();
+        LogDebug(
+            "[model] '%s': Assimp %.2f ms (x%.1f), peak RSS +%.1f MiB.\n",
+            filename,
+            assimp_ms,
+            assimp_ms / glb_ms,
+            ToMiB(GetPeakMemoryBytes() - assimp_peak_before)
+        );
+    }
+    return outcome::success(std::move(m));
+}
+
+// Source is streamed into a chunked cache, then mapped as a warm load would;
+// see model_chunks.h. The viewer pages chunks in (see ModelChunkPager).
+static outcome::result<Model> LoadOutOfCore(const char* filename, NativeFormat format)
+{
+    const StopWatch timer;
+    auto maybe_key = ModelCache_MakeKeyStreamed(filename, 0u, c_pipeline_native | c_pipeline_out_of_core);
+    if (!maybe_key)
+    {
+        return outcome::failure(maybe_key.error());
+    }
+    const ModelCacheKey key = maybe_key.value();
+    const std::filesystem::path cache_path = ModelCache_GetPath(filename);
+    if (auto maybe_cached = ModelCache_Load(cache_path, key))
+    {
+        Model m{};
+        m.mapped_ = std::make_unique<MappedModel>(std::move(maybe_cached.value()));
+        LogDebug("[model] '%s': warm load (mapped chunks) %.2f ms.\n", filename, timer.elapsed_ms());
+        return outcome::success(std::move(m));
+    }
+
+    const std::size_t peak_before = GetPeakMemoryBytes();
+    auto maybe_stats = (format == NativeFormat::Ply)
+                           ? Ply_ImportChunked(filename, cache_path, key, c_out_of_core_settings)
+                           : Stl_ImportChunked(filename, cache_path, key, c_out_of_core_settings);
+    const std::size_t import_peak = GetPeakMemoryBytes() - peak_before;
+    if (!maybe_stats)
+    {
+        LogDebug("[model] '%s': out-of-core import failed.\n", filename);
+        return outcome::failure(maybe_stats.error());
+    }
+    const ChunkStats& stats = maybe_stats.value();
+    LogDebug(
+        "[model] '%s': out-of-core import %.2f ms, %u chunks, %.1f M triangles, %.1f MiB spilled, "
+        "peak RSS +%.1f MiB (limit %.1f MiB%s).\n",
+        filename,
+        timer.elapsed_ms(),
+        stats.chunks,
+        double(stats.triangles) / 1e6,
+        ToMiB(std::size_t(stats.spilled_bytes)),
+        ToMiB(import_peak),
+        ToMiB(c_out_of_core_settings.memory_limit_bytes),
+        (import_peak > c_out_of_core_settings.memory_limit_bytes) ? ", exceeded" : ""
+    );
+
+    auto maybe_cached = ModelCache_Load(cache_path, key);
+    if (!maybe_cached)
+    {
+        return outcome::failure(maybe_cached.error());
+    }
+    Model m{};
+    m.mapped_ = std::make_unique<MappedModel>(std::move(maybe_cached.value()));
+    return outcome::success(std::move(m));
+}
+
+// Files the import read besides the model file; textures are next to it.
+static std::vector<std::filesystem::path> GetImportDependencies(const char* filename, const AssimpModel& model)
+{
+    const std::filesystem::path dir = std::filesystem::path(filename).parent_path();
+    std::vector<std::filesystem::path> dependencies = model.dependencies;
+    for (const AssimpModel::Blob& blob : model.materials)
+    {
+        dependencies.push_back(dir / blob.path);
+    }
+    return dependencies;
+}
+
+static outcome::result<Model> LoadModelData(const char* filename)
+{
+    NativeFormat format = GetNativeFormat(filename);
+    // Native loaders map files; packed ones are read through Assimp's IOSystem.
+    const bool packed = Package_IsPath(filename);
+    if (packed)
+    {
+        format = NativeFormat::None;
+    }
+    if (format == NativeFormat::Glb)
+    {
+        auto maybe_glb = LoadGlb(filename);
+        if (maybe_glb)
+        {
+            return maybe_glb;
+        }
+        LogDebug("[model] '%s': GLB loader failed, fallback to Assimp.\n", filename);
+        format = NativeFormat::None;
+    }
+    if ((format == NativeFormat::Ply) || (format == NativeFormat::Stl))
+    {
+        std::error_code ec;
+        const std::uint64_t file_size = std::filesystem::file_size(filename, ec);
+        if (!ec && (file_size >= c_out_of_core_min_bytes))
+        {
+            auto maybe_chunked = LoadOutOfCore(filename, format);
+            if (maybe_chunked)
+            {
+                return maybe_chunked;
+            }
+            // E.g. ASCII files: imported in memory (if they fit).
+        }
+    }
+
+    const StopWatch timer;
+    const std::uint32_t import_flags = Assimp_ImportFlags();
+    const std::uint32_t pipeline_flags = ((format != NativeFormat::None) ? c_pipeline_native : 0u)
+                                         | c_pipeline_texture_compression | c_pipeline_welded | c_pipeline_vertex_cache
+                                         | c_pipeline_overdraw | c_pipeline_vertex_fetch;
+    ModelCacheKey key{};
+    if (packed)
+    {
+        // Package index has the hash; same as ModelCache_MakeKey() of the unpacked file.
+        auto maybe_entry = Package_Stat(filename);
+        if (!maybe_entry)
+        {
+            return outcome::failure(maybe_entry.error());
+        }
+        key.source_hash = maybe_entry.value().content_hash;
+        key.source_size = maybe_entry.value().size;
+        key.import_flags = import_flags;
+        key.pipeline_flags = pipeline_flags;
+    }
+    else
+    {
+        // Nothing else needs the source; don't keep it mapped while importing.
+        auto maybe_source = MappedFile::open(filename);
+        if (!maybe_source)
+        {
+            return outcome::failure(maybe_source.error());
+        }
+        key = ModelCache_MakeKey(maybe_source.value().bytes(), import_flags, pipeline_flags);
+    }
+    const std::filesystem::path cache_path = ModelCache_GetPath(filename);
+
+    if (auto maybe_cached = ModelCache_Load(cache_path, key))
+    {
+        Model m{};
+        m.mapped_ = std::make_unique<MappedModel>(std::move(maybe_cached.value()));
+        LogDebug("[model] '%s': warm load (mapped cache) %.2f ms.\n", filename, timer.elapsed_ms());
+        return outcome::success(std::move(m));
+    }
+
+    auto maybe_model = ImportModel(filename, format);
+    if (!maybe_model)
+    {
+        return outcome::failure(maybe_model.error());
+    }
+    const std::vector<std::filesystem::path> dependencies = GetImportDependencies(filename, maybe_model.value());
+    WeldMeshes(filename, maybe_model.value());
+    OptimizeMeshes(filename, maybe_model.value());
     Model m{};
-    m.assimp_ = std::make_unique<AssimpModel>(std::move(model));
+    m.assimp_ = std::make_unique<AssimpModel>(std::move(maybe_model.value()));
+    // Baked with the model: warm loads map the chains.
+    m.generate_mips();
+    m.compress_textures(c_texture_compression);
+    const double import_ms = timer.elapsed_ms();
+
+    const bool saved = ModelCache_Save(cache_path, key, m, dependencies);
+    LogDebug(
+        "[model] '%s': cold load (import) %.2f ms, cache bake %.2f ms%s.\n",
+        filename,
+        import_ms,
+        timer.elapsed_ms() - import_ms,
+        saved ? "" : " (failed to write cache)"
+    );
     return outcome::success(std::move(m));
 }
+
+outcome::result<Model> LoadModel(const char* filename)
+{
+    auto maybe_model = LoadModelData(filename);
+    if (maybe_model)
+    {
+        // After the cache bake: baked models keep their own copy of the texels.
+        maybe_model.value().share_textures();
+    }
+    return maybe_model;
+}
@@ -4,24 +4,52 @@
 
 #include <glm/vec3.hpp>
 
+#include <filesystem>
+#include <memory>
 #include <span>
+#include <string>
+#include <string_view>
 #include <type_traits>
 
 #include <cstdint>
 
 struct AssimpModel;
+struct MappedModel;
 struct Model;
+enum class TextureCompression;
 outcome::result<Model> LoadModel(const char* filename);
+// .obj, .ply, .stl, .glb - extensions LoadModel() is expected to handle.
+bool IsModelFile(const std::filesystem::path& path);
 
-// RGBA, 8 bits per channel.
+// Color space is per texture (see Texture::srgb).
+enum class TextureFormat : std::uint32_t
+{
+    RGBA8, // 8 bits per channel
+    BC1,
+    BC3,
+    BC5, // normal map x, y (z is reconstructed)
+    BC7,
+};
+
+// Texels in the format: decoded images are RGBA8, then block-compressed (see texture_compress.h);
+// .dds/.ktx2 files come in their own format (see texture_container.h).
 // In the example (backpack/diffuse.png) it's actually DXGI_FORMAT_R8G8B8A8_UNORM_SRGB.
-// No mips.
+// data is the mip chain, level 0 first (see texture_mips.h); width/height are of level 0.
 struct Texture
 {
     std::uint32_t id;
     std::span<const std::uint8_t> data;
     std::uint32_t width;
     std::uint32_t height;
+    std::uint32_t mips_count = 1;
+    TextureFormat format = TextureFormat::RGBA8;
+    // Texels are sRGB-encoded color (sampled with gamma decode); false for linear data:
+    // normal maps and UNORM containers. BC5 is always linear.
+    bool srgb = true;
+    // Source image relative to the model's folder; empty if embedded (.glb).
+    std::string_view path;
+    // Content key once the texels are shared with other models (see texture_share.h); 0 otherwise.
+    std::uint64_t content_key = 0;
 };
 
 struct Mesh
@@ -30,19 +58,65 @@ struct Mesh
     std::span<const Index> indices;
     std::uint32_t texture_diffuse_id;
     std::uint32_t texture_normal_id;
+    glm::vec3 aabb_min;
+    glm::vec3 aabb_max;
+};
+
+// Of Model::memory(); each byte is in one of these.
+struct ModelMemory
+{
+    // Heap: imported/decoded data, texels shared with other models if this one registered them.
+    std::size_t owned_bytes = 0;
+    // Cache or .glb file mapping: paged in on use, dropped by the OS under pressure.
+    std::size_t mapped_bytes = 0;
+    // Texels registered by other models (see texture_share.h), counted by them.
+    std::size_t shared_bytes = 0;
+
+    std::size_t data_bytes() const
+    {
+        return (owned_bytes + mapped_bytes + shared_bytes);
+    }
 };
 
+// Either owns Assimp-imported data or maps baked cache file (see model_cache.h)
+// or .glb file (see gltf_loader.h).
+// Only one is set; none for not (yet) loaded catalog entry.
 struct Model
 {
     std::unique_ptr<AssimpModel> assimp_;
+    std::unique_ptr<MappedModel> mapped_;
 
     Mesh get_mesh(std::uint32_t index) const;
     Texture get_texture(std::uint32_t index) const;
 
+    bool is_loaded() const;
     glm::vec3 aabb_min() const;
     glm::vec3 aabb_max() const;
     std::uint32_t meshes_count() const;
     std::uint32_t textures_count() const;
+    // Vertices, indices and texels.
+    ModelMemory memory() const;
+    // Hot reload (see ModelWatch): texels of the texture are replaced by new ones
+    // (mip chain in the format, owned by the model from now on); meshes keep referencing the same id.
+    void set_texture(
+        std::uint32_t index,
+        std::unique_ptr<std::uint8_t, void (*)(void*)> texels,
+        std::uint32_t width,
+        std::uint32_t height,
+        std::uint32_t mips_count,
+        TextureFormat format,
+        bool srgb
+    );
+    // Full mip chains for RGBA8 textures that have level 0 only; textures referenced
+    // as normal maps are filtered as such. Textures are processed in parallel.
+    void generate_mips();
+    // RGBA8 chains to block formats (see texture_compress.h); logs throughput and PSNR.
+    // Call after generate_mips(): levels are encoded as they are.
+    void compress_textures(TextureCompression compression);
+    // Texels with the same content as some other loaded model's are replaced by that model's
+    // (own copy is freed); the rest are registered for the next models (see texture_share.h).
+    // Call once the texels are final; logs the bytes saved.
+    void share_textures();
 
     Model() noexcept;
     Model(Model&&) noexcept;
@@ -50,6 +124,7 @@ struct Model
     ~Model() noexcept;
 };
 
+// Catalog entry; model is loaded on demand (see ModelLoader).
 struct FileModel
 {
     std::string file_name;
@@ -57,4 +132,4 @@ struct FileModel
     Model model;
 };
 
-constexpr std::uint32_t c_texture_channels = 4; // RGBA, 8 bit per channel.
+constexpr std::uint32_t c_texture_channels = 4; // TextureFormat::RGBA8 (decoded images) only.
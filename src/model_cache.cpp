@@ -0,0 +1,746 @@
+#include "model_cache.h"
+#include "mesh_codec.h"
+#include "package.h"
+#include "texture_mips.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "utils_hash.h"
+#include "utils_log.h"
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <type_traits>
+
+#include <cstdio>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+// Layout (little-endian, everything is POD):
+//  CacheHeader
+//  CacheMesh[meshes_count]
+//  CacheTexture[textures_count]
+//  CacheDependency[dependencies_count]
+//  payload (vertices, indices, texture mip chains, texture paths, dependency paths),
+//  every blob is c_payload_alignment-aligned.
+// Offsets are from the beginning of the file. Vertices/indices with non-zero
+// *_encoded_size are compressed with mesh_codec.h and decoded on load.
+
+static constexpr char c_cache_magic[8] = {'X', 'X', 'M', 'O', 'D', 'E', 'L', '\0'};
+static constexpr std::uint32_t c_cache_version = 8;
+static constexpr std::uint64_t c_payload_alignment = 16;
+// Smaller cache to read vs geometry mapped in place (no decode).
+static constexpr bool c_cache_encode_geometry = true;
+
+struct CacheHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t import_flags;
+    std::uint64_t source_hash;
+    std::uint64_t source_size;
+    std::uint32_t meshes_count;
+    std::uint32_t textures_count;
+    std::uint32_t dependencies_count;
+    std::uint32_t pipeline_flags;
+    glm::vec3 aabb_min;
+    glm::vec3 aabb_max;
+};
+
+struct CacheMesh
+{
+    std::uint64_t vertices_offset;
+    std::uint64_t vertices_count;
+    std::uint64_t vertices_encoded_size; // 0 - stored as is
+    std::uint64_t indices_offset;
+    std::uint64_t indices_count;
+    std::uint64_t indices_encoded_size; // 0 - stored as is
+    std::uint32_t texture_diffuse_id;
+    std::uint32_t texture_normal_id;
+    glm::vec3 aabb_min;
+    glm::vec3 aabb_max;
+};
+
+struct CacheTexture
+{
+    std::uint64_t data_offset;
+    std::uint64_t data_size;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint64_t path_offset;
+    std::uint64_t path_size; // 0 - embedded texture
+    std::uint32_t mips_count;
+    TextureFormat format;
+    std::uint32_t srgb; // 0 - linear, see Texture::srgb
+};
+
+// File the import read besides the source; absolute (or packed) UTF-8 path.
+struct CacheDependency
+{
+    std::uint64_t path_offset;
+    std::uint64_t path_size;
+    std::uint64_t file_size;  // c_missing_file - there was no file
+    std::uint64_t file_stamp; // last write time; content hash if packed
+};
+
+static constexpr std::uint64_t c_missing_file = ~std::uint64_t(0);
+
+static_assert(std::is_trivially_copyable_v<CacheHeader>);
+static_assert(std::is_trivially_copyable_v<CacheMesh>);
+static_assert(std::is_trivially_copyable_v<CacheTexture>);
+static_assert(std::is_trivially_copyable_v<CacheDependency>);
+static_assert(std::is_trivially_copyable_v<Vertex>);
+
+static std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+ModelCacheKey ModelCache_MakeKey(
+    std::span<const std::uint8_t> source,
+    std::uint32_t import_flags,
+    std::uint32_t pipeline_flags
+)
+{
+    ModelCacheKey key{};
+    key.source_hash = Hash64(source.data(), source.size());
+    key.source_size = source.size();
+    key.import_flags = import_flags;
+    key.pipeline_flags = pipeline_flags;
+    return key;
+}
+
+outcome::result<ModelCacheKey> ModelCache_MakeKeyStreamed(
+    const fs::path& source_path,
+    std::uint32_t import_flags,
+    std::uint32_t pipeline_flags
+)
+{
+    std::ifstream in(source_path, std::ios::binary);
+    if (!in)
+    {
+        return outcome::failure(std::errc::no_such_file_or_directory);
+    }
+    std::vector<char> buffer(std::size_t(4) << 20);
+    ModelCacheKey key{};
+    key.import_flags = import_flags;
+    key.pipeline_flags = pipeline_flags;
+    while (in)
+    {
+        in.read(buffer.data(), std::streamsize(buffer.size()));
+        const std::size_t size = std::size_t(in.gcount());
+        if (size == 0)
+        {
+            break;
+        }
+        key.source_hash = Hash64_Mix(key.source_hash, Hash64(buffer.data(), size));
+        key.source_size += size;
+    }
+    if (in.bad())
+    {
+        return outcome::failure(std::errc::io_error);
+    }
+    return outcome::success(key);
+}
+
+fs::path ModelCache_GetPath(const fs::path& source_path)
+{
+    std::error_code ec;
+    fs::path absolute = source_path;
+    if (!Package_IsPath(source_path.string()))
+    {
+        absolute = fs::absolute(source_path, ec);
+        if (ec)
+        {
+            absolute = source_path;
+        }
+    }
+    const std::wstring str = absolute.make_preferred().wstring();
+    const std::uint64_t path_hash = Hash64(str.data(), str.size() * sizeof(wchar_t));
+
+    char suffix[32]{};
+    (void)std::snprintf(suffix, sizeof(suffix), "-%016llx.bake", static_cast<unsigned long long>(path_hash));
+
+    fs::path file_name = source_path.filename();
+    file_name += suffix;
+    return fs::temp_directory_path(ec) / "render_playground" / file_name;
+}
+
+static std::string ToCachePath(const fs::path& path)
+{
+    const std::u8string str = path.u8string();
+    return std::string(reinterpret_cast<const char*>(str.data()), str.size());
+}
+
+static fs::path FromCachePath(std::span<const char> path)
+{
+    return fs::path(std::u8string_view(reinterpret_cast<const char8_t*>(path.data()), path.size()));
+}
+
+static void StatDependency(const fs::path& path, CacheDependency& dependency)
+{
+    dependency.file_size = c_missing_file;
+    dependency.file_stamp = 0;
+    const std::string str = path.string();
+    if (Package_IsPath(str))
+    {
+        if (auto maybe_entry = Package_Stat(str))
+        {
+            dependency.file_size = maybe_entry.value().size;
+            dependency.file_stamp = maybe_entry.value().content_hash;
+        }
+        return;
+    }
+    std::error_code ec;
+    const std::uint64_t file_size = fs::file_size(path, ec);
+    if (ec)
+    {
+        return;
+    }
+    const fs::file_time_type time = fs::last_write_time(path, ec);
+    if (ec)
+    {
+        return;
+    }
+    dependency.file_size = file_size;
+    dependency.file_stamp = std::uint64_t(time.time_since_epoch().count());
+}
+
+template <typename T>
+static bool ReadPOD(std::span<const std::uint8_t> bytes, std::uint64_t offset, T& value)
+{
+    if ((offset > bytes.size()) || ((bytes.size() - offset) < sizeof(T)))
+    {
+        return false;
+    }
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return true;
+}
+
+template <typename T>
+static bool GetSpan(std::span<const std::uint8_t> bytes, std::uint64_t offset, std::uint64_t count, std::span<const T>& out)
+{
+    if ((offset % alignof(T)) != 0)
+    {
+        return false;
+    }
+    if ((offset > bytes.size()) || (count > ((bytes.size() - offset) / sizeof(T))))
+    {
+        return false;
+    }
+    out = {reinterpret_cast<const T*>(bytes.data() + offset), std::size_t(count)};
+    return true;
+}
+
+// Encoded stream (see mesh_codec.h) to decode into owned storage.
+struct CacheDecode
+{
+    std::span<const std::uint8_t> encoded;
+    std::span<Vertex> vertices;
+    std::span<Index> indices;
+};
+
+// Stream stored as is is mapped in place; encoded one gets owned storage to decode into.
+template <typename T>
+static bool GetStream(
+    std::span<const std::uint8_t> bytes,
+    std::uint64_t offset,
+    std::uint64_t count,
+    std::uint64_t encoded_size,
+    std::vector<std::vector<T>>& owned,
+    std::span<const T>& out,
+    std::vector<CacheDecode>& decodes
+)
+{
+    if (encoded_size == 0)
+    {
+        return GetSpan(bytes, offset, count, out);
+    }
+    CacheDecode decode{};
+    if (!GetSpan(bytes, offset, encoded_size, decode.encoded))
+    {
+        return false;
+    }
+    // Count is not trusted for the allocation: it can't decode from fewer bytes than that.
+    if (count > ((encoded_size * c_mesh_codec_max_expansion) / sizeof(T)))
+    {
+        return false;
+    }
+    std::vector<T>& storage = owned.emplace_back(std::size_t(count));
+    out = storage;
+    if constexpr (std::is_same_v<T, Vertex>)
+    {
+        decode.vertices = storage;
+    }
+    else
+    {
+        decode.indices = storage;
+    }
+    decodes.push_back(decode);
+    return true;
+}
+
+outcome::result<MappedModel> ModelCache_Load(const fs::path& cache_path, const ModelCacheKey& key)
+{
+    std::error_code ec;
+    if (!fs::is_regular_file(cache_path, ec))
+    {
+        return outcome::failure(std::errc::no_such_file_or_directory);
+    }
+    auto maybe_file = MappedFile::open(cache_path);
+    if (!maybe_file)
+    {
+        return outcome::failure(maybe_file.error());
+    }
+
+    MappedModel model{};
+    model.file = std::move(maybe_file.value());
+    const std::span<const std::uint8_t> bytes = model.file.bytes();
+
+    CacheHeader header{};
+    if (!ReadPOD(bytes, 0, header))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    if ((std::memcmp(header.magic, c_cache_magic, sizeof(c_cache_magic)) != 0) //
+        || (header.version != c_cache_version))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    if ((header.source_hash != key.source_hash)      //
+        || (header.source_size != key.source_size)   //
+        || (header.import_flags != key.import_flags) //
+        || (header.pipeline_flags != key.pipeline_flags))
+    {
+        // Stale.
+        return outcome::failure(std::errc::invalid_argument);
+    }
+    // Files are checked before anything is decoded.
+    std::uint64_t dependency_offset = sizeof(CacheHeader)                                    //
+                                      + sizeof(CacheMesh) * std::uint64_t(header.meshes_count) //
+                                      + sizeof(CacheTexture) * std::uint64_t(header.textures_count);
+    for (std::uint32_t i = 0; i < header.dependencies_count; ++i, dependency_offset += sizeof(CacheDependency))
+    {
+        CacheDependency baked{};
+        std::span<const char> path;
+        if (!ReadPOD(bytes, dependency_offset, baked) || !GetSpan(bytes, baked.path_offset, baked.path_size, path))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        CacheDependency current{};
+        StatDependency(FromCachePath(path), current);
+        if ((current.file_size != baked.file_size) || (current.file_stamp != baked.file_stamp))
+        {
+            LogDebug("[model cache] '%.*s' changed since the bake.\n", int(path.size()), path.data());
+            return outcome::failure(std::errc::invalid_argument);
+        }
+    }
+
+    model.aabb_min = header.aabb_min;
+    model.aabb_max = header.aabb_max;
+    model.meshes.reserve(header.meshes_count);
+    model.textures.reserve(header.textures_count);
+
+    std::vector<CacheDecode> decodes;
+    std::uint64_t offset = sizeof(CacheHeader);
+    for (std::uint32_t i = 0; i < header.meshes_count; ++i, offset += sizeof(CacheMesh))
+    {
+        CacheMesh cache_mesh{};
+        Mesh mesh{};
+        if (!ReadPOD(bytes, offset, cache_mesh)
+            || !GetStream(
+                bytes,
+                cache_mesh.vertices_offset,
+                cache_mesh.vertices_count,
+                cache_mesh.vertices_encoded_size,
+                model.owned_vertices,
+                mesh.vertices,
+                decodes
+            )
+            || !GetStream(
+                bytes,
+                cache_mesh.indices_offset,
+                cache_mesh.indices_count,
+                cache_mesh.indices_encoded_size,
+                model.owned_indices,
+                mesh.indices,
+                decodes
+            ))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        mesh.texture_diffuse_id = cache_mesh.texture_diffuse_id;
+        mesh.texture_normal_id = cache_mesh.texture_normal_id;
+        mesh.aabb_min = cache_mesh.aabb_min;
+        mesh.aabb_max = cache_mesh.aabb_max;
+        model.meshes.push_back(mesh);
+    }
+    for (std::uint32_t i = 0; i < header.textures_count; ++i, offset += sizeof(CacheTexture))
+    {
+        CacheTexture cache_texture{};
+        Texture texture{};
+        std::span<const char> path;
+        if (!ReadPOD(bytes, offset, cache_texture) //
+            || !GetSpan(bytes, cache_texture.data_offset, cache_texture.data_size, texture.data)
+            || !GetSpan(bytes, cache_texture.path_offset, cache_texture.path_size, path))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        const std::uint32_t width = cache_texture.width;
+        const std::uint32_t height = cache_texture.height;
+        const TextureFormat format = cache_texture.format;
+        if ((format > TextureFormat::BC7) || (cache_texture.mips_count == 0)
+            || (cache_texture.mips_count > TextureMips_FullCount(width, height))
+            || (texture.data.size() != TextureMips_ChainBytes(format, width, height, cache_texture.mips_count)))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        texture.id = i;
+        texture.width = width;
+        texture.height = height;
+        texture.mips_count = cache_texture.mips_count;
+        texture.format = format;
+        texture.srgb = (cache_texture.srgb != 0);
+        texture.path = std::string_view(path.data(), path.size());
+        model.textures.push_back(texture);
+    }
+
+    if (!decodes.empty())
+    {
+        const StopWatch timer;
+        std::atomic<bool> decoded{true};
+        GlobalThreadPool().parallel_for(decodes.size(), [&](std::size_t i) {
+            const CacheDecode& decode = decodes[i];
+            const bool ok = decode.vertices.empty() ? MeshCodec_DecodeIndices(decode.encoded, decode.indices)
+                                                    : MeshCodec_DecodeVertices(decode.encoded, decode.vertices);
+            if (!ok)
+            {
+                decoded.store(false);
+            }
+        });
+        if (!decoded.load())
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        const double decode_ms = timer.elapsed_ms();
+        std::size_t encoded_bytes = 0;
+        std::size_t decoded_bytes = 0;
+        for (const CacheDecode& decode : decodes)
+        {
+            encoded_bytes += decode.encoded.size();
+            decoded_bytes += (decode.vertices.size_bytes() + decode.indices.size_bytes());
+        }
+        LogDebug(
+            "[model cache] geometry decoded %.2f MB -> %.2f MB: %.2f ms (%.2f GB/s).\n",
+            double(encoded_bytes) / double(1 << 20),
+            double(decoded_bytes) / double(1 << 20),
+            decode_ms,
+            (decode_ms > 0.0) ? (double(decoded_bytes) / (decode_ms * 1e6)) : 0.0
+        );
+    }
+    return outcome::success(std::move(model));
+}
+
+bool ModelCache_Save(
+    const fs::path& cache_path,
+    const ModelCacheKey& key,
+    const Model& model,
+    std::span<const fs::path> dependencies
+)
+{
+    const std::uint32_t meshes_count = model.meshes_count();
+    const std::uint32_t textures_count = model.textures_count();
+    const std::uint32_t dependencies_count = std::uint32_t(dependencies.size());
+
+    // Absolute: the cache is per source path (see ModelCache_GetPath()), not per working directory.
+    std::vector<std::string> dependency_paths(dependencies_count);
+    std::vector<CacheDependency> cache_dependencies(dependencies_count);
+    for (std::uint32_t i = 0; i < dependencies_count; ++i)
+    {
+        std::error_code ec;
+        fs::path path = dependencies[i];
+        if (!Package_IsPath(path.string()))
+        {
+            path = fs::absolute(path, ec);
+            if (ec)
+            {
+                path = dependencies[i];
+            }
+        }
+        dependency_paths[i] = ToCachePath(path.lexically_normal());
+        StatDependency(path, cache_dependencies[i]);
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, c_cache_magic, sizeof(c_cache_magic));
+    header.version = c_cache_version;
+    header.import_flags = key.import_flags;
+    header.pipeline_flags = key.pipeline_flags;
+    header.source_hash = key.source_hash;
+    header.source_size = key.source_size;
+    header.meshes_count = meshes_count;
+    header.textures_count = textures_count;
+    header.dependencies_count = dependencies_count;
+    header.aabb_min = model.aabb_min();
+    header.aabb_max = model.aabb_max();
+
+    // Meshes are independent; encoded concurrently.
+    std::vector<std::vector<std::uint8_t>> encoded_vertices(meshes_count);
+    std::vector<std::vector<std::uint8_t>> encoded_indices(meshes_count);
+    if constexpr (c_cache_encode_geometry)
+    {
+        GlobalThreadPool().parallel_for(meshes_count, [&](std::size_t i) {
+            const Mesh mesh = model.get_mesh(std::uint32_t(i));
+            encoded_vertices[i] = MeshCodec_EncodeVertices(mesh.vertices);
+            encoded_indices[i] = MeshCodec_EncodeIndices(mesh.indices);
+        });
+    }
+
+    // Layout pass.
+    std::vector<CacheMesh> cache_meshes(meshes_count);
+    std::vector<CacheTexture> cache_textures(textures_count);
+    std::uint64_t offset = sizeof(CacheHeader)                      //
+                           + sizeof(CacheMesh) * meshes_count     //
+                           + sizeof(CacheTexture) * textures_count //
+                           + sizeof(CacheDependency) * dependencies_count;
+    for (std::uint32_t i = 0; i < meshes_count; ++i)
+    {
+        const Mesh mesh = model.get_mesh(i);
+        CacheMesh& cache_mesh = cache_meshes[i];
+        offset = AlignUp(offset, c_payload_alignment);
+        cache_mesh.vertices_offset = offset;
+        cache_mesh.vertices_count = mesh.vertices.size();
+        cache_mesh.vertices_encoded_size = encoded_vertices[i].size();
+        offset += (encoded_vertices[i].empty() ? mesh.vertices.size_bytes() : encoded_vertices[i].size());
+        offset = AlignUp(offset, c_payload_alignment);
+        cache_mesh.indices_offset = offset;
+        cache_mesh.indices_count = mesh.indices.size();
+        cache_mesh.indices_encoded_size = encoded_indices[i].size();
+        offset += (encoded_indices[i].empty() ? mesh.indices.size_bytes() : encoded_indices[i].size());
+        cache_mesh.texture_diffuse_id = mesh.texture_diffuse_id;
+        cache_mesh.texture_normal_id = mesh.texture_normal_id;
+        cache_mesh.aabb_min = mesh.aabb_min;
+        cache_mesh.aabb_max = mesh.aabb_max;
+    }
+    for (std::uint32_t i = 0; i < textures_count; ++i)
+    {
+        const Texture texture = model.get_texture(i);
+        CacheTexture& cache_texture = cache_textures[i];
+        offset = AlignUp(offset, c_payload_alignment);
+        cache_texture.data_offset = offset;
+        cache_texture.data_size = texture.data.size();
+        cache_texture.width = texture.width;
+        cache_texture.height = texture.height;
+        cache_texture.mips_count = texture.mips_count;
+        cache_texture.format = texture.format;
+        cache_texture.srgb = (texture.srgb ? 1u : 0u);
+        offset += texture.data.size();
+        offset = AlignUp(offset, c_payload_alignment);
+        cache_texture.path_offset = offset;
+        cache_texture.path_size = texture.path.size();
+        offset += texture.path.size();
+    }
+    for (std::uint32_t i = 0; i < dependencies_count; ++i)
+    {
+        CacheDependency& cache_dependency = cache_dependencies[i];
+        offset = AlignUp(offset, c_payload_alignment);
+        cache_dependency.path_offset = offset;
+        cache_dependency.path_size = dependency_paths[i].size();
+        offset += dependency_paths[i].size();
+    }
+
+    std::error_code ec;
+    fs::create_directories(cache_path.parent_path(), ec);
+    // Write to a temporary file first so a crash never leaves half-written cache.
+    fs::path temp_path = cache_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            return false;
+        }
+        std::uint64_t written = 0;
+        auto write = [&](const void* data, std::uint64_t size) {
+            out.write(static_cast<const char*>(data), std::streamsize(size));
+            written += size;
+        };
+        auto pad_to = [&](std::uint64_t target) {
+            static const char c_zeros[c_payload_alignment]{};
+            Panic(target >= written);
+            Panic((target - written) <= sizeof(c_zeros));
+            write(c_zeros, target - written);
+        };
+
+        write(&header, sizeof(header));
+        write(cache_meshes.data(), sizeof(CacheMesh) * cache_meshes.size());
+        write(cache_textures.data(), sizeof(CacheTexture) * cache_textures.size());
+        write(cache_dependencies.data(), sizeof(CacheDependency) * cache_dependencies.size());
+        for (std::uint32_t i = 0; i < meshes_count; ++i)
+        {
+            const Mesh mesh = model.get_mesh(i);
+            pad_to(cache_meshes[i].vertices_offset);
+            if (encoded_vertices[i].empty())
+            {
+                write(mesh.vertices.data(), mesh.vertices.size_bytes());
+            }
+            else
+            {
+                write(encoded_vertices[i].data(), encoded_vertices[i].size());
+            }
+            pad_to(cache_meshes[i].indices_offset);
+            if (encoded_indices[i].empty())
+            {
+                write(mesh.indices.data(), mesh.indices.size_bytes());
+            }
+            else
+            {
+                write(encoded_indices[i].data(), encoded_indices[i].size());
+            }
+        }
+        for (std::uint32_t i = 0; i < textures_count; ++i)
+        {
+            const Texture texture = model.get_texture(i);
+            pad_to(cache_textures[i].data_offset);
+            write(texture.data.data(), texture.data.size());
+            pad_to(cache_textures[i].path_offset);
+            write(texture.path.data(), texture.path.size());
+        }
+        for (std::uint32_t i = 0; i < dependencies_count; ++i)
+        {
+            pad_to(cache_dependencies[i].path_offset);
+            write(dependency_paths[i].data(), dependency_paths[i].size());
+        }
+        Panic(written == offset);
+        if (!out)
+        {
+            return false;
+        }
+    }
+    if constexpr (c_cache_encode_geometry)
+    {
+        std::size_t raw_bytes = 0;
+        std::size_t encoded_bytes = 0;
+        for (std::uint32_t i = 0; i < meshes_count; ++i)
+        {
+            const Mesh mesh = model.get_mesh(i);
+            raw_bytes += (mesh.vertices.size_bytes() + mesh.indices.size_bytes());
+            encoded_bytes += (encoded_vertices[i].size() + encoded_indices[i].size());
+        }
+        LogDebug(
+            "[model cache] geometry encoded %.2f MB -> %.2f MB (x%.2f).\n",
+            double(raw_bytes) / double(1 << 20),
+            double(encoded_bytes) / double(1 << 20),
+            (encoded_bytes > 0) ? (double(raw_bytes) / double(encoded_bytes)) : 0.0
+        );
+    }
+    fs::rename(temp_path, cache_path, ec);
+    return !ec;
+}
+
+ModelCacheWriter::ModelCacheWriter() = default;
+
+ModelCacheWriter::~ModelCacheWriter()
+{
+    if (out_.is_open())
+    {
+        out_.close();
+        std::error_code ec;
+        (void)fs::remove(temp_path_, ec);
+    }
+}
+
+/*static*/ std::unique_ptr<ModelCacheWriter> ModelCacheWriter::create(
+    const fs::path& cache_path,
+    const ModelCacheKey& key,
+    std::uint32_t meshes_count,
+    glm::vec3 aabb_min,
+    glm::vec3 aabb_max
+)
+{
+    std::unique_ptr<ModelCacheWriter> writer(new ModelCacheWriter());
+    writer->cache_path_ = cache_path;
+    writer->temp_path_ = cache_path;
+    writer->temp_path_ += ".tmp";
+    writer->key_ = key;
+    writer->aabb_min_ = aabb_min;
+    writer->aabb_max_ = aabb_max;
+    writer->meshes_count_ = meshes_count;
+    writer->meshes_.reserve(meshes_count);
+
+    std::error_code ec;
+    fs::create_directories(cache_path.parent_path(), ec);
+    writer->out_.open(writer->temp_path_, std::ios::binary | std::ios::trunc);
+    if (!writer->out_)
+    {
+        return nullptr;
+    }
+    // Header & table are written by finish(); payload goes after them.
+    const std::uint64_t payload_offset = sizeof(CacheHeader) + sizeof(CacheMesh) * std::uint64_t(meshes_count);
+    const std::vector<char> zeros(std::size_t(AlignUp(payload_offset, c_payload_alignment)), 0);
+    writer->out_.write(zeros.data(), std::streamsize(zeros.size()));
+    writer->written_ = zeros.size();
+    return writer;
+}
+
+bool ModelCacheWriter::append(const Mesh& mesh)
+{
+    if (meshes_.size() >= meshes_count_)
+    {
+        return false;
+    }
+    auto write_aligned = [&](const void* data, std::uint64_t size) {
+        static const char c_zeros[c_payload_alignment]{};
+        const std::uint64_t offset = AlignUp(written_, c_payload_alignment);
+        out_.write(c_zeros, std::streamsize(offset - written_));
+        out_.write(static_cast<const char*>(data), std::streamsize(size));
+        written_ = offset + size;
+        return offset;
+    };
+    CacheMesh& cache_mesh = meshes_.emplace_back();
+    cache_mesh.vertices_offset = write_aligned(mesh.vertices.data(), mesh.vertices.size_bytes());
+    cache_mesh.vertices_count = mesh.vertices.size();
+    cache_mesh.vertices_encoded_size = 0;
+    cache_mesh.indices_offset = write_aligned(mesh.indices.data(), mesh.indices.size_bytes());
+    cache_mesh.indices_count = mesh.indices.size();
+    cache_mesh.indices_encoded_size = 0;
+    cache_mesh.texture_diffuse_id = mesh.texture_diffuse_id;
+    cache_mesh.texture_normal_id = mesh.texture_normal_id;
+    cache_mesh.aabb_min = mesh.aabb_min;
+    cache_mesh.aabb_max = mesh.aabb_max;
+    return !!out_;
+}
+
+bool ModelCacheWriter::finish()
+{
+    if (meshes_.size() != meshes_count_)
+    {
+        return false;
+    }
+    CacheHeader header{};
+    std::memcpy(header.magic, c_cache_magic, sizeof(c_cache_magic));
+    header.version = c_cache_version;
+    header.import_flags = key_.import_flags;
+    header.pipeline_flags = key_.pipeline_flags;
+    header.source_hash = key_.source_hash;
+    header.source_size = key_.source_size;
+    header.meshes_count = meshes_count_;
+    header.textures_count = 0;
+    header.dependencies_count = 0;
+    header.aabb_min = aabb_min_;
+    header.aabb_max = aabb_max_;
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.write(reinterpret_cast<const char*>(meshes_.data()), std::streamsize(sizeof(CacheMesh) * meshes_.size()));
+    out_.close();
+    if (!out_)
+    {
+        std::error_code ec;
+        (void)fs::remove(temp_path_, ec);
+        return false;
+    }
+    std::error_code ec;
+    fs::rename(temp_path_, cache_path_, ec);
+    return !ec;
+}
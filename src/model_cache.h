@@ -0,0 +1,112 @@
+#pragma once
+#include "mapped_file.h"
+#include "model.h"
+
+#include <glm/vec3.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <cstdint>
+
+// Baked binary model: written after the first (slow) import,
+// memory-mapped on the next loads. Mesh/Texture spans point
+// directly into the mapping, nothing is copied.
+// Also used by Glb_Load() for the source file itself; there, data that
+// can't be used in place is converted into owned_* storage.
+struct MappedModel
+{
+    using OwnedBlob = std::unique_ptr<std::uint8_t, void (*)(void*)>;
+
+    MappedFile file;
+    std::vector<Mesh> meshes;
+    std::vector<Texture> textures;
+    glm::vec3 aabb_min;
+    glm::vec3 aabb_max;
+
+    std::vector<std::vector<Vertex>> owned_vertices;
+    std::vector<std::vector<Index>> owned_indices;
+    std::vector<OwnedBlob> owned_blobs; // decoded texels
+    // Once textures are shared (see Model::share_textures()): file, owned by the texels
+    // that point into it, and references to the texels of each texture.
+    std::shared_ptr<const MappedFile> shared_file;
+    std::vector<std::shared_ptr<const std::uint8_t>> shared_texels;
+    // Per texture: shared_texels are this model's own, registered for the others.
+    std::vector<bool> shared_owner;
+};
+
+struct ModelCacheKey
+{
+    std::uint64_t source_hash;
+    std::uint64_t source_size;
+    std::uint32_t import_flags;   // Assimp post-processing steps (aiPostProcessSteps)
+    std::uint32_t pipeline_flags; // the viewer's own steps that change baked data (see model.cpp)
+};
+
+ModelCacheKey ModelCache_MakeKey(
+    std::span<const std::uint8_t> source,
+    std::uint32_t import_flags,
+    std::uint32_t pipeline_flags
+);
+// Reads the file through a fixed-size buffer (never mapped as a whole), for sources
+// larger than memory. The hash differs from ModelCache_MakeKey() of the same bytes.
+outcome::result<ModelCacheKey> ModelCache_MakeKeyStreamed(
+    const std::filesystem::path& source_path,
+    std::uint32_t import_flags,
+    std::uint32_t pipeline_flags
+);
+// %TEMP%/render_playground/<name>-<path hash>.bake
+std::filesystem::path ModelCache_GetPath(const std::filesystem::path& source_path);
+
+// Fails if there is no cache, the cache was baked for a different key
+// or one of the files it depends on changed since (see ModelCache_Save()).
+outcome::result<MappedModel> ModelCache_Load(const std::filesystem::path& cache_path, const ModelCacheKey& key);
+// Dependencies: files the import read besides the source (.mtl, textures); their size &
+// last write time (content hash, if packed) are stored and checked by ModelCache_Load().
+bool ModelCache_Save(
+    const std::filesystem::path& cache_path,
+    const ModelCacheKey& key,
+    const Model& model,
+    std::span<const std::filesystem::path> dependencies
+);
+
+struct CacheMesh;
+
+// Cache written mesh by mesh, for models that don't fit in memory (see ChunkBuilder).
+// Geometry is stored as is, so it's mapped in place on load; no textures.
+struct ModelCacheWriter
+{
+    static std::unique_ptr<ModelCacheWriter> create(
+        const std::filesystem::path& cache_path,
+        const ModelCacheKey& key,
+        std::uint32_t meshes_count,
+        glm::vec3 aabb_min,
+        glm::vec3 aabb_max
+    );
+
+    bool append(const Mesh& mesh);
+    // All meshes_count meshes must be appended.
+    bool finish();
+
+    // Unfinished cache is removed.
+    ~ModelCacheWriter();
+    ModelCacheWriter(const ModelCacheWriter&) = delete;
+    ModelCacheWriter& operator=(const ModelCacheWriter&) = delete;
+
+private:
+    ModelCacheWriter();
+
+private:
+    std::filesystem::path cache_path_;
+    std::filesystem::path temp_path_;
+    std::ofstream out_;
+    ModelCacheKey key_{};
+    glm::vec3 aabb_min_{};
+    glm::vec3 aabb_max_{};
+    std::uint32_t meshes_count_ = 0;
+    std::vector<CacheMesh> meshes_;
+    std::uint64_t written_ = 0;
+};
@@ -0,0 +1,391 @@
+#include "model_chunks.h"
+#include "model.h"
+#include "utils.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include <cfloat>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+// Cells per axis of the grid, at most; cell index fits std::uint16_t.
+static constexpr std::uint32_t c_max_cells_per_axis = 40;
+// Vertices per key of ChunkBuilder::requests_.
+static constexpr std::uint64_t c_request_bucket_vertices = (std::uint64_t(1) << 20);
+static constexpr std::uint32_t c_no_texture = std::uint32_t(-1);
+
+struct VertexRecord
+{
+    Index index;
+    Vertex vertex;
+};
+
+static_assert(std::is_trivially_copyable_v<VertexRecord>);
+static_assert((std::uint64_t(c_max_cells_per_axis) * c_max_cells_per_axis * c_max_cells_per_axis) <= 0xffff);
+
+template <typename T>
+static std::vector<T> AsRecords(const std::vector<std::uint8_t>& bytes)
+{
+    std::vector<T> records(bytes.size() / sizeof(T));
+    std::memcpy(records.data(), bytes.data(), records.size() * sizeof(T));
+    return records;
+}
+
+std::uint64_t ChunkBuilder::SpillFile::write(const void* data, std::size_t bytes)
+{
+    const std::uint64_t offset = size;
+    file.seekp(std::streamoff(offset));
+    file.write(static_cast<const char*>(data), std::streamsize(bytes));
+    failed |= !file;
+    size += bytes;
+    return offset;
+}
+
+void ChunkBuilder::SpillFile::read(std::uint64_t offset, void* data, std::size_t bytes)
+{
+    file.seekg(std::streamoff(offset));
+    file.read(static_cast<char*>(data), std::streamsize(bytes));
+    failed |= !file;
+}
+
+void ChunkBuilder::Spill::init(SpillFile& spill_file, std::size_t keys_count, std::size_t buffers_limit)
+{
+    file = &spill_file;
+    buffers.resize(keys_count);
+    segments.resize(keys_count);
+    key_bytes.resize(keys_count, 0);
+    limit = buffers_limit;
+}
+
+void ChunkBuilder::Spill::append(std::size_t key, const void* data, std::size_t size)
+{
+    std::vector<std::uint8_t>& buffer = buffers[key];
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+    key_bytes[key] += size;
+    buffered += size;
+    if (buffered > limit)
+    {
+        flush();
+    }
+}
+
+void ChunkBuilder::Spill::flush()
+{
+    for (std::size_t key = 0; key < buffers.size(); ++key)
+    {
+        std::vector<std::uint8_t>& buffer = buffers[key];
+        if (buffer.empty())
+        {
+            continue;
+        }
+        segments[key].push_back(Segment{file->write(buffer.data(), buffer.size()), buffer.size()});
+        // Release the memory, not just the size.
+        std::vector<std::uint8_t>().swap(buffer);
+    }
+    buffered = 0;
+}
+
+std::vector<std::uint8_t> ChunkBuilder::Spill::read(std::size_t key)
+{
+    std::vector<std::uint8_t> bytes(std::size_t(key_bytes[key]));
+    std::size_t offset = 0;
+    for (const Segment& segment : segments[key])
+    {
+        file->read(segment.offset, bytes.data() + offset, std::size_t(segment.size));
+        offset += std::size_t(segment.size);
+    }
+    std::vector<std::uint8_t>& buffer = buffers[key];
+    std::memcpy(bytes.data() + offset, buffer.data(), buffer.size());
+    buffered -= buffer.size();
+    std::vector<std::uint8_t>().swap(buffer);
+    segments[key].clear();
+    key_bytes[key] = 0;
+    return bytes;
+}
+
+ChunkBuilder::ChunkBuilder() = default;
+
+ChunkBuilder::~ChunkBuilder()
+{
+    file_.file.close();
+    std::error_code ec;
+    (void)fs::remove(spill_path_, ec);
+}
+
+/*static*/ outcome::result<std::unique_ptr<ChunkBuilder>> ChunkBuilder::make(
+    const ChunkSettings& settings,
+    const fs::path& spill_path,
+    glm::vec3 aabb_min,
+    glm::vec3 aabb_max,
+    std::uint64_t vertices_count,
+    std::uint64_t triangles_count
+)
+{
+    if (vertices_count > std::uint64_t(Index(-1)))
+    {
+        return outcome::failure(std::errc::value_too_large);
+    }
+    const std::size_t cells_map_bytes = std::size_t(vertices_count) * sizeof(std::uint16_t);
+    if (cells_map_bytes >= (settings.memory_limit_bytes / 2))
+    {
+        return outcome::failure(std::errc::not_enough_memory);
+    }
+
+    std::unique_ptr<ChunkBuilder> builder(new ChunkBuilder());
+    builder->settings_ = settings;
+    builder->spill_path_ = spill_path;
+    builder->aabb_min_ = aabb_min;
+    builder->aabb_max_ = aabb_max;
+    builder->soup_ = (vertices_count == 0);
+    builder->vertices_count_ = vertices_count;
+
+    // Surface meshes occupy ~n^2 cells of the n^3 grid: aim for chunk_triangles per occupied cell.
+    const glm::vec3 extent = glm::max(aabb_max - aabb_min, glm::vec3(FLT_MIN));
+    const float max_extent = std::max({extent.x, extent.y, extent.z});
+    const double cells_per_axis = std::ceil(std::sqrt(double(triangles_count) / double(settings.chunk_triangles)));
+    const double n = std::clamp(cells_per_axis, 1.0, double(c_max_cells_per_axis));
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double cells = std::round(n * double(extent[axis]) / double(max_extent));
+        builder->dims_[axis] = std::uint32_t(std::clamp(cells, 1.0, double(c_max_cells_per_axis)));
+    }
+    const std::size_t cells_count = std::size_t(builder->dims_[0]) * builder->dims_[1] * builder->dims_[2];
+
+    builder->file_.file.open(spill_path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    if (!builder->file_.file)
+    {
+        return outcome::failure(std::errc::io_error);
+    }
+    // Half of what is left goes to the buffers; the other half is for the cell being written.
+    const std::size_t buffers_limit = std::max(
+        std::size_t(4) << 20, //
+        (settings.memory_limit_bytes - cells_map_bytes) / 2 / 3
+    );
+    builder->triangles_.init(builder->file_, cells_count, buffers_limit);
+    builder->vertices_.init(builder->file_, cells_count, buffers_limit);
+    const std::size_t buckets_count =
+        std::size_t((vertices_count + c_request_bucket_vertices - 1) / c_request_bucket_vertices);
+    builder->requests_.init(builder->file_, buckets_count, buffers_limit);
+    builder->vertex_cells_.resize(std::size_t(vertices_count), 0);
+    return outcome::success(std::move(builder));
+}
+
+std::uint32_t ChunkBuilder::cell_of(const glm::vec3& position) const
+{
+    const glm::vec3 extent = glm::max(aabb_max_ - aabb_min_, glm::vec3(FLT_MIN));
+    const glm::vec3 t = (position - aabb_min_) / extent;
+    std::uint32_t cell[3]{};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const float c = std::floor(t[axis] * float(dims_[axis]));
+        cell[axis] = std::uint32_t(std::clamp(c, 0.f, float(dims_[axis] - 1)));
+    }
+    return (cell[2] * dims_[1] + cell[1]) * dims_[0] + cell[0];
+}
+
+void ChunkBuilder::assign_vertices(std::uint64_t first, std::span<const Vertex> vertices)
+{
+    Panic(!soup_);
+    Panic((first + vertices.size()) <= vertices_count_);
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        vertex_cells_[std::size_t(first + i)] = std::uint16_t(cell_of(vertices[i].position));
+    }
+}
+
+bool ChunkBuilder::add_triangles(std::span<const Index> indices)
+{
+    Panic(!soup_);
+    for (std::size_t i = 0; (i + 3) <= indices.size(); i += 3)
+    {
+        const Index* triangle = &indices[i];
+        if ((triangle[0] >= vertices_count_) || (triangle[1] >= vertices_count_) || (triangle[2] >= vertices_count_))
+        {
+            return false;
+        }
+        const std::uint32_t cell = vertex_cells_[triangle[0]];
+        triangles_.append(cell, triangle, 3 * sizeof(Index));
+        for (std::size_t k = 1; k < 3; ++k)
+        {
+            if (vertex_cells_[triangle[k]] != cell)
+            {
+                const RequestRecord request{triangle[k], cell};
+                requests_.append(std::size_t(triangle[k] / c_request_bucket_vertices), &request, sizeof(request));
+            }
+        }
+    }
+    return true;
+}
+
+void ChunkBuilder::add_vertices(std::uint64_t first, std::span<const Vertex> vertices)
+{
+    Panic(!soup_);
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Index index = Index(first + i);
+        const std::size_t bucket = std::size_t(index / c_request_bucket_vertices);
+        if (bucket != loaded_bucket_)
+        {
+            // Vertices come in order: every range is loaded once.
+            loaded_requests_ = AsRecords<RequestRecord>(requests_.read(bucket));
+            auto less = [](const RequestRecord& lhs, const RequestRecord& rhs) {
+                return (lhs.vertex < rhs.vertex) || ((lhs.vertex == rhs.vertex) && (lhs.cell < rhs.cell));
+            };
+            auto equal = [](const RequestRecord& lhs, const RequestRecord& rhs) {
+                return (lhs.vertex == rhs.vertex) && (lhs.cell == rhs.cell);
+            };
+            // Border vertex is requested by every triangle of the other cell.
+            std::sort(loaded_requests_.begin(), loaded_requests_.end(), less);
+            loaded_requests_.erase(
+                std::unique(loaded_requests_.begin(), loaded_requests_.end(), equal),
+                loaded_requests_.end()
+            );
+            loaded_bucket_ = bucket;
+            request_cursor_ = 0;
+        }
+        const VertexRecord record{index, vertices[i]};
+        vertices_.append(vertex_cells_[index], &record, sizeof(record));
+        while ((request_cursor_ < loaded_requests_.size()) && (loaded_requests_[request_cursor_].vertex <= index))
+        {
+            const RequestRecord& request = loaded_requests_[request_cursor_++];
+            if (request.vertex == index)
+            {
+                vertices_.append(request.cell, &record, sizeof(record));
+            }
+        }
+    }
+}
+
+void ChunkBuilder::add_triangle_soup(std::span<const Vertex> vertices)
+{
+    Panic(soup_);
+    for (std::size_t i = 0; (i + 3) <= vertices.size(); i += 3)
+    {
+        triangles_.append(cell_of(vertices[i].position), &vertices[i], 3 * sizeof(Vertex));
+    }
+}
+
+// Chunk's vertices are the ones its triangles use, in the order of first use.
+static Mesh MakeChunkMesh(std::span<const Vertex> vertices, std::span<const Index> indices)
+{
+    Mesh mesh{};
+    mesh.vertices = vertices;
+    mesh.indices = indices;
+    mesh.texture_diffuse_id = c_no_texture;
+    mesh.texture_normal_id = c_no_texture;
+    mesh.aabb_min = glm::vec3(FLT_MAX);
+    mesh.aabb_max = glm::vec3(-FLT_MAX);
+    for (const Vertex& v : vertices)
+    {
+        mesh.aabb_min = glm::min(mesh.aabb_min, v.position);
+        mesh.aabb_max = glm::max(mesh.aabb_max, v.position);
+    }
+    return mesh;
+}
+
+outcome::result<ChunkStats> ChunkBuilder::finish(const fs::path& cache_path, const ModelCacheKey& key)
+{
+    const std::size_t triangle_size = 3 * (soup_ ? sizeof(Vertex) : sizeof(Index));
+    const std::uint64_t chunk_triangles = settings_.chunk_triangles;
+    ChunkStats stats{};
+    for (std::uint64_t bytes : triangles_.key_bytes)
+    {
+        const std::uint64_t triangles = (bytes / triangle_size);
+        stats.triangles += triangles;
+        stats.chunks += std::uint32_t((triangles + chunk_triangles - 1) / chunk_triangles);
+    }
+    if (stats.chunks == 0)
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+
+    auto writer = ModelCacheWriter::create(cache_path, key, stats.chunks, aabb_min_, aabb_max_);
+    if (!writer)
+    {
+        return outcome::failure(std::errc::io_error);
+    }
+
+    std::vector<Vertex> chunk_vertices;
+    std::vector<Index> chunk_indices;
+    for (std::size_t cell = 0, count = triangles_.key_bytes.size(); cell < count; ++cell)
+    {
+        if (triangles_.key_bytes[cell] == 0)
+        {
+            continue;
+        }
+        if (soup_)
+        {
+            const std::vector<Vertex> soup = AsRecords<Vertex>(triangles_.read(cell));
+            const std::size_t triangles_count = (soup.size() / 3);
+            for (std::size_t first = 0; first < triangles_count; first += std::size_t(chunk_triangles))
+            {
+                const std::size_t last = std::min(triangles_count, first + std::size_t(chunk_triangles));
+                const std::span<const Vertex> vertices(soup.data() + first * 3, (last - first) * 3);
+                chunk_indices.resize(vertices.size());
+                for (std::size_t i = 0; i < chunk_indices.size(); ++i)
+                {
+                    chunk_indices[i] = Index(i);
+                }
+                stats.vertices += vertices.size();
+                if (!writer->append(MakeChunkMesh(vertices, chunk_indices)))
+                {
+                    return outcome::failure(std::errc::io_error);
+                }
+            }
+            continue;
+        }
+
+        const std::vector<Index> triangles = AsRecords<Index>(triangles_.read(cell));
+        std::vector<VertexRecord> records = AsRecords<VertexRecord>(vertices_.read(cell));
+        std::sort(records.begin(), records.end(), [](const VertexRecord& lhs, const VertexRecord& rhs) {
+            return (lhs.index < rhs.index);
+        });
+        auto find_local = [&](Index index) {
+            auto it = std::lower_bound(records.begin(), records.end(), index, [](const VertexRecord& r, Index i) {
+                return (r.index < i);
+            });
+            Panic((it != records.end()) && (it->index == index));
+            return std::size_t(it - records.begin());
+        };
+        std::vector<Index> remap(records.size(), Index(-1));
+        const std::size_t triangles_count = (triangles.size() / 3);
+        for (std::size_t first = 0; first < triangles_count; first += std::size_t(chunk_triangles))
+        {
+            const std::size_t last = std::min(triangles_count, first + std::size_t(chunk_triangles));
+            chunk_vertices.clear();
+            chunk_indices.clear();
+            std::fill(remap.begin(), remap.end(), Index(-1));
+            for (std::size_t i = first * 3; i < last * 3; ++i)
+            {
+                const std::size_t local = find_local(triangles[i]);
+                if (remap[local] == Index(-1))
+                {
+                    remap[local] = Index(chunk_vertices.size());
+                    chunk_vertices.push_back(records[local].vertex);
+                }
+                chunk_indices.push_back(remap[local]);
+            }
+            stats.vertices += chunk_vertices.size();
+            if (!writer->append(MakeChunkMesh(chunk_vertices, chunk_indices)))
+            {
+                return outcome::failure(std::errc::io_error);
+            }
+        }
+    }
+    if (file_.failed)
+    {
+        return outcome::failure(std::errc::io_error);
+    }
+    stats.spilled_bytes = file_.size;
+    if (!writer->finish())
+    {
+        return outcome::failure(std::errc::io_error);
+    }
+    return outcome::success(stats);
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "model_cache.h"
+#include "utils_outcome.h"
+#include "vertex.h"
+
+#include <glm/vec3.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+// Out-of-core import of models larger than memory (see LoadModel()).
+// The source is streamed in batches (see Ply_ImportChunked()); triangles are
+// partitioned by a grid over the model bounds (cell of the first vertex) and
+// every cell is written as one or more meshes (chunks) of up to chunk_triangles
+// into the model cache, mapped on load. Records of not yet finished cells are
+// kept in bounded buffers and spilled to a temporary file next to the cache.
+// Memory: spill buffers + 2 bytes per source vertex (indexed sources) + one cell.
+
+struct ChunkSettings
+{
+    std::size_t memory_limit_bytes = (std::size_t(512) << 20);
+    std::uint32_t chunk_triangles = (64 * 1024);
+};
+
+struct ChunkStats
+{
+    std::uint32_t chunks = 0;
+    std::uint64_t triangles = 0;
+    std::uint64_t vertices = 0; // written; shared by triangles of the same chunk
+    std::uint64_t spilled_bytes = 0;
+};
+
+struct ChunkBuilder
+{
+    // Indexed sources pass vertices_count; triangle soups (STL) pass 0.
+    // triangles_count may be an estimate (polygons); it only sizes the grid.
+    static outcome::result<std::unique_ptr<ChunkBuilder>> make(
+        const ChunkSettings& settings,
+        const std::filesystem::path& spill_path,
+        glm::vec3 aabb_min,
+        glm::vec3 aabb_max,
+        std::uint64_t vertices_count,
+        std::uint64_t triangles_count
+    );
+
+    // Indexed source, in this order:
+    // 1. all vertices (first - index of vertices[0]), only positions are used;
+    void assign_vertices(std::uint64_t first, std::span<const Vertex> vertices);
+    // 2. triangles, 3 indices each; false if an index is out of range;
+    bool add_triangles(std::span<const Index> indices);
+    // 3. all vertices again.
+    void add_vertices(std::uint64_t first, std::span<const Vertex> vertices);
+
+    // Triangle soup: 3 vertices per triangle, single pass.
+    void add_triangle_soup(std::span<const Vertex> vertices);
+
+    // Writes chunks into the model cache, cell by cell.
+    outcome::result<ChunkStats> finish(const std::filesystem::path& cache_path, const ModelCacheKey& key);
+
+    ~ChunkBuilder();
+    ChunkBuilder(const ChunkBuilder&) = delete;
+    ChunkBuilder& operator=(const ChunkBuilder&) = delete;
+
+private:
+    struct SpillFile
+    {
+        std::fstream file;
+        std::uint64_t size = 0;
+        bool failed = false;
+
+        std::uint64_t write(const void* data, std::size_t bytes);
+        void read(std::uint64_t offset, void* data, std::size_t bytes);
+    };
+
+    // Records appended per key (grid cell, vertex range) are buffered and written
+    // to the shared file in segments once all buffers exceed the limit.
+    struct Spill
+    {
+        struct Segment
+        {
+            std::uint64_t offset;
+            std::uint64_t size;
+        };
+
+        SpillFile* file = nullptr;
+        std::vector<std::vector<std::uint8_t>> buffers;
+        std::vector<std::vector<Segment>> segments;
+        std::vector<std::uint64_t> key_bytes; // total, buffered & spilled
+        std::size_t buffered = 0;
+        std::size_t limit = 0;
+
+        void init(SpillFile& spill_file, std::size_t keys_count, std::size_t buffers_limit);
+        void append(std::size_t key, const void* data, std::size_t size);
+        std::vector<std::uint8_t> read(std::size_t key);
+        void flush();
+    };
+
+    struct RequestRecord
+    {
+        std::uint32_t vertex;
+        std::uint32_t cell;
+    };
+
+    ChunkBuilder();
+    std::uint32_t cell_of(const glm::vec3& position) const;
+
+private:
+    ChunkSettings settings_;
+    std::filesystem::path spill_path_;
+    SpillFile file_;
+
+    glm::vec3 aabb_min_{};
+    glm::vec3 aabb_max_{};
+    std::uint32_t dims_[3]{1, 1, 1};
+    bool soup_ = false;
+    std::uint64_t vertices_count_ = 0;
+
+    // Indexed: cell of every vertex. Triangles on a cell border use vertices of
+    // other cells; those are requested per vertex range and routed in pass 3.
+    std::vector<std::uint16_t> vertex_cells_;
+    Spill triangles_; // per cell: 3 x Index, or 3 x Vertex for soups
+    Spill vertices_;  // per cell: index + Vertex
+    Spill requests_;  // per vertex range: RequestRecord
+    std::vector<RequestRecord> loaded_requests_;
+    std::size_t loaded_bucket_ = std::size_t(-1);
+    std::size_t request_cursor_ = 0;
+};
@@ -0,0 +1,137 @@
+#include "model_residency.h"
+#include "utils.h"
+#include "utils_log.h"
+
+#include <algorithm>
+#include <iterator>
+
+static constexpr double c_mb = double(1 << 20);
+
+void ModelResidency::touch(const std::string& file_name)
+{
+    entries_[file_name].last_used = ++clock_;
+}
+
+void ModelResidency::on_loaded(const FileModel& model, double load_ms)
+{
+    Entry& e = entries_[model.file_name];
+    e.last_used = ++clock_;
+    const ModelMemory memory = model.model.memory();
+    e.cpu_bytes = memory.owned_bytes;
+    e.cpu_mapped_bytes = memory.mapped_bytes;
+    if (e.evicted)
+    {
+        e.evicted = false;
+        ++stats_.reloads;
+        stats_.reloads_ms += load_ms;
+        LogDebug("[residency] '%s': reloaded, %.2f ms.\n", model.file_name.c_str(), load_ms);
+    }
+}
+
+void ModelResidency::keep(const std::string& file_name, RenderModel&& model)
+{
+    Entry& e = entries_[file_name];
+    e.gpu_bytes = model.memory_bytes();
+    e.gpu = std::move(model);
+}
+
+bool ModelResidency::take(const std::string& file_name, RenderModel& model)
+{
+    auto it = entries_.find(file_name);
+    if ((it == entries_.end()) || (it->second.gpu_bytes == 0))
+    {
+        return false;
+    }
+    model = std::move(it->second.gpu);
+    it->second.gpu = RenderModel{};
+    it->second.gpu_bytes = 0;
+    return true;
+}
+
+void ModelResidency::forget(const std::string& file_name)
+{
+    (void)entries_.erase(file_name);
+}
+
+const ResidencyStats& ModelResidency::stats() const
+{
+    return stats_;
+}
+
+void ModelResidency::trim(
+    std::vector<FileModel>& models,
+    const std::string& selected,
+    const std::string& active,
+    std::size_t active_gpu_bytes
+)
+{
+    stats_.cpu_bytes = 0;
+    stats_.cpu_mapped_bytes = 0;
+    stats_.gpu_bytes = active_gpu_bytes;
+    stats_.cpu_models = 0;
+    stats_.gpu_models = 0;
+    for (const auto& [file_name, e] : entries_)
+    {
+        stats_.cpu_bytes += e.cpu_bytes;
+        stats_.cpu_mapped_bytes += e.cpu_mapped_bytes;
+        stats_.gpu_bytes += e.gpu_bytes;
+        stats_.cpu_models += (((e.cpu_bytes > 0) || (e.cpu_mapped_bytes > 0)) ? 1u : 0u);
+        stats_.gpu_models += ((e.gpu_bytes > 0) ? 1u : 0u);
+    }
+
+    // Least recently used entry that has something to evict.
+    auto find_lru = [&](std::size_t Entry::*bytes) {
+        auto lru = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (((it->second).*bytes == 0) || (it->first == selected) || (it->first == active))
+            {
+                continue;
+            }
+            if ((lru == entries_.end()) || (it->second.last_used < lru->second.last_used))
+            {
+                lru = it;
+            }
+        }
+        return lru;
+    };
+
+    while (stats_.cpu_bytes > cpu_budget_bytes)
+    {
+        auto lru = find_lru(&Entry::cpu_bytes);
+        if (lru == entries_.end())
+        {
+            break;
+        }
+        auto fm = std::find_if(std::begin(models), std::end(models), [&](const FileModel& m) {
+            return (m.file_name == lru->first);
+        });
+        Panic(fm != std::end(models));
+        fm->model = Model();
+        Entry& e = lru->second;
+        LogDebug("[residency] '%s': CPU data evicted, %.2f MB.\n", lru->first.c_str(), double(e.cpu_bytes) / c_mb);
+        stats_.cpu_bytes -= e.cpu_bytes;
+        stats_.cpu_mapped_bytes -= e.cpu_mapped_bytes;
+        --stats_.cpu_models;
+        ++stats_.cpu_evictions;
+        e.cpu_bytes = 0;
+        e.cpu_mapped_bytes = 0;
+        e.evicted = true;
+    }
+
+    while (stats_.gpu_bytes > gpu_budget_bytes)
+    {
+        auto lru = find_lru(&Entry::gpu_bytes);
+        if (lru == entries_.end())
+        {
+            break;
+        }
+        Entry& e = lru->second;
+        LogDebug("[residency] '%s': GPU resources evicted, %.2f MB.\n", lru->first.c_str(), double(e.gpu_bytes) / c_mb);
+        stats_.gpu_bytes -= e.gpu_bytes;
+        --stats_.gpu_models;
+        ++stats_.gpu_evictions;
+        e.gpu = RenderModel{};
+        e.gpu_bytes = 0;
+    }
+}
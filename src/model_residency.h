@@ -0,0 +1,67 @@
+#pragma once
+#include "model.h"
+#include "render_model.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+struct ResidencyStats
+{
+    std::size_t cpu_bytes = 0;        // owned (see ModelMemory), against the budget
+    std::size_t cpu_mapped_bytes = 0; // not committed memory
+    std::size_t gpu_bytes = 0; // kept + active model
+    std::uint32_t cpu_models = 0;
+    std::uint32_t gpu_models = 0; // kept, not active
+    std::uint32_t cpu_evictions = 0;
+    std::uint32_t gpu_evictions = 0;
+    std::uint32_t reloads = 0; // loads of evicted models
+    double reloads_ms = 0.0;
+};
+
+// Keeps loaded catalog models within CPU & GPU byte budgets. Evicts the least
+// recently selected ones first: FileModel data (loaded again on select, see
+// ModelLoader) and GPU resources of not active models, kept to switch back
+// to them without an upload. Frame thread only.
+struct ModelResidency
+{
+    std::size_t cpu_budget_bytes = (std::size_t(2048) << 20);
+    std::size_t gpu_budget_bytes = (std::size_t(1024) << 20);
+
+    // Selected entry becomes the most recently used one.
+    void touch(const std::string& file_name);
+    void on_loaded(const FileModel& model, double load_ms);
+    // GPU resources of the fully uploaded model that is not active anymore.
+    void keep(const std::string& file_name, RenderModel&& model);
+    // Takes kept GPU resources back, if any.
+    bool take(const std::string& file_name, RenderModel& model);
+    // Changed file; its model was dropped.
+    void forget(const std::string& file_name);
+    // Evicts to fit the budgets; never evicts selected & active entries.
+    void trim(
+        std::vector<FileModel>& models,
+        const std::string& selected,
+        const std::string& active,
+        std::size_t active_gpu_bytes
+    );
+
+    const ResidencyStats& stats() const;
+
+private:
+    struct Entry
+    {
+        std::uint64_t last_used = 0;
+        std::size_t cpu_bytes = 0;        // 0 when data is not loaded
+        std::size_t cpu_mapped_bytes = 0; // 0 when data is not loaded
+        bool evicted = false;             // next load is a reload
+        RenderModel gpu{};
+        std::size_t gpu_bytes = 0; // 0 when GPU resources are not kept
+    };
+
+    std::uint64_t clock_ = 0;
+    std::unordered_map<std::string, Entry> entries_;
+    ResidencyStats stats_;
+};
@@ -0,0 +1,749 @@
+#include "model_streaming.h"
+#include "package.h"
+#include "texture_bc.h"
+#include "texture_mips.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "utils_log.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iterator>
+
+// Pieces/models in flight; producer waits when the frame thread lags behind.
+static constexpr std::size_t c_queue_capacity = 64;
+static constexpr auto c_producer_backoff = std::chrono::milliseconds(1);
+
+template <typename T>
+static void RemoveDuplicates(std::vector<T>& es)
+{
+    std::sort(std::begin(es), std::end(es));
+    auto it = std::unique(std::begin(es), std::end(es));
+    es.erase(it, std::end(es));
+}
+
+static std::string GetPathFileName(const std::string& path)
+{
+    auto name = std::filesystem::path(path).stem();
+    while (name.has_extension())
+    {
+        auto next = name.stem();
+        if (next == name)
+        {
+            break;
+        }
+        name = std::move(next);
+    }
+    return name.string();
+}
+
+// Dropped files and everything next to them; dropped folders recursively;
+// model files inside of packages.
+static std::vector<std::string> CollectModelFiles(std::vector<std::string> paths)
+{
+    std::vector<std::string> folders;
+    std::vector<std::string> files;
+    for (std::string& p : paths)
+    {
+        std::error_code ec;
+        std::filesystem::path path(p);
+        if (std::filesystem::is_directory(path, ec))
+        {
+            folders.push_back(std::move(p));
+        }
+        else if (std::filesystem::is_regular_file(path, ec))
+        {
+            files.push_back(path.make_preferred().string());
+            // We also want to get all files in the same directory.
+            folders.push_back(path.parent_path().make_preferred().string());
+        }
+        Panic(!ec);
+    }
+    RemoveDuplicates(folders);
+    // Collect all files in a folder.
+    for (std::string& f : folders)
+    {
+        for (const auto& e : std::filesystem::recursive_directory_iterator(f))
+        {
+            if (e.is_regular_file())
+            {
+                auto path = e.path();
+                files.push_back(path.make_preferred().string());
+            }
+        }
+    }
+    // Packages are listed by their files.
+    const std::size_t disk_files_count = files.size();
+    for (std::size_t i = 0; i < disk_files_count; ++i)
+    {
+        if (!IsPackageFile(files[i]))
+        {
+            continue;
+        }
+        auto maybe_package = Package_Open(files[i]);
+        if (!maybe_package)
+        {
+            LogDebug("[catalog] '%s': not a package.\n", files[i].c_str());
+            continue;
+        }
+        for (const PackageEntry& entry : maybe_package.value()->entries)
+        {
+            files.push_back(Package_MakePath(files[i], entry.path));
+        }
+    }
+    RemoveDuplicates(files);
+    files.erase(
+        std::remove_if(std::begin(files), std::end(files), [](const std::string& f) { return !IsModelFile(f); }),
+        std::end(files)
+    );
+    return files;
+}
+
+/*explicit*/ ModelListJob::ModelListJob(FileIndex& index)
+    : index_(index),
+      queue_(c_queue_capacity)
+{
+}
+
+/*static*/ std::unique_ptr<ModelListJob> ModelListJob::start(std::vector<std::string> paths, FileIndex& index)
+{
+    std::unique_ptr<ModelListJob> job(new ModelListJob(index));
+    job->thread_ = std::thread([job_ptr = job.get(), paths = std::move(paths)]() mutable {
+        job_ptr->run(std::move(paths));
+    });
+    return job;
+}
+
+ModelListJob::~ModelListJob()
+{
+    cancel();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+bool ModelListJob::try_pop(CatalogFile& file)
+{
+    return queue_.try_pop(file);
+}
+
+bool ModelListJob::finished() const
+{
+    return finished_.load();
+}
+
+void ModelListJob::cancel()
+{
+    cancel_.store(true);
+}
+
+std::uint32_t ModelListJob::files_total() const
+{
+    return files_total_.load();
+}
+
+std::uint32_t ModelListJob::files_done() const
+{
+    return files_done_.load();
+}
+
+void ModelListJob::run(std::vector<std::string> paths)
+{
+    const StopWatch timer;
+    const std::vector<std::string> files = CollectModelFiles(std::move(paths));
+    files_total_.store(std::uint32_t(files.size()));
+
+    // check() may hash file contents; it's const, so run in parallel.
+    std::vector<FileStamp> stamps(files.size());
+    std::vector<std::uint8_t> changed(files.size());
+    GlobalThreadPool().parallel_for(files.size(), [&](std::size_t i) {
+        if (cancel_.load())
+        {
+            return;
+        }
+        bool file_changed = true;
+        stamps[i] = index_.check(files[i], file_changed);
+        changed[i] = (file_changed ? 1 : 0);
+        files_done_.fetch_add(1);
+    });
+
+    std::uint32_t listed = 0;
+    std::uint32_t unchanged = 0;
+    for (std::size_t i = 0, count = files.size(); (i < count) && !cancel_.load(); ++i)
+    {
+        CatalogFile file;
+        file.file_name = files[i];
+        file.name = GetPathFileName(file.file_name);
+        file.changed = (changed[i] != 0);
+        bool pushed = queue_.try_push(file);
+        while (!pushed && !cancel_.load())
+        {
+            std::this_thread::sleep_for(c_producer_backoff);
+            pushed = queue_.try_push(file);
+        }
+        if (!pushed)
+        {
+            break;
+        }
+        // Listed entries of changed files get their old model dropped,
+        // so the stamp describes what will be loaded next time.
+        index_.record(files[i], stamps[i]);
+        ++listed;
+        unchanged += (changed[i] ? 0u : 1u);
+    }
+
+    (void)index_.save();
+    LogDebug(
+        "[catalog] %u of %u files listed%s, %u unchanged: %.2f ms.\n",
+        listed,
+        unsigned(files.size()),
+        cancel_.load() ? " (canceled)" : "",
+        unchanged,
+        timer.elapsed_ms()
+    );
+    finished_.store(true);
+}
+
+ModelLoader::~ModelLoader()
+{
+    // Tasks own what they use; just tell them not to bother.
+    for (Pending& p : pending_)
+    {
+        p.wanted->store(false);
+    }
+}
+
+void ModelLoader::start(const std::string& file_name, bool prefetch)
+{
+    Pending& p = pending_.emplace_back();
+    p.file_name = file_name;
+    p.prefetch = prefetch;
+    p.wanted = std::make_shared<std::atomic<bool>>(true);
+    p.result = GlobalThreadPool().submit([file_name, wanted = p.wanted]() -> Result {
+        if (!wanted->load())
+        {
+            return Result{outcome::failure(std::errc::operation_canceled), 0.0};
+        }
+        const StopWatch timer;
+        outcome::result<Model> model = LoadModel(file_name.c_str());
+        return Result{std::move(model), timer.elapsed_ms()};
+    });
+}
+
+bool ModelLoader::is_loading(const std::string& file_name) const
+{
+    return std::any_of(std::cbegin(pending_), std::cend(pending_), [&](const Pending& p) {
+        return (p.file_name == file_name);
+    });
+}
+
+void ModelLoader::request(const std::vector<FileModel>& models, std::size_t index, bool load_selected)
+{
+    Panic(index < models.size());
+    // Selected first (the pool is FIFO), then neighbors;
+    // index - 1 wraps around for the first entry and is skipped.
+    const std::size_t wanted[] = {index, index - 1, index + 1};
+    auto is_wanted = [&](const std::string& file_name) {
+        return std::any_of(std::begin(wanted), std::end(wanted), [&](std::size_t i) {
+            return (i < models.size()) && (models[i].file_name == file_name);
+        });
+    };
+    // Not yet started loads the user has browsed past are skipped.
+    for (Pending& p : pending_)
+    {
+        p.wanted->store(is_wanted(p.file_name));
+    }
+    for (std::size_t k = 0; k < std::size(wanted); ++k)
+    {
+        const std::size_t i = wanted[k];
+        if ((k == 0) && !load_selected)
+        {
+            continue;
+        }
+        if ((i < models.size()) && !models[i].model.is_loaded() && !is_loading(models[i].file_name))
+        {
+            start(models[i].file_name, (k > 0));
+        }
+    }
+}
+
+std::vector<ModelLoader::Loaded> ModelLoader::collect(std::vector<FileModel>& models)
+{
+    std::vector<Loaded> loaded;
+    for (auto it = pending_.begin(); it != pending_.end();)
+    {
+        if (it->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+        Result result = it->result.get();
+        if (result.model)
+        {
+            for (std::size_t i = 0, count = models.size(); i < count; ++i)
+            {
+                FileModel& fm = models[i];
+                if ((fm.file_name == it->file_name) && !fm.model.is_loaded())
+                {
+                    fm.model = std::move(result.model.value());
+                    loaded.push_back(Loaded{i, result.load_ms});
+                    LogDebug("[catalog] '%s': loaded%s.\n", it->file_name.c_str(), it->prefetch ? " (prefetch)" : "");
+                    break;
+                }
+            }
+        }
+        it = pending_.erase(it);
+    }
+    return loaded;
+}
+
+ModelUploadJob::ModelUploadJob()
+    : queue_(c_queue_capacity)
+{
+}
+
+/*static*/ std::unique_ptr<ModelUploadJob> ModelUploadJob::start(
+    ID3D11Device& device,
+    const Model& model,
+    bool with_textures,
+    bool pack_vertices
+)
+{
+    std::unique_ptr<ModelUploadJob> job(new ModelUploadJob());
+    job->device_ = &device;
+    job->pack_vertices_ = pack_vertices;
+    // Mesh/Texture are views into the model's data, cheap to gather here.
+    for (std::uint32_t i = 0, count = model.meshes_count(); i < count; ++i)
+    {
+        job->meshes_.push_back(model.get_mesh(i));
+    }
+    for (std::uint32_t i = 0, count = (with_textures ? model.textures_count() : 0u); i < count; ++i)
+    {
+        job->textures_.push_back(model.get_texture(i));
+    }
+    job->thread_ = std::thread([job_ptr = job.get()]() { job_ptr->run(); });
+    return job;
+}
+
+ModelUploadJob::~ModelUploadJob()
+{
+    cancel_.store(true);
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+std::uint32_t ModelUploadJob::pieces_total() const
+{
+    return std::uint32_t(meshes_.size() + textures_.size());
+}
+
+std::uint32_t ModelUploadJob::pieces_done() const
+{
+    return pieces_done_.load();
+}
+
+bool ModelUploadJob::push(Piece& piece)
+{
+    while (!queue_.try_push(piece))
+    {
+        if (cancel_.load())
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(c_producer_backoff);
+    }
+    pieces_done_.fetch_add(1);
+    return true;
+}
+
+void ModelUploadJob::run()
+{
+    // Geometry first: shaded without textures until they arrive.
+    for (const Mesh& mesh : meshes_)
+    {
+        if (cancel_.load())
+        {
+            return;
+        }
+        Piece piece;
+        piece.mesh = RenderMesh::make(*device_.Get(), mesh, pack_vertices_);
+        if (!push(piece))
+        {
+            return;
+        }
+    }
+    for (const Texture& texture : textures_)
+    {
+        if (cancel_.load())
+        {
+            return;
+        }
+        Piece piece;
+        piece.texture = RenderTexture::make(*device_.Get(), texture);
+        piece.is_texture = true;
+        if (!push(piece))
+        {
+            return;
+        }
+    }
+}
+
+bool ModelUploadJob::drain(RenderModel& model)
+{
+    Piece piece;
+    while (queue_.try_pop(piece))
+    {
+        if (piece.is_texture)
+        {
+            model.textures.push_back(std::move(piece.texture));
+        }
+        else
+        {
+            model.meshes.push_back(std::move(piece.mesh));
+        }
+        ++pieces_received_;
+    }
+    return (pieces_received_ == pieces_total());
+}
+
+static std::size_t MeshBytes(const Mesh& mesh)
+{
+    return (mesh.vertices.size_bytes() + mesh.indices.size_bytes());
+}
+
+bool ModelChunkPager::is_needed(const Model& model) const
+{
+    return (model.meshes_count() > 1) && (model.memory().data_bytes() > gpu_budget_bytes);
+}
+
+void ModelChunkPager::start(ID3D11Device& device, const Model& model, RenderModel& render, bool with_textures)
+{
+    reset();
+    active_ = true;
+    const std::uint32_t meshes_count = model.meshes_count();
+    distances_.resize(meshes_count);
+    order_.resize(meshes_count);
+    wanted_.assign(meshes_count, false);
+    resident_.assign(meshes_count, false);
+    stats_.total_chunks = meshes_count;
+    for (std::uint32_t i = 0, count = (with_textures ? model.textures_count() : 0u); i < count; ++i)
+    {
+        render.textures.push_back(RenderTexture::make(device, model.get_texture(i)));
+    }
+}
+
+void ModelChunkPager::reset()
+{
+    active_ = false;
+    distances_.clear();
+    order_.clear();
+    wanted_.clear();
+    resident_.clear();
+    render_meshes_.clear();
+    stats_ = {};
+}
+
+bool ModelChunkPager::is_active() const
+{
+    return active_;
+}
+
+bool ModelTextureStreamer::is_settled() const
+{
+    if (!active_ || !ticked_)
+    {
+        return false;
+    }
+    // Uploads are done by tick() itself, none is in flight.
+    return std::all_of(textures_.begin(), textures_.end(), [](const Streamed& streamed) {
+        return (streamed.resident == streamed.wanted);
+    });
+}
+
+void ModelChunkPager::tick(
+    ID3D11Device& device,
+    const Model& model,
+    RenderModel& render,
+    const glm::vec3& camera_position
+)
+{
+    if (!active_)
+    {
+        return;
+    }
+    // Chunk bounds are in model space.
+    const glm::vec3 camera = glm::vec3(glm::inverse(render.world) * glm::vec4(camera_position, 1.f));
+    const std::uint32_t meshes_count = std::uint32_t(order_.size());
+    for (std::uint32_t i = 0; i < meshes_count; ++i)
+    {
+        const Mesh mesh = model.get_mesh(i);
+        distances_[i] = glm::distance(glm::clamp(camera, mesh.aabb_min, mesh.aabb_max), camera);
+        order_[i] = i;
+    }
+    std::sort(order_.begin(), order_.end(), [&](std::uint32_t lhs, std::uint32_t rhs) {
+        return (distances_[lhs] < distances_[rhs]);
+    });
+
+    // Nearest chunks that fit the budget (at least one).
+    std::size_t wanted_bytes = 0;
+    std::fill(wanted_.begin(), wanted_.end(), false);
+    for (std::uint32_t i : order_)
+    {
+        const std::size_t bytes = MeshBytes(model.get_mesh(i));
+        if ((wanted_bytes > 0) && ((wanted_bytes + bytes) > gpu_budget_bytes))
+        {
+            break;
+        }
+        wanted_bytes += bytes;
+        wanted_[i] = true;
+    }
+
+    // Release first, so uploads stay within the budget.
+    for (std::size_t k = render_meshes_.size(); k-- > 0;)
+    {
+        const std::uint32_t i = render_meshes_[k];
+        if (wanted_[i])
+        {
+            continue;
+        }
+        stats_.resident_bytes -= render.meshes[k].memory_bytes;
+        render.meshes[k] = std::move(render.meshes.back());
+        render.meshes.pop_back();
+        render_meshes_[k] = render_meshes_.back();
+        render_meshes_.pop_back();
+        resident_[i] = false;
+        ++stats_.evictions;
+    }
+
+    std::uint32_t uploads = 0;
+    for (std::uint32_t i : order_)
+    {
+        if (!wanted_[i] || (uploads >= uploads_per_tick))
+        {
+            break;
+        }
+        if (resident_[i])
+        {
+            continue;
+        }
+        RenderMesh mesh = RenderMesh::make(device, model.get_mesh(i), render.pack_vertices_);
+        stats_.resident_bytes += mesh.memory_bytes;
+        render.meshes.push_back(std::move(mesh));
+        render_meshes_.push_back(i);
+        resident_[i] = true;
+        ++uploads;
+    }
+    stats_.uploads += uploads;
+    stats_.resident_chunks = std::uint32_t(render_meshes_.size());
+}
+
+const ChunkPagerStats& ModelChunkPager::stats() const
+{
+    return stats_;
+}
+
+// Block formats need the first level of the tail to be a multiple of 4.
+static std::uint32_t CoarsestTailLevel(const Texture& texture)
+{
+    std::uint32_t level = 0;
+    while ((level + 1) < texture.mips_count)
+    {
+        const std::uint32_t width = TextureMips_LevelSize(texture.width, level + 1);
+        const std::uint32_t height = TextureMips_LevelSize(texture.height, level + 1);
+        if (TextureBC_IsCompressed(texture.format) && (((width % 4) != 0) || ((height % 4) != 0)))
+        {
+            break;
+        }
+        ++level;
+    }
+    return level;
+}
+
+static std::size_t TailBytes(const Texture& texture, std::uint32_t first_level)
+{
+    return TextureMips_ChainBytes(texture.format, texture.width, texture.height, texture.mips_count)
+           - TextureMips_LevelOffset(texture.format, texture.width, texture.height, first_level);
+}
+
+bool ModelTextureStreamer::is_needed(const Model& model) const
+{
+    std::size_t bytes = 0;
+    for (std::uint32_t i = 0, count = model.textures_count(); i < count; ++i)
+    {
+        bytes += model.get_texture(i).data.size();
+    }
+    return (bytes >= min_stream_bytes);
+}
+
+void ModelTextureStreamer::start(ID3D11Device& device, const Model& model, RenderModel& render)
+{
+    reset();
+    active_ = true;
+    const std::uint32_t textures_count = model.textures_count();
+    textures_.resize(textures_count);
+    demand_.resize(textures_count);
+    stats_.textures = textures_count;
+    for (std::uint32_t i = 0; i < textures_count; ++i)
+    {
+        const Texture texture = model.get_texture(i);
+        Streamed& streamed = textures_[i];
+        streamed.coarsest = CoarsestTailLevel(texture);
+        streamed.resident = streamed.coarsest;
+        streamed.wanted = streamed.coarsest;
+        streamed.render_index = render.textures.size();
+        RenderTexture render_texture = RenderTexture::make(device, TextureMips_Tail(texture, streamed.resident));
+        stats_.resident_bytes += render_texture.memory_bytes;
+        stats_.full_bytes += texture.data.size();
+        render.textures.push_back(std::move(render_texture));
+    }
+}
+
+void ModelTextureStreamer::reset()
+{
+    active_ = false;
+    ticked_ = false;
+    textures_.clear();
+    demand_.clear();
+    stats_ = {};
+}
+
+bool ModelTextureStreamer::is_active() const
+{
+    return active_;
+}
+
+void ModelTextureStreamer::tick(
+    ID3D11Device& device,
+    const Model& model,
+    RenderModel& render,
+    const glm::vec3& camera_position,
+    float fov_y,
+    float viewport_height
+)
+{
+    if (!active_)
+    {
+        return;
+    }
+    // Screen-space demand: on-screen diameter of the bounds of every mesh, in pixels,
+    // assuming its UVs span the texture once. Ratio of sizes, so model space will do.
+    const glm::vec3 camera = glm::vec3(glm::inverse(render.world) * glm::vec4(camera_position, 1.f));
+    // Diameter 2r at distance d is (r / d) / tan(fov / 2) of the viewport height.
+    const float focal_pixels = viewport_height / std::max(std::tan(fov_y * 0.5f), 1e-3f);
+    std::fill(demand_.begin(), demand_.end(), 0.f);
+    for (std::uint32_t i = 0, count = model.meshes_count(); i < count; ++i)
+    {
+        const Mesh mesh = model.get_mesh(i);
+        const float radius = glm::distance(mesh.aabb_min, mesh.aabb_max) * 0.5f;
+        const float distance = glm::distance(glm::clamp(camera, mesh.aabb_min, mesh.aabb_max), camera);
+        const float pixels = focal_pixels * radius / std::max(distance, 1e-3f);
+        for (std::uint32_t id : {mesh.texture_diffuse_id, mesh.texture_normal_id})
+        {
+            if (id < demand_.size())
+            {
+                demand_[id] = std::max(demand_[id], pixels);
+            }
+        }
+    }
+
+    // Finest useful level: a texel of it covers at least a pixel.
+    stats_.requested_bytes = 0;
+    for (std::uint32_t i = 0; i < textures_.size(); ++i)
+    {
+        const Texture texture = model.get_texture(i);
+        Streamed& streamed = textures_[i];
+        const float size = float(std::max(texture.width, texture.height));
+        const float level = std::floor(std::log2(size / std::max(demand_[i], 1.f)));
+        streamed.wanted = std::min(streamed.coarsest, std::uint32_t(std::max(level, 0.f)));
+        stats_.requested_bytes += TailBytes(texture, streamed.wanted);
+    }
+    std::size_t wanted_bytes = stats_.requested_bytes;
+    // Over the budget: the largest finest levels go first.
+    while (wanted_bytes > gpu_budget_bytes)
+    {
+        std::size_t best = textures_.size();
+        std::size_t best_bytes = 0;
+        for (std::size_t i = 0; i < textures_.size(); ++i)
+        {
+            const Streamed& streamed = textures_[i];
+            if (streamed.wanted >= streamed.coarsest)
+            {
+                continue;
+            }
+            const Texture texture = model.get_texture(std::uint32_t(i));
+            const std::size_t bytes =
+                TextureMips_LevelBytes(texture.format, texture.width, texture.height, streamed.wanted);
+            if (bytes > best_bytes)
+            {
+                best = i;
+                best_bytes = bytes;
+            }
+        }
+        if (best == textures_.size())
+        {
+            break; // coarsest levels only
+        }
+        ++textures_[best].wanted;
+        wanted_bytes -= best_bytes;
+    }
+    stats_.wanted_bytes = wanted_bytes;
+    ticked_ = true;
+
+    auto upload = [&](std::uint32_t i, std::uint32_t first_level) {
+        Streamed& streamed = textures_[i];
+        RenderTexture& render_texture = render.textures[streamed.render_index];
+        RenderTexture next = RenderTexture::make(device, TextureMips_Tail(model.get_texture(i), first_level));
+        stats_.resident_bytes = stats_.resident_bytes - render_texture.memory_bytes + next.memory_bytes;
+        render_texture = std::move(next);
+        streamed.resident = first_level;
+    };
+    // Release first, so uploads stay within the budget.
+    for (std::uint32_t i = 0; i < textures_.size(); ++i)
+    {
+        if (textures_[i].resident < textures_[i].wanted)
+        {
+            upload(i, textures_[i].wanted);
+            ++stats_.drops;
+        }
+    }
+    // One level finer per upload (the chain appears progressively); furthest behind first.
+    std::uint32_t uploads = 0;
+    while (uploads < uploads_per_tick)
+    {
+        std::uint32_t best = std::uint32_t(textures_.size());
+        std::uint32_t best_gap = 0;
+        for (std::uint32_t i = 0; i < textures_.size(); ++i)
+        {
+            const Streamed& streamed = textures_[i];
+            const std::uint32_t gap =
+                (streamed.resident > streamed.wanted) ? (streamed.resident - streamed.wanted) : 0u;
+            if (gap > best_gap)
+            {
+                best = i;
+                best_gap = gap;
+            }
+        }
+        if (best == textures_.size())
+        {
+            break;
+        }
+        upload(best, textures_[best].resident - 1);
+        ++uploads;
+    }
+    stats_.uploads += uploads;
+}
+
+const TextureStreamStats& ModelTextureStreamer::stats() const
+{
+    return stats_;
+}
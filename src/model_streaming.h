@@ -0,0 +1,263 @@
+#pragma once
+#include "dx_api.h"
+#include "file_index.h"
+#include "model.h"
+#include "render_model.h"
+#include "spsc_queue.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstdint>
+
+// Catalog entry for a model file; the model itself is loaded on demand (ModelLoader).
+struct CatalogFile
+{
+    std::string file_name;
+    std::string name;
+    bool changed = true; // new or modified since it was listed last time (see FileIndex)
+};
+
+// Lists dropped files/folders off the frame thread: collects model files and
+// checks them against the index. Entries are handed over to the frame thread
+// in the (sorted) files order; nothing is loaded here.
+struct ModelListJob
+{
+    // The index is used (and saved) by the job until finished().
+    static std::unique_ptr<ModelListJob> start(std::vector<std::string> paths, FileIndex& index);
+
+    // Cancels and waits.
+    ~ModelListJob();
+    ModelListJob(const ModelListJob&) = delete;
+    ModelListJob& operator=(const ModelListJob&) = delete;
+
+    // Frame thread.
+    bool try_pop(CatalogFile& file);
+    // Everything was handed over (or canceled).
+    bool finished() const;
+    void cancel();
+
+    std::uint32_t files_total() const;
+    std::uint32_t files_done() const;
+
+private:
+    explicit ModelListJob(FileIndex& index);
+    void run(std::vector<std::string> paths);
+
+private:
+    FileIndex& index_;
+    SpscQueue<CatalogFile> queue_;
+    std::atomic<bool> cancel_{false};
+    std::atomic<bool> finished_{false};
+    std::atomic<std::uint32_t> files_total_{0};
+    std::atomic<std::uint32_t> files_done_{0};
+    std::thread thread_;
+};
+
+// Loads catalog models on GlobalThreadPool(): the selected one on demand and
+// its neighbors as prefetch. Loads that are no longer wanted when their turn
+// comes are skipped. Frame thread only.
+struct ModelLoader
+{
+    struct Loaded
+    {
+        std::size_t index = 0; // in models
+        double load_ms = 0.0;
+    };
+
+    // Starts loading (if not loaded/loading yet) models_[index] and its
+    // previous/next entries; pending loads of other entries are dropped.
+    // Only neighbors, if the selected one does not need its data.
+    void request(const std::vector<FileModel>& models, std::size_t index, bool load_selected);
+    // Moves finished loads into their entries.
+    std::vector<Loaded> collect(std::vector<FileModel>& models);
+    bool is_loading(const std::string& file_name) const;
+
+    ModelLoader() = default;
+    ~ModelLoader();
+    ModelLoader(const ModelLoader&) = delete;
+    ModelLoader& operator=(const ModelLoader&) = delete;
+
+private:
+    struct Result
+    {
+        outcome::result<Model> model;
+        double load_ms;
+    };
+
+    struct Pending
+    {
+        std::string file_name;
+        bool prefetch = false;
+        std::shared_ptr<std::atomic<bool>> wanted;
+        std::future<Result> result;
+    };
+
+    void start(const std::string& file_name, bool prefetch);
+
+private:
+    std::vector<Pending> pending_;
+};
+
+// Creates GPU resources of a model off the frame thread (ID3D11Device is
+// free-threaded), mesh by mesh, then textures. The frame thread appends
+// finished pieces to the RenderModel, so the model appears progressively.
+// The model must outlive the job.
+struct ModelUploadJob
+{
+    // Meshes only, if textures are streamed (see ModelTextureStreamer).
+    // pack_vertices: of the RenderModel the pieces go to (see RenderMesh::make()).
+    static std::unique_ptr<ModelUploadJob> start(
+        ID3D11Device& device,
+        const Model& model,
+        bool with_textures,
+        bool pack_vertices
+    );
+
+    // Cancels and waits.
+    ~ModelUploadJob();
+    ModelUploadJob(const ModelUploadJob&) = delete;
+    ModelUploadJob& operator=(const ModelUploadJob&) = delete;
+
+    // Frame thread. Moves finished pieces into the model;
+    // true when everything is there.
+    bool drain(RenderModel& model);
+
+    std::uint32_t pieces_total() const;
+    std::uint32_t pieces_done() const;
+
+private:
+    struct Piece
+    {
+        RenderMesh mesh;
+        RenderTexture texture;
+        bool is_texture = false;
+    };
+
+    ModelUploadJob();
+    void run();
+    bool push(Piece& piece);
+
+private:
+    ComPtr<ID3D11Device> device_;
+    std::vector<Mesh> meshes_;
+    std::vector<Texture> textures_;
+    bool pack_vertices_ = true;
+    SpscQueue<Piece> queue_;
+    std::atomic<bool> cancel_{false};
+    std::atomic<std::uint32_t> pieces_done_{0};
+    std::uint32_t pieces_received_ = 0;
+    std::thread thread_;
+};
+
+struct ChunkPagerStats
+{
+    std::uint32_t resident_chunks = 0;
+    std::uint32_t total_chunks = 0;
+    std::size_t resident_bytes = 0;
+    std::uint32_t uploads = 0;
+    std::uint32_t evictions = 0;
+};
+
+// Keeps meshes (chunks) of a model that does not fit the GPU budget resident by
+// distance to the camera, instead of uploading the whole model (ModelUploadJob).
+// Out-of-core imports (see model_chunks.h) are spatially partitioned, so the
+// nearest chunks are the visible detail. RenderModel::meshes holds only resident
+// chunks; a few are uploaded per tick, far ones are released.
+// tick() gets the model of start() every time: it is not kept, catalog entries
+// (FileModel) move as the catalog grows. Frame thread only.
+struct ModelChunkPager
+{
+    std::size_t gpu_budget_bytes = (std::size_t(512) << 20);
+    std::uint32_t uploads_per_tick = 4;
+
+    // Model with several meshes that is larger than the budget.
+    bool is_needed(const Model& model) const;
+    // Uploads textures (unless streamed); meshes are paged in by tick().
+    void start(ID3D11Device& device, const Model& model, RenderModel& render, bool with_textures);
+    void reset();
+    bool is_active() const;
+    void tick(ID3D11Device& device, const Model& model, RenderModel& render, const glm::vec3& camera_position);
+
+    const ChunkPagerStats& stats() const;
+
+private:
+    bool active_ = false;
+    std::vector<float> distances_; // per mesh, model space
+    std::vector<std::uint32_t> order_;
+    std::vector<bool> wanted_;
+    std::vector<bool> resident_;
+    std::vector<std::uint32_t> render_meshes_; // mesh index of RenderModel::meshes[i]
+    ChunkPagerStats stats_;
+};
+
+struct TextureStreamStats
+{
+    std::uint32_t textures = 0;
+    std::size_t resident_bytes = 0;  // GPU, levels uploaded so far
+    std::size_t requested_bytes = 0; // levels the view asks for, regardless of the budget
+    std::size_t wanted_bytes = 0;    // requested, trimmed to the budget
+    std::size_t full_bytes = 0;      // all levels
+    std::uint32_t uploads = 0;
+    std::uint32_t drops = 0; // finer levels released
+};
+
+// Streams mips of the model's textures instead of uploading whole chains up front.
+// Every texture starts with its coarsest levels; finer ones follow by screen-space demand:
+// the largest on-screen size of the bounds of meshes that sample it, so a level
+// is wanted once a texel of it would cover less than a pixel. Levels that don't fit
+// the budget are trimmed from textures with the largest finest level first.
+// A texture is resident as its tail [first level; last] (see TextureMips_Tail()):
+// a finer level means a new D3D11 texture, swapped into RenderTexture.
+// tick() gets the model of start() every time, it is not kept (see ModelChunkPager).
+// Frame thread only.
+struct ModelTextureStreamer
+{
+    std::size_t gpu_budget_bytes = (std::size_t(256) << 20);
+    // Models with less texture data are uploaded as is (ModelUploadJob).
+    std::size_t min_stream_bytes = (std::size_t(32) << 20);
+    std::uint32_t uploads_per_tick = 2;
+
+    bool is_needed(const Model& model) const;
+    // Uploads the coarsest levels of all textures.
+    void start(ID3D11Device& device, const Model& model, RenderModel& render);
+    void reset();
+    bool is_active() const;
+    // Resident levels are the wanted ones of the last tick(): nothing to upload or drop
+    // until the view (or the budget) changes. RenderModel::textures can be patched then
+    // (hot reload, packing); tick() replaces them again once streaming resumes.
+    bool is_settled() const;
+    // render.world must be set; fov_y in radians, viewport_height in pixels.
+    void tick(
+        ID3D11Device& device,
+        const Model& model,
+        RenderModel& render,
+        const glm::vec3& camera_position,
+        float fov_y,
+        float viewport_height
+    );
+
+    const TextureStreamStats& stats() const;
+
+private:
+    struct Streamed
+    {
+        std::uint32_t coarsest = 0; // first level of the initial upload
+        std::uint32_t resident = 0; // first level on the GPU
+        std::uint32_t wanted = 0;
+        std::size_t render_index = 0; // in RenderModel::textures
+    };
+
+    bool active_ = false;
+    bool ticked_ = false; // wanted levels are known
+    std::vector<Streamed> textures_;
+    std::vector<float> demand_; // per texture, on-screen pixels
+    TextureStreamStats stats_;
+};
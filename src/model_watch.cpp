@@ -0,0 +1,406 @@
+#include "model_watch.h"
+#include "assimp_model.h"
+#include "package.h"
+#include "texture_compress.h"
+#include "texture_mips.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "utils_log.h"
+
+#include <algorithm>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+static constexpr auto c_settle_time = std::chrono::milliseconds(250);
+
+static fs::path NormalPath(const fs::path& path)
+{
+    return path.lexically_normal().make_preferred();
+}
+
+// Files the model's import reads besides the model file itself.
+static bool IsModelCompanionFile(const fs::path& path)
+{
+    const fs::path ext = path.extension();
+    return (ext == ".mtl") || (ext == ".MTL") || (ext == ".bin") || (ext == ".BIN");
+}
+
+static bool SameMesh(const Mesh& lhs, const Mesh& rhs)
+{
+    return (lhs.texture_diffuse_id == rhs.texture_diffuse_id)                   //
+           && (lhs.texture_normal_id == rhs.texture_normal_id)                  //
+           && (lhs.vertices.size() == rhs.vertices.size())                      //
+           && (lhs.indices.size() == rhs.indices.size())                        //
+           && (std::memcmp(lhs.vertices.data(), rhs.vertices.data(), lhs.vertices.size_bytes()) == 0)
+           && (std::memcmp(lhs.indices.data(), rhs.indices.data(), lhs.indices.size_bytes()) == 0);
+}
+
+static bool SameTexture(const Texture& lhs, const Texture& rhs)
+{
+    return (lhs.width == rhs.width)                   //
+           && (lhs.height == rhs.height)              //
+           && (lhs.mips_count == rhs.mips_count)      //
+           && (lhs.format == rhs.format)              //
+           && (lhs.srgb == rhs.srgb)                  //
+           && (lhs.data.size() == rhs.data.size())    //
+           && (std::memcmp(lhs.data.data(), rhs.data.data(), lhs.data.size()) == 0);
+}
+
+/*explicit*/ ModelWatch::ModelWatch()
+    : io_port_(),
+      dir_()
+{
+    std::error_code ec;
+    auto port = wi::IoCompletionPort::make(1, ec);
+    Panic(!!port);
+    Panic(!ec);
+    io_port_ = std::move(*port);
+}
+
+ModelWatch::~ModelWatch() = default;
+
+void ModelWatch::watch(const std::string& file_name)
+{
+    if (file_name == file_name_)
+    {
+        return;
+    }
+    file_name_ = file_name;
+    model_changed_ = false;
+    textures_changed_.clear();
+    model_job_ = {};
+    texture_jobs_.clear();
+    if (file_name.empty() || Package_IsPath(file_name))
+    {
+        dir_.reset();
+        return;
+    }
+
+    std::error_code ec;
+    fs::path dir_path = NormalPath(fs::absolute(file_name, ec).parent_path());
+    if (ec)
+    {
+        dir_.reset();
+        return;
+    }
+    if (dir_ && (dir_->directory_path == dir_path))
+    {
+        return;
+    }
+    dir_.reset();
+    dir_ = Directory::make(std::move(dir_path), io_port_, ++key_);
+    if (dir_)
+    {
+        dir_->watcher().start_watch(ec);
+        Panic(!ec);
+    }
+}
+
+/*static*/ auto ModelWatch::Directory::make(
+    fs::path directory_path,
+    wi::IoCompletionPort& io_port,
+    wi::WinULONG_PTR key
+) -> std::unique_ptr<Directory>
+{
+    std::unique_ptr<Directory> ptr(new Directory());
+    ptr->directory_path = std::move(directory_path);
+    void* mem = static_cast<void*>(&ptr->watcher_data);
+    std::error_code ec;
+    auto dir_changes = wi::DirectoryChanges::make(
+        ptr->directory_path.c_str(),
+        ptr->buffer,
+        sizeof(ptr->buffer),
+        true // watch subtree, textures are usually in subfolders
+        ,
+        FILE_NOTIFY_CHANGE_LAST_WRITE,
+        io_port,
+        key,
+        ec
+    );
+    if (ec || !dir_changes)
+    {
+        // Not a fatal error as for shaders: model just is not hot reloaded.
+        LogDebug("[hot reload] can't watch '%s'.\n", ptr->directory_path.string().c_str());
+        return nullptr;
+    }
+    (void)new (mem) wi::DirectoryChanges(std::move(*dir_changes));
+    return ptr;
+}
+
+ModelWatch::Directory::~Directory()
+{
+    using DirectoryChanges = wi::DirectoryChanges;
+    watcher().~DirectoryChanges();
+}
+
+void ModelWatch::collect_changes(const Model& model)
+{
+    const fs::path model_path = NormalPath(dir_->directory_path / fs::path(file_name_).filename());
+    std::error_code ec;
+    while (std::optional<wi::PortEntry> data = io_port_.query(ec))
+    {
+        Panic(!ec);
+        if (!data)
+        {
+            continue;
+        }
+        if (data->completion_key != key_)
+        {
+            // Directory of the previous model.
+            continue;
+        }
+        wi::DirectoryChangesRange changes(dir_->buffer, *data);
+        for (wi::DirectoryChange file_change : changes)
+        {
+            const fs::path path = NormalPath(dir_->directory_path / std::wstring(file_change.name));
+            if ((path == model_path) || IsModelCompanionFile(path))
+            {
+                model_changed_ = true;
+                last_change_ = std::chrono::steady_clock::now();
+                continue;
+            }
+            if (!model.is_loaded())
+            {
+                continue;
+            }
+            for (std::uint32_t i = 0, count = model.textures_count(); i < count; ++i)
+            {
+                const Texture texture = model.get_texture(i);
+                if (!texture.path.empty() && (NormalPath(dir_->directory_path / texture.path) == path))
+                {
+                    if (std::find(textures_changed_.begin(), textures_changed_.end(), i) == textures_changed_.end())
+                    {
+                        textures_changed_.push_back(i);
+                    }
+                    last_change_ = std::chrono::steady_clock::now();
+                }
+            }
+        }
+        dir_->watcher().start_watch(ec);
+        Panic(!ec);
+    }
+}
+
+void ModelWatch::start_reloads(const Model& model)
+{
+    if (!model_changed_ && textures_changed_.empty())
+    {
+        return;
+    }
+    if ((std::chrono::steady_clock::now() - last_change_) < c_settle_time)
+    {
+        return;
+    }
+    if (model_job_.valid())
+    {
+        // One import at a time; the next one starts once this one is applied.
+        return;
+    }
+
+    if (model_changed_)
+    {
+        // Import decodes all textures, pending ones included.
+        model_changed_ = false;
+        textures_changed_.clear();
+        model_job_ = GlobalThreadPool().submit([file_name = file_name_]() {
+            return LoadModel(file_name.c_str());
+        });
+        return;
+    }
+    for (std::uint32_t index : textures_changed_)
+    {
+        const fs::path texture_file = dir_->directory_path / model.get_texture(index).path;
+        MipFilter filter = MipFilter::Color;
+        for (std::uint32_t i = 0, count = model.meshes_count(); i < count; ++i)
+        {
+            filter = (model.get_mesh(i).texture_normal_id == index) ? MipFilter::NormalMap : filter;
+        }
+        texture_jobs_.push_back(GlobalThreadPool().submit([index, texture_file, filter]() {
+            TextureReload reload{.index = index};
+            AssimpModel::Blob blob;
+            if (Assimp_LoadTexture(texture_file, blob))
+            {
+                reload.width = std::uint32_t(blob.width);
+                reload.height = std::uint32_t(blob.height);
+                reload.mips_count = blob.mips_count;
+                reload.format = blob.format;
+                // As a load marks it (see Assimp_LoadModelTextures()).
+                reload.srgb = blob.srgb && (filter != MipFilter::NormalMap);
+                if ((blob.format == TextureFormat::RGBA8) && (blob.mips_count == 1))
+                {
+                    const std::span<const std::uint8_t> texels(
+                        blob.data.get(),
+                        std::size_t(reload.width) * reload.height * c_texture_channels
+                    );
+                    reload.texels = TextureMips_Build(texels, reload.width, reload.height, filter);
+                    reload.mips_count = TextureMips_FullCount(reload.width, reload.height);
+                }
+                else
+                {
+                    // .dds/.ktx2 chain as is; copied, blob may be a mapping.
+                    const std::size_t bytes =
+                        TextureMips_ChainBytes(reload.format, reload.width, reload.height, reload.mips_count);
+                    reload.texels = MipChain(static_cast<std::uint8_t*>(std::malloc(bytes)), &std::free);
+                    Panic(!!reload.texels);
+                    std::memcpy(reload.texels.get(), blob.data.get(), bytes);
+                }
+                // Same formats as a cold load; unchanged texels hit the texture cache.
+                Texture texture{};
+                texture.id = index;
+                texture.data = {
+                    reload.texels.get(),
+                    TextureMips_ChainBytes(reload.format, reload.width, reload.height, reload.mips_count)
+                };
+                texture.width = reload.width;
+                texture.height = reload.height;
+                texture.mips_count = reload.mips_count;
+                texture.format = reload.format;
+                texture.srgb = reload.srgb;
+                TextureCompressResult compressed = TextureCompress_Chain(texture, filter, c_texture_compression);
+                if (compressed.data)
+                {
+                    reload.texels = std::move(compressed.data);
+                    reload.format = compressed.format;
+                }
+            }
+            return reload;
+        }));
+    }
+    textures_changed_.clear();
+}
+
+// Keeps GPU resources of meshes & textures with the same data; uploads the rest.
+static void ApplyModel(ID3D11Device& device, FileModel& model, RenderModel& render, Model&& new_model)
+{
+    const Model& old_model = model.model;
+    const std::uint32_t old_meshes = (old_model.is_loaded() ? old_model.meshes_count() : 0u);
+    const std::uint32_t old_textures = (old_model.is_loaded() ? old_model.textures_count() : 0u);
+
+    std::vector<RenderMesh> meshes;
+    const std::uint32_t meshes_count = new_model.meshes_count();
+    meshes.reserve(meshes_count);
+    std::uint32_t meshes_uploaded = 0;
+    for (std::uint32_t i = 0; i < meshes_count; ++i)
+    {
+        const Mesh mesh = new_model.get_mesh(i);
+        if ((i < old_meshes) && (i < render.meshes.size()) && SameMesh(old_model.get_mesh(i), mesh))
+        {
+            meshes.push_back(std::move(render.meshes[i]));
+            continue;
+        }
+        meshes.push_back(RenderMesh::make(device, mesh, render.pack_vertices_));
+        ++meshes_uploaded;
+    }
+
+    std::vector<RenderTexture> textures;
+    const std::uint32_t textures_count = new_model.textures_count();
+    textures.reserve(textures_count);
+    std::uint32_t textures_uploaded = 0;
+    for (std::uint32_t i = 0; i < textures_count; ++i)
+    {
+        const Texture texture = new_model.get_texture(i);
+        auto it = std::find_if(render.textures.begin(), render.textures.end(), [&](const RenderTexture& t) {
+            return (t.texture_id == i);
+        });
+        if ((i < old_textures) && (it != render.textures.end()) && SameTexture(old_model.get_texture(i), texture))
+        {
+            textures.push_back(std::move(*it));
+            continue;
+        }
+        textures.push_back(RenderTexture::make(device, texture));
+        ++textures_uploaded;
+    }
+
+    LogDebug(
+        "[hot reload] '%s': re-imported, uploaded %u of %u meshes, %u of %u textures.\n",
+        model.file_name.c_str(),
+        meshes_uploaded,
+        meshes_count,
+        textures_uploaded,
+        textures_count
+    );
+    render.meshes = std::move(meshes);
+    render.textures = std::move(textures);
+    render.aabb_min = new_model.aabb_min();
+    render.aabb_max = new_model.aabb_max();
+    model.model = std::move(new_model);
+}
+
+ModelWatch::Reloaded ModelWatch::tick(ID3D11Device& device, FileModel& model, RenderModel& render)
+{
+    Reloaded reloaded;
+    if (!dir_ || (model.file_name != file_name_))
+    {
+        return reloaded;
+    }
+    collect_changes(model.model);
+    start_reloads(model.model);
+
+    if (model_job_.valid() && (model_job_.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+    {
+        auto maybe_model = model_job_.get();
+        if (maybe_model)
+        {
+            ApplyModel(device, model, render, std::move(maybe_model.value()));
+            reloaded.model = true;
+        }
+        else
+        {
+            LogDebug("[hot reload] '%s': import failed.\n", file_name_.c_str());
+        }
+    }
+
+    for (auto it = texture_jobs_.begin(); it != texture_jobs_.end();)
+    {
+        if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+        TextureReload reload = it->get();
+        it = texture_jobs_.erase(it);
+        if (!reload.texels)
+        {
+            LogDebug("[hot reload] '%s': texture #%u can't be decoded.\n", file_name_.c_str(), reload.index);
+            continue;
+        }
+        if (!model.model.is_loaded() || (reload.index >= model.model.textures_count()))
+        {
+            // Model was imported again meanwhile.
+            continue;
+        }
+        model.model.set_texture(
+            reload.index,
+            std::move(reload.texels),
+            reload.width,
+            reload.height,
+            reload.mips_count,
+            reload.format,
+            reload.srgb
+        );
+        const Texture texture = model.model.get_texture(reload.index);
+        RenderTexture render_texture = RenderTexture::make(device, texture);
+        auto render_it = std::find_if(render.textures.begin(), render.textures.end(), [&](const RenderTexture& t) {
+            return (t.texture_id == reload.index);
+        });
+        if (render_it != render.textures.end())
+        {
+            *render_it = std::move(render_texture);
+        }
+        else
+        {
+            render.textures.push_back(std::move(render_texture));
+        }
+        ++reloaded.textures;
+        LogDebug(
+            "[hot reload] '%s': texture '%.*s' re-uploaded, geometry kept.\n",
+            file_name_.c_str(),
+            int(texture.path.size()),
+            texture.path.data()
+        );
+    }
+    return reloaded;
+}
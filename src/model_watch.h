@@ -0,0 +1,99 @@
+#pragma once
+#include "dx_api.h"
+#include "model.h"
+#include "render_model.h"
+#include "utils_outcome.h"
+
+#include <read_directory_changes.h>
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+// Hot reload of the active model, the same way ShadersWatch does it for shaders:
+// the model's folder (with subfolders) is watched for writes.
+// - A changed texture is decoded again and only its RenderTexture is re-created;
+//   geometry is not imported.
+// - A changed model file (or .mtl/.bin) imports the model again; RenderMesh and
+//   RenderTexture entries with the same data are kept, only changed ones are uploaded.
+// Decoding/import runs on GlobalThreadPool(); results are applied on the frame thread.
+// Textures are matched by Texture::path, so the model's CPU data must be loaded.
+// Packed (pkg://) models are not watched.
+struct ModelWatch
+{
+    explicit ModelWatch();
+    ~ModelWatch();
+    ModelWatch(const ModelWatch&) = delete;
+    ModelWatch& operator=(const ModelWatch&) = delete;
+
+    // Stops watching the previous model; its pending reloads are dropped.
+    void watch(const std::string& file_name);
+    struct Reloaded
+    {
+        bool model = false;         // imported again
+        std::uint32_t textures = 0; // re-uploaded alone
+    };
+
+    // Applies finished reloads to the model's data & its fully uploaded GPU resources
+    // (neither can be used by ModelUploadJob).
+    Reloaded tick(ID3D11Device& device, FileModel& model, RenderModel& render);
+
+private:
+    template <typename T>
+    using BufferFor = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+    struct Directory
+    {
+        std::filesystem::path directory_path;
+
+        DWORD buffer[1024];
+        BufferFor<wi::DirectoryChanges> watcher_data;
+
+        static std::unique_ptr<Directory> make(
+            std::filesystem::path directory_path,
+            wi::IoCompletionPort& io_port,
+            wi::WinULONG_PTR key
+        );
+
+        wi::DirectoryChanges& watcher()
+        {
+            return *reinterpret_cast<wi::DirectoryChanges*>(&watcher_data);
+        }
+
+        ~Directory();
+    };
+
+    struct TextureReload
+    {
+        std::uint32_t index = 0;
+        std::unique_ptr<std::uint8_t, void (*)(void*)> texels{nullptr, nullptr}; // null if decode failed
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        std::uint32_t mips_count = 0;
+        TextureFormat format = TextureFormat::RGBA8;
+        bool srgb = true;
+    };
+
+    void collect_changes(const Model& model);
+    void start_reloads(const Model& model);
+
+private:
+    wi::IoCompletionPort io_port_;
+    std::unique_ptr<Directory> dir_;
+    // Completion key of dir_; notifications of previous directories are skipped.
+    wi::WinULONG_PTR key_ = 0;
+    std::string file_name_;
+
+    // Editors write files in several steps; reload once writes settle.
+    std::chrono::steady_clock::time_point last_change_;
+    bool model_changed_ = false;
+    std::vector<std::uint32_t> textures_changed_;
+
+    std::future<outcome::result<Model>> model_job_;
+    std::vector<std::future<TextureReload>> texture_jobs_;
+};
@@ -0,0 +1,753 @@
+#include "obj_loader.h"
+#include "mapped_file.h"
+#include "tangents.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cfloat>
+#include <climits>
+#include <cstdint>
+
+namespace
+{
+
+constexpr std::int32_t c_no_index = INT32_MIN;
+// ObjChunk::corner_relative bits: index is relative to the chunk's
+// first element (negative .obj index), needs chunk's base added.
+constexpr std::uint8_t c_relative_v = 0x1;
+constexpr std::uint8_t c_relative_vt = 0x2;
+constexpr std::uint8_t c_relative_vn = 0x4;
+
+struct ObjCorner
+{
+    std::int32_t v;
+    std::int32_t vt;
+    std::int32_t vn;
+};
+
+// "usemtl"/"o"/"g" that happened before face_index.
+struct ObjStatement
+{
+    enum Kind
+    {
+        Material,
+        Object,
+    };
+    Kind kind;
+    std::uint32_t face_index;
+    std::string name;
+};
+
+struct ObjChunk
+{
+    std::string_view text;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<ObjCorner> corners;
+    std::vector<std::uint8_t> corner_relative;
+    std::vector<std::uint32_t> face_first_corner; // faces count + 1
+    std::vector<ObjStatement> statements;
+    std::vector<std::string> mtllibs;
+    bool has_uv_w = false;
+    bool ok = true;
+
+    // After merge.
+    std::int64_t positions_base = 0;
+    std::int64_t normals_base = 0;
+    std::int64_t uvs_base = 0;
+
+    std::uint32_t faces_count() const
+    {
+        return std::uint32_t(face_first_corner.size() - 1);
+    }
+};
+
+struct ObjMaterial
+{
+    std::string name;
+    std::string diffuse;
+    std::string normal;
+};
+
+// Continuous range of faces of one chunk that goes to one mesh.
+struct ObjSegment
+{
+    std::uint32_t chunk;
+    std::uint32_t face_begin;
+    std::uint32_t face_end;
+    std::uint32_t mesh;
+
+    // Filled by the count pass.
+    std::uint64_t vertices_count;
+    std::uint64_t indices_count;
+    bool all_have_normals;
+    bool all_have_uvs;
+
+    std::uint64_t vertices_offset;
+    std::uint64_t indices_offset;
+    glm::vec3 aabb_min;
+    glm::vec3 aabb_max;
+};
+
+struct ObjMesh
+{
+    std::string material;
+    std::uint64_t faces_count = 0;
+};
+
+bool IsSpace(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r');
+}
+
+void SkipSpaces(const char*& p, const char* end)
+{
+    while ((p < end) && IsSpace(*p))
+    {
+        ++p;
+    }
+}
+
+const char* LineEnd(const char* p, const char* end)
+{
+    while ((p < end) && (*p != '\n'))
+    {
+        ++p;
+    }
+    return p;
+}
+
+bool ParseFloat(const char*& p, const char* end, float& value)
+{
+    SkipSpaces(p, end);
+    if ((p < end) && (*p == '+'))
+    {
+        ++p;
+    }
+    const std::from_chars_result r = std::from_chars(p, end, value);
+    if (r.ec != std::errc())
+    {
+        return false;
+    }
+    p = r.ptr;
+    return true;
+}
+
+bool ParseInt(const char*& p, const char* end, std::int32_t& value)
+{
+    const std::from_chars_result r = std::from_chars(p, end, value);
+    if (r.ec != std::errc())
+    {
+        return false;
+    }
+    p = r.ptr;
+    return true;
+}
+
+std::string_view RestOfLine(const char* p, const char* line_end)
+{
+    SkipSpaces(p, line_end);
+    const char* e = line_end;
+    while ((e > p) && IsSpace(*(e - 1)))
+    {
+        --e;
+    }
+    return std::string_view(p, std::size_t(e - p));
+}
+
+// .obj indices are 1-based; negative are relative to the current end.
+// Store 0-based index, either absolute or relative to the chunk start.
+bool ResolveIndex(std::int32_t raw, std::size_t local_count, std::int32_t& out, std::uint8_t& flags, std::uint8_t bit)
+{
+    if (raw > 0)
+    {
+        out = raw - 1;
+        return true;
+    }
+    if (raw < 0)
+    {
+        out = std::int32_t(local_count) + raw;
+        flags |= bit;
+        return true;
+    }
+    return false;
+}
+
+bool ParseFace(ObjChunk& chunk, const char* p, const char* line_end)
+{
+    chunk.face_first_corner.push_back(std::uint32_t(chunk.corners.size()));
+    while (true)
+    {
+        SkipSpaces(p, line_end);
+        if (p >= line_end)
+        {
+            break;
+        }
+        ObjCorner corner{c_no_index, c_no_index, c_no_index};
+        std::uint8_t flags = 0;
+        std::int32_t raw = 0;
+        if (!ParseInt(p, line_end, raw) //
+            || !ResolveIndex(raw, chunk.positions.size(), corner.v, flags, c_relative_v))
+        {
+            return false;
+        }
+        if ((p < line_end) && (*p == '/'))
+        {
+            ++p;
+            if ((p < line_end) && (*p != '/'))
+            {
+                if (!ParseInt(p, line_end, raw) //
+                    || !ResolveIndex(raw, chunk.uvs.size(), corner.vt, flags, c_relative_vt))
+                {
+                    return false;
+                }
+            }
+            if ((p < line_end) && (*p == '/'))
+            {
+                ++p;
+                if (!ParseInt(p, line_end, raw) //
+                    || !ResolveIndex(raw, chunk.normals.size(), corner.vn, flags, c_relative_vn))
+                {
+                    return false;
+                }
+            }
+        }
+        chunk.corners.push_back(corner);
+        chunk.corner_relative.push_back(flags);
+    }
+    return true;
+}
+
+void ParseChunk(ObjChunk& chunk)
+{
+    const char* p = chunk.text.data();
+    const char* const end = p + chunk.text.size();
+    // ParseFace() pushes first corner of every face; sentinel is added at the end.
+
+    while (p < end)
+    {
+        SkipSpaces(p, end);
+        const char* const line_end = LineEnd(p, end);
+        const std::size_t length = std::size_t(line_end - p);
+        bool ok = true;
+        if ((length >= 2) && (p[0] == 'v') && IsSpace(p[1]))
+        {
+            const char* s = p + 2;
+            glm::vec3& v = chunk.positions.emplace_back();
+            ok = ParseFloat(s, line_end, v.x) && ParseFloat(s, line_end, v.y) && ParseFloat(s, line_end, v.z);
+        }
+        else if ((length >= 3) && (p[0] == 'v') && (p[1] == 'n') && IsSpace(p[2]))
+        {
+            const char* s = p + 3;
+            glm::vec3& n = chunk.normals.emplace_back();
+            ok = ParseFloat(s, line_end, n.x) && ParseFloat(s, line_end, n.y) && ParseFloat(s, line_end, n.z);
+        }
+        else if ((length >= 3) && (p[0] == 'v') && (p[1] == 't') && IsSpace(p[2]))
+        {
+            const char* s = p + 3;
+            glm::vec2& uv = chunk.uvs.emplace_back();
+            ok = ParseFloat(s, line_end, uv.x);
+            // v is optional.
+            if (ok && !ParseFloat(s, line_end, uv.y))
+            {
+                uv.y = 0.f;
+            }
+            float w = 0.f;
+            chunk.has_uv_w |= (ok && ParseFloat(s, line_end, w));
+        }
+        else if ((length >= 2) && (p[0] == 'f') && IsSpace(p[1]))
+        {
+            ok = ParseFace(chunk, p + 2, line_end);
+        }
+        else if ((length >= 7) && (std::string_view(p, 6) == "usemtl") && IsSpace(p[6]))
+        {
+            chunk.statements.push_back(
+                {ObjStatement::Material, std::uint32_t(chunk.face_first_corner.size()), std::string(RestOfLine(p + 6, line_end))}
+            );
+        }
+        else if ((length >= 2) && ((p[0] == 'o') || (p[0] == 'g')) && IsSpace(p[1]))
+        {
+            chunk.statements.push_back(
+                {ObjStatement::Object, std::uint32_t(chunk.face_first_corner.size()), std::string(RestOfLine(p + 1, line_end))}
+            );
+        }
+        else if ((length >= 7) && (std::string_view(p, 6) == "mtllib") && IsSpace(p[6]))
+        {
+            chunk.mtllibs.emplace_back(RestOfLine(p + 6, line_end));
+        }
+        // Else: comments, "s", "l", "p", unknown - skip.
+
+        if (!ok)
+        {
+            chunk.ok = false;
+            return;
+        }
+        p = line_end + ((line_end < end) ? 1 : 0);
+    }
+    chunk.face_first_corner.push_back(std::uint32_t(chunk.corners.size()));
+}
+
+// Next space-separated token of the line; p is moved past it.
+std::string_view NextToken(const char*& p, const char* end)
+{
+    SkipSpaces(p, end);
+    const char* begin = p;
+    while ((p < end) && !IsSpace(*p))
+    {
+        ++p;
+    }
+    return std::string_view(begin, std::size_t(p - begin));
+}
+
+bool IsNumber(std::string_view token)
+{
+    float value = 0.f;
+    const std::from_chars_result r = std::from_chars(token.data(), token.data() + token.size(), value);
+    return !token.empty() && (r.ec == std::errc()) && (r.ptr == (token.data() + token.size()));
+}
+
+// Arguments of "map_Kd -bm 1.0 -o 0 0 my texture.png": options go first, the file name
+// (may have spaces) is the rest of the line.
+std::string MtlTexturePath(std::string_view args)
+{
+    // Options with a fixed number of arguments; -o, -s, -t take 1 to 3 numbers.
+    static constexpr std::pair<std::string_view, int> c_options[] = {
+        {"-blendu", 1},
+        {"-blendv", 1},
+        {"-bm", 1},
+        {"-boost", 1},
+        {"-cc", 1},
+        {"-clamp", 1},
+        {"-imfchan", 1},
+        {"-mm", 2},
+        {"-texres", 1},
+        {"-type", 1},
+    };
+    const char* p = args.data();
+    const char* const end = p + args.size();
+    while (true)
+    {
+        SkipSpaces(p, end);
+        const char* const token_begin = p;
+        const std::string_view option = NextToken(p, end);
+        if (option.empty() || (option[0] != '-') || IsNumber(option))
+        {
+            p = token_begin;
+            break;
+        }
+        auto it = std::find_if(std::begin(c_options), std::end(c_options), [&](const auto& known) {
+            return (known.first == option);
+        });
+        if (it != std::end(c_options))
+        {
+            for (int i = 0; i < it->second; ++i)
+            {
+                (void)NextToken(p, end);
+            }
+            continue;
+        }
+        // -o, -s, -t and unknown ones: numbers that follow.
+        for (int i = 0; i < 3; ++i)
+        {
+            const char* const arg_begin = p;
+            if (!IsNumber(NextToken(p, end)))
+            {
+                p = arg_begin;
+                break;
+            }
+        }
+    }
+    return std::string(RestOfLine(p, end));
+}
+
+std::vector<ObjMaterial> ParseMtl(const fs::path& mtl_path)
+{
+    std::vector<ObjMaterial> materials;
+    std::ifstream in(mtl_path, std::ios::binary);
+    if (!in)
+    {
+        return materials;
+    }
+    std::string line;
+    while (std::getline(in, line))
+    {
+        const char* p = line.data();
+        const char* const end = p + line.size();
+        SkipSpaces(p, end);
+        const std::string_view l = RestOfLine(p, end);
+        auto starts_with = [&](std::string_view key) {
+            return (l.size() > key.size()) && (l.substr(0, key.size()) == key) && IsSpace(l[key.size()]);
+        };
+        if (starts_with("newmtl"))
+        {
+            materials.push_back({});
+            materials.back().name = std::string(RestOfLine(l.data() + 6, l.data() + l.size()));
+        }
+        else if (materials.empty())
+        {
+            continue;
+        }
+        else if (starts_with("map_Kd"))
+        {
+            materials.back().diffuse = MtlTexturePath(l.substr(6));
+        }
+        else if (starts_with("map_Bump") || starts_with("map_bump"))
+        {
+            // Assimp maps "bump" to aiTextureType_HEIGHT, what Assimp_ProcessMesh() uses as normal map.
+            materials.back().normal = MtlTexturePath(l.substr(8));
+        }
+        else if (starts_with("bump"))
+        {
+            materials.back().normal = MtlTexturePath(l.substr(4));
+        }
+    }
+    return materials;
+}
+
+std::vector<std::string_view> SplitIntoChunks(std::string_view text, std::size_t chunks_hint)
+{
+    constexpr std::size_t c_min_chunk_size = 256 * 1024;
+    const std::size_t chunk_size = std::max(c_min_chunk_size, text.size() / std::max<std::size_t>(chunks_hint, 1));
+    std::vector<std::string_view> chunks;
+    std::size_t begin = 0;
+    while (begin < text.size())
+    {
+        std::size_t end = std::min(text.size(), begin + chunk_size);
+        // Split on line boundary only.
+        while ((end < text.size()) && (text[end - 1] != '\n'))
+        {
+            ++end;
+        }
+        chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+} // namespace
+
+outcome::result<AssimpModel> Obj_Load(const fs::path& file_path)
+{
+    auto maybe_file = MappedFile::open(file_path);
+    if (!maybe_file)
+    {
+        return outcome::failure(maybe_file.error());
+    }
+    const std::span<const std::uint8_t> bytes = maybe_file.value().bytes();
+    const std::string_view text(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+    ThreadPool& pool = GlobalThreadPool();
+    const std::vector<std::string_view> texts = SplitIntoChunks(text, (pool.threads_count() + 1) * 4);
+    std::vector<ObjChunk> chunks(texts.size());
+    for (std::size_t i = 0; i < texts.size(); ++i)
+    {
+        chunks[i].text = texts[i];
+    }
+    pool.parallel_for(chunks.size(), [&](std::size_t i) { ParseChunk(chunks[i]); });
+
+    // Global positions/normals/uvs.
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<std::string> mtllibs;
+    bool has_uv_w = false;
+    for (ObjChunk& chunk : chunks)
+    {
+        if (!chunk.ok)
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        chunk.positions_base = std::int64_t(positions.size());
+        chunk.normals_base = std::int64_t(normals.size());
+        chunk.uvs_base = std::int64_t(uvs.size());
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+        mtllibs.insert(mtllibs.end(), chunk.mtllibs.begin(), chunk.mtllibs.end());
+        has_uv_w |= chunk.has_uv_w;
+        chunk.positions = {};
+        chunk.normals = {};
+        chunk.uvs = {};
+    }
+    if (positions.empty())
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+
+    // Resolve chunk-relative indices & validate.
+    std::vector<std::uint8_t> chunk_ok(chunks.size(), 1);
+    pool.parallel_for(chunks.size(), [&](std::size_t i) {
+        ObjChunk& chunk = chunks[i];
+        auto fix = [](std::int32_t& index, bool relative, std::int64_t base, std::size_t count) {
+            if (index == c_no_index)
+            {
+                return true;
+            }
+            const std::int64_t v = relative ? (base + index) : index;
+            if ((v < 0) || (v >= std::int64_t(count)))
+            {
+                return false;
+            }
+            index = std::int32_t(v);
+            return true;
+        };
+        for (std::size_t c = 0, count = chunk.corners.size(); c < count; ++c)
+        {
+            ObjCorner& corner = chunk.corners[c];
+            const std::uint8_t flags = chunk.corner_relative[c];
+            const bool ok = fix(corner.v, (flags & c_relative_v), chunk.positions_base, positions.size())
+                            && fix(corner.vt, (flags & c_relative_vt), chunk.uvs_base, uvs.size())
+                            && fix(corner.vn, (flags & c_relative_vn), chunk.normals_base, normals.size());
+            if (!ok)
+            {
+                chunk_ok[i] = 0;
+                return;
+            }
+        }
+        chunk.corner_relative = {};
+    });
+    if (std::find(chunk_ok.begin(), chunk_ok.end(), std::uint8_t(0)) != chunk_ok.end())
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+
+    const fs::path dir = file_path.parent_path();
+    std::vector<ObjMaterial> materials;
+    for (const std::string& mtllib : mtllibs)
+    {
+        std::vector<ObjMaterial> more = ParseMtl(dir / mtllib);
+        materials.insert(materials.end(), more.begin(), more.end());
+    }
+    auto find_material = [&](const std::string& name) -> const ObjMaterial* {
+        for (const ObjMaterial& m : materials)
+        {
+            if (m.name == name)
+            {
+                return &m;
+            }
+        }
+        return nullptr;
+    };
+
+    // Split into meshes: new mesh on every material/object change (as Assimp does).
+    std::vector<ObjMesh> meshes(1);
+    std::vector<ObjSegment> segments;
+    for (std::uint32_t chunk_index = 0; chunk_index < std::uint32_t(chunks.size()); ++chunk_index)
+    {
+        const ObjChunk& chunk = chunks[chunk_index];
+        std::uint32_t face_begin = 0;
+        auto close_segment = [&](std::uint32_t face_end) {
+            if (face_end > face_begin)
+            {
+                ObjSegment segment{};
+                segment.chunk = chunk_index;
+                segment.face_begin = face_begin;
+                segment.face_end = face_end;
+                segment.mesh = std::uint32_t(meshes.size() - 1);
+                segments.push_back(segment);
+                meshes.back().faces_count += (face_end - face_begin);
+            }
+            face_begin = face_end;
+        };
+        for (const ObjStatement& statement : chunk.statements)
+        {
+            close_segment(statement.face_index);
+            const bool same_material = (statement.kind == ObjStatement::Material) //
+                                       && (meshes.back().material == statement.name);
+            if (same_material)
+            {
+                continue;
+            }
+            if (meshes.back().faces_count > 0)
+            {
+                ObjMesh next{};
+                next.material = meshes.back().material;
+                meshes.push_back(std::move(next));
+            }
+            if (statement.kind == ObjStatement::Material)
+            {
+                meshes.back().material = statement.name;
+            }
+        }
+        close_segment(chunk.faces_count());
+    }
+
+    // Count pass.
+    pool.parallel_for(segments.size(), [&](std::size_t i) {
+        ObjSegment& segment = segments[i];
+        const ObjChunk& chunk = chunks[segment.chunk];
+        segment.all_have_normals = true;
+        segment.all_have_uvs = true;
+        for (std::uint32_t f = segment.face_begin; f < segment.face_end; ++f)
+        {
+            const std::uint32_t first = chunk.face_first_corner[f];
+            const std::uint32_t size = chunk.face_first_corner[f + 1] - first;
+            if (size < 3)
+            {
+                continue; // points/lines; Assimp_ProcessMesh() supports triangles only.
+            }
+            segment.vertices_count += size;
+            segment.indices_count += (size - 2) * 3;
+            for (std::uint32_t c = first; c < (first + size); ++c)
+            {
+                segment.all_have_normals &= (chunk.corners[c].vn != c_no_index);
+                segment.all_have_uvs &= (chunk.corners[c].vt != c_no_index);
+            }
+        }
+    });
+
+    AssimpModel model;
+    model.aabb_min = glm::vec3(FLT_MAX);
+    model.aabb_max = glm::vec3(-FLT_MAX);
+    for (const std::string& mtllib : mtllibs)
+    {
+        model.dependencies.push_back(dir / mtllib);
+    }
+    model.meshes.resize(meshes.size());
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        AssimpMesh& mesh = model.meshes[i];
+        mesh.has_normals = true;
+        mesh.has_texture_coords = true;
+    }
+    std::vector<std::uint64_t> vertices_counts(meshes.size(), 0);
+    std::vector<std::uint64_t> indices_counts(meshes.size(), 0);
+    for (ObjSegment& segment : segments)
+    {
+        AssimpMesh& mesh = model.meshes[segment.mesh];
+        segment.vertices_offset = vertices_counts[segment.mesh];
+        segment.indices_offset = indices_counts[segment.mesh];
+        vertices_counts[segment.mesh] += segment.vertices_count;
+        indices_counts[segment.mesh] += segment.indices_count;
+        mesh.has_normals &= segment.all_have_normals;
+        mesh.has_texture_coords &= segment.all_have_uvs;
+    }
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        AssimpMesh& mesh = model.meshes[i];
+        // Same rules as Assimp_ProcessMesh(): tangents (need normals) and 2D uvs
+        // and material with diffuse & normal textures.
+        const ObjMaterial* material = find_material(meshes[i].material);
+        mesh.has_texture_coords = mesh.has_texture_coords && mesh.has_normals && !has_uv_w //
+                                  && material && !material->diffuse.empty() && !material->normal.empty();
+        if (mesh.has_texture_coords)
+        {
+            mesh.texture_diffuse.path = material->diffuse;
+            mesh.texture_normal.path = material->normal;
+        }
+        if ((vertices_counts[i] > UINT_MAX) || (indices_counts[i] > UINT_MAX))
+        {
+            return outcome::failure(std::errc::value_too_large);
+        }
+        mesh.vertices.resize(std::size_t(vertices_counts[i]));
+        mesh.indices.resize(std::size_t(indices_counts[i]));
+    }
+
+    // Fill pass.
+    pool.parallel_for(segments.size(), [&](std::size_t i) {
+        ObjSegment& segment = segments[i];
+        const ObjChunk& chunk = chunks[segment.chunk];
+        AssimpMesh& mesh = model.meshes[segment.mesh];
+        Vertex* vertex = mesh.vertices.data() + segment.vertices_offset;
+        Index* index = mesh.indices.data() + segment.indices_offset;
+        Index next_index = Index(segment.vertices_offset);
+        segment.aabb_min = glm::vec3(FLT_MAX);
+        segment.aabb_max = glm::vec3(-FLT_MAX);
+
+        for (std::uint32_t f = segment.face_begin; f < segment.face_end; ++f)
+        {
+            const std::uint32_t first = chunk.face_first_corner[f];
+            const std::uint32_t size = chunk.face_first_corner[f + 1] - first;
+            if (size < 3)
+            {
+                continue;
+            }
+            Vertex* const face_vertices = vertex;
+            for (std::uint32_t c = first; c < (first + size); ++c, ++vertex)
+            {
+                const ObjCorner& corner = chunk.corners[c];
+                *vertex = Vertex{};
+                vertex->position = positions[std::size_t(corner.v)];
+                segment.aabb_min = glm::min(segment.aabb_min, vertex->position);
+                segment.aabb_max = glm::max(segment.aabb_max, vertex->position);
+                if (mesh.has_normals)
+                {
+                    vertex->normal = normals[std::size_t(corner.vn)];
+                }
+                if (mesh.has_texture_coords)
+                {
+                    vertex->texture_coord = uvs[std::size_t(corner.vt)];
+                }
+            }
+            // Fan triangulation (as aiProcess_Triangulate for convex polygons).
+            for (std::uint32_t k = 1; (k + 1) < size; ++k)
+            {
+                *index++ = next_index;
+                *index++ = next_index + k;
+                *index++ = next_index + k + 1;
+            }
+
+            if (mesh.has_texture_coords)
+            {
+                glm::vec3 tangent(0.f);
+                for (std::uint32_t k = 1; (k + 1) < size; ++k)
+                {
+                    tangent += TriangleTangent(face_vertices[0], face_vertices[k], face_vertices[k + 1]);
+                }
+                for (std::uint32_t k = 0; k < size; ++k)
+                {
+                    face_vertices[k].tangent = OrthogonalTangent(tangent, face_vertices[k].normal);
+                }
+            }
+            next_index += size;
+        }
+    });
+
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        AssimpMesh& mesh = model.meshes[i];
+        mesh.aabb_min = glm::vec3(FLT_MAX);
+        mesh.aabb_max = glm::vec3(-FLT_MAX);
+    }
+    for (const ObjSegment& segment : segments)
+    {
+        AssimpMesh& mesh = model.meshes[segment.mesh];
+        mesh.aabb_min = glm::min(mesh.aabb_min, segment.aabb_min);
+        mesh.aabb_max = glm::max(mesh.aabb_max, segment.aabb_max);
+    }
+
+    // Drop empty meshes (only "usemtl" without faces, points/lines).
+    auto empty_it = std::remove_if(model.meshes.begin(), model.meshes.end(), [](const AssimpMesh& mesh) {
+        return mesh.indices.empty();
+    });
+    model.meshes.erase(empty_it, model.meshes.end());
+    if (model.meshes.empty())
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+
+    for (const AssimpMesh& mesh : model.meshes)
+    {
+        Assimp_UpdateAABB(model, mesh);
+    }
+    if (!Assimp_LoadModelTextures(model, dir))
+    {
+        // Assimp gets to try (and report) it.
+        return outcome::failure(std::errc::no_such_file_or_directory);
+    }
+    return outcome::success(std::move(model));
+}
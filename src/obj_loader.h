@@ -0,0 +1,13 @@
+#pragma once
+#include "assimp_model.h"
+#include "utils_outcome.h"
+
+#include <filesystem>
+
+// Native Wavefront .obj/.mtl reader, bypasses Assimp.
+// Builds the same AssimpModel as Assimp_Load() does with
+// aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes:
+// one vertex per face corner, polygons are fan-triangulated,
+// tangents for textured meshes (not smoothed across faces).
+// The file is mapped and split into chunks parsed on GlobalThreadPool().
+outcome::result<AssimpModel> Obj_Load(const fs::path& file_path);
@@ -0,0 +1,484 @@
+#include "package.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "utils_hash.h"
+#include "utils_log.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <type_traits>
+
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+// Layout (little-endian, everything is POD):
+//  PackageHeader
+//  chunks payload
+//  PackageChunk[chunks_count]   at index_offset
+//  PackageFileRecord + path bytes, entries_count times
+// Chunk offsets are from the beginning of the file.
+
+static constexpr char c_package_magic[8] = {'X', 'X', 'P', 'A', 'C', 'K', '\0', '\0'};
+static constexpr std::uint32_t c_package_version = 1;
+static constexpr std::uint32_t c_package_chunk_size = (256 * 1024);
+static constexpr std::string_view c_package_scheme = "pkg://";
+static constexpr std::string_view c_package_extension = ".rpkg";
+
+struct PackageHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t chunk_size;
+    std::uint32_t entries_count;
+    std::uint32_t chunks_count;
+    std::uint64_t index_offset;
+};
+
+struct PackageFileRecord
+{
+    std::uint64_t size;
+    std::uint64_t content_hash;
+    std::uint32_t first_chunk;
+    std::uint32_t chunks_count;
+    std::uint32_t path_size;
+    std::uint32_t reserved;
+};
+
+static_assert(std::is_trivially_copyable_v<PackageHeader>);
+static_assert(std::is_trivially_copyable_v<PackageChunk>);
+static_assert(std::is_trivially_copyable_v<PackageFileRecord>);
+
+template <typename T>
+static bool ReadPOD(std::span<const std::uint8_t> bytes, std::uint64_t offset, T& value)
+{
+    if ((offset > bytes.size()) || ((bytes.size() - offset) < sizeof(T)))
+    {
+        return false;
+    }
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return true;
+}
+
+static std::uint64_t ChunksCount(std::uint64_t size)
+{
+    return (size + c_package_chunk_size - 1) / c_package_chunk_size;
+}
+
+// "a\b/./c" -> "a/b/c".
+static std::string NormalizeEntryPath(std::string_view entry_path)
+{
+    return fs::path(entry_path).lexically_normal().generic_string();
+}
+
+// "pkg://<package>.rpkg/<entry>" -> "<package>.rpkg", "<entry>".
+static bool SplitPackagePath(std::string_view path, std::string& package_path, std::string& entry_path)
+{
+    if (!Package_IsPath(path))
+    {
+        return false;
+    }
+    path.remove_prefix(c_package_scheme.size());
+    std::size_t end = path.find(c_package_extension);
+    while (end != std::string_view::npos)
+    {
+        const std::size_t separator = (end + c_package_extension.size());
+        if ((separator < path.size()) && ((path[separator] == '/') || (path[separator] == '\\')))
+        {
+            package_path = std::string(path.substr(0, separator));
+            entry_path = NormalizeEntryPath(path.substr(separator + 1));
+            return true;
+        }
+        end = path.find(c_package_extension, separator);
+    }
+    return false;
+}
+
+bool IsPackageFile(const fs::path& path)
+{
+    return (path.extension() == c_package_extension);
+}
+
+bool Package_IsPath(std::string_view path)
+{
+    return path.starts_with(c_package_scheme);
+}
+
+std::string Package_MakePath(const fs::path& package_path, std::string_view entry_path)
+{
+    std::string path(c_package_scheme);
+    path += package_path.generic_string();
+    path += '/';
+    path += entry_path;
+    return path;
+}
+
+static outcome::result<Package> Package_Load(const fs::path& package_path)
+{
+    auto maybe_file = MappedFile::open(package_path);
+    if (!maybe_file)
+    {
+        return outcome::failure(maybe_file.error());
+    }
+    Package package{};
+    package.file = std::move(maybe_file.value());
+    const std::span<const std::uint8_t> bytes = package.file.bytes();
+
+    PackageHeader header{};
+    if (!ReadPOD(bytes, 0, header))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    if ((std::memcmp(header.magic, c_package_magic, sizeof(c_package_magic)) != 0) //
+        || (header.version != c_package_version)                                 //
+        || (header.chunk_size != c_package_chunk_size))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+
+    // Each chunk & entry takes index bytes: counts the file can't hold are rejected
+    // before they size any allocation.
+    if ((header.index_offset > bytes.size()) //
+        || (header.chunks_count > ((bytes.size() - header.index_offset) / sizeof(PackageChunk))))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    const std::uint64_t entries_offset =
+        header.index_offset + sizeof(PackageChunk) * std::uint64_t(header.chunks_count);
+    if (header.entries_count > ((bytes.size() - entries_offset) / sizeof(PackageFileRecord)))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+
+    std::uint64_t offset = header.index_offset;
+    package.chunks.resize(header.chunks_count);
+    for (PackageChunk& chunk : package.chunks)
+    {
+        if (!ReadPOD(bytes, offset, chunk)                             //
+            || (chunk.offset > bytes.size())                           //
+            || (chunk.compressed_size > (bytes.size() - chunk.offset)) //
+            || (chunk.size > c_package_chunk_size))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        offset += sizeof(PackageChunk);
+    }
+    package.entries.resize(header.entries_count);
+    for (PackageEntry& entry : package.entries)
+    {
+        PackageFileRecord record{};
+        if (!ReadPOD(bytes, offset, record))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        offset += sizeof(record);
+        if ((record.path_size > (bytes.size() - offset))         //
+            || (record.chunks_count != ChunksCount(record.size)) //
+            || (record.first_chunk > package.chunks.size())      //
+            || (record.chunks_count > (package.chunks.size() - record.first_chunk)))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        entry.path.assign(reinterpret_cast<const char*>(bytes.data() + offset), record.path_size);
+        entry.size = record.size;
+        entry.content_hash = record.content_hash;
+        entry.first_chunk = record.first_chunk;
+        entry.chunks_count = record.chunks_count;
+        offset += record.path_size;
+    }
+    const bool sorted = std::is_sorted(
+        std::cbegin(package.entries),
+        std::cend(package.entries),
+        [](const PackageEntry& lhs, const PackageEntry& rhs) { return (lhs.path < rhs.path); }
+    );
+    if (!sorted)
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    return outcome::success(std::move(package));
+}
+
+const PackageEntry* Package::find(std::string_view entry_path) const
+{
+    auto it = std::lower_bound(
+        std::cbegin(entries),
+        std::cend(entries),
+        entry_path,
+        [](const PackageEntry& entry, std::string_view path) { return (entry.path < path); }
+    );
+    if ((it != std::cend(entries)) && (it->path == entry_path))
+    {
+        return &(*it);
+    }
+    return nullptr;
+}
+
+outcome::result<std::vector<std::uint8_t>> Package::read(const PackageEntry& entry) const
+{
+    const std::span<const std::uint8_t> bytes = file.bytes();
+    std::vector<std::uint8_t> data(std::size_t(entry.size));
+    std::atomic<bool> failed{false};
+    GlobalThreadPool().parallel_for(entry.chunks_count, [&](std::size_t i) {
+        const PackageChunk& chunk = chunks[entry.first_chunk + i];
+        const std::size_t offset = (i * c_package_chunk_size);
+        if (chunk.size != std::min<std::uint64_t>(c_package_chunk_size, entry.size - offset))
+        {
+            failed.store(true);
+            return;
+        }
+        const std::uint8_t* src = (bytes.data() + chunk.offset);
+        std::uint8_t* dst = (data.data() + offset);
+        if (chunk.compressed_size == chunk.size)
+        {
+            std::memcpy(dst, src, chunk.size);
+            return;
+        }
+        uLongf dst_size = uLongf(chunk.size);
+        const int status = ::uncompress(dst, &dst_size, src, uLong(chunk.compressed_size));
+        if ((status != Z_OK) || (dst_size != chunk.size))
+        {
+            failed.store(true);
+        }
+    });
+    if (failed.load())
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    return outcome::success(std::move(data));
+}
+
+static std::mutex& PackagesMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::map<fs::path, std::shared_ptr<const Package>>& OpenPackages()
+{
+    static std::map<fs::path, std::shared_ptr<const Package>> packages;
+    return packages;
+}
+
+outcome::result<std::shared_ptr<const Package>> Package_Open(const fs::path& package_path)
+{
+    const fs::path key = package_path.lexically_normal();
+    std::lock_guard<std::mutex> lock(PackagesMutex());
+    auto& packages = OpenPackages();
+    auto it = packages.find(key);
+    if (it != packages.end())
+    {
+        return outcome::success(it->second);
+    }
+    auto maybe_package = Package_Load(key);
+    if (!maybe_package)
+    {
+        return outcome::failure(maybe_package.error());
+    }
+    auto package = std::make_shared<const Package>(std::move(maybe_package.value()));
+    packages[key] = package;
+    return outcome::success(std::move(package));
+}
+
+// Package is rebuilt; its current users keep the old mapping.
+static void Package_Close(const fs::path& package_path)
+{
+    std::lock_guard<std::mutex> lock(PackagesMutex());
+    (void)OpenPackages().erase(package_path.lexically_normal());
+}
+
+outcome::result<PackageEntry> Package_Stat(std::string_view path)
+{
+    std::string package_path;
+    std::string entry_path;
+    if (!SplitPackagePath(path, package_path, entry_path))
+    {
+        return outcome::failure(std::errc::invalid_argument);
+    }
+    auto maybe_package = Package_Open(package_path);
+    if (!maybe_package)
+    {
+        return outcome::failure(maybe_package.error());
+    }
+    const PackageEntry* entry = maybe_package.value()->find(entry_path);
+    if (!entry)
+    {
+        return outcome::failure(std::errc::no_such_file_or_directory);
+    }
+    return outcome::success(*entry);
+}
+
+outcome::result<std::vector<std::uint8_t>> Package_ReadFile(std::string_view path)
+{
+    std::string package_path;
+    std::string entry_path;
+    if (!SplitPackagePath(path, package_path, entry_path))
+    {
+        return outcome::failure(std::errc::invalid_argument);
+    }
+    auto maybe_package = Package_Open(package_path);
+    if (!maybe_package)
+    {
+        return outcome::failure(maybe_package.error());
+    }
+    const Package& package = *maybe_package.value();
+    const PackageEntry* entry = package.find(entry_path);
+    if (!entry)
+    {
+        return outcome::failure(std::errc::no_such_file_or_directory);
+    }
+    return package.read(*entry);
+}
+
+bool Package_Build(const fs::path& folder, const fs::path& package_path)
+{
+    const StopWatch timer;
+    std::vector<PackageEntry> entries;
+    std::vector<fs::path> files;
+    {
+        std::error_code ec;
+        for (const auto& e : fs::recursive_directory_iterator(folder, ec))
+        {
+            if (e.is_regular_file() && !IsPackageFile(e.path()))
+            {
+                files.push_back(e.path());
+            }
+        }
+        if (ec)
+        {
+            return false;
+        }
+    }
+    for (const fs::path& file : files)
+    {
+        PackageEntry& entry = entries.emplace_back();
+        entry.path = file.lexically_relative(folder).generic_string();
+    }
+    std::vector<std::size_t> order(files.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::sort(std::begin(order), std::end(order), [&](std::size_t lhs, std::size_t rhs) {
+        return (entries[lhs].path < entries[rhs].path);
+    });
+
+    std::error_code ec;
+    fs::create_directories(package_path.parent_path(), ec);
+    // Write to a temporary file first so a crash never leaves half-written package.
+    fs::path temp_path = package_path;
+    temp_path += ".tmp";
+    std::vector<PackageChunk> chunks;
+    std::uint64_t source_size = 0;
+    std::uint64_t written = 0;
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            return false;
+        }
+        auto write = [&](const void* data, std::uint64_t size) {
+            out.write(static_cast<const char*>(data), std::streamsize(size));
+            written += size;
+        };
+
+        PackageHeader header{};
+        write(&header, sizeof(header));
+        for (std::size_t i : order)
+        {
+            MappedFile mapped;
+            if (auto maybe_source = MappedFile::open(files[i]))
+            {
+                mapped = std::move(maybe_source.value());
+            }
+            else if ((fs::file_size(files[i], ec) != 0) || ec)
+            {
+                // Empty files can't be mapped; anything else is an error.
+                return false;
+            }
+            const std::span<const std::uint8_t> source = mapped.bytes();
+            PackageEntry& entry = entries[i];
+            entry.size = source.size();
+            entry.content_hash = Hash64(source.data(), source.size());
+            entry.first_chunk = std::uint32_t(chunks.size());
+            entry.chunks_count = std::uint32_t(ChunksCount(entry.size));
+            source_size += entry.size;
+
+            // Chunks are independent; compress all of the file at once.
+            std::vector<std::vector<std::uint8_t>> compressed(entry.chunks_count);
+            GlobalThreadPool().parallel_for(entry.chunks_count, [&](std::size_t k) {
+                const std::size_t offset = (k * c_package_chunk_size);
+                const std::span<const std::uint8_t> raw =
+                    source.subspan(offset, std::min<std::size_t>(c_package_chunk_size, source.size() - offset));
+                std::vector<std::uint8_t>& dst = compressed[k];
+                dst.resize(::compressBound(uLong(raw.size())));
+                uLongf dst_size = uLongf(dst.size());
+                const int status =
+                    ::compress2(dst.data(), &dst_size, raw.data(), uLong(raw.size()), Z_DEFAULT_COMPRESSION);
+                if ((status != Z_OK) || (dst_size >= raw.size()))
+                {
+                    // Not compressible; stored as is.
+                    dst.assign(raw.begin(), raw.end());
+                    return;
+                }
+                dst.resize(dst_size);
+            });
+            const std::uint64_t chunk_bytes = c_package_chunk_size;
+            for (std::uint32_t k = 0; k < entry.chunks_count; ++k)
+            {
+                PackageChunk chunk{};
+                chunk.offset = written;
+                chunk.compressed_size = std::uint32_t(compressed[k].size());
+                chunk.size = std::uint32_t(std::min<std::uint64_t>(c_package_chunk_size, entry.size - k * chunk_bytes));
+                chunks.push_back(chunk);
+                write(compressed[k].data(), compressed[k].size());
+            }
+        }
+
+        std::memcpy(header.magic, c_package_magic, sizeof(c_package_magic));
+        header.version = c_package_version;
+        header.chunk_size = c_package_chunk_size;
+        header.entries_count = std::uint32_t(entries.size());
+        header.chunks_count = std::uint32_t(chunks.size());
+        header.index_offset = written;
+        write(chunks.data(), sizeof(PackageChunk) * chunks.size());
+        for (std::size_t i : order)
+        {
+            const PackageEntry& entry = entries[i];
+            PackageFileRecord record{};
+            record.size = entry.size;
+            record.content_hash = entry.content_hash;
+            record.first_chunk = entry.first_chunk;
+            record.chunks_count = entry.chunks_count;
+            record.path_size = std::uint32_t(entry.path.size());
+            write(&record, sizeof(record));
+            write(entry.path.data(), entry.path.size());
+        }
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!out)
+        {
+            return false;
+        }
+    }
+    Package_Close(package_path);
+    fs::rename(temp_path, package_path, ec);
+    if (ec)
+    {
+        return false;
+    }
+    LogDebug(
+        "[package] '%s': %u files, %.2f MB -> %.2f MB: %.2f ms.\n",
+        package_path.string().c_str(),
+        unsigned(entries.size()),
+        double(source_size) / double(1 << 20),
+        double(written) / double(1 << 20),
+        timer.elapsed_ms()
+    );
+    return true;
+}
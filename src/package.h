@@ -0,0 +1,59 @@
+#pragma once
+#include "mapped_file.h"
+#include "utils_outcome.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+// Files of a folder packed into a single .rpkg file: zlib-compressed chunks
+// of c_package_chunk_size bytes and an index. A package is mapped once per
+// process (see Package_Open()); chunks of a file are decompressed in parallel.
+// Packed files are addressed as "pkg://<package>.rpkg/<path in the folder>"
+// and are loaded by LoadModel() the same way as files on disk.
+
+struct PackageChunk
+{
+    std::uint64_t offset; // from the beginning of the package
+    std::uint32_t compressed_size;
+    std::uint32_t size; // == compressed_size when stored as is
+};
+
+struct PackageEntry
+{
+    std::string path; // relative to the packed folder, '/'-separated
+    std::uint64_t size;
+    std::uint64_t content_hash; // Hash64() of the uncompressed bytes
+    std::uint32_t first_chunk;
+    std::uint32_t chunks_count;
+};
+
+struct Package
+{
+    MappedFile file;
+    std::vector<PackageEntry> entries; // sorted by path
+    std::vector<PackageChunk> chunks;
+
+    const PackageEntry* find(std::string_view entry_path) const;
+    // Decompresses chunks on GlobalThreadPool().
+    outcome::result<std::vector<std::uint8_t>> read(const PackageEntry& entry) const;
+};
+
+// .rpkg
+bool IsPackageFile(const std::filesystem::path& path);
+// Starts with "pkg://".
+bool Package_IsPath(std::string_view path);
+std::string Package_MakePath(const std::filesystem::path& package_path, std::string_view entry_path);
+
+// Mapped on first use and kept open.
+outcome::result<std::shared_ptr<const Package>> Package_Open(const std::filesystem::path& package_path);
+// For "pkg://" paths: entry of a packed file, without reading it.
+outcome::result<PackageEntry> Package_Stat(std::string_view path);
+outcome::result<std::vector<std::uint8_t>> Package_ReadFile(std::string_view path);
+
+// Packs all files of the folder (recursively), skipping packages.
+bool Package_Build(const std::filesystem::path& folder, const std::filesystem::path& package_path);
@@ -1,5 +1,10 @@
 #include "render_model.h"
 #include "shaders_compiler.h"
+#include "texture_mips.h"
+#include "utils_log.h"
+
+#include <algorithm>
+#include <vector>
 
 static constexpr DXGI_FORMAT GetIndexBufferFormat()
 {
@@ -15,39 +20,131 @@ static constexpr DXGI_FORMAT GetIndexBufferFormat()
     // (Control reaching the end of a constexpr function).
 }
 
-static ID3D11ShaderResourceView* GetTexture(const RenderModel& model, std::uint32_t id)
+static DXGI_FORMAT GetTextureFormat(TextureFormat format, bool srgb)
 {
+    switch (format)
+    {
+    case TextureFormat::RGBA8:
+        return (srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM);
+    case TextureFormat::BC1:
+        return (srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM);
+    case TextureFormat::BC3:
+        return (srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM);
+    case TextureFormat::BC5:
+        return DXGI_FORMAT_BC5_UNORM; // normal map, not color
+    case TextureFormat::BC7:
+        return (srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM);
+    }
+    Unreachable();
+}
+
+// Binds & constant buffer updates of RenderModel::render(), besides textures:
+// once per model: topology, input layout, VS, VS constants (update & bind), PS, PS constants, sampler;
+// per draw: vertex & index buffers (+ PS constants update, if they are not the same as the previous draw's;
+// + VS constants update, if the mesh is of PackedVertex of other bounds than the previous draw's).
+static constexpr std::uint32_t c_binds_per_model = 8;
+static constexpr std::uint32_t c_binds_per_draw = 2;
+
+static const RenderTexture* FindTexture(const RenderModel& model, std::uint32_t id)
+{
+    if (id < model.texture_lookup_.size())
+    {
+        const std::uint32_t index = model.texture_lookup_[id];
+        if ((index < model.textures.size()) && (model.textures[index].texture_id == id))
+        {
+            return &model.textures[index];
+        }
+    }
+    // Not packed yet (textures are still arriving).
     for (const RenderTexture& texture : model.textures)
     {
         if (texture.texture_id == id)
         {
-            Panic(texture.texture_view);
-            return texture.texture_view.Get();
+            Panic(texture.texture_view || (texture.array_index < model.texture_arrays_.size()));
+            return &texture;
         }
     }
     return nullptr;
 }
 
-/*static*/ RenderMesh RenderMesh::make(ID3D11Device& device, const Mesh& mesh)
+// Texture for slot 0/1, array for slot 2/3 (see ps_basic_phong_lighting.hlsl).
+static ID3D11ShaderResourceView* GetTextureView(const RenderModel& model, const RenderTexture* texture, bool from_array)
+{
+    if (!texture)
+    {
+        return nullptr;
+    }
+    // Null once packed: not sampled as a texture then.
+    return from_array ? model.texture_arrays_[texture->array_index].Get() : texture->texture_view.Get();
+}
+
+// Per slot: a packed texture is sampled from its array, even if the other texture of the mesh is not packed.
+static bool IsFromArray(const RenderTexture* texture)
+{
+    return texture && texture->is_packed();
+}
+
+// PSConstantBuffer0::texture_slices of the mesh.
+static glm::vec4 GetTextureSlices(const RenderTexture* diffuse, const RenderTexture* normal)
+{
+    const bool diffuse_array = IsFromArray(diffuse);
+    const bool normal_array = IsFromArray(normal);
+    return glm::vec4(
+        diffuse_array ? float(diffuse->array_slice) : 0.f,
+        normal_array ? float(normal->array_slice) : 0.f,
+        diffuse_array ? 1.f : 0.f,
+        normal_array ? 1.f : 0.f
+    );
+}
+
+/*static*/ RenderMesh RenderMesh::make(ID3D11Device& device, const Mesh& mesh, bool pack_vertices)
 {
     RenderMesh render{};
     render.indices_count = UINT(mesh.indices.size());
     render.ps_texture_diffuse = mesh.texture_diffuse_id;
     render.ps_texture_normal = mesh.texture_normal_id;
+    render.vertices_count = std::uint32_t(mesh.vertices.size());
+    render.packed_vertices = pack_vertices;
+
+    // Temporary, for the upload only.
+    std::vector<PackedVertex> packed;
+    std::vector<PackedTangent> tangents;
+    if (render.packed_vertices)
+    {
+        packed.resize(mesh.vertices.size());
+        // Only the normal map reads tangents.
+        if (mesh.texture_normal_id != std::uint32_t(-1))
+        {
+            tangents.resize(mesh.vertices.size());
+        }
+        render.dequantize = VertexPacked_Pack(mesh.vertices, packed, tangents, render.pack_error);
+    }
+    const std::size_t vertex_size = (render.packed_vertices ? sizeof(PackedVertex) : sizeof(Vertex));
+    render.memory_bytes = (mesh.vertices.size() * vertex_size + mesh.indices.size_bytes());
+    render.memory_bytes += (tangents.size() * sizeof(PackedTangent));
 
     D3D11_BUFFER_DESC bd{};
 
     // VB.
     Panic(!mesh.vertices.empty());
     bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = UINT(mesh.vertices.size() * sizeof(Vertex));
+    bd.ByteWidth = UINT(mesh.vertices.size() * vertex_size);
     bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     bd.CPUAccessFlags = 0;
     D3D11_SUBRESOURCE_DATA InitData{};
-    InitData.pSysMem = mesh.vertices.data();
+    InitData.pSysMem = (render.packed_vertices ? static_cast<const void*>(packed.data()) : mesh.vertices.data());
     HRESULT hr = device.CreateBuffer(&bd, &InitData, &render.vertex_buffer);
     Panic(SUCCEEDED(hr));
 
+    // Tangents VB.
+    if (!tangents.empty())
+    {
+        bd.ByteWidth = UINT(tangents.size() * sizeof(PackedTangent));
+        InitData.pSysMem = tangents.data();
+        hr = device.CreateBuffer(&bd, &InitData, &render.tangent_buffer);
+        Panic(SUCCEEDED(hr));
+    }
+
     // IB.
     Panic(!mesh.indices.empty());
     bd.Usage = D3D11_USAGE_DEFAULT;
@@ -65,13 +162,25 @@ static ID3D11ShaderResourceView* GetTexture(const RenderModel& model, std::uint3
 {
     RenderTexture render{};
     render.texture_id = texture.id;
+    render.format = texture.format;
+    render.memory_bytes = texture.data.size_bytes();
+    render.content_key = texture.content_key;
+    if (texture.content_key != 0)
+    {
+        if (SharedTextureView shared_view = GlobalTextureShare().find_view(texture.content_key))
+        {
+            render.texture_view = shared_view.get();
+            render.shared_view = std::move(shared_view);
+            return render;
+        }
+    }
 
     D3D11_TEXTURE2D_DESC t2d_desc{};
     t2d_desc.Width = texture.width;
     t2d_desc.Height = texture.height;
-    t2d_desc.MipLevels = 1;
+    t2d_desc.MipLevels = texture.mips_count;
     t2d_desc.ArraySize = 1;
-    t2d_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    t2d_desc.Format = GetTextureFormat(texture.format, texture.srgb);
     t2d_desc.SampleDesc.Count = 1;
     t2d_desc.SampleDesc.Quality = 0;
     t2d_desc.Usage = D3D11_USAGE_DEFAULT;
@@ -79,27 +188,57 @@ static ID3D11ShaderResourceView* GetTexture(const RenderModel& model, std::uint3
     t2d_desc.CPUAccessFlags = 0;
     t2d_desc.MiscFlags = 0;
 
-    D3D11_SUBRESOURCE_DATA subresource{};
-    subresource.pSysMem = texture.data.data();
-    subresource.SysMemPitch = (texture.width * c_texture_channels);
-    subresource.SysMemSlicePitch = 0; // not used for 2d textures.
+    // One per mip, from the chain.
+    std::vector<D3D11_SUBRESOURCE_DATA> subresources(texture.mips_count);
+    for (std::uint32_t mip = 0; mip < texture.mips_count; ++mip)
+    {
+        D3D11_SUBRESOURCE_DATA& subresource = subresources[mip];
+        subresource.pSysMem =
+            texture.data.data() + TextureMips_LevelOffset(texture.format, texture.width, texture.height, mip);
+        // Of a row of 4x4 blocks for block-compressed formats.
+        subresource.SysMemPitch = TextureMips_RowPitch(texture.format, texture.width, mip);
+        subresource.SysMemSlicePitch = 0; // not used for 2d textures.
+    }
 
     ComPtr<ID3D11Texture2D> texture2d;
-    HRESULT hr = device.CreateTexture2D(&t2d_desc, &subresource, &texture2d);
+    HRESULT hr = device.CreateTexture2D(&t2d_desc, subresources.data(), &texture2d);
     Panic(SUCCEEDED(hr));
 
     D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
-    SRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    SRVDesc.Format = t2d_desc.Format;
     SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    SRVDesc.Texture2D.MipLevels = 1;
+    SRVDesc.Texture2D.MipLevels = texture.mips_count;
 
     hr = device.CreateShaderResourceView(texture2d.Get(), &SRVDesc, &render.texture_view);
     Panic(SUCCEEDED(hr));
 
+    if (texture.content_key != 0)
+    {
+        // Or the one uploaded meanwhile by another thread.
+        render.shared_view =
+            GlobalTextureShare().share_view(texture.content_key, render.texture_view.Get(), render.memory_bytes);
+        render.texture_view = render.shared_view.get();
+    }
     return render;
 }
 
 /*static*/ RenderModel RenderModel::make(ID3D11Device& device, const Model& model)
+{
+    RenderModel render = make(device);
+    render.aabb_min = model.aabb_min();
+    render.aabb_max = model.aabb_max();
+    for (std::uint32_t i = 0; i < model.meshes_count(); ++i)
+    {
+        render.meshes.push_back(RenderMesh::make(device, model.get_mesh(i), render.pack_vertices_));
+    }
+    for (std::uint32_t i = 0; i < model.textures_count(); ++i)
+    {
+        render.textures.push_back(RenderTexture::make(device, model.get_texture(i)));
+    }
+    return render;
+}
+
+/*static*/ RenderModel RenderModel::make(ID3D11Device& device)
 {
     RenderModel render{};
 
@@ -129,19 +268,285 @@ static ID3D11ShaderResourceView* GetTexture(const RenderModel& model, std::uint3
     sampler_desc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
     sampler_desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
     sampler_desc.MinLOD = 0;
-    sampler_desc.MaxLOD = 0;
+    sampler_desc.MaxLOD = D3D11_FLOAT32_MAX; // all mips of Texture
     hr = device.CreateSamplerState(&sampler_desc, &render.sampler_linear_);
     Panic(SUCCEEDED(hr));
 
-    for (std::uint32_t i = 0; i < model.meshes_count(); ++i)
+    // Zero tangent (decodes as +Z; never read without a normal map).
+    const PackedTangent no_tangent{};
+    D3D11_BUFFER_DESC tangent_bd{};
+    tangent_bd.Usage = D3D11_USAGE_IMMUTABLE;
+    tangent_bd.ByteWidth = sizeof(PackedTangent);
+    tangent_bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    tangent_bd.CPUAccessFlags = 0;
+    D3D11_SUBRESOURCE_DATA tangent_data{};
+    tangent_data.pSysMem = &no_tangent;
+    hr = device.CreateBuffer(&tangent_bd, &tangent_data, &render.no_tangent_buffer_);
+    Panic(SUCCEEDED(hr));
+    return render;
+}
+
+std::size_t RenderModel::memory_bytes() const
+{
+    std::size_t bytes = 0;
+    for (const RenderMesh& mesh : meshes)
     {
-        render.meshes.push_back(RenderMesh::make(device, model.get_mesh(i)));
+        bytes += mesh.memory_bytes;
     }
-    for (std::uint32_t i = 0; i < model.textures_count(); ++i)
+    for (const RenderTexture& texture : textures)
     {
-        render.textures.push_back(RenderTexture::make(device, model.get_texture(i)));
+        bytes += texture.memory_bytes;
     }
-    return render;
+    return bytes;
+}
+
+VertexPackStats RenderModel::vertex_pack_stats() const
+{
+    VertexPackStats stats{};
+    for (const RenderMesh& mesh : meshes)
+    {
+        if (!mesh.packed_vertices)
+        {
+            continue;
+        }
+        ++stats.meshes;
+        stats.bytes_before += (std::size_t(mesh.vertices_count) * sizeof(Vertex));
+        stats.bytes_after += (std::size_t(mesh.vertices_count) * sizeof(PackedVertex));
+        if (mesh.tangent_buffer.Get())
+        {
+            stats.bytes_after += (std::size_t(mesh.vertices_count) * sizeof(PackedTangent));
+        }
+        VertexPackError& error = stats.max_error;
+        error.position = std::max(error.position, mesh.pack_error.position);
+        error.position_relative = std::max(error.position_relative, mesh.pack_error.position_relative);
+        error.normal_degrees = std::max(error.normal_degrees, mesh.pack_error.normal_degrees);
+        error.tangent_degrees = std::max(error.tangent_degrees, mesh.pack_error.tangent_degrees);
+        error.texture_coord = std::max(error.texture_coord, mesh.pack_error.texture_coord);
+    }
+    return stats;
+}
+
+// Walks the meshes the same way render() does.
+static void CountBinds(const RenderModel& model, TexturePackStats& stats)
+{
+    const std::uint32_t draws = std::uint32_t(model.meshes.size());
+    // One per mesh's buffers, with or without arrays.
+    stats.draws_before = draws;
+    stats.draws_after = draws;
+    // Everything, PS constants update included, for every draw.
+    stats.binds_before = draws * (c_binds_per_model + c_binds_per_draw + 1);
+    stats.binds_after = c_binds_per_model + draws * c_binds_per_draw;
+    stats.texture_binds_before = 0;
+    stats.texture_binds_after = 0;
+    const ID3D11ShaderResourceView* bound_views[4]{};
+    bool has_constants = false;
+    float last_is_bc5 = 0.f;
+    float last_has_normal = 0.f;
+    glm::vec4 last_slices{};
+    const VertexDequantize* last_dequantize = nullptr;
+    for (const RenderMesh& mesh : model.meshes)
+    {
+        if (mesh.packed_vertices)
+        {
+            // First update is the per model one.
+            const bool changed = last_dequantize && (mesh.dequantize != *last_dequantize);
+            stats.binds_after += (changed ? 1u : 0u);
+            last_dequantize = &mesh.dequantize;
+        }
+        const RenderTexture* diffuse = FindTexture(model, mesh.ps_texture_diffuse);
+        const RenderTexture* normal = FindTexture(model, mesh.ps_texture_normal);
+        stats.texture_binds_before += (diffuse ? 1u : 0u) + (normal ? 1u : 0u);
+        // Per mesh PS constants: parameters.z & w, texture_slices.
+        const float is_bc5 = (normal && (normal->format == TextureFormat::BC5)) ? 1.f : 0.f;
+        const float has_normal = (normal ? 1.f : 0.f);
+        const glm::vec4 slices = GetTextureSlices(diffuse, normal);
+        if (!has_constants || (is_bc5 != last_is_bc5) || (has_normal != last_has_normal) || (slices != last_slices))
+        {
+            ++stats.binds_after;
+            has_constants = true;
+            last_is_bc5 = is_bc5;
+            last_has_normal = has_normal;
+            last_slices = slices;
+        }
+        const RenderTexture* slot_textures[2] = {diffuse, normal};
+        for (UINT i = 0; i < 2; ++i)
+        {
+            const bool from_array = IsFromArray(slot_textures[i]);
+            const UINT slot = (from_array ? 2 + i : i);
+            const ID3D11ShaderResourceView* view = GetTextureView(model, slot_textures[i], from_array);
+            if (view && (view != bound_views[slot]))
+            {
+                ++stats.texture_binds_after;
+                bound_views[slot] = view;
+            }
+        }
+    }
+    stats.binds_before += stats.texture_binds_before;
+    stats.binds_after += stats.texture_binds_after;
+}
+
+// Uploaded once for other models too (see texture_share.h): packing would copy it.
+static bool IsSharedWithOthers(const RenderTexture& texture)
+{
+    return texture.shared_view && GlobalTextureShare().is_shared(texture.content_key);
+}
+
+bool RenderModel::pack_textures(ID3D11Device& device, ID3D11DeviceContext& device_context)
+{
+    bool all_packed = true;
+    bool lookup_valid = true;
+    std::uint32_t ids_count = 0;
+    std::vector<bool> to_pack(textures.size());
+    for (std::size_t i = 0; i < textures.size(); ++i)
+    {
+        const RenderTexture& texture = textures[i];
+        to_pack[i] = texture.is_packed() || !IsSharedWithOthers(texture);
+        all_packed = all_packed && (texture.is_packed() || !to_pack[i]);
+        lookup_valid = lookup_valid && (texture.texture_id < texture_lookup_.size())
+                       && (texture_lookup_[texture.texture_id] == i);
+        ids_count = std::max(ids_count, texture.texture_id + 1);
+    }
+    if (!lookup_valid)
+    {
+        texture_lookup_.assign(ids_count, ~std::uint32_t(0));
+        for (std::size_t i = 0; i < textures.size(); ++i)
+        {
+            texture_lookup_[textures[i].texture_id] = std::uint32_t(i);
+        }
+    }
+    if (all_packed)
+    {
+        if (textures.empty())
+        {
+            texture_arrays_.clear();
+        }
+        return false;
+    }
+
+    const StopWatch timer;
+    // Single texture or a slice of the current arrays.
+    struct Source
+    {
+        ComPtr<ID3D11Texture2D> texture;
+        UINT slice = 0;
+        D3D11_TEXTURE2D_DESC desc{}; // ArraySize = 1
+    };
+    std::vector<Source> sources(textures.size());
+    for (std::size_t i = 0; i < textures.size(); ++i)
+    {
+        if (!to_pack[i])
+        {
+            continue;
+        }
+        const RenderTexture& texture = textures[i];
+        Source& source = sources[i];
+        ComPtr<ID3D11Resource> resource;
+        GetTextureView(*this, &texture, texture.is_packed())->GetResource(&resource);
+        HRESULT hr = resource.As(&source.texture);
+        Panic(SUCCEEDED(hr));
+        source.texture->GetDesc(&source.desc);
+        source.desc.ArraySize = 1;
+        source.slice = (texture.is_packed() ? texture.array_slice : 0);
+    }
+
+    // Textures indices; in order of the first use, same as the draws.
+    std::vector<std::vector<std::uint32_t>> groups;
+    for (std::uint32_t i = 0; i < std::uint32_t(sources.size()); ++i)
+    {
+        if (!to_pack[i])
+        {
+            continue;
+        }
+        const D3D11_TEXTURE2D_DESC& desc = sources[i].desc;
+        auto it = std::find_if(groups.begin(), groups.end(), [&](const std::vector<std::uint32_t>& group) {
+            const D3D11_TEXTURE2D_DESC& other = sources[group[0]].desc;
+            return (group.size() < std::size_t(D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION)) && (other.Width == desc.Width)
+                   && (other.Height == desc.Height) && (other.MipLevels == desc.MipLevels)
+                   && (other.Format == desc.Format);
+        });
+        if (it == groups.end())
+        {
+            groups.emplace_back();
+            it = groups.end() - 1;
+        }
+        it->push_back(i);
+    }
+
+    std::vector<ComPtr<ID3D11ShaderResourceView>> arrays;
+    arrays.reserve(groups.size());
+    for (const std::vector<std::uint32_t>& group : groups)
+    {
+        D3D11_TEXTURE2D_DESC t2d_desc = sources[group[0]].desc;
+        t2d_desc.ArraySize = UINT(group.size());
+        t2d_desc.Usage = D3D11_USAGE_DEFAULT;
+        t2d_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        t2d_desc.CPUAccessFlags = 0;
+        t2d_desc.MiscFlags = 0;
+        ComPtr<ID3D11Texture2D> texture2d;
+        HRESULT hr = device.CreateTexture2D(&t2d_desc, nullptr, &texture2d);
+        Panic(SUCCEEDED(hr));
+
+        const UINT mips = t2d_desc.MipLevels;
+        for (UINT slice = 0; slice < t2d_desc.ArraySize; ++slice)
+        {
+            const Source& source = sources[group[slice]];
+            for (UINT mip = 0; mip < mips; ++mip)
+            {
+                device_context.CopySubresourceRegion(
+                    texture2d.Get(),
+                    D3D11CalcSubresource(mip, slice, mips),
+                    0,
+                    0,
+                    0,
+                    source.texture.Get(),
+                    D3D11CalcSubresource(mip, source.slice, mips),
+                    nullptr
+                );
+            }
+        }
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
+        SRVDesc.Format = t2d_desc.Format;
+        SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+        SRVDesc.Texture2DArray.MostDetailedMip = 0;
+        SRVDesc.Texture2DArray.MipLevels = mips;
+        SRVDesc.Texture2DArray.FirstArraySlice = 0;
+        SRVDesc.Texture2DArray.ArraySize = t2d_desc.ArraySize;
+        ComPtr<ID3D11ShaderResourceView> array_view;
+        hr = device.CreateShaderResourceView(texture2d.Get(), &SRVDesc, &array_view);
+        Panic(SUCCEEDED(hr));
+
+        for (std::uint32_t slice = 0; slice < std::uint32_t(group.size()); ++slice)
+        {
+            RenderTexture& texture = textures[group[slice]];
+            // Single textures are released here, previous arrays below.
+            texture.texture_view.Reset();
+            texture.shared_view.reset();
+            texture.array_index = std::uint32_t(arrays.size());
+            texture.array_slice = slice;
+        }
+        arrays.push_back(std::move(array_view));
+    }
+    texture_arrays_ = std::move(arrays);
+
+    pack_stats_ = TexturePackStats{};
+    pack_stats_.textures = std::uint32_t(std::count(to_pack.begin(), to_pack.end(), true));
+    pack_stats_.arrays = std::uint32_t(texture_arrays_.size());
+    CountBinds(*this, pack_stats_);
+    LogDebug(
+        "[texture] packed %u textures into %u arrays in %.1f ms; per frame: %u -> %u texture binds, "
+        "%u -> %u binds, %u -> %u draws.\n",
+        pack_stats_.textures,
+        pack_stats_.arrays,
+        timer.elapsed_ms(),
+        pack_stats_.texture_binds_before,
+        pack_stats_.texture_binds_after,
+        pack_stats_.binds_before,
+        pack_stats_.binds_after,
+        pack_stats_.draws_before,
+        pack_stats_.draws_after
+    );
+    return true;
 }
 
 void RenderModel::render(ID3D11DeviceContext& device_context, const glm::mat4x4& view, const glm::mat4x4& projection)
@@ -159,9 +564,9 @@ void RenderModel::render(ID3D11DeviceContext& device_context, const glm::mat4x4&
 
     // Put a flag that there is actually no needed textures
     // (decide by looking at fist mesh; they all the same).
-    const bool has_texture = (meshes.size() > 0)                                //
-                             && GetTexture(*this, meshes[0].ps_texture_diffuse) //
-                             && GetTexture(*this, meshes[0].ps_texture_normal);
+    const bool has_texture = (meshes.size() > 0)                                 //
+                             && FindTexture(*this, meshes[0].ps_texture_diffuse) //
+                             && FindTexture(*this, meshes[0].ps_texture_normal);
 
     // Parameters for PS.
     PSConstantBuffer0 ps_cb0;
@@ -173,33 +578,89 @@ void RenderModel::render(ID3D11DeviceContext& device_context, const glm::mat4x4&
     ps_cb0.parameters.x = (has_texture ? 1.f : 0.f);
     ps_cb0.parameters.y = 1.f; // Lights count.
 
+    // Same for all meshes (c_binds_per_model); input layout, VS & VS constants
+    // are set by the first draw (again only if the vertex format/bounds change).
+    // Input Assembler.
+    device_context.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    // Vertex Shader.
+    device_context.VSSetConstantBuffers(0, 1, vs_constant_buffer0_.GetAddressOf());
+    // Pixel Shader.
+    device_context.PSSetShader(ps_shader_->ps.Get(), nullptr, 0);
+    device_context.PSSetConstantBuffers(0, 1, ps_constant_buffer0_.GetAddressOf());
+    // Use same sampler for both normal & diffuse textures.
+    device_context.PSSetSamplers(0, 1, sampler_linear_.GetAddressOf());
+
+    // Set by this call; other models (or ImGui) may have changed them since the last frame.
+    const VSShader* bound_vs = nullptr;
+    bool has_vs_cb0 = false;
+    ID3D11ShaderResourceView* bound_views[4]{};
+    bool has_ps_cb0 = false;
+    glm::vec4 last_parameters{};
+    glm::vec4 last_slices{};
     for (const RenderMesh& render_mesh : meshes)
     {
-        UINT stride = sizeof(Vertex);
-        UINT offset = 0;
+        const VSShader* vs = (render_mesh.packed_vertices ? vs_packed_shader_ : vs_shader_);
+        Panic(vs);
+        if (vs != bound_vs)
+        {
+            device_context.IASetInputLayout(vs->vs_layout.Get());
+            device_context.VSSetShader(vs->vs.Get(), nullptr, 0);
+            bound_vs = vs;
+        }
+        if (!has_vs_cb0 || (render_mesh.packed_vertices && (render_mesh.dequantize != vs_cb0.dequantize)))
+        {
+            vs_cb0.dequantize = render_mesh.dequantize;
+            device_context.UpdateSubresource(vs_constant_buffer0_.Get(), 0, nullptr, &vs_cb0, 0, 0);
+            has_vs_cb0 = true;
+        }
+
+        const RenderTexture* diffuse_texture = FindTexture(*this, render_mesh.ps_texture_diffuse);
+        const RenderTexture* normal_texture = FindTexture(*this, render_mesh.ps_texture_normal);
+        ps_cb0.parameters.z = (normal_texture && (normal_texture->format == TextureFormat::BC5)) ? 1.f : 0.f;
+        ps_cb0.parameters.w = (normal_texture ? 1.f : 0.f);
+        ps_cb0.texture_slices = GetTextureSlices(diffuse_texture, normal_texture);
+        if (!has_ps_cb0 || (ps_cb0.parameters != last_parameters) || (ps_cb0.texture_slices != last_slices))
+        {
+            device_context.UpdateSubresource(ps_constant_buffer0_.Get(), 0, nullptr, &ps_cb0, 0, 0);
+            has_ps_cb0 = true;
+            last_parameters = ps_cb0.parameters;
+            last_slices = ps_cb0.texture_slices;
+        }
+        // Array or single texture, per slot.
+        const RenderTexture* slot_textures[2] = {diffuse_texture, normal_texture};
+        for (UINT i = 0; i < 2; ++i)
+        {
+            const bool from_array = IsFromArray(slot_textures[i]);
+            const UINT slot = (from_array ? 2 + i : i);
+            ID3D11ShaderResourceView* texture_view = GetTextureView(*this, slot_textures[i], from_array);
+            // Keep the previous one if there is none, as before.
+            if (texture_view && (texture_view != bound_views[slot]))
+            {
+                device_context.PSSetShaderResources(slot, 1, &texture_view);
+                bound_views[slot] = texture_view;
+            }
+        }
+
         // Input Assembler.
-        device_context.IASetVertexBuffers(0, 1, render_mesh.vertex_buffer.GetAddressOf(), &stride, &offset);
-        device_context.IASetIndexBuffer(render_mesh.index_buffer.Get(), GetIndexBufferFormat(), 0);
-        device_context.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        device_context.IASetInputLayout(vs_shader_->vs_layout.Get());
-        // Vertex Shader.
-        device_context.VSSetShader(vs_shader_->vs.Get(), nullptr, 0);
-        device_context.UpdateSubresource(vs_constant_buffer0_.Get(), 0, nullptr, &vs_cb0, 0, 0);
-        device_context.VSSetConstantBuffers(0, 1, vs_constant_buffer0_.GetAddressOf());
-        // Pixel Shader.
-        device_context.PSSetShader(ps_shader_->ps.Get(), nullptr, 0);
-        device_context.UpdateSubresource(ps_constant_buffer0_.Get(), 0, nullptr, &ps_cb0, 0, 0);
-        device_context.PSSetConstantBuffers(0, 1, ps_constant_buffer0_.GetAddressOf());
-        // Use same sampler for both normal & diffuse textures.
-        device_context.PSSetSamplers(0, 1, sampler_linear_.GetAddressOf());
-        if (ID3D11ShaderResourceView* ps_texture_diffuse = GetTexture(*this, render_mesh.ps_texture_diffuse))
-        {
-            device_context.PSSetShaderResources(0, 1, &ps_texture_diffuse);
-        }
-        if (ID3D11ShaderResourceView* ps_texture_normal = GetTexture(*this, render_mesh.ps_texture_normal))
-        {
-            device_context.PSSetShaderResources(1, 1, &ps_texture_normal);
+        if (render_mesh.packed_vertices)
+        {
+            // Tangents as a second stream; the shared zero one (stride 0) without a normal map.
+            const bool has_tangents = (render_mesh.tangent_buffer.Get() != nullptr);
+            ID3D11Buffer* buffers[2] = {
+                render_mesh.vertex_buffer.Get(),
+                (has_tangents ? render_mesh.tangent_buffer.Get() : no_tangent_buffer_.Get())
+            };
+            UINT strides[2] = {sizeof(PackedVertex), (has_tangents ? UINT(sizeof(PackedTangent)) : 0u)};
+            UINT offsets[2] = {0, 0};
+            device_context.IASetVertexBuffers(0, 2, buffers, strides, offsets);
+        }
+        else
+        {
+            UINT stride = sizeof(Vertex);
+            UINT offset = 0;
+            device_context.IASetVertexBuffers(0, 1, render_mesh.vertex_buffer.GetAddressOf(), &stride, &offset);
         }
+        device_context.IASetIndexBuffer(render_mesh.index_buffer.Get(), GetIndexBufferFormat(), 0);
 
         // Actual draw call.
         device_context.DrawIndexed(render_mesh.indices_count, 0, 0);
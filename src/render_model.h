@@ -2,7 +2,9 @@
 #include "dx_api.h"
 #include "model.h"
 #include "shaders_compiler.h"
+#include "texture_share.h"
 #include "utils.h"
+#include "vertex_packed.h"
 
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
@@ -13,30 +15,81 @@
 struct RenderMesh
 {
     ComPtr<ID3D11Buffer> vertex_buffer;
+    // Of PackedTangent, second stream; only if packed_vertices and the mesh has a normal map.
+    ComPtr<ID3D11Buffer> tangent_buffer;
     ComPtr<ID3D11Buffer> index_buffer;
     UINT indices_count;
     std::uint32_t ps_texture_diffuse;
     std::uint32_t ps_texture_normal;
-
-    static RenderMesh make(ID3D11Device& device, const Mesh& mesh);
+    std::size_t memory_bytes; // vertex, tangent & index buffers
+    std::uint32_t vertices_count;
+    // Vertex buffer is of PackedVertex (see RenderModel::vs_packed_shader_), otherwise of Vertex.
+    bool packed_vertices;
+    VertexDequantize dequantize;
+    VertexPackError pack_error;
+
+    // pack_vertices: upload as PackedVertex, 16 bytes per vertex instead of 44
+    // (+ 4 of PackedTangent, if the mesh has a normal map; see vertex_packed.h).
+    static RenderMesh make(ID3D11Device& device, const Mesh& mesh, bool pack_vertices);
 };
 
 struct RenderTexture
 {
     ComPtr<ID3D11ShaderResourceView> texture_view;
     std::uint32_t texture_id;
+    TextureFormat format;
+    std::size_t memory_bytes;
+    // Once packed (see RenderModel::pack_textures()), texture_view is released
+    // and the texture is array_slice of RenderModel::texture_arrays_[array_index].
+    std::uint32_t array_index;
+    std::uint32_t array_slice;
+    // Same as texture_view, if shared with other models' textures of the same content (see texture_share.h);
+    // such textures are not packed while other models use them.
+    std::uint64_t content_key;
+    SharedTextureView shared_view;
 
     static RenderTexture make(ID3D11Device& device, const Texture& texture);
+
+    bool is_packed() const
+    {
+        return !texture_view;
+    }
+};
+
+// Of the last RenderModel::pack_textures(); per frame, for the meshes at that time.
+// "Before" is a draw that sets all the state and both textures, as render() used to do.
+struct TexturePackStats
+{
+    std::uint32_t textures = 0;
+    std::uint32_t arrays = 0;
+    std::uint32_t draws_before = 0;
+    std::uint32_t draws_after = 0;
+    std::uint32_t texture_binds_before = 0;
+    std::uint32_t texture_binds_after = 0;
+    // State binds & constant buffer updates, texture binds included.
+    std::uint32_t binds_before = 0;
+    std::uint32_t binds_after = 0;
+};
+
+// Of the meshes uploaded so far: vertex buffers as packed & as they would be of Vertex.
+struct VertexPackStats
+{
+    std::uint32_t meshes = 0; // packed ones
+    std::size_t bytes_before = 0;
+    std::size_t bytes_after = 0;
+    VertexPackError max_error;
 };
 
 struct RenderModel
 {
-    // vs_basic_phong_lighting.hlsl
+    // vs_basic_phong_lighting.hlsl (and common_vertex_packed.hlsl).
     struct VSConstantBuffer0
     {
         glm::mat4x4 world;
         glm::mat4x4 view;
         glm::mat4x4 projection;
+        // Per mesh of PackedVertex.
+        VertexDequantize dequantize;
     };
 
     // ps_basic_phong_lighting.hlsl
@@ -54,13 +107,30 @@ struct RenderModel
         glm::vec4 viewer_position;
         // x = has textures
         // y = lights count
+        // z = normal map is BC5 (x, y only); per mesh
+        // w = mesh has a normal map (and tangents); per mesh
         glm::vec4 parameters;
+        // x = diffuse slice, y = normal slice,
+        // z = diffuse is a slice of an array, w = normal is a slice of an array; per mesh
+        glm::vec4 texture_slices;
     };
 
     std::vector<RenderMesh> meshes;
     std::vector<RenderTexture> textures;
+    // Textures of the same size, mips & format, one array per group (see pack_textures()).
+    std::vector<ComPtr<ID3D11ShaderResourceView>> texture_arrays_;
+    // Index in textures by texture id; checked on use (textures are replaced/reordered).
+    std::vector<std::uint32_t> texture_lookup_;
+    TexturePackStats pack_stats_;
 
     VSShader* vs_shader_ = nullptr;
+    // For meshes of PackedVertex (see Shaders::find_packed_vs()).
+    const VSShader* vs_packed_shader_ = nullptr;
+    // Meshes are made of PackedVertex (see RenderMesh::make()); fixed once they are uploaded:
+    // the other choice is a new RenderModel.
+    bool pack_vertices_ = true;
+    // Zero PackedTangent, stride 0: the tangent stream of packed meshes without a normal map.
+    ComPtr<ID3D11Buffer> no_tangent_buffer_;
     ComPtr<ID3D11Buffer> vs_constant_buffer0_;
     PSShader* ps_shader_ = nullptr;
     ComPtr<ID3D11Buffer> ps_constant_buffer0_;
@@ -68,6 +138,9 @@ struct RenderModel
 
     // Tweak whole model position & orientation.
     glm::mat4x4 world;
+    // Model space bounds; model's data may be unloaded already (see ModelResidency).
+    glm::vec3 aabb_min;
+    glm::vec3 aabb_max;
 
     // Tweak light.
     glm::vec3 light_color;
@@ -75,6 +148,19 @@ struct RenderModel
     glm::vec3 viewer_position;
 
     static RenderModel make(ID3D11Device& device, const Model& model);
+    // Without meshes/textures; to be added later (see ModelUploadJob).
+    static RenderModel make(ID3D11Device& device);
+
+    // GPU memory of meshes & textures.
+    std::size_t memory_bytes() const;
+    VertexPackStats vertex_pack_stats() const;
+
+    // Copies (on the GPU) textures into texture arrays, grouped by size, mips & format,
+    // so that the draws bind them only when the group changes; slices go to the shader
+    // with per mesh constants. Textures shared with other models stay single (see RenderTexture).
+    // Again if any texture was replaced or added since, so only once all textures are uploaded
+    // (not while streamed). False if nothing changed.
+    bool pack_textures(ID3D11Device& device, ID3D11DeviceContext& device_context);
 
     void render(ID3D11DeviceContext& device_context, const glm::mat4x4& view, const glm::mat4x4& projection) const;
 };
@@ -0,0 +1,996 @@
+#include "scan_loader.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cfloat>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+
+// Vertices per parallel_for() task.
+constexpr std::size_t c_batch_size = 64 * 1024;
+// Read buffer of out-of-core imports.
+constexpr std::size_t c_stream_buffer_size = (std::size_t(8) << 20);
+// Big enough for any PLY header.
+constexpr std::size_t c_ply_header_max_size = (64 * 1024);
+constexpr std::size_t c_stl_header_size = 80 + sizeof(std::uint32_t);
+constexpr std::size_t c_stl_triangle_size = 12 * sizeof(float) + sizeof(std::uint16_t);
+
+enum class PlyType
+{
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64,
+    Invalid,
+};
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType type = PlyType::Invalid;
+    bool is_list = false;
+    PlyType list_count_type = PlyType::Invalid;
+    std::size_t offset = 0; // for non-list properties of fixed-size elements
+};
+
+struct PlyElement
+{
+    std::string name;
+    std::uint64_t count = 0;
+    std::vector<PlyProperty> properties;
+    bool has_lists = false;
+    std::size_t stride = 0; // if !has_lists
+
+    const PlyProperty* find(std::string_view property_name) const
+    {
+        for (const PlyProperty& p : properties)
+        {
+            if (p.name == property_name)
+            {
+                return &p;
+            }
+        }
+        return nullptr;
+    }
+};
+
+std::size_t PlyTypeSize(PlyType type)
+{
+    switch (type)
+    {
+    case PlyType::Int8:
+    case PlyType::UInt8:
+        return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16:
+        return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float32:
+        return 4;
+    case PlyType::Float64:
+        return 8;
+    case PlyType::Invalid:
+        return 0;
+    }
+    return 0;
+}
+
+PlyType ParsePlyType(std::string_view name)
+{
+    if ((name == "char") || (name == "int8"))
+    {
+        return PlyType::Int8;
+    }
+    if ((name == "uchar") || (name == "uint8"))
+    {
+        return PlyType::UInt8;
+    }
+    if ((name == "short") || (name == "int16"))
+    {
+        return PlyType::Int16;
+    }
+    if ((name == "ushort") || (name == "uint16"))
+    {
+        return PlyType::UInt16;
+    }
+    if ((name == "int") || (name == "int32"))
+    {
+        return PlyType::Int32;
+    }
+    if ((name == "uint") || (name == "uint32"))
+    {
+        return PlyType::UInt32;
+    }
+    if ((name == "float") || (name == "float32"))
+    {
+        return PlyType::Float32;
+    }
+    if ((name == "double") || (name == "float64"))
+    {
+        return PlyType::Float64;
+    }
+    return PlyType::Invalid;
+}
+
+template <typename T>
+T LoadAs(const std::uint8_t* p, bool swap_bytes)
+{
+    T value{};
+    std::memcpy(&value, p, sizeof(T));
+    if (swap_bytes)
+    {
+        std::uint8_t bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        std::reverse(std::begin(bytes), std::end(bytes));
+        std::memcpy(&value, bytes, sizeof(T));
+    }
+    return value;
+}
+
+double ReadPlyValue(const std::uint8_t* p, PlyType type, bool swap_bytes)
+{
+    switch (type)
+    {
+    case PlyType::Int8:
+        return double(LoadAs<std::int8_t>(p, swap_bytes));
+    case PlyType::UInt8:
+        return double(LoadAs<std::uint8_t>(p, swap_bytes));
+    case PlyType::Int16:
+        return double(LoadAs<std::int16_t>(p, swap_bytes));
+    case PlyType::UInt16:
+        return double(LoadAs<std::uint16_t>(p, swap_bytes));
+    case PlyType::Int32:
+        return double(LoadAs<std::int32_t>(p, swap_bytes));
+    case PlyType::UInt32:
+        return double(LoadAs<std::uint32_t>(p, swap_bytes));
+    case PlyType::Float32:
+        return double(LoadAs<float>(p, swap_bytes));
+    case PlyType::Float64:
+        return LoadAs<double>(p, swap_bytes);
+    case PlyType::Invalid:
+        break;
+    }
+    return 0.0;
+}
+
+std::uint32_t ReadPlyIndex(const std::uint8_t* p, PlyType type, bool swap_bytes)
+{
+    switch (type)
+    {
+    case PlyType::Int8:
+        return std::uint32_t(LoadAs<std::int8_t>(p, swap_bytes));
+    case PlyType::UInt8:
+        return LoadAs<std::uint8_t>(p, swap_bytes);
+    case PlyType::Int16:
+        return std::uint32_t(LoadAs<std::int16_t>(p, swap_bytes));
+    case PlyType::UInt16:
+        return LoadAs<std::uint16_t>(p, swap_bytes);
+    case PlyType::Int32:
+        return std::uint32_t(LoadAs<std::int32_t>(p, swap_bytes));
+    case PlyType::UInt32:
+        return LoadAs<std::uint32_t>(p, swap_bytes);
+    case PlyType::Float32:
+    case PlyType::Float64:
+    case PlyType::Invalid:
+        break;
+    }
+    return UINT_MAX;
+}
+
+std::vector<std::string_view> SplitWords(std::string_view line)
+{
+    std::vector<std::string_view> words;
+    std::size_t i = 0;
+    while (i < line.size())
+    {
+        while ((i < line.size()) && ((line[i] == ' ') || (line[i] == '\t') || (line[i] == '\r')))
+        {
+            ++i;
+        }
+        const std::size_t begin = i;
+        while ((i < line.size()) && (line[i] != ' ') && (line[i] != '\t') && (line[i] != '\r'))
+        {
+            ++i;
+        }
+        if (i > begin)
+        {
+            words.push_back(line.substr(begin, i - begin));
+        }
+    }
+    return words;
+}
+
+struct PlyHeader
+{
+    std::vector<PlyElement> elements;
+    bool swap_bytes = false;
+    std::size_t data_offset = 0;
+};
+
+bool ParsePlyHeader(std::span<const std::uint8_t> bytes, PlyHeader& header)
+{
+    const std::string_view text(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (text.substr(0, 4) != "ply\n" && text.substr(0, 5) != "ply\r\n")
+    {
+        return false;
+    }
+    std::size_t pos = 0;
+    bool has_format = false;
+    while (pos < text.size())
+    {
+        const std::size_t end = text.find('\n', pos);
+        if (end == std::string_view::npos)
+        {
+            return false;
+        }
+        const std::vector<std::string_view> words = SplitWords(text.substr(pos, end - pos));
+        pos = end + 1;
+        if (words.empty())
+        {
+            continue;
+        }
+        if (words[0] == "end_header")
+        {
+            header.data_offset = pos;
+            return has_format;
+        }
+        if ((words[0] == "format") && (words.size() >= 2))
+        {
+            constexpr bool c_little_endian_host = (std::endian::native == std::endian::little);
+            if (words[1] == "binary_little_endian")
+            {
+                header.swap_bytes = !c_little_endian_host;
+            }
+            else if (words[1] == "binary_big_endian")
+            {
+                header.swap_bytes = c_little_endian_host;
+            }
+            else
+            {
+                return false; // ascii
+            }
+            has_format = true;
+        }
+        else if ((words[0] == "element") && (words.size() >= 3))
+        {
+            PlyElement element;
+            element.name = std::string(words[1]);
+            const std::from_chars_result r =
+                std::from_chars(words[2].data(), words[2].data() + words[2].size(), element.count);
+            if (r.ec != std::errc())
+            {
+                return false;
+            }
+            header.elements.push_back(std::move(element));
+        }
+        else if ((words[0] == "property") && !header.elements.empty())
+        {
+            PlyElement& element = header.elements.back();
+            PlyProperty property;
+            if ((words.size() >= 5) && (words[1] == "list"))
+            {
+                property.is_list = true;
+                property.list_count_type = ParsePlyType(words[2]);
+                property.type = ParsePlyType(words[3]);
+                property.name = std::string(words[4]);
+                element.has_lists = true;
+            }
+            else if (words.size() >= 3)
+            {
+                property.type = ParsePlyType(words[1]);
+                property.name = std::string(words[2]);
+                property.offset = element.stride;
+                element.stride += PlyTypeSize(property.type);
+            }
+            if ((property.type == PlyType::Invalid) || (property.is_list && (property.list_count_type == PlyType::Invalid)))
+            {
+                return false;
+            }
+            element.properties.push_back(std::move(property));
+        }
+        // Else: comment, obj_info - skip.
+    }
+    return false;
+}
+
+// Size of one element record with lists (walks list counts).
+std::size_t PlyRecordSize(const PlyElement& element, const std::uint8_t* p, const std::uint8_t* end, bool swap_bytes)
+{
+    std::size_t size = 0;
+    for (const PlyProperty& property : element.properties)
+    {
+        if (!property.is_list)
+        {
+            size += PlyTypeSize(property.type);
+            continue;
+        }
+        const std::size_t count_size = PlyTypeSize(property.list_count_type);
+        if ((p + size + count_size) > end)
+        {
+            return 0;
+        }
+        const std::uint32_t count = ReadPlyIndex(p + size, property.list_count_type, swap_bytes);
+        size += count_size + std::size_t(count) * PlyTypeSize(property.type);
+    }
+    return size;
+}
+
+glm::vec3 ReadVec3(const std::uint8_t* record, const PlyProperty* const (&xyz)[3], bool swap_bytes)
+{
+    glm::vec3 v;
+    if ((xyz[0]->type == PlyType::Float32) && (xyz[1]->type == PlyType::Float32) && (xyz[2]->type == PlyType::Float32)
+        && !swap_bytes)
+    {
+        std::memcpy(&v.x, record + xyz[0]->offset, sizeof(float));
+        std::memcpy(&v.y, record + xyz[1]->offset, sizeof(float));
+        std::memcpy(&v.z, record + xyz[2]->offset, sizeof(float));
+        return v;
+    }
+    v.x = float(ReadPlyValue(record + xyz[0]->offset, xyz[0]->type, swap_bytes));
+    v.y = float(ReadPlyValue(record + xyz[1]->offset, xyz[1]->type, swap_bytes));
+    v.z = float(ReadPlyValue(record + xyz[2]->offset, xyz[2]->type, swap_bytes));
+    return v;
+}
+
+void ComputeAABB(AssimpMesh& mesh)
+{
+    ThreadPool& pool = GlobalThreadPool();
+    const std::size_t batches = (mesh.vertices.size() + c_batch_size - 1) / c_batch_size;
+    std::vector<glm::vec3> mins(batches, glm::vec3(FLT_MAX));
+    std::vector<glm::vec3> maxs(batches, glm::vec3(-FLT_MAX));
+    pool.parallel_for(batches, [&](std::size_t batch) {
+        const std::size_t begin = batch * c_batch_size;
+        const std::size_t end = std::min(mesh.vertices.size(), begin + c_batch_size);
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            mins[batch] = glm::min(mins[batch], mesh.vertices[i].position);
+            maxs[batch] = glm::max(maxs[batch], mesh.vertices[i].position);
+        }
+    });
+    mesh.aabb_min = glm::vec3(FLT_MAX);
+    mesh.aabb_max = glm::vec3(-FLT_MAX);
+    for (std::size_t i = 0; i < batches; ++i)
+    {
+        mesh.aabb_min = glm::min(mesh.aabb_min, mins[i]);
+        mesh.aabb_max = glm::max(mesh.aabb_max, maxs[i]);
+    }
+}
+
+AssimpModel MakeSingleMeshModel(AssimpMesh&& mesh)
+{
+    ComputeAABB(mesh);
+    AssimpModel model;
+    model.aabb_min = glm::vec3(FLT_MAX);
+    model.aabb_max = glm::vec3(-FLT_MAX);
+    Assimp_UpdateAABB(model, mesh);
+    model.meshes.push_back(std::move(mesh));
+    return model;
+}
+
+// Sequential reads through a fixed-size buffer; the file is never mapped as a whole.
+struct FileStream
+{
+    std::ifstream in;
+    std::vector<std::uint8_t> buffer;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+
+    bool open(const fs::path& file_path, std::uint64_t offset)
+    {
+        in.open(file_path, std::ios::binary);
+        in.seekg(std::streamoff(offset));
+        buffer.resize(c_stream_buffer_size);
+        return !!in;
+    }
+
+    // At least size bytes at data(); false at the end of the file. Sizes come from the file:
+    // the buffer never grows, larger records are rejected (false) as well.
+    bool ensure(std::size_t size)
+    {
+        if ((end - begin) >= size)
+        {
+            return true;
+        }
+        if (size > buffer.size())
+        {
+            return false;
+        }
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+        in.read(reinterpret_cast<char*>(buffer.data() + end), std::streamsize(buffer.size() - end));
+        end += std::size_t(in.gcount());
+        return ((end - begin) >= size);
+    }
+
+    const std::uint8_t* data() const
+    {
+        return buffer.data() + begin;
+    }
+
+    std::size_t available() const
+    {
+        return (end - begin);
+    }
+
+    void consume(std::size_t size)
+    {
+        begin += size;
+    }
+
+    bool skip(std::uint64_t size)
+    {
+        while (size > 0)
+        {
+            const std::size_t step = std::size_t(std::min<std::uint64_t>(size, buffer.size()));
+            if (!ensure(step))
+            {
+                return false;
+            }
+            consume(step);
+            size -= step;
+        }
+        return true;
+    }
+};
+
+using OnPlyVertices = std::function<void(std::uint64_t first, std::span<const Vertex> vertices)>;
+using OnPlyTriangles = std::function<bool(std::span<const Index> indices)>;
+
+// One sequential pass over the binary PLY payload: vertices and (fan-triangulated)
+// faces are handed over in batches. Stops after the vertices if there is no on_triangles.
+// Faces must follow vertices.
+bool StreamPly(
+    const fs::path& file_path,
+    const PlyHeader& header,
+    const OnPlyVertices& on_vertices,
+    const OnPlyTriangles& on_triangles
+)
+{
+    FileStream stream;
+    if (!stream.open(file_path, header.data_offset))
+    {
+        return false;
+    }
+    const bool swap_bytes = header.swap_bytes;
+    bool has_vertices = false;
+    bool has_faces = false;
+    std::vector<Vertex> vertices;
+    std::vector<Index> triangles;
+    for (const PlyElement& element : header.elements)
+    {
+        if ((element.name == "vertex") && !element.has_lists && !has_vertices)
+        {
+            const PlyProperty* const xyz[3] = {element.find("x"), element.find("y"), element.find("z")};
+            const PlyProperty* const nxyz[3] = {element.find("nx"), element.find("ny"), element.find("nz")};
+            if (!xyz[0] || !xyz[1] || !xyz[2])
+            {
+                return false;
+            }
+            const bool has_normals = (nxyz[0] && nxyz[1] && nxyz[2]);
+            // Batch of wide vertices fits the stream buffer (stride is not 0: x, y, z are there).
+            const std::size_t batch_size =
+                std::max<std::size_t>(std::min(c_batch_size, c_stream_buffer_size / element.stride), 1);
+            for (std::uint64_t first = 0; first < element.count; first += batch_size)
+            {
+                const std::size_t count = std::size_t(std::min<std::uint64_t>(batch_size, element.count - first));
+                if (!stream.ensure(count * element.stride))
+                {
+                    return false;
+                }
+                vertices.resize(count);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    const std::uint8_t* record = stream.data() + i * element.stride;
+                    Vertex& v = vertices[i];
+                    v = Vertex{};
+                    v.position = ReadVec3(record, xyz, swap_bytes);
+                    if (has_normals)
+                    {
+                        v.normal = ReadVec3(record, nxyz, swap_bytes);
+                    }
+                }
+                stream.consume(count * element.stride);
+                on_vertices(first, vertices);
+            }
+            has_vertices = true;
+            if (!on_triangles)
+            {
+                return true;
+            }
+            continue;
+        }
+
+        const PlyProperty* indices = (element.name == "face") ? element.find("vertex_indices") : nullptr;
+        if (!indices)
+        {
+            indices = (element.name == "face") ? element.find("vertex_index") : nullptr;
+        }
+        if (indices && indices->is_list && !has_faces && (element.properties.size() == 1))
+        {
+            if (!has_vertices)
+            {
+                return false;
+            }
+            const std::size_t count_size = PlyTypeSize(indices->list_count_type);
+            const std::size_t index_size = PlyTypeSize(indices->type);
+            for (std::uint64_t i = 0; i < element.count; ++i)
+            {
+                if (!stream.ensure(count_size))
+                {
+                    return false;
+                }
+                const std::uint32_t count = ReadPlyIndex(stream.data(), indices->list_count_type, swap_bytes);
+                const std::size_t record_size = count_size + std::size_t(count) * index_size;
+                if (!stream.ensure(record_size))
+                {
+                    return false;
+                }
+                const std::uint8_t* p = stream.data() + count_size;
+                for (std::uint32_t k = 1; (k + 1) < count; ++k)
+                {
+                    triangles.push_back(ReadPlyIndex(p, indices->type, swap_bytes));
+                    triangles.push_back(ReadPlyIndex(p + k * index_size, indices->type, swap_bytes));
+                    triangles.push_back(ReadPlyIndex(p + (k + 1) * index_size, indices->type, swap_bytes));
+                }
+                stream.consume(record_size);
+                if (triangles.size() >= (3 * c_batch_size))
+                {
+                    if (!on_triangles(triangles))
+                    {
+                        return false;
+                    }
+                    triangles.clear();
+                }
+            }
+            if (!triangles.empty() && !on_triangles(triangles))
+            {
+                return false;
+            }
+            has_faces = true;
+            continue;
+        }
+
+        // Skip unknown element.
+        if (!element.has_lists)
+        {
+            if (!stream.skip(element.count * element.stride))
+            {
+                return false;
+            }
+            continue;
+        }
+        for (std::uint64_t i = 0; i < element.count; ++i)
+        {
+            std::size_t size = 0;
+            while (true)
+            {
+                size = PlyRecordSize(element, stream.data(), stream.data() + stream.available(), swap_bytes);
+                if ((size > 0) && (size <= stream.available()))
+                {
+                    break;
+                }
+                if (!stream.ensure(std::max(size, stream.available() + 1)))
+                {
+                    return false;
+                }
+            }
+            stream.consume(size);
+        }
+    }
+    return has_vertices && has_faces;
+}
+
+bool ReadPlyHeader(const fs::path& file_path, PlyHeader& header)
+{
+    FileStream stream;
+    if (!stream.open(file_path, 0))
+    {
+        return false;
+    }
+    (void)stream.ensure(c_ply_header_max_size);
+    return ParsePlyHeader({stream.data(), stream.available()}, header);
+}
+
+void UpdateBounds(std::span<const Vertex> vertices, glm::vec3& aabb_min, glm::vec3& aabb_max)
+{
+    for (const Vertex& v : vertices)
+    {
+        aabb_min = glm::min(aabb_min, v.position);
+        aabb_max = glm::max(aabb_max, v.position);
+    }
+}
+
+fs::path GetSpillPath(const fs::path& cache_path)
+{
+    fs::path spill_path = cache_path;
+    spill_path += ".spill";
+    return spill_path;
+}
+
+} // namespace
+
+outcome::result<AssimpModel> Ply_Load(const fs::path& file_path)
+{
+    auto maybe_file = MappedFile::open(file_path);
+    if (!maybe_file)
+    {
+        return outcome::failure(maybe_file.error());
+    }
+    const std::span<const std::uint8_t> bytes = maybe_file.value().bytes();
+    PlyHeader header;
+    if (!ParsePlyHeader(bytes, header))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    const bool swap_bytes = header.swap_bytes;
+    const std::uint8_t* p = bytes.data() + header.data_offset;
+    const std::uint8_t* const end = bytes.data() + bytes.size();
+
+    AssimpMesh mesh{};
+    bool has_vertices = false;
+    bool has_faces = false;
+    for (const PlyElement& element : header.elements)
+    {
+        if ((element.name == "vertex") && !element.has_lists && !has_vertices)
+        {
+            const PlyProperty* const xyz[3] = {element.find("x"), element.find("y"), element.find("z")};
+            const PlyProperty* const nxyz[3] = {element.find("nx"), element.find("ny"), element.find("nz")};
+            if (!xyz[0] || !xyz[1] || !xyz[2])
+            {
+                return outcome::failure(std::errc::not_supported);
+            }
+            if ((element.count > UINT_MAX) || (element.count > (std::uint64_t(end - p) / element.stride)))
+            {
+                return outcome::failure(std::errc::illegal_byte_sequence);
+            }
+            mesh.has_normals = (nxyz[0] && nxyz[1] && nxyz[2]);
+            mesh.vertices.resize(std::size_t(element.count));
+            const std::uint8_t* const records = p;
+            const std::size_t batches = (mesh.vertices.size() + c_batch_size - 1) / c_batch_size;
+            GlobalThreadPool().parallel_for(batches, [&](std::size_t batch) {
+                const std::size_t begin = batch * c_batch_size;
+                const std::size_t batch_end = std::min(mesh.vertices.size(), begin + c_batch_size);
+                for (std::size_t i = begin; i < batch_end; ++i)
+                {
+                    const std::uint8_t* record = records + i * element.stride;
+                    Vertex& v = mesh.vertices[i];
+                    v = Vertex{};
+                    v.position = ReadVec3(record, xyz, swap_bytes);
+                    if (mesh.has_normals)
+                    {
+                        v.normal = ReadVec3(record, nxyz, swap_bytes);
+                    }
+                }
+            });
+            p += std::size_t(element.count) * element.stride;
+            has_vertices = true;
+            continue;
+        }
+
+        const PlyProperty* indices = (element.name == "face") ? element.find("vertex_indices") : nullptr;
+        if (!indices)
+        {
+            indices = (element.name == "face") ? element.find("vertex_index") : nullptr;
+        }
+        if (indices && indices->is_list && !has_faces && (element.properties.size() == 1))
+        {
+            const std::size_t count_size = PlyTypeSize(indices->list_count_type);
+            const std::size_t index_size = PlyTypeSize(indices->type);
+            if (element.count > UINT_MAX)
+            {
+                return outcome::failure(std::errc::illegal_byte_sequence);
+            }
+            // Fast path: all faces are triangles, records have fixed size.
+            // Otherwise (or if the records don't fit) the walk below checks every face.
+            const std::size_t triangle_stride = count_size + 3 * index_size;
+            bool all_triangles = (element.count <= (std::uint64_t(end - p) / triangle_stride));
+            for (std::uint64_t i = 0; all_triangles && (i < element.count); ++i)
+            {
+                all_triangles = (ReadPlyIndex(p + i * triangle_stride, indices->list_count_type, swap_bytes) == 3);
+            }
+            if (all_triangles)
+            {
+                mesh.indices.resize(std::size_t(element.count) * 3);
+                const std::uint8_t* const records = p;
+                const std::size_t batches = (std::size_t(element.count) + c_batch_size - 1) / c_batch_size;
+                const bool raw_copy = (indices->type == PlyType::Int32 || indices->type == PlyType::UInt32) && !swap_bytes;
+                GlobalThreadPool().parallel_for(batches, [&](std::size_t batch) {
+                    const std::size_t begin = batch * c_batch_size;
+                    const std::size_t batch_end = std::min(std::size_t(element.count), begin + c_batch_size);
+                    for (std::size_t i = begin; i < batch_end; ++i)
+                    {
+                        const std::uint8_t* record = records + i * triangle_stride + count_size;
+                        Index* out = &mesh.indices[i * 3];
+                        if (raw_copy)
+                        {
+                            std::memcpy(out, record, 3 * sizeof(Index));
+                            continue;
+                        }
+                        for (std::size_t k = 0; k < 3; ++k)
+                        {
+                            out[k] = ReadPlyIndex(record + k * index_size, indices->type, swap_bytes);
+                        }
+                    }
+                });
+                p += std::size_t(element.count) * triangle_stride;
+            }
+            else
+            {
+                // Polygons: sequential walk, fan triangulation.
+                for (std::uint64_t i = 0; i < element.count; ++i)
+                {
+                    if ((p + count_size) > end)
+                    {
+                        return outcome::failure(std::errc::illegal_byte_sequence);
+                    }
+                    const std::uint32_t count = ReadPlyIndex(p, indices->list_count_type, swap_bytes);
+                    p += count_size;
+                    if ((std::size_t(end - p) / index_size) < count)
+                    {
+                        return outcome::failure(std::errc::illegal_byte_sequence);
+                    }
+                    for (std::uint32_t k = 1; (k + 1) < count; ++k)
+                    {
+                        mesh.indices.push_back(ReadPlyIndex(p, indices->type, swap_bytes));
+                        mesh.indices.push_back(ReadPlyIndex(p + k * index_size, indices->type, swap_bytes));
+                        mesh.indices.push_back(ReadPlyIndex(p + (k + 1) * index_size, indices->type, swap_bytes));
+                    }
+                    p += std::size_t(count) * index_size;
+                }
+            }
+            has_faces = true;
+            continue;
+        }
+
+        // Skip unknown element.
+        if (!element.has_lists)
+        {
+            if ((element.stride > 0) && (element.count > (std::uint64_t(end - p) / element.stride)))
+            {
+                return outcome::failure(std::errc::illegal_byte_sequence);
+            }
+            p += std::size_t(element.count) * element.stride;
+            continue;
+        }
+        for (std::uint64_t i = 0; i < element.count; ++i)
+        {
+            const std::size_t size = PlyRecordSize(element, p, end, swap_bytes);
+            if ((size == 0) || (size > std::size_t(end - p)))
+            {
+                return outcome::failure(std::errc::illegal_byte_sequence);
+            }
+            p += size;
+        }
+    }
+
+    if (!has_vertices || mesh.vertices.empty() || mesh.indices.empty())
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    const Index vertices_count = Index(mesh.vertices.size());
+    const bool valid = std::all_of(mesh.indices.begin(), mesh.indices.end(), [&](Index i) {
+        return (i < vertices_count);
+    });
+    if (!valid)
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    return outcome::success(MakeSingleMeshModel(std::move(mesh)));
+}
+
+outcome::result<AssimpModel> Stl_Load(const fs::path& file_path)
+{
+    auto maybe_file = MappedFile::open(file_path);
+    if (!maybe_file)
+    {
+        return outcome::failure(maybe_file.error());
+    }
+    const std::span<const std::uint8_t> bytes = maybe_file.value().bytes();
+    constexpr std::size_t c_header_size = 80 + sizeof(std::uint32_t);
+    constexpr std::size_t c_triangle_size = 12 * sizeof(float) + sizeof(std::uint16_t);
+    if (bytes.size() < c_header_size)
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    std::uint32_t triangles_count = 0;
+    std::memcpy(&triangles_count, bytes.data() + 80, sizeof(triangles_count));
+    // ASCII STL starts with "solid" too, but size never matches.
+    if ((triangles_count == 0) || ((bytes.size() - c_header_size) / c_triangle_size) != triangles_count
+        || ((bytes.size() - c_header_size) % c_triangle_size) != 0
+        || (std::uint64_t(triangles_count) * 3 > UINT_MAX))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+
+    AssimpMesh mesh{};
+    mesh.has_normals = true;
+    mesh.vertices.resize(std::size_t(triangles_count) * 3);
+    mesh.indices.resize(std::size_t(triangles_count) * 3);
+    const std::uint8_t* const records = bytes.data() + c_header_size;
+    const std::size_t batches = (std::size_t(triangles_count) + c_batch_size - 1) / c_batch_size;
+    GlobalThreadPool().parallel_for(batches, [&](std::size_t batch) {
+        const std::size_t begin = batch * c_batch_size;
+        const std::size_t batch_end = std::min(std::size_t(triangles_count), begin + c_batch_size);
+        for (std::size_t i = begin; i < batch_end; ++i)
+        {
+            float data[12];
+            std::memcpy(data, records + i * c_triangle_size, sizeof(data));
+            const glm::vec3 normal(data[0], data[1], data[2]);
+            for (std::size_t k = 0; k < 3; ++k)
+            {
+                Vertex& v = mesh.vertices[i * 3 + k];
+                v = Vertex{};
+                v.position = glm::vec3(data[3 + k * 3], data[4 + k * 3], data[5 + k * 3]);
+                v.normal = normal;
+                mesh.indices[i * 3 + k] = Index(i * 3 + k);
+            }
+        }
+    });
+    return outcome::success(MakeSingleMeshModel(std::move(mesh)));
+}
+
+outcome::result<ChunkStats> Ply_ImportChunked(
+    const fs::path& file_path,
+    const fs::path& cache_path,
+    const ModelCacheKey& key,
+    const ChunkSettings& settings
+)
+{
+    PlyHeader header;
+    if (!ReadPlyHeader(file_path, header))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    std::uint64_t vertices_count = 0;
+    std::uint64_t faces_count = 0;
+    for (const PlyElement& element : header.elements)
+    {
+        vertices_count = ((element.name == "vertex") && (vertices_count == 0)) ? element.count : vertices_count;
+        faces_count = ((element.name == "face") && (faces_count == 0)) ? element.count : faces_count;
+    }
+
+    // Pass 1: bounds.
+    glm::vec3 aabb_min(FLT_MAX);
+    glm::vec3 aabb_max(-FLT_MAX);
+    const bool bounds_read = StreamPly(
+        file_path,
+        header,
+        [&](std::uint64_t, std::span<const Vertex> vertices) { UpdateBounds(vertices, aabb_min, aabb_max); },
+        nullptr
+    );
+    if (!bounds_read || (vertices_count == 0))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    auto maybe_builder =
+        ChunkBuilder::make(settings, GetSpillPath(cache_path), aabb_min, aabb_max, vertices_count, faces_count);
+    if (!maybe_builder)
+    {
+        return outcome::failure(maybe_builder.error());
+    }
+    ChunkBuilder& builder = *maybe_builder.value();
+
+    // Pass 2: cells of vertices; triangles.
+    const bool triangles_read = StreamPly(
+        file_path,
+        header,
+        [&](std::uint64_t first, std::span<const Vertex> vertices) { builder.assign_vertices(first, vertices); },
+        [&](std::span<const Index> indices) { return builder.add_triangles(indices); }
+    );
+    if (!triangles_read)
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+
+    // Pass 3: vertices to the cells that use them.
+    const bool vertices_read = StreamPly(
+        file_path,
+        header,
+        [&](std::uint64_t first, std::span<const Vertex> vertices) { builder.add_vertices(first, vertices); },
+        nullptr
+    );
+    if (!vertices_read)
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    return builder.finish(cache_path, key);
+}
+
+outcome::result<ChunkStats> Stl_ImportChunked(
+    const fs::path& file_path,
+    const fs::path& cache_path,
+    const ModelCacheKey& key,
+    const ChunkSettings& settings
+)
+{
+    std::error_code ec;
+    const std::uint64_t file_size = fs::file_size(file_path, ec);
+    FileStream stream;
+    if (ec || (file_size < c_stl_header_size) || !stream.open(file_path, 0) || !stream.ensure(c_stl_header_size))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    std::uint32_t triangles_count = 0;
+    std::memcpy(&triangles_count, stream.data() + 80, sizeof(triangles_count));
+    if ((triangles_count == 0) || (((file_size - c_stl_header_size) / c_stl_triangle_size) != triangles_count)
+        || (((file_size - c_stl_header_size) % c_stl_triangle_size) != 0))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+
+    // Triangles are independent: pass 1 for bounds, pass 2 to bin them.
+    std::vector<Vertex> vertices;
+    auto stream_triangles = [&](const std::function<void(std::span<const Vertex>)>& on_vertices) {
+        FileStream pass;
+        if (!pass.open(file_path, c_stl_header_size))
+        {
+            return false;
+        }
+        for (std::uint64_t first = 0; first < triangles_count; first += c_batch_size)
+        {
+            const std::size_t count = std::size_t(std::min<std::uint64_t>(c_batch_size, triangles_count - first));
+            if (!pass.ensure(count * c_stl_triangle_size))
+            {
+                return false;
+            }
+            vertices.resize(count * 3);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                float data[12];
+                std::memcpy(data, pass.data() + i * c_stl_triangle_size, sizeof(data));
+                const glm::vec3 normal(data[0], data[1], data[2]);
+                for (std::size_t k = 0; k < 3; ++k)
+                {
+                    Vertex& v = vertices[i * 3 + k];
+                    v = Vertex{};
+                    v.position = glm::vec3(data[3 + k * 3], data[4 + k * 3], data[5 + k * 3]);
+                    v.normal = normal;
+                }
+            }
+            pass.consume(count * c_stl_triangle_size);
+            on_vertices(vertices);
+        }
+        return true;
+    };
+
+    glm::vec3 aabb_min(FLT_MAX);
+    glm::vec3 aabb_max(-FLT_MAX);
+    if (!stream_triangles([&](std::span<const Vertex> soup) { UpdateBounds(soup, aabb_min, aabb_max); }))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    auto maybe_builder = ChunkBuilder::make(settings, GetSpillPath(cache_path), aabb_min, aabb_max, 0, triangles_count);
+    if (!maybe_builder)
+    {
+        return outcome::failure(maybe_builder.error());
+    }
+    ChunkBuilder& builder = *maybe_builder.value();
+    if (!stream_triangles([&](std::span<const Vertex> soup) { builder.add_triangle_soup(soup); }))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    return builder.finish(cache_path, key);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "assimp_model.h"
+#include "model_cache.h"
+#include "model_chunks.h"
+#include "utils_outcome.h"
+
+#include <filesystem>
+
+// Native loaders for scan data, bypass Assimp. The file is mapped and
+// attributes are copied in bulk (in parallel) from the binary payload.
+// ASCII variants are not supported (fail; let Assimp handle those).
+
+// Binary (little or big endian) PLY: "vertex" element with float/double
+// x, y, z and optional nx, ny, nz; "face" element with vertex_indices list.
+// Polygons are fan-triangulated.
+outcome::result<AssimpModel> Ply_Load(const fs::path& file_path);
+
+// Binary STL. 3 vertices per triangle, normal is the facet normal.
+outcome::result<AssimpModel> Stl_Load(const fs::path& file_path);
+
+// Out-of-core variants for files larger than memory: the file is read sequentially
+// through a fixed-size buffer (several passes) and partitioned into chunks written
+// to the model cache at cache_path (see model_chunks.h); nothing is kept in memory.
+outcome::result<ChunkStats> Ply_ImportChunked(
+    const fs::path& file_path,
+    const fs::path& cache_path,
+    const ModelCacheKey& key,
+    const ChunkSettings& settings
+);
+outcome::result<ChunkStats> Stl_ImportChunked(
+    const fs::path& file_path,
+    const fs::path& cache_path,
+    const ModelCacheKey& key,
+    const ChunkSettings& settings
+);
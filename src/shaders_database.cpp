@@ -4,20 +4,26 @@
 #include "render_lines.h" // vertex definition
 #include "shaders/ps_lines.h"
 #include "shaders/vs_lines.h"
+#include "shaders/vs_lines_packed.h"
 
 #include "shaders/ps_basic_phong_lighting.h"
 #include "shaders/vs_basic_phong_lighting.h"
-#include "vertex.h" // vertex definition
+#include "shaders/vs_basic_phong_lighting_packed.h"
+#include "vertex.h"        // vertex definition
+#include "vertex_packed.h" // vertex definition
 
 #include "shaders/ps_gooch_shading.h"
 #include "shaders/vs_gooch_shading.h"
+#include "shaders/vs_gooch_shading_packed.h"
 
 #include "shaders/ps_vertices_only.h"
 #include "shaders/vs_vertices_only.h"
+#include "shaders/vs_vertices_only_packed.h"
 
 #include "render_with_normals.h" // vertex definition
 #include "shaders/ps_normals.h"
 #include "shaders/vs_normals.h"
+#include "shaders/vs_normals_packed.h"
 
 static const ShaderInfo::Dependency c_basic_phong_deps[] = {
     {.file_name = L"" XX_SHADERS_FOLDER "common_basic_phong_lighting.hlsl"}
@@ -66,6 +72,54 @@ extern const ShaderInfo c_vs_basic_phong{
     .defines = {}
 };
 
+static const ShaderInfo::Dependency c_basic_phong_packed_deps[] = {
+    {.file_name = L"" XX_SHADERS_FOLDER "common_basic_phong_lighting.hlsl"},
+    {.file_name = L"" XX_SHADERS_FOLDER "common_vertex_packed.hlsl"},
+};
+
+static const D3D11_INPUT_ELEMENT_DESC c_layout_basic_phong_packed[] = {
+    {.SemanticName = "position",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16B16A16_UNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, position),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+    {.SemanticName = "normal",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16_SNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, normal),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+    {.SemanticName = "tangent",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16_SNORM,
+     .InputSlot = 1, // PackedTangent stream
+     .AlignedByteOffset = offsetof(PackedTangent, tangent),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+    {.SemanticName = "texcoord",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16_UNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, texture_coord),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+};
+
+extern const ShaderInfo c_vs_basic_phong_packed{
+    .debug_name = "vs_basic_phong_packed",
+    .kind = ShaderInfo::VS,
+    .bytecode = {k_vs_basic_phong_lighting_packed},
+    .file_name = L"" XX_SHADERS_FOLDER "vs_basic_phong_lighting_packed.hlsl",
+    .vs_layout = {c_layout_basic_phong_packed},
+    .entry_point_name = "main_vs",
+    .profile = "vs_5_0",
+    .dependencies = {c_basic_phong_packed_deps},
+    .defines = {}
+};
+
 static const ShaderInfo::Dependency c_gooch_shading_deps[] = {
     {.file_name = L"" XX_SHADERS_FOLDER "common_gooch_shading.hlsl"}
 };
@@ -99,6 +153,40 @@ extern const ShaderInfo c_vs_gooch_shading{
     .defines = {}
 };
 
+static const ShaderInfo::Dependency c_gooch_shading_packed_deps[] = {
+    {.file_name = L"" XX_SHADERS_FOLDER "common_gooch_shading.hlsl"},
+    {.file_name = L"" XX_SHADERS_FOLDER "common_vertex_packed.hlsl"},
+};
+
+static const D3D11_INPUT_ELEMENT_DESC c_layout_gooch_shading_packed[] = {
+    {.SemanticName = "position",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16B16A16_UNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, position),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+    {.SemanticName = "normal",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16_SNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, normal),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+};
+
+extern const ShaderInfo c_vs_gooch_shading_packed{
+    .debug_name = "vs_gooch_shading_packed",
+    .kind = ShaderInfo::VS,
+    .bytecode = {k_vs_gooch_shading_packed},
+    .file_name = L"" XX_SHADERS_FOLDER "vs_gooch_shading_packed.hlsl",
+    .vs_layout = {c_layout_gooch_shading_packed},
+    .entry_point_name = "main_vs",
+    .profile = "vs_5_0",
+    .dependencies = {c_gooch_shading_packed_deps},
+    .defines = {}
+};
+
 extern const ShaderInfo c_ps_basic_phong{
     .debug_name = "ps_basic_phong",
     .kind = ShaderInfo::PS,
@@ -154,6 +242,41 @@ extern const ShaderInfo c_vs_lines{
     .defines = {}
 };
 
+static const ShaderInfo::Dependency c_lines_packed_deps[] = {
+    {.file_name = L"" XX_SHADERS_FOLDER "common_lines.hlsl"},
+    {.file_name = L"" XX_SHADERS_FOLDER "common_vertex_packed.hlsl"},
+};
+
+// Color is the normal, as with Vertex (see c_layout_lines).
+static const D3D11_INPUT_ELEMENT_DESC c_layout_lines_packed[] = {
+    {.SemanticName = "position",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16B16A16_UNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, position),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+    {.SemanticName = "color",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16_SNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, normal),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+};
+
+extern const ShaderInfo c_vs_lines_packed{
+    .debug_name = "vs_lines_packed",
+    .kind = ShaderInfo::VS,
+    .bytecode = {k_vs_lines_packed},
+    .file_name = L"" XX_SHADERS_FOLDER "vs_lines_packed.hlsl",
+    .vs_layout = {c_layout_lines_packed},
+    .entry_point_name = "main_vs",
+    .profile = "vs_5_0",
+    .dependencies = {c_lines_packed_deps},
+    .defines = {}
+};
+
 extern const ShaderInfo c_ps_lines{
     .debug_name = "ps_lines",
     .kind = ShaderInfo::PS,
@@ -188,6 +311,32 @@ extern const ShaderInfo c_vs_vertices_only{
     .defines = {}
 };
 
+static const ShaderInfo::Dependency c_vertex_packed_deps[] = {
+    {.file_name = L"" XX_SHADERS_FOLDER "common_vertex_packed.hlsl"},
+};
+
+static const D3D11_INPUT_ELEMENT_DESC c_layout_vertices_only_packed[] = {
+    {.SemanticName = "position",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16B16A16_UNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, position),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+};
+
+extern const ShaderInfo c_vs_vertices_only_packed{
+    .debug_name = "vs_vertices_only_packed",
+    .kind = ShaderInfo::VS,
+    .bytecode = {k_vs_vertices_only_packed},
+    .file_name = L"" XX_SHADERS_FOLDER "vs_vertices_only_packed.hlsl",
+    .vs_layout = {c_layout_vertices_only_packed},
+    .entry_point_name = "main_vs",
+    .profile = "vs_5_0",
+    .dependencies = {c_vertex_packed_deps},
+    .defines = {}
+};
+
 extern const ShaderInfo c_ps_vertices_only{
     .debug_name = "ps_vertices_only",
     .kind = ShaderInfo::PS,
@@ -229,6 +378,35 @@ extern const ShaderInfo c_vs_normals{
     .defines = {}
 };
 
+static const D3D11_INPUT_ELEMENT_DESC c_layout_normals_packed[] = {
+    {.SemanticName = "position",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16B16A16_UNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, position),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+    {.SemanticName = "normal",
+     .SemanticIndex = 0,
+     .Format = DXGI_FORMAT_R16G16_SNORM,
+     .InputSlot = 0,
+     .AlignedByteOffset = offsetof(PackedVertex, normal),
+     .InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA,
+     .InstanceDataStepRate = 0},
+};
+
+extern const ShaderInfo c_vs_normals_packed{
+    .debug_name = "vs_normals_packed",
+    .kind = ShaderInfo::VS,
+    .bytecode = {k_vs_normals_packed},
+    .file_name = L"" XX_SHADERS_FOLDER "vs_normals_packed.hlsl",
+    .vs_layout = {c_layout_normals_packed},
+    .entry_point_name = "main_vs",
+    .profile = "vs_5_0",
+    .dependencies = {c_vertex_packed_deps},
+    .defines = {}
+};
+
 extern const ShaderInfo c_ps_normals{
     .debug_name = "ps_normals",
     .kind = ShaderInfo::PS,
@@ -3,16 +3,21 @@
 struct ShaderInfo;
 
 extern const ShaderInfo c_vs_basic_phong;
+extern const ShaderInfo c_vs_basic_phong_packed; // PackedVertex
 extern const ShaderInfo c_ps_basic_phong;
 
 extern const ShaderInfo c_vs_gooch_shading;
+extern const ShaderInfo c_vs_gooch_shading_packed; // PackedVertex
 extern const ShaderInfo c_ps_gooch_shading;
 
 extern const ShaderInfo c_vs_lines;
+extern const ShaderInfo c_vs_lines_packed; // PackedVertex
 extern const ShaderInfo c_ps_lines;
 
 extern const ShaderInfo c_vs_vertices_only;
+extern const ShaderInfo c_vs_vertices_only_packed; // PackedVertex
 extern const ShaderInfo c_ps_vertices_only;
 
 extern const ShaderInfo c_vs_normals;
+extern const ShaderInfo c_vs_normals_packed; // PackedVertex
 extern const ShaderInfo c_ps_normals;
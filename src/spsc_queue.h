@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread
+// and one consumer thread. Capacity is rounded up to power of two.
+template <typename T>
+struct SpscQueue
+{
+    explicit SpscQueue(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        items_.resize(size);
+        mask_ = (size - 1);
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer. On success, value is moved-from.
+    bool try_push(T& value)
+    {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if ((tail - head_.load(std::memory_order_acquire)) > mask_)
+        {
+            return false; // full
+        }
+        items_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer.
+    bool try_pop(T& value)
+    {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+        {
+            return false; // empty
+        }
+        value = std::move(items_[head & mask_]);
+        items_[head & mask_] = T();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> items_;
+    std::size_t mask_ = 0;
+    std::atomic<std::size_t> head_{0}; // written by consumer only
+    std::atomic<std::size_t> tail_{0}; // written by producer only
+};
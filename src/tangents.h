@@ -0,0 +1,65 @@
+#pragma once
+#include "vertex.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <span>
+
+#include <cmath>
+
+// Gram-Schmidt: tangent made perpendicular to the normal;
+// any perpendicular vector for degenerate UVs.
+inline glm::vec3 OrthogonalTangent(const glm::vec3& tangent, const glm::vec3& normal)
+{
+    glm::vec3 t = tangent - normal * glm::dot(normal, tangent);
+    const float length = glm::length(t);
+    if (length > 1e-12f)
+    {
+        return t / length;
+    }
+    const glm::vec3 axis = (std::abs(normal.x) < 0.9f) ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+    t = glm::cross(normal, axis);
+    const float axis_length = glm::length(t);
+    return (axis_length > 0.f) ? (t / axis_length) : axis;
+}
+
+// Unnormalized tangent of the triangle (direction of +U).
+inline glm::vec3 TriangleTangent(const Vertex& v0, const Vertex& v1, const Vertex& v2)
+{
+    const glm::vec3 e1 = v1.position - v0.position;
+    const glm::vec3 e2 = v2.position - v0.position;
+    const glm::vec2 d1 = v1.texture_coord - v0.texture_coord;
+    const glm::vec2 d2 = v2.texture_coord - v0.texture_coord;
+    const float r = (d1.x * d2.y) - (d2.x * d1.y);
+    if (std::abs(r) <= 1e-20f)
+    {
+        return glm::vec3(0.f);
+    }
+    return (e1 * d2.y - e2 * d1.y) / r;
+}
+
+// Per-vertex tangents for indexed triangles: sum of adjacent triangles'
+// tangents, orthogonalized against vertex normal.
+inline void ComputeVertexTangents(std::span<Vertex> vertices, std::span<const Index> indices)
+{
+    for (Vertex& v : vertices)
+    {
+        v.tangent = glm::vec3(0.f);
+    }
+    for (std::size_t i = 0; (i + 2) < indices.size(); i += 3)
+    {
+        Vertex& v0 = vertices[indices[i + 0]];
+        Vertex& v1 = vertices[indices[i + 1]];
+        Vertex& v2 = vertices[indices[i + 2]];
+        const glm::vec3 t = TriangleTangent(v0, v1, v2);
+        v0.tangent += t;
+        v1.tangent += t;
+        v2.tangent += t;
+    }
+    for (Vertex& v : vertices)
+    {
+        v.tangent = OrthogonalTangent(v.tangent, v.normal);
+    }
+}
@@ -0,0 +1,805 @@
+#include "texture_bc.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define XX_TEXTURE_SIMD 1
+#include <immintrin.h>
+#else
+#define XX_TEXTURE_SIMD 0
+#endif
+
+#include <algorithm>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+// Block rows per parallel_for() task.
+static constexpr std::uint32_t c_block_rows_per_task = 4;
+// Least squares passes of BcQuality::High.
+static constexpr int c_refine_iterations = 2;
+
+static constexpr int c_bc7_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// 16 texels, channel-major, [0; 255].
+struct BlockTexels
+{
+    alignas(16) float c[4][16];
+};
+
+struct Endpoints
+{
+    float e0[4];
+    float e1[4];
+};
+
+static void LoadBlock(
+    const std::uint8_t* rgba,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint32_t bx,
+    std::uint32_t by,
+    BlockTexels& block
+)
+{
+    for (std::uint32_t y = 0; y < 4; ++y)
+    {
+        const std::uint32_t sy = std::min(by * 4 + y, height - 1);
+        for (std::uint32_t x = 0; x < 4; ++x)
+        {
+            const std::uint32_t sx = std::min(bx * 4 + x, width - 1);
+            const std::uint8_t* p = rgba + (std::size_t(sy) * width + sx) * 4;
+            for (int c = 0; c < 4; ++c)
+            {
+                block.c[c][y * 4 + x] = float(p[c]);
+            }
+        }
+    }
+}
+
+// Nearest palette entry of every texel over the first `channels`; total squared error.
+static float SelectIndices(
+    const BlockTexels& block,
+    const float (*palette)[4],
+    int palette_size,
+    int channels,
+    std::uint8_t indices[16]
+)
+{
+    float total = 0.f;
+#if XX_TEXTURE_SIMD
+    for (int i = 0; i < 16; i += 4)
+    {
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i best_index = _mm_setzero_si128();
+        for (int p = 0; p < palette_size; ++p)
+        {
+            __m128 distance = _mm_setzero_ps();
+            for (int c = 0; c < channels; ++c)
+            {
+                const __m128 d = _mm_sub_ps(_mm_load_ps(&block.c[c][i]), _mm_set1_ps(palette[p][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+            }
+            const __m128i less = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+            best = _mm_min_ps(distance, best);
+            best_index = _mm_or_si128(_mm_andnot_si128(less, best_index), _mm_and_si128(less, _mm_set1_epi32(p)));
+        }
+        alignas(16) float errors[4];
+        alignas(16) std::int32_t found[4];
+        _mm_store_ps(errors, best);
+        _mm_store_si128(reinterpret_cast<__m128i*>(found), best_index);
+        for (int k = 0; k < 4; ++k)
+        {
+            indices[i + k] = std::uint8_t(found[k]);
+            total += errors[k];
+        }
+    }
+#else
+    for (int i = 0; i < 16; ++i)
+    {
+        float best = FLT_MAX;
+        for (int p = 0; p < palette_size; ++p)
+        {
+            float distance = 0.f;
+            for (int c = 0; c < channels; ++c)
+            {
+                const float d = block.c[c][i] - palette[p][c];
+                distance += d * d;
+            }
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = std::uint8_t(p);
+            }
+        }
+        total += best;
+    }
+#endif
+    return total;
+}
+
+// Extremes of the texels projected onto the principal axis (power iteration).
+static Endpoints FitPrincipalAxis(const BlockTexels& block, int channels)
+{
+    float mean[4]{};
+    float lo[4];
+    float hi[4];
+    for (int c = 0; c < channels; ++c)
+    {
+        lo[c] = hi[c] = block.c[c][0];
+        for (int i = 0; i < 16; ++i)
+        {
+            mean[c] += block.c[c][i];
+            lo[c] = std::min(lo[c], block.c[c][i]);
+            hi[c] = std::max(hi[c], block.c[c][i]);
+        }
+        mean[c] /= 16.f;
+    }
+    float covariance[4][4]{};
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = 0; b < channels; ++b)
+            {
+                covariance[a][b] += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+            }
+        }
+    }
+    float axis[4]{};
+    for (int c = 0; c < channels; ++c)
+    {
+        axis[c] = hi[c] - lo[c];
+    }
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4]{};
+        float length = 0.f;
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = 0; b < channels; ++b)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length = std::max(length, std::abs(next[a]));
+        }
+        if (length < 1e-6f)
+        {
+            break;
+        }
+        for (int c = 0; c < channels; ++c)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+    float axis_length2 = 0.f;
+    for (int c = 0; c < channels; ++c)
+    {
+        axis_length2 += axis[c] * axis[c];
+    }
+    Endpoints e{};
+    if (axis_length2 < 1e-12f)
+    {
+        // Solid block.
+        std::copy_n(mean, 4, e.e0);
+        std::copy_n(mean, 4, e.e1);
+        return e;
+    }
+    float t_min = FLT_MAX;
+    float t_max = -FLT_MAX;
+    for (int i = 0; i < 16; ++i)
+    {
+        float t = 0.f;
+        for (int c = 0; c < channels; ++c)
+        {
+            t += (block.c[c][i] - mean[c]) * axis[c];
+        }
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+    }
+    for (int c = 0; c < channels; ++c)
+    {
+        e.e0[c] = std::clamp(mean[c] + axis[c] * t_min / axis_length2, 0.f, 255.f);
+        e.e1[c] = std::clamp(mean[c] + axis[c] * t_max / axis_length2, 0.f, 255.f);
+    }
+    return e;
+}
+
+// Endpoints that minimize squared error for the fixed interpolation weights (of e1)
+// of every texel. False if the system is degenerate (all weights equal).
+static bool FitLeastSquares(const BlockTexels& block, const float weights[16], int channels, Endpoints& e)
+{
+    float aa = 0.f;
+    float ab = 0.f;
+    float bb = 0.f;
+    float ax[4]{};
+    float bx[4]{};
+    for (int i = 0; i < 16; ++i)
+    {
+        const float b = weights[i];
+        const float a = 1.f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < channels; ++c)
+        {
+            ax[c] += a * block.c[c][i];
+            bx[c] += b * block.c[c][i];
+        }
+    }
+    const float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f)
+    {
+        return false;
+    }
+    for (int c = 0; c < channels; ++c)
+    {
+        e.e0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.f, 255.f);
+        e.e1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.f, 255.f);
+    }
+    return true;
+}
+
+static std::uint16_t ToRGB565(const float c[4])
+{
+    const auto q = [](float v, float max) { return std::uint16_t(std::lround(v * max / 255.f)); };
+    return std::uint16_t((q(c[0], 31.f) << 11) | (q(c[1], 63.f) << 5) | q(c[2], 31.f));
+}
+
+static void FromRGB565(std::uint16_t v, float c[4])
+{
+    const unsigned r = (v >> 11) & 31u;
+    const unsigned g = (v >> 5) & 63u;
+    const unsigned b = v & 31u;
+    c[0] = float((r << 3) | (r >> 2));
+    c[1] = float((g << 2) | (g >> 4));
+    c[2] = float((b << 3) | (b >> 2));
+    c[3] = 255.f;
+}
+
+static void Store16(std::uint8_t* out, std::uint16_t v)
+{
+    std::memcpy(out, &v, sizeof(v));
+}
+
+static std::uint16_t Load16(const std::uint8_t* in)
+{
+    std::uint16_t v = 0;
+    std::memcpy(&v, in, sizeof(v));
+    return v;
+}
+
+// Palette index -> weight of the second endpoint.
+static constexpr float c_bc1_weights[4] = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+
+static void MakeBC1Palette(std::uint16_t c0, std::uint16_t c1, float palette[4][4])
+{
+    FromRGB565(c0, palette[0]);
+    FromRGB565(c1, palette[1]);
+    for (int c = 0; c < 4; ++c)
+    {
+        palette[2][c] = std::floor((2.f * palette[0][c] + palette[1][c]) / 3.f + 0.5f);
+        palette[3][c] = std::floor((palette[0][c] + 2.f * palette[1][c]) / 3.f + 0.5f);
+    }
+}
+
+static void EncodeBC1(const BlockTexels& block, BcQuality quality, std::uint8_t* out)
+{
+    Endpoints e = FitPrincipalAxis(block, 3);
+    std::uint16_t best_c0 = 0;
+    std::uint16_t best_c1 = 0;
+    std::uint8_t best_indices[16]{};
+    float best_error = FLT_MAX;
+    const int iterations = (quality == BcQuality::High) ? c_refine_iterations : 0;
+    for (int iteration = 0; iteration <= iterations; ++iteration)
+    {
+        const std::uint16_t c0 = ToRGB565(e.e0);
+        const std::uint16_t c1 = ToRGB565(e.e1);
+        float palette[4][4];
+        MakeBC1Palette(c0, c1, palette);
+        std::uint8_t indices[16];
+        const float error = SelectIndices(block, palette, 4, 3, indices);
+        if (error < best_error)
+        {
+            best_error = error;
+            best_c0 = c0;
+            best_c1 = c1;
+            std::copy_n(indices, 16, best_indices);
+        }
+        float weights[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            weights[i] = c_bc1_weights[indices[i]];
+        }
+        if ((iteration == iterations) || !FitLeastSquares(block, weights, 3, e))
+        {
+            break;
+        }
+    }
+
+    // 4-color blocks need c0 > c1; the same colors use index 0 only.
+    if (best_c0 == best_c1)
+    {
+        std::fill_n(best_indices, 16, std::uint8_t(0));
+    }
+    else if (best_c0 < best_c1)
+    {
+        std::swap(best_c0, best_c1);
+        for (std::uint8_t& index : best_indices)
+        {
+            index = std::uint8_t(index ^ 1u);
+        }
+    }
+    Store16(out, best_c0);
+    Store16(out + 2, best_c1);
+    std::uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        bits |= (std::uint32_t(best_indices[i]) << (i * 2));
+    }
+    std::memcpy(out + 4, &bits, sizeof(bits));
+}
+
+static void DecodeBC1(const std::uint8_t* in, bool four_colors, std::uint8_t texels[16][4])
+{
+    const std::uint16_t c0 = Load16(in);
+    const std::uint16_t c1 = Load16(in + 2);
+    float palette[4][4];
+    MakeBC1Palette(c0, c1, palette);
+    if (!four_colors && (c0 <= c1))
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            palette[2][c] = std::floor((palette[0][c] + palette[1][c]) / 2.f);
+            palette[3][c] = 0.f;
+        }
+    }
+    std::uint32_t bits = 0;
+    std::memcpy(&bits, in + 4, sizeof(bits));
+    for (int i = 0; i < 16; ++i)
+    {
+        const float* color = palette[(bits >> (i * 2)) & 3u];
+        for (int c = 0; c < 4; ++c)
+        {
+            texels[i][c] = std::uint8_t(color[c]);
+        }
+    }
+}
+
+// 8-value mode: a0 > a1.
+static void MakeBC4Palette(float a0, float a1, float palette[8][4])
+{
+    palette[0][0] = a0;
+    palette[1][0] = a1;
+    for (int i = 2; i < 8; ++i)
+    {
+        palette[i][0] = std::floor((float(8 - i) * a0 + float(i - 1) * a1) / 7.f + 0.5f);
+    }
+}
+
+static void EncodeBC4(const BlockTexels& block, int channel, BcQuality quality, std::uint8_t* out)
+{
+    // Single channel moved to the first one, as SelectIndices() expects.
+    BlockTexels single{};
+    std::copy_n(block.c[channel], 16, single.c[0]);
+    float lo = single.c[0][0];
+    float hi = single.c[0][0];
+    for (int i = 0; i < 16; ++i)
+    {
+        lo = std::min(lo, single.c[0][i]);
+        hi = std::max(hi, single.c[0][i]);
+    }
+    std::uint8_t best_a0 = std::uint8_t(hi);
+    std::uint8_t best_a1 = std::uint8_t(lo);
+    std::uint8_t best_indices[16]{};
+    if (best_a0 != best_a1)
+    {
+        Endpoints e{};
+        e.e0[0] = hi;
+        e.e1[0] = lo;
+        float best_error = FLT_MAX;
+        const int iterations = (quality == BcQuality::High) ? c_refine_iterations : 0;
+        for (int iteration = 0; iteration <= iterations; ++iteration)
+        {
+            std::uint8_t a0 = std::uint8_t(std::lround(e.e0[0]));
+            std::uint8_t a1 = std::uint8_t(std::lround(e.e1[0]));
+            // Keep 8-value mode (a0 > a1); indices are selected again anyway.
+            if (a0 < a1)
+            {
+                std::swap(a0, a1);
+            }
+            else if ((a0 == a1) && (a0 < 255))
+            {
+                ++a0;
+            }
+            else if (a0 == a1)
+            {
+                --a1;
+            }
+            float palette[8][4];
+            MakeBC4Palette(float(a0), float(a1), palette);
+            std::uint8_t indices[16];
+            const float error = SelectIndices(single, palette, 8, 1, indices);
+            if (error < best_error)
+            {
+                best_error = error;
+                best_a0 = a0;
+                best_a1 = a1;
+                std::copy_n(indices, 16, best_indices);
+            }
+            float weights[16];
+            for (int i = 0; i < 16; ++i)
+            {
+                weights[i] = (indices[i] < 2) ? float(indices[i]) : float(indices[i] - 1) / 7.f;
+            }
+            if ((iteration == iterations) || !FitLeastSquares(single, weights, 1, e))
+            {
+                break;
+            }
+        }
+    }
+    out[0] = best_a0;
+    out[1] = best_a1;
+    std::uint64_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        bits |= (std::uint64_t(best_indices[i]) << (i * 3));
+    }
+    for (int k = 0; k < 6; ++k)
+    {
+        out[2 + k] = std::uint8_t(bits >> (k * 8));
+    }
+}
+
+static void DecodeBC4(const std::uint8_t* in, int channel, std::uint8_t texels[16][4])
+{
+    const float a0 = float(in[0]);
+    const float a1 = float(in[1]);
+    float palette[8][4];
+    if (in[0] > in[1])
+    {
+        MakeBC4Palette(a0, a1, palette);
+    }
+    else
+    {
+        palette[0][0] = a0;
+        palette[1][0] = a1;
+        for (int i = 2; i < 6; ++i)
+        {
+            palette[i][0] = std::floor((float(6 - i) * a0 + float(i - 1) * a1) / 5.f + 0.5f);
+        }
+        palette[6][0] = 0.f;
+        palette[7][0] = 255.f;
+    }
+    std::uint64_t bits = 0;
+    for (int k = 0; k < 6; ++k)
+    {
+        bits |= (std::uint64_t(in[2 + k]) << (k * 8));
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+        texels[i][channel] = std::uint8_t(palette[(bits >> (i * 3)) & 7u][0]);
+    }
+}
+
+struct BitWriter
+{
+    std::uint8_t* out;
+    unsigned position = 0;
+
+    void write(std::uint32_t value, unsigned bits)
+    {
+        for (unsigned i = 0; i < bits; ++i, ++position)
+        {
+            if ((value >> i) & 1u)
+            {
+                out[position / 8] = std::uint8_t(out[position / 8] | (1u << (position % 8)));
+            }
+        }
+    }
+};
+
+struct BitReader
+{
+    const std::uint8_t* in;
+    unsigned position = 0;
+
+    std::uint32_t read(unsigned bits)
+    {
+        std::uint32_t value = 0;
+        for (unsigned i = 0; i < bits; ++i, ++position)
+        {
+            value |= std::uint32_t((in[position / 8] >> (position % 8)) & 1u) << i;
+        }
+        return value;
+    }
+};
+
+// Mode 6 endpoint: 7 bits per channel + p-bit shared by the channels.
+struct Bc7Endpoint
+{
+    std::uint8_t q[4];
+    std::uint8_t p;
+};
+
+static Bc7Endpoint QuantizeBC7(const float e[4])
+{
+    Bc7Endpoint best{};
+    float best_error = FLT_MAX;
+    for (std::uint8_t p = 0; p < 2; ++p)
+    {
+        Bc7Endpoint candidate{};
+        candidate.p = p;
+        float error = 0.f;
+        for (int c = 0; c < 4; ++c)
+        {
+            const long q = std::clamp(std::lround((e[c] - float(p)) / 2.f), 0l, 127l);
+            candidate.q[c] = std::uint8_t(q);
+            const float d = float((q << 1) | p) - e[c];
+            error += d * d;
+        }
+        if (error < best_error)
+        {
+            best_error = error;
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+static void MakeBC7Palette(const Bc7Endpoint& e0, const Bc7Endpoint& e1, float palette[16][4])
+{
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            const int v0 = (e0.q[c] << 1) | e0.p;
+            const int v1 = (e1.q[c] << 1) | e1.p;
+            palette[i][c] = float(((64 - c_bc7_weights[i]) * v0 + c_bc7_weights[i] * v1 + 32) >> 6);
+        }
+    }
+}
+
+static void EncodeBC7(const BlockTexels& block, BcQuality quality, std::uint8_t* out)
+{
+    Endpoints e = FitPrincipalAxis(block, 4);
+    Bc7Endpoint best_e0{};
+    Bc7Endpoint best_e1{};
+    std::uint8_t best_indices[16]{};
+    float best_error = FLT_MAX;
+    const int iterations = (quality == BcQuality::High) ? c_refine_iterations : 0;
+    for (int iteration = 0; iteration <= iterations; ++iteration)
+    {
+        const Bc7Endpoint e0 = QuantizeBC7(e.e0);
+        const Bc7Endpoint e1 = QuantizeBC7(e.e1);
+        float palette[16][4];
+        MakeBC7Palette(e0, e1, palette);
+        std::uint8_t indices[16];
+        const float error = SelectIndices(block, palette, 16, 4, indices);
+        if (error < best_error)
+        {
+            best_error = error;
+            best_e0 = e0;
+            best_e1 = e1;
+            std::copy_n(indices, 16, best_indices);
+        }
+        float weights[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            weights[i] = float(c_bc7_weights[indices[i]]) / 64.f;
+        }
+        if ((iteration == iterations) || !FitLeastSquares(block, weights, 4, e))
+        {
+            break;
+        }
+    }
+
+    // Anchor (texel 0) index has its top bit implicitly 0.
+    if (best_indices[0] >= 8)
+    {
+        std::swap(best_e0, best_e1);
+        for (std::uint8_t& index : best_indices)
+        {
+            index = std::uint8_t(15 - index);
+        }
+    }
+    std::memset(out, 0, 16);
+    BitWriter writer{out};
+    writer.write(1u << 6, 7); // mode 6
+    for (int c = 0; c < 4; ++c)
+    {
+        writer.write(best_e0.q[c], 7);
+        writer.write(best_e1.q[c], 7);
+    }
+    writer.write(best_e0.p, 1);
+    writer.write(best_e1.p, 1);
+    writer.write(best_indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+    {
+        writer.write(best_indices[i], 4);
+    }
+}
+
+// Mode 6 only; other modes decode as black.
+static void DecodeBC7(const std::uint8_t* in, std::uint8_t texels[16][4])
+{
+    BitReader reader{in};
+    if (reader.read(7) != (1u << 6))
+    {
+        std::memset(texels, 0, 16 * 4);
+        return;
+    }
+    Bc7Endpoint e0{};
+    Bc7Endpoint e1{};
+    for (int c = 0; c < 4; ++c)
+    {
+        e0.q[c] = std::uint8_t(reader.read(7));
+        e1.q[c] = std::uint8_t(reader.read(7));
+    }
+    e0.p = std::uint8_t(reader.read(1));
+    e1.p = std::uint8_t(reader.read(1));
+    float palette[16][4];
+    MakeBC7Palette(e0, e1, palette);
+    for (int i = 0; i < 16; ++i)
+    {
+        const float* color = palette[reader.read((i == 0) ? 3 : 4)];
+        for (int c = 0; c < 4; ++c)
+        {
+            texels[i][c] = std::uint8_t(color[c]);
+        }
+    }
+}
+
+bool TextureBC_IsCompressed(TextureFormat format)
+{
+    return (format != TextureFormat::RGBA8);
+}
+
+std::uint32_t TextureBC_BlockBytes(TextureFormat format)
+{
+    switch (format)
+    {
+    case TextureFormat::BC1:
+        return 8;
+    case TextureFormat::BC3:
+    case TextureFormat::BC5:
+    case TextureFormat::BC7:
+        return 16;
+    case TextureFormat::RGBA8:
+        break;
+    }
+    Unreachable();
+}
+
+const char* TextureBC_FormatName(TextureFormat format)
+{
+    switch (format)
+    {
+    case TextureFormat::RGBA8:
+        return "RGBA8";
+    case TextureFormat::BC1:
+        return "BC1";
+    case TextureFormat::BC3:
+        return "BC3";
+    case TextureFormat::BC5:
+        return "BC5";
+    case TextureFormat::BC7:
+        return "BC7";
+    }
+    Unreachable();
+}
+
+static void EncodeBlock(TextureFormat format, BcQuality quality, const BlockTexels& block, std::uint8_t* out)
+{
+    switch (format)
+    {
+    case TextureFormat::BC1:
+        EncodeBC1(block, quality, out);
+        return;
+    case TextureFormat::BC3:
+        EncodeBC4(block, 3, quality, out);
+        EncodeBC1(block, quality, out + 8);
+        return;
+    case TextureFormat::BC5:
+        EncodeBC4(block, 0, quality, out);
+        EncodeBC4(block, 1, quality, out + 8);
+        return;
+    case TextureFormat::BC7:
+        EncodeBC7(block, quality, out);
+        return;
+    case TextureFormat::RGBA8:
+        break;
+    }
+    Unreachable();
+}
+
+static void DecodeBlock(TextureFormat format, const std::uint8_t* in, std::uint8_t texels[16][4])
+{
+    switch (format)
+    {
+    case TextureFormat::BC1:
+        DecodeBC1(in, false, texels);
+        return;
+    case TextureFormat::BC3:
+        DecodeBC1(in + 8, true, texels);
+        DecodeBC4(in, 3, texels);
+        return;
+    case TextureFormat::BC5:
+        for (int i = 0; i < 16; ++i)
+        {
+            texels[i][2] = 0;
+            texels[i][3] = 255;
+        }
+        DecodeBC4(in, 0, texels);
+        DecodeBC4(in + 8, 1, texels);
+        return;
+    case TextureFormat::BC7:
+        DecodeBC7(in, texels);
+        return;
+    case TextureFormat::RGBA8:
+        break;
+    }
+    Unreachable();
+}
+
+void TextureBC_Encode(
+    TextureFormat format,
+    BcQuality quality,
+    const std::uint8_t* rgba,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint8_t* blocks
+)
+{
+    const std::uint32_t blocks_x = (width + 3) / 4;
+    const std::uint32_t blocks_y = (height + 3) / 4;
+    const std::uint32_t block_bytes = TextureBC_BlockBytes(format);
+    const std::uint32_t tasks = (blocks_y + c_block_rows_per_task - 1) / c_block_rows_per_task;
+    GlobalThreadPool().parallel_for(tasks, [&](std::size_t task) {
+        const std::uint32_t first = std::uint32_t(task) * c_block_rows_per_task;
+        const std::uint32_t last = std::min(blocks_y, first + c_block_rows_per_task);
+        BlockTexels block;
+        for (std::uint32_t by = first; by < last; ++by)
+        {
+            for (std::uint32_t bx = 0; bx < blocks_x; ++bx)
+            {
+                LoadBlock(rgba, width, height, bx, by, block);
+                EncodeBlock(format, quality, block, blocks + (std::size_t(by) * blocks_x + bx) * block_bytes);
+            }
+        }
+    });
+}
+
+void TextureBC_Decode(
+    TextureFormat format,
+    const std::uint8_t* blocks,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint8_t* rgba
+)
+{
+    const std::uint32_t blocks_x = (width + 3) / 4;
+    const std::uint32_t blocks_y = (height + 3) / 4;
+    const std::uint32_t block_bytes = TextureBC_BlockBytes(format);
+    for (std::uint32_t by = 0; by < blocks_y; ++by)
+    {
+        for (std::uint32_t bx = 0; bx < blocks_x; ++bx)
+        {
+            std::uint8_t texels[16][4];
+            DecodeBlock(format, blocks + (std::size_t(by) * blocks_x + bx) * block_bytes, texels);
+            for (std::uint32_t y = 0; y < 4; ++y)
+            {
+                for (std::uint32_t x = 0; x < 4; ++x)
+                {
+                    const std::uint32_t px = bx * 4 + x;
+                    const std::uint32_t py = by * 4 + y;
+                    if ((px < width) && (py < height))
+                    {
+                        std::memcpy(rgba + (std::size_t(py) * width + px) * 4, texels[y * 4 + x], 4);
+                    }
+                }
+            }
+        }
+    }
+}
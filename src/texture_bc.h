@@ -0,0 +1,43 @@
+#pragma once
+#include "model.h"
+
+#include <cstdint>
+
+// CPU block compression of RGBA8 texels (4x4 blocks; edge blocks repeat the last row/column):
+// - BC1: RGB, 4-color blocks (alpha is dropped);
+// - BC3: BC1 color + BC4 alpha;
+// - BC5: two BC4 channels, R & G (normal map x, y);
+// - BC7: mode 6 only (single subset, RGBA 7.7.7.7 + p-bit endpoints, 4-bit indices).
+// Endpoints are fit along the principal axis of the block; indices are searched
+// with SSE over the whole block. High quality refines endpoints with least squares.
+// Blocks are encoded in parallel on GlobalThreadPool().
+
+enum class BcQuality
+{
+    Fast,
+    High,
+};
+
+// Block-compressed format (not RGBA8).
+bool TextureBC_IsCompressed(TextureFormat format);
+std::uint32_t TextureBC_BlockBytes(TextureFormat format);
+// "RGBA8", "BC1", ...
+const char* TextureBC_FormatName(TextureFormat format);
+
+// blocks: ceil(width / 4) * ceil(height / 4) * TextureBC_BlockBytes(format).
+void TextureBC_Encode(
+    TextureFormat format,
+    BcQuality quality,
+    const std::uint8_t* rgba,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint8_t* blocks
+);
+// Back to RGBA8 (for quality reports); BC5 gives (x, y, 0, 255).
+void TextureBC_Decode(
+    TextureFormat format,
+    const std::uint8_t* blocks,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint8_t* rgba
+);
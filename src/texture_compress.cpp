@@ -0,0 +1,203 @@
+#include "texture_compress.h"
+#include "texture_bc.h"
+#include "utils.h"
+#include "utils_hash.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+// File: TextureCacheHeader, then data_size bytes of the chain.
+static constexpr char c_texture_cache_magic[8] = {'X', 'X', 'T', 'E', 'X', 'B', 'C', '\0'};
+// Bump when the encoder output changes.
+static constexpr std::uint32_t c_texture_cache_version = 1;
+
+struct TextureCacheHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    TextureFormat format;
+    std::uint64_t key;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t mips_count;
+    std::uint32_t reserved;
+    std::uint64_t data_size;
+    double psnr_db;
+};
+
+static_assert(std::is_trivially_copyable_v<TextureCacheHeader>);
+
+static fs::path GetCachePath(std::uint64_t key)
+{
+    char file_name[32]{};
+    (void)std::snprintf(file_name, sizeof(file_name), "%016llx.btex", static_cast<unsigned long long>(key));
+    std::error_code ec;
+    return fs::temp_directory_path(ec) / "render_playground" / "textures" / file_name;
+}
+
+static bool LoadCached(
+    const fs::path& path,
+    std::uint64_t key,
+    const TextureCacheHeader& expected,
+    TextureCompressResult& result
+)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    TextureCacheHeader header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || (std::memcmp(header.magic, c_texture_cache_magic, sizeof(c_texture_cache_magic)) != 0)
+        || (header.version != c_texture_cache_version) || (header.key != key) || (header.format != expected.format)
+        || (header.width != expected.width) || (header.height != expected.height)
+        || (header.mips_count != expected.mips_count) || (header.data_size != expected.data_size))
+    {
+        return false;
+    }
+    MipChain data(static_cast<std::uint8_t*>(std::malloc(std::size_t(header.data_size))), &std::free);
+    Panic(!!data);
+    if (!in.read(reinterpret_cast<char*>(data.get()), std::streamsize(header.data_size)))
+    {
+        return false;
+    }
+    result.data = std::move(data);
+    result.psnr_db = header.psnr_db;
+    result.from_cache = true;
+    return true;
+}
+
+static void SaveCached(const fs::path& path, const TextureCacheHeader& header, const std::uint8_t* data)
+{
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    // Same as the model cache: never leave a half-written file.
+    fs::path temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(data), std::streamsize(header.data_size));
+        if (!out)
+        {
+            return;
+        }
+    }
+    fs::rename(temp_path, path, ec);
+}
+
+// Over the channels the format stores: RGB (BC1), RG (BC5), RGBA otherwise.
+static double ComputePSNR(TextureFormat format, const std::uint8_t* blocks, const Texture& texture)
+{
+    const std::size_t pixels = std::size_t(texture.width) * texture.height;
+    MipChain decoded(static_cast<std::uint8_t*>(std::malloc(pixels * c_texture_channels)), &std::free);
+    Panic(!!decoded);
+    TextureBC_Decode(format, blocks, texture.width, texture.height, decoded.get());
+    const std::size_t channels = (format == TextureFormat::BC5) ? 2 : ((format == TextureFormat::BC1) ? 3 : 4);
+    double squared_error = 0.0;
+    for (std::size_t i = 0; i < pixels; ++i)
+    {
+        for (std::size_t c = 0; c < channels; ++c)
+        {
+            const double d = double(decoded.get()[i * 4 + c]) - double(texture.data[i * 4 + c]);
+            squared_error += d * d;
+        }
+    }
+    const double mse = squared_error / double(pixels * channels);
+    return (mse > 0.0) ? (10.0 * std::log10(255.0 * 255.0 / mse)) : 99.0;
+}
+
+TextureFormat TextureCompress_PickFormat(const Texture& texture, MipFilter filter, TextureCompression compression)
+{
+    if ((compression == TextureCompression::None) || (texture.format != TextureFormat::RGBA8)
+        || (texture.width == 0) || (texture.height == 0) || ((texture.width % 4) != 0) || ((texture.height % 4) != 0))
+    {
+        return TextureFormat::RGBA8;
+    }
+    if (filter == MipFilter::NormalMap)
+    {
+        return TextureFormat::BC5;
+    }
+    if (compression == TextureCompression::Quality)
+    {
+        return TextureFormat::BC7;
+    }
+    const std::size_t pixels = std::size_t(texture.width) * texture.height;
+    for (std::size_t i = 0; i < pixels; ++i)
+    {
+        if (texture.data[i * 4 + 3] != 0xFF)
+        {
+            return TextureFormat::BC3;
+        }
+    }
+    return TextureFormat::BC1;
+}
+
+TextureCompressResult TextureCompress_Chain(const Texture& texture, MipFilter filter, TextureCompression compression)
+{
+    TextureCompressResult result{};
+    result.format = TextureCompress_PickFormat(texture, filter, compression);
+    if (result.format == TextureFormat::RGBA8)
+    {
+        return result;
+    }
+    const BcQuality quality = (compression == TextureCompression::Quality) ? BcQuality::High : BcQuality::Fast;
+    const std::uint32_t width = texture.width;
+    const std::uint32_t height = texture.height;
+    Panic(texture.data.size() == TextureMips_ChainBytes(TextureFormat::RGBA8, width, height, texture.mips_count));
+
+    TextureCacheHeader header{};
+    std::memcpy(header.magic, c_texture_cache_magic, sizeof(c_texture_cache_magic));
+    header.version = c_texture_cache_version;
+    header.format = result.format;
+    header.width = width;
+    header.height = height;
+    header.mips_count = texture.mips_count;
+    header.data_size = TextureMips_ChainBytes(result.format, width, height, texture.mips_count);
+    std::uint64_t key = Hash64(texture.data.data(), texture.data.size());
+    key = Hash64_Mix(key, (std::uint64_t(width) << 32) | height);
+    key = Hash64_Mix(key, (std::uint64_t(texture.mips_count) << 32) | std::uint32_t(result.format));
+    key = Hash64_Mix(key, (std::uint64_t(c_texture_cache_version) << 32) | std::uint32_t(quality));
+    header.key = key;
+
+    const fs::path cache_path = GetCachePath(key);
+    if (LoadCached(cache_path, key, header, result))
+    {
+        return result;
+    }
+
+    result.data = MipChain(static_cast<std::uint8_t*>(std::malloc(std::size_t(header.data_size))), &std::free);
+    Panic(!!result.data);
+    const StopWatch timer;
+    std::size_t pixels = 0;
+    for (std::uint32_t mip = 0; mip < texture.mips_count; ++mip)
+    {
+        const std::uint32_t level_width = TextureMips_LevelSize(width, mip);
+        const std::uint32_t level_height = TextureMips_LevelSize(height, mip);
+        TextureBC_Encode(
+            result.format,
+            quality,
+            texture.data.data() + TextureMips_LevelOffset(TextureFormat::RGBA8, width, height, mip),
+            level_width,
+            level_height,
+            result.data.get() + TextureMips_LevelOffset(result.format, width, height, mip)
+        );
+        pixels += std::size_t(level_width) * level_height;
+    }
+    result.encode_ms = timer.elapsed_ms();
+    result.mpix_per_s = (result.encode_ms > 0.0) ? (double(pixels) / (result.encode_ms * 1e3)) : 0.0;
+    result.psnr_db = ComputePSNR(result.format, result.data.get(), texture);
+
+    header.psnr_db = result.psnr_db;
+    SaveCached(cache_path, header, result.data.get());
+    return result;
+}
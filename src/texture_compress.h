@@ -0,0 +1,39 @@
+#pragma once
+#include "model.h"
+#include "texture_mips.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+// Block compression of texture mip chains (see texture_bc.h) with quality presets:
+// - Fast: BC1 color (BC3 if there is alpha), fast endpoint fit;
+// - Quality: BC7 color, refined endpoints;
+// normal maps are BC5 with both presets (z is reconstructed in the shader).
+// Results are cached on disk by content hash: %TEMP%/render_playground/textures/<hash>.btex,
+// so the same texels are encoded once, whatever model they come from.
+enum class TextureCompression
+{
+    None,
+    Fast,
+    Quality,
+};
+
+// Part of the model cache key (see LoadModel()).
+constexpr TextureCompression c_texture_compression = TextureCompression::Quality;
+
+// RGBA8 if the texture is kept as is (compression is off, already compressed,
+// or level 0 is not a multiple of 4 as D3D11 requires for block formats).
+TextureFormat TextureCompress_PickFormat(const Texture& texture, MipFilter filter, TextureCompression compression);
+
+struct TextureCompressResult
+{
+    MipChain data{nullptr, &std::free}; // null if the texture is kept as is
+    TextureFormat format = TextureFormat::RGBA8;
+    double encode_ms = 0.0;
+    double mpix_per_s = 0.0; // encode throughput, all levels; 0 if from_cache
+    double psnr_db = 0.0;    // level 0, channels the format keeps
+    bool from_cache = false;
+};
+
+// Same mips_count as the (RGBA8) texture.
+TextureCompressResult TextureCompress_Chain(const Texture& texture, MipFilter filter, TextureCompression compression);
@@ -0,0 +1,355 @@
+#include "texture_container.h"
+#include "texture_bc.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <cstdlib>
+#include <cstring>
+
+// https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+struct DdsPixelFormat
+{
+    std::uint32_t size;
+    std::uint32_t flags;
+    std::uint32_t four_cc;
+    std::uint32_t rgb_bit_count;
+    std::uint32_t r_mask;
+    std::uint32_t g_mask;
+    std::uint32_t b_mask;
+    std::uint32_t a_mask;
+};
+
+struct DdsHeader
+{
+    std::uint32_t size;
+    std::uint32_t flags;
+    std::uint32_t height;
+    std::uint32_t width;
+    std::uint32_t pitch_or_linear_size;
+    std::uint32_t depth;
+    std::uint32_t mip_map_count;
+    std::uint32_t reserved1[11];
+    DdsPixelFormat pixel_format;
+    std::uint32_t caps;
+    std::uint32_t caps2;
+    std::uint32_t caps3;
+    std::uint32_t caps4;
+    std::uint32_t reserved2;
+};
+
+struct DdsHeaderDX10
+{
+    std::uint32_t dxgi_format;
+    std::uint32_t resource_dimension;
+    std::uint32_t misc_flag;
+    std::uint32_t array_size;
+    std::uint32_t misc_flags2;
+};
+
+// https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+struct Ktx2Header
+{
+    std::uint8_t identifier[12];
+    std::uint32_t vk_format;
+    std::uint32_t type_size;
+    std::uint32_t pixel_width;
+    std::uint32_t pixel_height;
+    std::uint32_t pixel_depth;
+    std::uint32_t layer_count;
+    std::uint32_t face_count;
+    std::uint32_t level_count;
+    std::uint32_t supercompression_scheme;
+    std::uint32_t dfd_byte_offset;
+    std::uint32_t dfd_byte_length;
+    std::uint32_t kvd_byte_offset;
+    std::uint32_t kvd_byte_length;
+    std::uint64_t sgd_byte_offset;
+    std::uint64_t sgd_byte_length;
+};
+
+struct Ktx2Level
+{
+    std::uint64_t byte_offset;
+    std::uint64_t byte_length;
+    std::uint64_t uncompressed_byte_length;
+};
+
+static_assert(sizeof(DdsHeader) == 124);
+static_assert(sizeof(DdsHeaderDX10) == 20);
+static_assert(sizeof(Ktx2Header) == 80);
+static_assert(sizeof(Ktx2Level) == 24);
+
+static constexpr std::uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+    return (std::uint32_t(std::uint8_t(a)) | (std::uint32_t(std::uint8_t(b)) << 8)
+            | (std::uint32_t(std::uint8_t(c)) << 16) | (std::uint32_t(std::uint8_t(d)) << 24));
+}
+
+static constexpr std::uint32_t c_dds_magic = MakeFourCC('D', 'D', 'S', ' ');
+static constexpr std::uint32_t c_ddsd_mipmapcount = 0x20000;
+static constexpr std::uint32_t c_ddpf_fourcc = 0x4;
+static constexpr std::uint32_t c_ddpf_rgb = 0x40;
+static constexpr std::uint32_t c_ddscaps2_cubemap = 0x200;
+static constexpr std::uint32_t c_ddscaps2_volume = 0x200000;
+static constexpr std::uint32_t c_d3d10_resource_dimension_texture2d = 3;
+static constexpr std::uint32_t c_d3d10_resource_misc_texturecube = 0x4;
+
+static constexpr std::uint8_t c_ktx2_identifier[12] =
+    {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+template <typename T>
+static bool ReadPOD(std::span<const std::uint8_t> bytes, std::uint64_t offset, T& value)
+{
+    if ((offset > bytes.size()) || ((bytes.size() - offset) < sizeof(T)))
+    {
+        return false;
+    }
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return true;
+}
+
+// DXGI_FORMAT values.
+static bool FromDxgiFormat(std::uint32_t dxgi_format, TextureFormat& format, bool& srgb)
+{
+    switch (dxgi_format)
+    {
+    case 28: // R8G8B8A8_UNORM
+    case 29: // R8G8B8A8_UNORM_SRGB
+        format = TextureFormat::RGBA8;
+        srgb = (dxgi_format == 29);
+        return true;
+    case 71: // BC1_UNORM
+    case 72: // BC1_UNORM_SRGB
+        format = TextureFormat::BC1;
+        srgb = (dxgi_format == 72);
+        return true;
+    case 77: // BC3_UNORM
+    case 78: // BC3_UNORM_SRGB
+        format = TextureFormat::BC3;
+        srgb = (dxgi_format == 78);
+        return true;
+    case 83: // BC5_UNORM
+        format = TextureFormat::BC5;
+        srgb = false;
+        return true;
+    case 98: // BC7_UNORM
+    case 99: // BC7_UNORM_SRGB
+        format = TextureFormat::BC7;
+        srgb = (dxgi_format == 99);
+        return true;
+    }
+    return false;
+}
+
+// VkFormat values.
+static bool FromVkFormat(std::uint32_t vk_format, TextureFormat& format, bool& srgb)
+{
+    switch (vk_format)
+    {
+    case 37: // R8G8B8A8_UNORM
+    case 43: // R8G8B8A8_SRGB
+        format = TextureFormat::RGBA8;
+        srgb = (vk_format == 43);
+        return true;
+    case 131: // BC1_RGB_UNORM_BLOCK
+    case 132: // BC1_RGB_SRGB_BLOCK
+    case 133: // BC1_RGBA_UNORM_BLOCK
+    case 134: // BC1_RGBA_SRGB_BLOCK
+        format = TextureFormat::BC1;
+        srgb = ((vk_format == 132) || (vk_format == 134));
+        return true;
+    case 137: // BC3_UNORM_BLOCK
+    case 138: // BC3_SRGB_BLOCK
+        format = TextureFormat::BC3;
+        srgb = (vk_format == 138);
+        return true;
+    case 141: // BC5_UNORM_BLOCK
+        format = TextureFormat::BC5;
+        srgb = false;
+        return true;
+    case 145: // BC7_UNORM_BLOCK
+    case 146: // BC7_SRGB_BLOCK
+        format = TextureFormat::BC7;
+        srgb = (vk_format == 146);
+        return true;
+    }
+    return false;
+}
+
+// Legacy formats have no color space: color ones are taken as sRGB, as decoded images.
+static bool FromDdsPixelFormat(const DdsPixelFormat& pixel_format, TextureFormat& format, bool& srgb)
+{
+    if (pixel_format.flags & c_ddpf_fourcc)
+    {
+        switch (pixel_format.four_cc)
+        {
+        case MakeFourCC('D', 'X', 'T', '1'):
+            format = TextureFormat::BC1;
+            srgb = true;
+            return true;
+        case MakeFourCC('D', 'X', 'T', '5'):
+            format = TextureFormat::BC3;
+            srgb = true;
+            return true;
+        case MakeFourCC('A', 'T', 'I', '2'):
+        case MakeFourCC('B', 'C', '5', 'U'):
+            format = TextureFormat::BC5;
+            srgb = false;
+            return true;
+        }
+        return false;
+    }
+    if ((pixel_format.flags & c_ddpf_rgb) && (pixel_format.rgb_bit_count == 32)
+        && (pixel_format.r_mask == 0x000000FF) && (pixel_format.g_mask == 0x0000FF00)
+        && (pixel_format.b_mask == 0x00FF0000) && (pixel_format.a_mask == 0xFF000000))
+    {
+        format = TextureFormat::RGBA8;
+        srgb = true;
+        return true;
+    }
+    return false;
+}
+
+// Sizes/mips are usable by D3D11 (block formats need level 0 to be a multiple of 4).
+static bool IsValidLayout(const TextureContainer& texture)
+{
+    if ((texture.width == 0) || (texture.height == 0) || (texture.mips_count == 0)
+        || (texture.mips_count > TextureMips_FullCount(texture.width, texture.height)))
+    {
+        return false;
+    }
+    if (TextureBC_IsCompressed(texture.format) && (((texture.width % 4) != 0) || ((texture.height % 4) != 0)))
+    {
+        return false;
+    }
+    return true;
+}
+
+static outcome::result<TextureContainer> ParseDds(std::span<const std::uint8_t> bytes)
+{
+    DdsHeader header{};
+    if (!ReadPOD(bytes, sizeof(c_dds_magic), header) || (header.size != sizeof(DdsHeader))
+        || (header.pixel_format.size != sizeof(DdsPixelFormat)))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    if ((header.caps2 & (c_ddscaps2_cubemap | c_ddscaps2_volume)) != 0)
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    TextureContainer texture{};
+    std::uint64_t offset = sizeof(c_dds_magic) + sizeof(DdsHeader);
+    if ((header.pixel_format.flags & c_ddpf_fourcc) && (header.pixel_format.four_cc == MakeFourCC('D', 'X', '1', '0')))
+    {
+        DdsHeaderDX10 dx10{};
+        if (!ReadPOD(bytes, offset, dx10))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        offset += sizeof(DdsHeaderDX10);
+        if ((dx10.resource_dimension != c_d3d10_resource_dimension_texture2d)
+            || ((dx10.misc_flag & c_d3d10_resource_misc_texturecube) != 0) || (dx10.array_size > 1)
+            || !FromDxgiFormat(dx10.dxgi_format, texture.format, texture.srgb))
+        {
+            return outcome::failure(std::errc::not_supported);
+        }
+    }
+    else if (!FromDdsPixelFormat(header.pixel_format, texture.format, texture.srgb))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.mips_count = (header.flags & c_ddsd_mipmapcount) ? std::max(1u, header.mip_map_count) : 1u;
+    if (!IsValidLayout(texture))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    // Levels follow the header, tightly packed: same as the chain layout.
+    const std::size_t chain_bytes =
+        TextureMips_ChainBytes(texture.format, texture.width, texture.height, texture.mips_count);
+    if ((bytes.size() - offset) < chain_bytes)
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    texture.data = bytes.subspan(std::size_t(offset), chain_bytes);
+    return outcome::success(std::move(texture));
+}
+
+static outcome::result<TextureContainer> ParseKtx2(std::span<const std::uint8_t> bytes)
+{
+    Ktx2Header header{};
+    if (!ReadPOD(bytes, 0, header))
+    {
+        return outcome::failure(std::errc::illegal_byte_sequence);
+    }
+    TextureContainer texture{};
+    if ((header.pixel_depth > 1) || (header.layer_count > 1) || (header.face_count != 1)
+        || (header.supercompression_scheme != 0) || !FromVkFormat(header.vk_format, texture.format, texture.srgb))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+    texture.width = header.pixel_width;
+    texture.height = header.pixel_height;
+    // 0 - mips are expected to be generated by the loader; there is level 0 only.
+    texture.mips_count = std::max(1u, header.level_count);
+    if (!IsValidLayout(texture))
+    {
+        return outcome::failure(std::errc::not_supported);
+    }
+
+    // Level index is level 0 first; the data itself is usually the smallest level first.
+    std::vector<std::span<const std::uint8_t>> levels(texture.mips_count);
+    for (std::uint32_t mip = 0; mip < texture.mips_count; ++mip)
+    {
+        Ktx2Level level{};
+        const std::size_t expected = TextureMips_LevelBytes(texture.format, texture.width, texture.height, mip);
+        if (!ReadPOD(bytes, sizeof(Ktx2Header) + sizeof(Ktx2Level) * mip, level)
+            || (level.byte_length != expected) || (level.byte_offset > bytes.size())
+            || ((bytes.size() - level.byte_offset) < level.byte_length))
+        {
+            return outcome::failure(std::errc::illegal_byte_sequence);
+        }
+        levels[mip] = bytes.subspan(std::size_t(level.byte_offset), expected);
+    }
+    if (texture.mips_count == 1)
+    {
+        texture.data = levels[0];
+        return outcome::success(std::move(texture));
+    }
+    const std::size_t chain_bytes =
+        TextureMips_ChainBytes(texture.format, texture.width, texture.height, texture.mips_count);
+    texture.owned = MipChain(static_cast<std::uint8_t*>(std::malloc(chain_bytes)), &std::free);
+    Panic(!!texture.owned);
+    std::uint8_t* dst = texture.owned.get();
+    for (const std::span<const std::uint8_t>& level : levels)
+    {
+        std::memcpy(dst, level.data(), level.size());
+        dst += level.size();
+    }
+    texture.data = {texture.owned.get(), chain_bytes};
+    return outcome::success(std::move(texture));
+}
+
+bool TextureContainer_IsPath(const std::filesystem::path& path)
+{
+    const std::filesystem::path ext = path.extension();
+    return (ext == ".dds") || (ext == ".DDS") || (ext == ".ktx2") || (ext == ".KTX2");
+}
+
+outcome::result<TextureContainer> TextureContainer_Parse(std::span<const std::uint8_t> bytes)
+{
+    std::uint32_t magic = 0;
+    if (ReadPOD(bytes, 0, magic) && (magic == c_dds_magic))
+    {
+        return ParseDds(bytes);
+    }
+    if ((bytes.size() >= sizeof(c_ktx2_identifier))
+        && (std::memcmp(bytes.data(), c_ktx2_identifier, sizeof(c_ktx2_identifier)) == 0))
+    {
+        return ParseKtx2(bytes);
+    }
+    return outcome::failure(std::errc::not_supported);
+}
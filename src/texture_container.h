@@ -0,0 +1,34 @@
+#pragma once
+#include "model.h"
+#include "texture_mips.h"
+#include "utils_outcome.h"
+
+#include <filesystem>
+#include <span>
+
+#include <cstdint>
+#include <cstdlib>
+
+// GPU-ready texture files, used as is (no decode, no mips generation, no compression):
+// - DDS: DX10 header (DXGI_FORMAT_*), legacy DXT1/DXT5/ATI2/BC5U FourCC or 32-bit RGBA masks;
+// - KTX2: VK_FORMAT_*, without supercompression.
+// Single 2D image (no arrays, cube maps or volumes) in one of TextureFormat formats;
+// UNORM and SRGB variants are the same format, told apart by srgb.
+struct TextureContainer
+{
+    TextureFormat format = TextureFormat::RGBA8;
+    // SRGB variant; legacy DDS formats (no color space) are sRGB, except BC5.
+    bool srgb = true;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint32_t mips_count = 0;
+    // Mip chain laid out as texture_mips.h describes. Points into the parsed bytes
+    // when the file has the same layout (DDS, single level KTX2), otherwise into owned.
+    std::span<const std::uint8_t> data;
+    MipChain owned{nullptr, &std::free};
+};
+
+// .dds or .ktx2 extension (lower or upper case).
+bool TextureContainer_IsPath(const std::filesystem::path& path);
+// Also checks the magic; std::errc::not_supported for valid files of other kinds/formats.
+outcome::result<TextureContainer> TextureContainer_Parse(std::span<const std::uint8_t> bytes);
@@ -0,0 +1,155 @@
+#include "texture_convert.h"
+#include "utils.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define XX_TEXTURE_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define XX_TEXTURE_SIMD 0
+#endif
+
+#include <cstddef>
+
+// SSE2 is x64 baseline; SSSE3 (pshufb, for RGB) is checked at runtime.
+#if XX_TEXTURE_SIMD && (defined(__clang__) || defined(__GNUC__))
+#define XX_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define XX_TARGET_SSSE3
+#endif
+
+static void ExpandScalar(const std::uint8_t* src, unsigned channels, std::size_t count, std::uint8_t* dst)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const std::uint8_t* s = src + i * channels;
+        std::uint8_t* d = dst + i * 4;
+        switch (channels)
+        {
+        case 1:
+            d[0] = d[1] = d[2] = s[0];
+            d[3] = 0xFF;
+            break;
+        case 2:
+            d[0] = d[1] = d[2] = s[0];
+            d[3] = s[1];
+            break;
+        default:
+            d[0] = s[0];
+            d[1] = s[1];
+            d[2] = s[2];
+            d[3] = 0xFF;
+            break;
+        }
+    }
+}
+
+#if XX_TEXTURE_SIMD
+static bool HasSSSE3()
+{
+#if defined(_MSC_VER)
+    int info[4]{};
+    __cpuid(info, 1);
+    return ((info[2] & (1 << 9)) != 0);
+#else
+    unsigned eax = 0;
+    unsigned ebx = 0;
+    unsigned ecx = 0;
+    unsigned edx = 0;
+    return (__get_cpuid(1, &eax, &ebx, &ecx, &edx) != 0) && ((ecx & bit_SSSE3) != 0);
+#endif
+}
+
+// 16 pixels per iteration; returns pixels done.
+static std::size_t ExpandGray_SSE2(const std::uint8_t* src, std::size_t count, std::uint8_t* dst)
+{
+    const __m128i alpha = _mm_set1_epi8(char(0xFF));
+    std::size_t i = 0;
+    for (; (i + 16) <= count; i += 16)
+    {
+        const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // (g, g) and (g, 255) word pairs, interleaved into (g, g, g, 255).
+        const __m128i gg_lo = _mm_unpacklo_epi8(g, g);
+        const __m128i gg_hi = _mm_unpackhi_epi8(g, g);
+        const __m128i ga_lo = _mm_unpacklo_epi8(g, alpha);
+        const __m128i ga_hi = _mm_unpackhi_epi8(g, alpha);
+        __m128i* out = reinterpret_cast<__m128i*>(dst + i * 4);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(gg_lo, ga_lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg_lo, ga_lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(gg_hi, ga_hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(gg_hi, ga_hi));
+    }
+    return i;
+}
+
+// 8 pixels per iteration.
+static std::size_t ExpandGrayAlpha_SSE2(const std::uint8_t* src, std::size_t count, std::uint8_t* dst)
+{
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+    std::size_t i = 0;
+    for (; (i + 8) <= count; i += 8)
+    {
+        const __m128i ga = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        const __m128i g = _mm_and_si128(ga, low_bytes);
+        const __m128i gg = _mm_or_si128(g, _mm_slli_epi16(g, 8));
+        __m128i* out = reinterpret_cast<__m128i*>(dst + i * 4);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(gg, ga));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg, ga));
+    }
+    return i;
+}
+
+// 16 pixels (48 bytes) per iteration.
+XX_TARGET_SSSE3 static std::size_t ExpandRGB_SSSE3(const std::uint8_t* src, std::size_t count, std::uint8_t* dst)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(int(0xFF000000u));
+    std::size_t i = 0;
+    for (; (i + 16) <= count; i += 16)
+    {
+        const __m128i* in = reinterpret_cast<const __m128i*>(src + i * 3);
+        const __m128i a = _mm_loadu_si128(in + 0);
+        const __m128i b = _mm_loadu_si128(in + 1);
+        const __m128i c = _mm_loadu_si128(in + 2);
+        // Every 12 input bytes (4 pixels) at the start of a register.
+        const __m128i rgb[4] = {a, _mm_alignr_epi8(b, a, 12), _mm_alignr_epi8(c, b, 8), _mm_srli_si128(c, 4)};
+        __m128i* out = reinterpret_cast<__m128i*>(dst + i * 4);
+        for (int k = 0; k < 4; ++k)
+        {
+            _mm_storeu_si128(out + k, _mm_or_si128(_mm_shuffle_epi8(rgb[k], shuffle), alpha));
+        }
+    }
+    return i;
+}
+#endif
+
+void Texture_ExpandToRGBA(std::span<const std::uint8_t> src, unsigned channels, std::span<std::uint8_t> rgba)
+{
+    Panic((channels >= 1) && (channels <= 3));
+    Panic((src.size() % channels) == 0);
+    const std::size_t count = (src.size() / channels);
+    Panic(rgba.size() == (count * 4));
+
+    std::size_t done = 0;
+#if XX_TEXTURE_SIMD
+    static const bool has_ssse3 = HasSSSE3();
+    switch (channels)
+    {
+    case 1:
+        done = ExpandGray_SSE2(src.data(), count, rgba.data());
+        break;
+    case 2:
+        done = ExpandGrayAlpha_SSE2(src.data(), count, rgba.data());
+        break;
+    default:
+        done = has_ssse3 ? ExpandRGB_SSSE3(src.data(), count, rgba.data()) : 0;
+        break;
+    }
+#endif
+    // Tail (and everything without SIMD).
+    ExpandScalar(src.data() + done * channels, channels, count - done, rgba.data() + done * 4);
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <span>
+
+#include <cstdint>
+
+// Expands decoded pixels with 1 (gray), 2 (gray, alpha) or 3 (RGB) channels
+// into RGBA: gray is replicated into RGB, missing alpha is 255.
+// rgba has 4 bytes per pixel of src. SSE2/SSSE3 on x64, scalar elsewhere.
+void Texture_ExpandToRGBA(std::span<const std::uint8_t> src, unsigned channels, std::span<std::uint8_t> rgba);
@@ -0,0 +1,306 @@
+#include "texture_mips.h"
+#include "texture_bc.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "utils_hash.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define XX_TEXTURE_SIMD 1
+#include <immintrin.h>
+#else
+#define XX_TEXTURE_SIMD 0
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Output rows per parallel_for() task.
+static constexpr std::uint32_t c_rows_per_task = 16;
+// linear -> sRGB table resolution; fine enough for 8-bit dark tones.
+static constexpr std::size_t c_srgb_table_size = (64 * 1024);
+
+struct SrgbTables
+{
+    float to_linear[256];
+    std::uint8_t to_srgb[c_srgb_table_size];
+};
+
+static const SrgbTables& GetSrgbTables()
+{
+    static const SrgbTables tables = []() {
+        SrgbTables t{};
+        for (int i = 0; i < 256; ++i)
+        {
+            const double c = double(i) / 255.0;
+            t.to_linear[i] = float((c <= 0.04045) ? (c / 12.92) : std::pow((c + 0.055) / 1.055, 2.4));
+        }
+        for (std::size_t i = 0; i < c_srgb_table_size; ++i)
+        {
+            const double l = double(i) / double(c_srgb_table_size - 1);
+            const double c = (l <= 0.0031308) ? (l * 12.92) : (1.055 * std::pow(l, 1.0 / 2.4) - 0.055);
+            t.to_srgb[i] = std::uint8_t(std::lround(std::clamp(c, 0.0, 1.0) * 255.0));
+        }
+        return t;
+    }();
+    return tables;
+}
+
+static std::uint8_t ToUnorm8(float v)
+{
+    return std::uint8_t(std::lround(std::clamp(v, 0.f, 1.f) * 255.f));
+}
+
+// RGBA8 row to float RGBA (linear color or [-1; 1] normal).
+static void DecodeRow(const std::uint8_t* src, std::uint32_t count, MipFilter filter, float* dst)
+{
+    const SrgbTables& tables = GetSrgbTables();
+    for (std::uint32_t x = 0; x < count; ++x)
+    {
+        const std::uint8_t* s = src + x * 4;
+        float* d = dst + x * 4;
+        if (filter == MipFilter::Color)
+        {
+            d[0] = tables.to_linear[s[0]];
+            d[1] = tables.to_linear[s[1]];
+            d[2] = tables.to_linear[s[2]];
+        }
+        else
+        {
+            d[0] = float(s[0]) / 127.5f - 1.f;
+            d[1] = float(s[1]) / 127.5f - 1.f;
+            d[2] = float(s[2]) / 127.5f - 1.f;
+        }
+        d[3] = float(s[3]) / 255.f;
+    }
+}
+
+static void EncodeRow(const float* src, std::uint32_t count, MipFilter filter, std::uint8_t* dst)
+{
+    const SrgbTables& tables = GetSrgbTables();
+    const float scale = float(c_srgb_table_size - 1);
+    for (std::uint32_t x = 0; x < count; ++x)
+    {
+        const float* s = src + x * 4;
+        std::uint8_t* d = dst + x * 4;
+        for (int c = 0; c < 3; ++c)
+        {
+            if (filter == MipFilter::Color)
+            {
+                d[c] = tables.to_srgb[std::size_t(std::clamp(s[c], 0.f, 1.f) * scale + 0.5f)];
+            }
+            else
+            {
+                d[c] = ToUnorm8(s[c] * 0.5f + 0.5f);
+            }
+        }
+        d[3] = ToUnorm8(s[3]);
+    }
+}
+
+// 2x2 box of two float rows into dst_count pixels; xyz is renormalized for normal maps.
+static void FilterRows(
+    const float* row0,
+    const float* row1,
+    std::uint32_t src_count,
+    std::uint32_t dst_count,
+    MipFilter filter,
+    float* dst
+)
+{
+    const bool normalize = (filter == MipFilter::NormalMap);
+    for (std::uint32_t x = 0; x < dst_count; ++x)
+    {
+        const std::uint32_t x0 = std::min(2 * x, src_count - 1) * 4;
+        const std::uint32_t x1 = std::min(2 * x + 1, src_count - 1) * 4;
+#if XX_TEXTURE_SIMD
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1));
+        sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+        __m128 v = _mm_mul_ps(sum, _mm_set1_ps(0.25f));
+        if (normalize)
+        {
+            // |xyz|^2 in every lane; w is kept.
+            const __m128 xyz = _mm_and_ps(v, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+            __m128 dot = _mm_mul_ps(xyz, xyz);
+            dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(2, 3, 0, 1)));
+            dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1, 0, 3, 2)));
+            if (_mm_cvtss_f32(dot) > 1e-12f)
+            {
+                const __m128 scaled = _mm_div_ps(v, _mm_sqrt_ps(dot));
+                const __m128 w = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+                // (x, y, z) / length, w.
+                v = _mm_shuffle_ps(scaled, _mm_unpackhi_ps(scaled, w), _MM_SHUFFLE(3, 0, 1, 0));
+            }
+        }
+        _mm_storeu_ps(dst + x * 4, v);
+#else
+        float* d = dst + x * 4;
+        for (std::uint32_t c = 0; c < 4; ++c)
+        {
+            d[c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+        }
+        if (normalize)
+        {
+            const float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            if (length > 1e-6f)
+            {
+                d[0] /= length;
+                d[1] /= length;
+                d[2] /= length;
+            }
+        }
+#endif
+    }
+}
+
+std::uint32_t TextureMips_FullCount(std::uint32_t width, std::uint32_t height)
+{
+    std::uint32_t count = 1;
+    while ((width > 1) || (height > 1))
+    {
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+        ++count;
+    }
+    return count;
+}
+
+std::uint32_t TextureMips_LevelSize(std::uint32_t size, std::uint32_t level)
+{
+    return std::max(1u, (level < 32) ? (size >> level) : 0u);
+}
+
+std::uint32_t TextureMips_RowPitch(TextureFormat format, std::uint32_t width, std::uint32_t level)
+{
+    const std::uint32_t size = TextureMips_LevelSize(width, level);
+    if (TextureBC_IsCompressed(format))
+    {
+        return ((size + 3) / 4) * TextureBC_BlockBytes(format);
+    }
+    return size * c_texture_channels;
+}
+
+std::size_t TextureMips_LevelBytes(
+    TextureFormat format,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint32_t level
+)
+{
+    std::size_t rows = TextureMips_LevelSize(height, level);
+    if (TextureBC_IsCompressed(format))
+    {
+        rows = (rows + 3) / 4; // of blocks
+    }
+    return rows * TextureMips_RowPitch(format, width, level);
+}
+
+std::size_t TextureMips_LevelOffset(
+    TextureFormat format,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint32_t level
+)
+{
+    std::size_t offset = 0;
+    for (std::uint32_t i = 0; i < level; ++i)
+    {
+        offset += TextureMips_LevelBytes(format, width, height, i);
+    }
+    return offset;
+}
+
+std::size_t TextureMips_ChainBytes(
+    TextureFormat format,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint32_t mips_count
+)
+{
+    return TextureMips_LevelOffset(format, width, height, mips_count);
+}
+
+Texture TextureMips_Tail(const Texture& texture, std::uint32_t first_level)
+{
+    Panic(first_level < texture.mips_count);
+    const std::size_t offset = TextureMips_LevelOffset(texture.format, texture.width, texture.height, first_level);
+    Texture tail = texture;
+    tail.width = TextureMips_LevelSize(texture.width, first_level);
+    tail.height = TextureMips_LevelSize(texture.height, first_level);
+    tail.mips_count = texture.mips_count - first_level;
+    tail.data = texture.data.subspan(offset);
+    if ((first_level > 0) && (tail.content_key != 0))
+    {
+        // Other content; same tail of the same texture for all models.
+        tail.content_key = Hash64_Mix(tail.content_key, first_level);
+    }
+    return tail;
+}
+
+MipChain TextureMips_Build(
+    std::span<const std::uint8_t> texels,
+    std::uint32_t width,
+    std::uint32_t height,
+    MipFilter filter
+)
+{
+    Panic((width > 0) && (height > 0));
+    Panic(texels.size() == (std::size_t(width) * height * c_texture_channels));
+    const std::uint32_t mips_count = TextureMips_FullCount(width, height);
+    const std::size_t chain_bytes = TextureMips_ChainBytes(TextureFormat::RGBA8, width, height, mips_count);
+    MipChain chain(static_cast<std::uint8_t*>(std::malloc(chain_bytes)), &std::free);
+    Panic(!!chain);
+    std::memcpy(chain.get(), texels.data(), texels.size());
+
+    // Previous level in float (none for level 1: decoded from texels row by row).
+    std::vector<float> prev;
+    std::vector<float> level;
+    for (std::uint32_t mip = 1; mip < mips_count; ++mip)
+    {
+        const std::uint32_t src_width = TextureMips_LevelSize(width, mip - 1);
+        const std::uint32_t src_height = TextureMips_LevelSize(height, mip - 1);
+        const std::uint32_t dst_width = TextureMips_LevelSize(width, mip);
+        const std::uint32_t dst_height = TextureMips_LevelSize(height, mip);
+        std::uint8_t* dst_texels = chain.get() + TextureMips_LevelOffset(TextureFormat::RGBA8, width, height, mip);
+        level.resize(std::size_t(dst_width) * dst_height * 4);
+
+        const std::uint32_t tasks = (dst_height + c_rows_per_task - 1) / c_rows_per_task;
+        GlobalThreadPool().parallel_for(tasks, [&](std::size_t task) {
+            std::vector<float> decoded; // source rows of level 1
+            if (mip == 1)
+            {
+                decoded.resize(std::size_t(src_width) * 4 * 2);
+            }
+            const std::uint32_t first = std::uint32_t(task) * c_rows_per_task;
+            const std::uint32_t last = std::min(dst_height, first + c_rows_per_task);
+            for (std::uint32_t y = first; y < last; ++y)
+            {
+                const std::uint32_t y0 = std::min(2 * y, src_height - 1);
+                const std::uint32_t y1 = std::min(2 * y + 1, src_height - 1);
+                const float* row0 = nullptr;
+                const float* row1 = nullptr;
+                if (mip == 1)
+                {
+                    const std::size_t pitch = std::size_t(src_width) * c_texture_channels;
+                    DecodeRow(texels.data() + y0 * pitch, src_width, filter, decoded.data());
+                    DecodeRow(texels.data() + y1 * pitch, src_width, filter, decoded.data() + src_width * 4);
+                    row0 = decoded.data();
+                    row1 = decoded.data() + src_width * 4;
+                }
+                else
+                {
+                    row0 = prev.data() + std::size_t(y0) * src_width * 4;
+                    row1 = prev.data() + std::size_t(y1) * src_width * 4;
+                }
+                float* dst = level.data() + std::size_t(y) * dst_width * 4;
+                FilterRows(row0, row1, src_width, dst_width, filter, dst);
+                EncodeRow(dst, dst_width, filter, dst_texels + std::size_t(y) * dst_width * c_texture_channels);
+            }
+        });
+        std::swap(prev, level);
+    }
+    return chain;
+}
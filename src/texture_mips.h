@@ -0,0 +1,61 @@
+#pragma once
+#include "model.h"
+
+#include <memory>
+#include <span>
+
+#include <cstddef>
+#include <cstdint>
+
+// Mip chains of RGBA8 textures (see Texture), built on the CPU with a 2x2 box filter.
+// The chain is tightly packed: level 0 first, every next level is max(1, size / 2)
+// in each dimension, down to 1x1 (odd last row/column is dropped).
+// - Color: RGB is averaged in linear space (texels are sRGB), alpha as is.
+// - NormalMap: texels are decoded to [-1; 1] vectors, averaged and renormalized.
+// Levels below 0 are filtered from the float previous level, so rounding does not
+// accumulate down the chain. Rows of every level are filtered on GlobalThreadPool().
+
+enum class MipFilter
+{
+    Color,
+    NormalMap,
+};
+
+using MipChain = std::unique_ptr<std::uint8_t, void (*)(void*)>; // std::free()
+
+std::uint32_t TextureMips_FullCount(std::uint32_t width, std::uint32_t height);
+std::uint32_t TextureMips_LevelSize(std::uint32_t size, std::uint32_t level);
+// Layout of a chain in any TextureFormat: block-compressed levels are
+// ceil(size / 4) blocks in each dimension, tightly packed the same way.
+std::uint32_t TextureMips_RowPitch(TextureFormat format, std::uint32_t width, std::uint32_t level);
+std::size_t TextureMips_LevelBytes(
+    TextureFormat format,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint32_t level
+);
+// Bytes of levels [0; level).
+std::size_t TextureMips_LevelOffset(
+    TextureFormat format,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint32_t level
+);
+std::size_t TextureMips_ChainBytes(
+    TextureFormat format,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::uint32_t mips_count
+);
+
+// Levels [first_level; mips_count) as a texture of their own, in place: the chain
+// of a smaller texture has the same layout (see ModelTextureStreamer).
+Texture TextureMips_Tail(const Texture& texture, std::uint32_t first_level);
+
+// Full chain (TextureMips_FullCount() levels); level 0 is a copy of texels.
+MipChain TextureMips_Build(
+    std::span<const std::uint8_t> texels,
+    std::uint32_t width,
+    std::uint32_t height,
+    MipFilter filter
+);
@@ -0,0 +1,138 @@
+#include "texture_share.h"
+#include "dx_api.h"
+#include "utils.h"
+#include "utils_hash.h"
+
+#include <algorithm>
+
+#include <cstring>
+
+static void ReleaseView(ID3D11ShaderResourceView* view)
+{
+    view->Release();
+}
+
+std::uint64_t TextureShare_MakeKey(const Texture& texture)
+{
+    std::uint64_t key = Hash64(texture.data.data(), texture.data.size());
+    key = Hash64_Mix(key, (std::uint64_t(texture.width) << 32) | texture.height);
+    key = Hash64_Mix(key, (std::uint64_t(texture.mips_count) << 32) | std::uint32_t(texture.format));
+    // Uploads of other color spaces are other views.
+    key = Hash64_Mix(key, texture.srgb ? 1u : 0u);
+    return (key != 0) ? key : 1;
+}
+
+SharedTexels TextureShare::share_texels(std::uint64_t key, std::span<const std::uint8_t> data, SharedTexels texels)
+{
+    Panic(key != 0);
+    Panic(texels.get() == data.data());
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[key];
+    if (SharedTexels existing = entry.texels.lock())
+    {
+        // Same key is not the same content for sure; don't share on a (very unlikely) collision.
+        if ((entry.texels_bytes == data.size()) && (std::memcmp(existing.get(), data.data(), data.size()) == 0))
+        {
+            ++cpu_hits_;
+            return existing;
+        }
+        return texels;
+    }
+    entry.texels = texels;
+    entry.texels_bytes = data.size();
+    sweep_locked();
+    return texels;
+}
+
+SharedTextureView TextureShare::find_view(std::uint64_t key)
+{
+    Panic(key != 0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        return SharedTextureView();
+    }
+    SharedTextureView view = it->second.view.lock();
+    gpu_hits_ += (view ? 1u : 0u);
+    return view;
+}
+
+SharedTextureView TextureShare::share_view(std::uint64_t key, ID3D11ShaderResourceView* view, std::size_t bytes)
+{
+    Panic(key != 0);
+    Panic(view);
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[key];
+    if (SharedTextureView existing = entry.view.lock())
+    {
+        ++gpu_hits_;
+        return existing;
+    }
+    view->AddRef();
+    SharedTextureView shared(view, &ReleaseView);
+    entry.view = shared;
+    entry.view_bytes = bytes;
+    sweep_locked();
+    return shared;
+}
+
+bool TextureShare::is_shared(std::uint64_t key) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        return false;
+    }
+    return (it->second.texels.use_count() > 1) || (it->second.view.use_count() > 1);
+}
+
+TextureShareStats TextureShare::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    TextureShareStats stats{};
+    stats.cpu_hits = cpu_hits_;
+    stats.gpu_hits = gpu_hits_;
+    for (const auto& it : entries_)
+    {
+        const Entry& entry = it.second;
+        if (const long refs = entry.texels.use_count(); refs > 0)
+        {
+            ++stats.cpu_textures;
+            stats.cpu_bytes_saved += std::size_t(refs - 1) * entry.texels_bytes;
+        }
+        if (const long refs = entry.view.use_count(); refs > 0)
+        {
+            ++stats.gpu_textures;
+            stats.gpu_bytes_saved += std::size_t(refs - 1) * entry.view_bytes;
+        }
+    }
+    return stats;
+}
+
+void TextureShare::sweep_locked()
+{
+    if (entries_.size() < next_sweep_)
+    {
+        return;
+    }
+    for (auto it = entries_.begin(); it != entries_.end();)
+    {
+        if (it->second.texels.expired() && it->second.view.expired())
+        {
+            it = entries_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    next_sweep_ = std::max<std::size_t>(64, entries_.size() * 2);
+}
+
+TextureShare& GlobalTextureShare()
+{
+    static TextureShare share;
+    return share;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "model.h"
+
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+
+#include <cstddef>
+#include <cstdint>
+
+struct ID3D11ShaderResourceView;
+
+// Texels & GPU textures shared by all loaded models, keyed by content (see TextureShare_MakeKey()):
+// catalog models that reference copies of the same image (under other paths or names)
+// keep one copy of the texels (see Model::share_textures()) and one uploaded texture
+// (see RenderTexture::make()). Entries are reference counted by the models & RenderTextures
+// that use them (shared_ptr); the registry only keeps weak references. Thread-safe.
+using SharedTexels = std::shared_ptr<const std::uint8_t>;
+using SharedTextureView = std::shared_ptr<ID3D11ShaderResourceView>;
+
+struct TextureShareStats
+{
+    std::uint32_t cpu_textures = 0; // alive chains
+    std::uint32_t gpu_textures = 0; // alive uploads
+    std::uint32_t cpu_hits = 0;     // since start
+    std::uint32_t gpu_hits = 0;
+    // Currently: bytes of the copies that would exist without sharing.
+    std::size_t cpu_bytes_saved = 0;
+    std::size_t gpu_bytes_saved = 0;
+};
+
+// Hash of the mip chain, size, mips, format & color space; never 0 (0 = not shared).
+std::uint64_t TextureShare_MakeKey(const Texture& texture);
+
+struct TextureShare
+{
+    // Texels of the same content some model has already (compared byte by byte);
+    // otherwise texels themselves, registered for the next models.
+    SharedTexels share_texels(std::uint64_t key, std::span<const std::uint8_t> data, SharedTexels texels);
+    // Uploaded texture of the same content, if any RenderTexture still has it.
+    SharedTextureView find_view(std::uint64_t key);
+    // view (with a reference added), registered; or the one registered by another thread meanwhile.
+    SharedTextureView share_view(std::uint64_t key, ID3D11ShaderResourceView* view, std::size_t bytes);
+    // Used by more than one model or RenderTexture.
+    bool is_shared(std::uint64_t key) const;
+
+    TextureShareStats stats() const;
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<const std::uint8_t> texels;
+        std::size_t texels_bytes = 0;
+        std::weak_ptr<ID3D11ShaderResourceView> view;
+        std::size_t view_bytes = 0;
+    };
+
+    // Drops entries nobody uses; amortized by the map growth.
+    void sweep_locked();
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<std::uint64_t, Entry> entries_;
+    std::size_t next_sweep_ = 64;
+    std::uint32_t cpu_hits_ = 0;
+    std::uint32_t gpu_hits_ = 0;
+};
+
+TextureShare& GlobalTextureShare();
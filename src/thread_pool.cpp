@@ -0,0 +1,123 @@
+#include "thread_pool.h"
+#include "utils.h"
+
+#include <atomic>
+
+/*explicit*/ ThreadPool::ThreadPool(unsigned threads_count)
+{
+    threads_.reserve(threads_count);
+    for (unsigned i = 0; i < threads_count; ++i)
+    {
+        threads_.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    has_work_.notify_all();
+    for (std::thread& t : threads_)
+    {
+        t.join();
+    }
+}
+
+unsigned ThreadPool::threads_count() const
+{
+    return unsigned(threads_.size());
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    has_work_.notify_one();
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            has_work_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            if (stop_ && tasks_.empty())
+            {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& f)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if ((count == 1) || threads_.empty())
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            f(i);
+        }
+        return;
+    }
+
+    // Helpers may start after the caller finished everything;
+    // keep state alive until the last one exits.
+    struct State
+    {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+        std::size_t count = 0;
+        const std::function<void(std::size_t)>* f = nullptr;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->f = &f;
+
+    auto run = [](State& s) {
+        std::size_t local_done = 0;
+        for (std::size_t i = s.next.fetch_add(1); i < s.count; i = s.next.fetch_add(1))
+        {
+            (*s.f)(i);
+            ++local_done;
+        }
+        if ((local_done > 0) && ((s.done.fetch_add(local_done) + local_done) == s.count))
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.finished.notify_all();
+        }
+    };
+
+    const std::size_t helpers = std::min<std::size_t>(threads_.size(), count - 1);
+    for (std::size_t i = 0; i < helpers; ++i)
+    {
+        push([state, run]() { run(*state); });
+    }
+    run(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return (state->done.load() == count); });
+}
+
+ThreadPool& GlobalThreadPool()
+{
+    static ThreadPool pool([]() {
+        const unsigned cores = std::thread::hardware_concurrency();
+        return ((cores > 1) ? (cores - 1) : 1u);
+    }());
+    return pool;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <cstddef>
+
+struct ThreadPool
+{
+    explicit ThreadPool(unsigned threads_count);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned threads_count() const;
+
+    template <typename F>
+    auto submit(F f) -> std::future<std::invoke_result_t<F&>>
+    {
+        using R = std::invoke_result_t<F&>;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::move(f));
+        std::future<R> result = task->get_future();
+        push([task]() { (*task)(); });
+        return result;
+    }
+
+    // Calls f(i) for i in [0; count). Blocks; the calling thread takes work too,
+    // so it's safe to call from inside other pool's task (no deadlock when
+    // all workers are busy).
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)>& f);
+
+private:
+    void push(std::function<void()> task);
+    void worker_loop();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable has_work_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    bool stop_ = false;
+};
+
+// Shared by all import/processing code. hardware_concurrency() - 1 workers
+// (the caller of parallel_for() is the +1).
+ThreadPool& GlobalThreadPool();
@@ -1,5 +1,6 @@
 #pragma once
 #include <algorithm>
+#include <chrono>
 
 #include <cassert>
 #include <cstdlib>
@@ -18,3 +19,14 @@ inline void Panic(bool condition)
     assert(false);
     std::exit(1);
 }
+
+struct StopWatch
+{
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+    double elapsed_ms() const
+    {
+        const auto delta = std::chrono::steady_clock::now() - start_;
+        return std::chrono::duration<double, std::milli>(delta).count();
+    }
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Non-cryptographic 64-bit hash, 8 bytes per step (wyhash-like mixing).
+// Used to key on-disk caches by content; not stable across versions
+// of this file (bump cache versions when changing it).
+inline std::uint64_t Hash64_Mix(std::uint64_t a, std::uint64_t b)
+{
+    const std::uint64_t lo = (a ^ 0xa0761d6478bd642full) * (b ^ 0xe7037ed1a0b428dbull);
+    return (lo ^ (lo >> 32)) + (a >> 17) + (b << 7);
+}
+
+inline std::uint64_t Hash64(const void* data, std::size_t size, std::uint64_t seed = 0)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::uint64_t h = seed ^ (std::uint64_t(size) * 0x9e3779b97f4a7c15ull);
+    std::uint64_t lanes[4] = {h, h + 1, h + 2, h + 3};
+    std::size_t i = 0;
+    // 4 independent lanes to hide multiply latency.
+    for (; (i + 32) <= size; i += 32)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            std::uint64_t v = 0;
+            std::memcpy(&v, bytes + i + lane * 8, sizeof(v));
+            lanes[lane] = Hash64_Mix(lanes[lane], v);
+        }
+    }
+    h = Hash64_Mix(Hash64_Mix(lanes[0], lanes[1]), Hash64_Mix(lanes[2], lanes[3]));
+    for (; (i + 8) <= size; i += 8)
+    {
+        std::uint64_t v = 0;
+        std::memcpy(&v, bytes + i, sizeof(v));
+        h = Hash64_Mix(h, v);
+    }
+    if (i < size)
+    {
+        std::uint64_t v = 0;
+        std::memcpy(&v, bytes + i, size - i);
+        h = Hash64_Mix(h, v ^ 0xff);
+    }
+    return Hash64_Mix(h, std::uint64_t(size));
+}
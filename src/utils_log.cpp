@@ -0,0 +1,32 @@
+#include "utils_log.h"
+
+#include <Windows.h>
+#include <Psapi.h>
+
+#include <cstdarg>
+#include <cstdio>
+
+void LogDebug(const char* format, ...)
+{
+    char buffer[1024];
+    va_list args;
+    va_start(args, format);
+    const int length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length <= 0)
+    {
+        return;
+    }
+    ::OutputDebugStringA(buffer);
+}
+
+std::size_t GetPeakMemoryBytes()
+{
+    PROCESS_MEMORY_COUNTERS counters{};
+    counters.cb = sizeof(counters);
+    if (!::K32GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+}
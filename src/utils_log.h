@@ -0,0 +1,8 @@
+#pragma once
+#include <cstddef>
+
+// printf-like; goes to the debugger output (OutputDebugStringA).
+void LogDebug(const char* format, ...);
+
+// Peak working set of the process so far, bytes (0 if unknown).
+std::size_t GetPeakMemoryBytes();
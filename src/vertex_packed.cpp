@@ -0,0 +1,157 @@
+#include "vertex_packed.h"
+#include "utils.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <numbers>
+
+#include <cfloat>
+#include <cmath>
+
+static constexpr float c_unorm16_max = 65535.f;
+static constexpr float c_snorm16_max = 32767.f;
+
+static std::uint16_t ToUnorm16(float value)
+{
+    return std::uint16_t(std::clamp(std::round(value * c_unorm16_max), 0.f, c_unorm16_max));
+}
+
+static float FromUnorm16(std::uint16_t value)
+{
+    return float(value) / c_unorm16_max;
+}
+
+static std::int16_t ToSnorm16(float value)
+{
+    return std::int16_t(std::clamp(std::round(value * c_snorm16_max), -c_snorm16_max, c_snorm16_max));
+}
+
+// As D3D does: -32768 is -1 too.
+static float FromSnorm16(std::int16_t value)
+{
+    return std::max(float(value) / c_snorm16_max, -1.f);
+}
+
+static float SignNotZero(float value)
+{
+    return (value >= 0.f) ? 1.f : -1.f;
+}
+
+glm::vec2 VertexPacked_OctEncode(const glm::vec3& direction)
+{
+    const float l1 = (std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z));
+    if (l1 == 0.f)
+    {
+        return glm::vec2(0.f);
+    }
+    const glm::vec3 n = direction / l1;
+    if (n.z >= 0.f)
+    {
+        return glm::vec2(n.x, n.y);
+    }
+    return glm::vec2((1.f - std::abs(n.y)) * SignNotZero(n.x), (1.f - std::abs(n.x)) * SignNotZero(n.y));
+}
+
+glm::vec3 VertexPacked_OctDecode(const glm::vec2& encoded)
+{
+    glm::vec3 n(encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y));
+    const float t = std::clamp(-n.z, 0.f, 1.f);
+    n.x += (n.x >= 0.f) ? -t : t;
+    n.y += (n.y >= 0.f) ? -t : t;
+    return glm::normalize(n);
+}
+
+static void PackDirection(const glm::vec3& direction, std::int16_t (&packed)[2], float& max_error_degrees)
+{
+    const glm::vec2 encoded = VertexPacked_OctEncode(direction);
+    packed[0] = ToSnorm16(encoded.x);
+    packed[1] = ToSnorm16(encoded.y);
+    const float length = glm::length(direction);
+    if (length == 0.f)
+    {
+        return;
+    }
+    const glm::vec3 decoded = VertexPacked_OctDecode(glm::vec2(FromSnorm16(packed[0]), FromSnorm16(packed[1])));
+    // atan2() of |cross| & dot: acos() of a float close to 1 is far less precise than the error.
+    const glm::vec3 cross = glm::cross(decoded, direction);
+    const double radians = std::atan2(double(glm::length(cross)), double(glm::dot(decoded, direction)));
+    const float degrees = float(radians * 180.0 / std::numbers::pi);
+    max_error_degrees = std::max(max_error_degrees, degrees);
+}
+
+// 1 if the range is empty: all the values are offset then.
+static float RangeScale(float min, float max)
+{
+    return (max > min) ? (max - min) : 1.f;
+}
+
+VertexDequantize VertexPacked_Pack(
+    std::span<const Vertex> vertices,
+    std::span<PackedVertex> packed,
+    std::span<PackedTangent> tangents,
+    VertexPackError& error
+)
+{
+    Panic(packed.size() == vertices.size());
+    Panic(tangents.empty() || (tangents.size() == vertices.size()));
+    error = VertexPackError{};
+    glm::vec3 position_min(FLT_MAX);
+    glm::vec3 position_max(-FLT_MAX);
+    glm::vec2 uv_min(FLT_MAX);
+    glm::vec2 uv_max(-FLT_MAX);
+    for (const Vertex& v : vertices)
+    {
+        position_min = glm::min(position_min, v.position);
+        position_max = glm::max(position_max, v.position);
+        uv_min = glm::min(uv_min, v.texture_coord);
+        uv_max = glm::max(uv_max, v.texture_coord);
+    }
+    if (vertices.empty())
+    {
+        position_min = position_max = glm::vec3(0.f);
+        uv_min = uv_max = glm::vec2(0.f);
+    }
+    const glm::vec3 position_scale(
+        RangeScale(position_min.x, position_max.x),
+        RangeScale(position_min.y, position_max.y),
+        RangeScale(position_min.z, position_max.z)
+    );
+    const glm::vec2 uv_scale(RangeScale(uv_min.x, uv_max.x), RangeScale(uv_min.y, uv_max.y));
+
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Vertex& v = vertices[i];
+        PackedVertex& p = packed[i];
+        glm::vec3 decoded_position(0.f);
+        for (int k = 0; k < 3; ++k)
+        {
+            p.position[k] = ToUnorm16((v.position[k] - position_min[k]) / position_scale[k]);
+            decoded_position[k] = FromUnorm16(p.position[k]) * position_scale[k] + position_min[k];
+        }
+        p.position[3] = 0;
+        error.position = std::max(error.position, glm::length(decoded_position - v.position));
+
+        PackDirection(v.normal, p.normal, error.normal_degrees);
+        if (!tangents.empty())
+        {
+            PackDirection(v.tangent, tangents[i].tangent, error.tangent_degrees);
+        }
+
+        for (int k = 0; k < 2; ++k)
+        {
+            p.texture_coord[k] = ToUnorm16((v.texture_coord[k] - uv_min[k]) / uv_scale[k]);
+            const float decoded = FromUnorm16(p.texture_coord[k]) * uv_scale[k] + uv_min[k];
+            error.texture_coord = std::max(error.texture_coord, std::abs(decoded - v.texture_coord[k]));
+        }
+    }
+    const float diagonal = glm::length(position_max - position_min);
+    error.position_relative = (diagonal > 0.f) ? (error.position / diagonal) : 0.f;
+
+    VertexDequantize dequantize{};
+    dequantize.position_scale = glm::vec4(position_scale, 0.f);
+    dequantize.position_offset = glm::vec4(position_min, 0.f);
+    dequantize.texture_coord_transform = glm::vec4(uv_scale.x, uv_scale.y, uv_min.x, uv_min.y);
+    return dequantize;
+}
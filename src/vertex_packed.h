@@ -0,0 +1,63 @@
+#pragma once
+#include "vertex.h"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <span>
+
+#include <cstdint>
+
+// GPU-only compact Vertex (see RenderMesh::make(), vs_*_packed.hlsl), 16 bytes instead of 44
+// (+ 4 of PackedTangent for meshes with a normal map):
+// - position: 16-bit UNORM in the mesh bounds (w is padding);
+// - normal: octahedral, 16-bit SNORM;
+// - texture_coord: 16-bit UNORM in the mesh UV bounds.
+// Absent (zero) normals & tangents decode as +Z.
+struct PackedVertex
+{
+    std::uint16_t position[4];
+    std::int16_t normal[2];
+    std::uint16_t texture_coord[2];
+};
+static_assert(sizeof(PackedVertex) == 16);
+
+// Second vertex stream, only the normal map needs it: octahedral, 16-bit SNORM.
+struct PackedTangent
+{
+    std::int16_t tangent[2];
+};
+static_assert(sizeof(PackedTangent) == 4);
+
+// Per mesh, to the VS constants: unpacked = packed * scale + offset.
+struct VertexDequantize
+{
+    glm::vec4 position_scale;
+    glm::vec4 position_offset;
+    glm::vec4 texture_coord_transform; // xy = scale, zw = offset
+
+    bool operator==(const VertexDequantize& rhs) const = default;
+};
+
+// Maxima over the vertices, as decoded on the GPU.
+struct VertexPackError
+{
+    float position = 0.f;          // distance, model units
+    float position_relative = 0.f; // to the bounds diagonal
+    float normal_degrees = 0.f;
+    float tangent_degrees = 0.f;
+    float texture_coord = 0.f;
+};
+
+// packed.size() == vertices.size(); so is tangents.size(), unless empty (no tangents then).
+VertexDequantize VertexPacked_Pack(
+    std::span<const Vertex> vertices,
+    std::span<PackedVertex> packed,
+    std::span<PackedTangent> tangents,
+    VertexPackError& error
+);
+
+// Unit vector to [-1; 1]^2 and back (same as OctDecode() of vs_*_packed.hlsl).
+glm::vec2 VertexPacked_OctEncode(const glm::vec3& direction);
+glm::vec3 VertexPacked_OctDecode(const glm::vec2& encoded);